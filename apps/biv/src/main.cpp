@@ -146,10 +146,11 @@ RenderSample *render_sample_init(exo::ScopeStack &scope)
 	return app;
 }
 
-void render_sample_destroy(RenderSample * /*app*/)
+void render_sample_destroy(RenderSample *app)
 {
 	EXO_PROFILE_SCOPE;
 
+	app->painter.destroy();
 	cross::platform::destroy();
 }
 
@@ -212,8 +213,7 @@ bool char_checkbox(Ui &ui, const CharCheckbox &checkbox)
 
 static void display_ui(RenderSample *app)
 {
-	app->painter.index_offset = 0;
-	app->painter.vertex_bytes_offset = 0;
+	app->painter.begin_frame();
 	app->ui.new_frame();
 
 	auto content_rect = Rect{.pos = {0, 0}, .size = float2(int2(app->window->size.x, app->window->size.y))};
@@ -300,6 +300,7 @@ static void display_ui(RenderSample *app)
 
 	app->ui.pop_clip_rect();
 	app->ui.end_frame();
+	app->painter.end_frame();
 	app->window->set_cursor(static_cast<cross::Cursor>(app->ui.state.cursor));
 }
 
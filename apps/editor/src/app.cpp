@@ -8,6 +8,7 @@
 #include "engine/render_world_system.h"
 #include "engine/scene.h"
 #include "exo/format.h"
+#include "exo/logger.h"
 #include "exo/memory/scope_stack.h"
 #include "exo/profile.h"
 #include "exo/string_view.h"
@@ -51,6 +52,8 @@ App::App(exo::ScopeStack &scope)
 	this->painter =
 		Painter::create({vertex_data, 1_MiB}, {index_data, 1_MiB / sizeof(PrimitiveIndex)}, int2(1024, 1024));
 	this->painter.glyph_atlas_gpu_idx = 0; // null texture
+	this->painter.mode = PainterMode::Batched;
+	this->painter.glyph_cache.jobmanager = &this->jobmanager;
 
 	this->ui = ui::Ui::create(&this->ui_font, font_size_px, &this->painter);
 	this->docking = docking::create();
@@ -71,6 +74,7 @@ App::App(exo::ScopeStack &scope)
 App::~App()
 {
 	scene.destroy();
+	this->painter.destroy();
 	cross::platform::destroy();
 }
 
@@ -79,8 +83,9 @@ void App::display_ui(double dt)
 	EXO_PROFILE_SCOPE;
 	static ui::Activation s_last_frame_activation = {};
 
-	this->ui.painter->index_offset = 0;
-	this->ui.painter->vertex_bytes_offset = 0;
+	this->ui.painter->begin_frame();
+	// Glyphs are placed before they are drawn, their UVs of this frame stay valid
+	this->ui.painter->glyph_cache.defragment(16);
 	this->ui.new_frame();
 
 	auto fullscreen_rect = Rect{.pos = {0, 0}, .size = float2(int2(this->window->size.x, this->window->size.y))};
@@ -176,6 +181,16 @@ void App::display_ui(double dt)
 
 		auto rectsplit = RectSplit{content_rect, SplitDirection::Top};
 
+		if (ui::button_split(this->ui, rectsplit, "Compact blobs")) {
+			// Streamed uploads copy from the mapped archive, it cannot be rewritten while they are in flight
+			if (this->renderer.mesh_renderer.asset_reads_fence) {
+				this->renderer.mesh_renderer.asset_reads_fence->wait();
+			}
+			const usize reclaimed = this->asset_manager.compact_blobs();
+			exo::logger::info("[Editor] Compacting blobs reclaimed %zu bytes.\n", reclaimed);
+		}
+		rectsplit.split(0.5f * em);
+
 		// Resources
 		static auto scroll_offset = float2();
 		ui::label_split(this->ui, rectsplit, exo::formatf(scope, "Resources (offset %f):", scroll_offset.y));
@@ -221,6 +236,8 @@ void App::display_ui(double dt)
 
 	docking::end_docking(this->docking, this->ui);
 
+	// Over the viewport
+	this->painter.layer += 1;
 	histogram.push_time(float(dt));
 	auto histogram_rect = Rect{
 		.pos =
@@ -238,6 +255,7 @@ void App::display_ui(double dt)
 		});
 
 	this->ui.end_frame();
+	this->painter.end_frame();
 	s_last_frame_activation = this->ui.activation;
 	this->window->set_cursor(static_cast<cross::Cursor>(this->ui.state.cursor));
 }
@@ -294,17 +312,23 @@ void App::run()
 
 			// Gameplay
 			this->scene.update(inputs);
-			this->render_world = std::move(
-				this->scene.entity_world.get_system_registry().get_system<PrepareRenderWorld>()->render_world);
+			// The render world is kept by the system between frames, only its changes are uploaded
+			auto &render_world =
+				this->scene.entity_world.get_system_registry().get_system<PrepareRenderWorld>()->render_world;
 
 			// Render
-			this->render_world.main_camera_projection = camera::infinite_perspective(this->render_world.main_camera_fov,
+			render_world.main_camera_projection = camera::infinite_perspective(render_world.main_camera_fov,
 				this->viewport_size.x / this->viewport_size.y,
 				0.1f);
+			cull_instances(render_world.instance_bounds,
+				render_world.main_camera_projection * render_world.main_camera_view,
+				CullingSettings{},
+				&this->jobmanager,
+				render_world.culling);
 
 			DrawInput draw_input = {};
 			draw_input.world_viewport_size = this->viewport_size;
-			draw_input.world = &this->render_world;
+			draw_input.world = &render_world;
 			draw_input.painter = &this->painter;
 			auto draw_result = this->renderer.draw(draw_input);
 
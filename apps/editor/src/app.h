@@ -4,7 +4,6 @@
 #include "cross/jobmanager.h"
 #include "cross/window.h"
 #include "custom_ui.h"
-#include "engine/render_world.h"
 #include "engine/scene.h"
 #include "exo/maths/vectors.h"
 #include "gameplay/inputs.h"
@@ -50,8 +49,6 @@ private:
 
 	Inputs inputs;
 
-	RenderWorld render_world;
-
 	Scene scene;
 
 	cross::FileWatcher watcher;
@@ -1,8 +1,10 @@
 #include "mesh_renderer.h"
 #include "assets/asset_id.h"
 #include "assets/asset_manager.h"
+#include "assets/baked_asset.h"
 #include "assets/material.h"
 #include "assets/mesh.h"
+#include "assets/mesh_encoding.h"
 #include "assets/texture.h"
 #include "engine/camera.h"
 #include "engine/render_world.h"
@@ -63,13 +65,12 @@ MeshRenderer MeshRenderer::create(vulkan::Device &device)
 	renderer.mesh_uuid_map     = exo::Map<AssetId, Handle<RenderMesh>>::with_capacity(64);
 	renderer.material_uuid_map = exo::Map<AssetId, Handle<RenderMaterial>>::with_capacity(64);
 	renderer.texture_uuid_map  = exo::Map<AssetId, Handle<RenderTexture>>::with_capacity(64);
-	renderer.instances_buffer  = RingBuffer::create(device,
-		 {
-			 .name               = "Instances buffer",
-			 .size               = 128_KiB,
-			 .gpu_usage          = vulkan::storage_buffer_usage,
-			 .frame_queue_length = FRAME_QUEUE_LENGTH,
-        });
+	renderer.frame_arena       = exo::ArenaAllocator::with_reserve(64_MiB, "MeshRenderer frame");
+	renderer.instances_buffer  = device.create_buffer({
+		 .name  = "Instances buffer",
+		 .size  = sizeof(InstanceDescriptor) * MeshRenderer::MAX_INSTANCES,
+		 .usage = vulkan::storage_buffer_usage,
+    });
 	renderer.meshes_buffer     = device.create_buffer({
 			.name  = "Meshes buffer",
 			.size  = sizeof(MeshDescriptor) * (1 << 15),
@@ -174,6 +175,48 @@ static Handle<RenderMaterial> get_or_create_material(
 	return handle;
 }
 
+// Decode the mesh blobs directly into the upload buffer, `decode_data` is the Mesh
+static void decode_mesh_indices(exo::Span<const u8> blob, exo::Span<u8> out_data, const void *decode_data)
+{
+	const auto *mesh = static_cast<const Mesh *>(decode_data);
+	assets::decode_mesh_indices(mesh->encoding, mesh->submeshes, {}, blob, exo::reinterpret_span<u32>(out_data));
+}
+
+static void decode_mesh_positions(exo::Span<const u8> blob, exo::Span<u8> out_data, const void *decode_data)
+{
+	const auto *mesh = static_cast<const Mesh *>(decode_data);
+	assets::decode_mesh_positions(mesh->encoding, mesh->submeshes, blob, exo::reinterpret_span<float4>(out_data));
+}
+
+static void decode_mesh_uvs(exo::Span<const u8> blob, exo::Span<u8> out_data, const void *decode_data)
+{
+	const auto *mesh = static_cast<const Mesh *>(decode_data);
+	assets::decode_mesh_uvs(mesh->encoding, blob, exo::reinterpret_span<float2>(out_data));
+}
+
+// Meshes loaded from a baked file are decoded from its mapped submeshes, `decode_data` is the mapped file
+static void decode_baked_mesh_indices(exo::Span<const u8> blob, exo::Span<u8> out_data, const void *decode_data)
+{
+	const auto  file = static_cast<const cross::MappedFile *>(decode_data)->content();
+	const auto *mesh = get_baked_mesh(file);
+	assets::decode_mesh_indices(
+		mesh->encoding, mesh->submeshes.view(file), {}, blob, exo::reinterpret_span<u32>(out_data));
+}
+
+static void decode_baked_mesh_positions(exo::Span<const u8> blob, exo::Span<u8> out_data, const void *decode_data)
+{
+	const auto  file = static_cast<const cross::MappedFile *>(decode_data)->content();
+	const auto *mesh = get_baked_mesh(file);
+	assets::decode_mesh_positions(
+		mesh->encoding, mesh->submeshes.view(file), blob, exo::reinterpret_span<float4>(out_data));
+}
+
+static void decode_baked_mesh_uvs(exo::Span<const u8> blob, exo::Span<u8> out_data, const void *decode_data)
+{
+	const auto *mesh = get_baked_mesh(static_cast<const cross::MappedFile *>(decode_data)->content());
+	assets::decode_mesh_uvs(mesh->encoding, blob, exo::reinterpret_span<float2>(out_data));
+}
+
 static Handle<RenderMesh> get_or_create_mesh(
 	MeshRenderer &renderer, AssetManager *asset_manager, vulkan::Device &device, const AssetId &mesh_uuid)
 {
@@ -234,30 +277,81 @@ void register_upload_nodes(RenderGraph &graph,
 	AssetManager                       *asset_manager,
 	const RenderWorld                  &world)
 {
-	mesh_renderer.instances_buffer.start_frame();
-	mesh_renderer.drawcalls.clear();
+	// The draw calls and uploads are only read by the passes of the current frame
+	mesh_renderer.frame_arena.reset();
+	mesh_renderer.drawcalls        = Vec<SimpleDraw>::with_allocator(&mesh_renderer.frame_arena);
+	mesh_renderer.buffer_uploads   = Vec<RenderUploads>::with_allocator(&mesh_renderer.frame_arena);
+	mesh_renderer.image_uploads    = Vec<RenderImageUpload>::with_allocator(&mesh_renderer.frame_arena);
+	mesh_renderer.instance_uploads = Vec<RenderUploads>::with_allocator(&mesh_renderer.frame_arena);
+
+	// Upload the descriptors of the instances that changed, all of them when an update of the world was missed
+	{
+		const u32 instances_len = world.drawable_instances.len();
+		ASSERT(instances_len <= MeshRenderer::MAX_INSTANCES);
+
+		mesh_renderer.instance_meshes.resize(instances_len, Handle<RenderMesh>::invalid());
+		for (const u32 i_instance : world.removed_instances) {
+			mesh_renderer.instance_meshes[i_instance] = Handle<RenderMesh>::invalid();
+		}
+
+		InstanceRange all_instances = {};
+		const auto    dirty_ranges  = world.get_ranges_to_read(mesh_renderer.world_update_index, all_instances);
+
+		mesh_renderer.world_update_index = world.update_index;
+		for (const auto &range : dirty_ranges) {
+			if (range.begin == range.end) {
+				continue;
+			}
+
+			const usize range_size              = (range.end - range.begin) * sizeof(InstanceDescriptor);
+			auto [p_upload_data, upload_offset] = upload_buffer.allocate(range_size);
+			if (p_upload_data.empty()) {
+				// Try again with all the instances next frame
+				mesh_renderer.world_update_index = u64_invalid;
+				break;
+			}
+
+			auto p_instances = exo::reinterpret_span<InstanceDescriptor>(p_upload_data);
+			for (u32 i_instance = range.begin; i_instance < range.end; ++i_instance) {
+				const auto &instance   = world.drawable_instances[i_instance];
+				auto       &descriptor = p_instances[i_instance - range.begin];
+				descriptor             = {};
+				if (!instance.mesh_asset.is_valid()) {
+					descriptor.i_mesh_descriptor              = u32_invalid;
+					mesh_renderer.instance_meshes[i_instance] = Handle<RenderMesh>::invalid();
+					continue;
+				}
+
+				auto render_mesh_handle = get_or_create_mesh(mesh_renderer, asset_manager, device, instance.mesh_asset);
+				descriptor.transform                      = instance.world_transform;
+				descriptor.i_mesh_descriptor              = render_mesh_handle.get_index();
+				mesh_renderer.instance_meshes[i_instance] = render_mesh_handle;
+			}
 
-	// Gather instances of uploaded meshes
-	for (const auto &instance : world.drawable_instances) {
-		auto        render_mesh_handle = get_or_create_mesh(mesh_renderer, asset_manager, device, instance.mesh_asset);
-		const auto &render_mesh        = mesh_renderer.render_meshes.get(render_mesh_handle);
+			mesh_renderer.instance_uploads.push(RenderUploads{
+				.dst_buffer    = mesh_renderer.instances_buffer,
+				.dst_offset    = range.begin * sizeof(InstanceDescriptor),
+				.upload_offset = upload_offset,
+				.upload_size   = range_size,
+			});
+		}
+	}
+
+	// Draw the visible instances of uploaded meshes
+	for (const u32 i_instance : world.culling.visible_instances) {
+		const auto render_mesh_handle = mesh_renderer.instance_meshes[i_instance];
+		if (!render_mesh_handle.is_valid()) {
+			continue;
+		}
+		const auto &render_mesh = mesh_renderer.render_meshes.get(render_mesh_handle);
 		if (!render_mesh.is_uploaded) {
 			continue;
 		}
 
-		auto [p_data, instance_bytes_offset] =
-			mesh_renderer.instances_buffer.allocate(sizeof(InstanceDescriptor), sizeof(InstanceDescriptor));
-		ASSERT(!p_data.empty());
-		auto p_instance                 = exo::reinterpret_span<InstanceDescriptor>(p_data);
-		p_instance[0].i_mesh_descriptor = render_mesh_handle.get_index();
-		p_instance[0].transform         = instance.world_transform;
-
-		ASSERT(instance_bytes_offset % sizeof(InstanceDescriptor) == 0);
-
 		for (u32 i_submesh = 0; i_submesh < render_mesh.render_submeshes.len(); ++i_submesh) {
 			const auto &submesh = render_mesh.render_submeshes[i_submesh];
 			mesh_renderer.drawcalls.push(SimpleDraw{
-				.instance_offset = static_cast<u32>(instance_bytes_offset / sizeof(InstanceDescriptor)),
+				.instance_offset = i_instance,
 				.instance_count  = 1,
 				.index_count     = submesh.index_count,
 				.index_offset    = submesh.first_index,
@@ -267,9 +361,39 @@ void register_upload_nodes(RenderGraph &graph,
 		}
 	}
 
+	// Submit the uploads whose blobs were read in the background
+	if (mesh_renderer.asset_reads_fence) {
+		if (mesh_renderer.asset_reads_fence->is_done()) {
+			for (const auto &upload : mesh_renderer.streamed_buffer_uploads) {
+				mesh_renderer.buffer_uploads.push(upload);
+			}
+			for (const auto &upload : mesh_renderer.streamed_image_uploads) {
+				mesh_renderer.image_uploads.push(upload);
+			}
+			for (auto texture_handle : mesh_renderer.streamed_textures) {
+				mesh_renderer.render_textures.get(texture_handle).frame_uploaded = graph.i_frame + 3;
+			}
+			for (auto mesh_handle : mesh_renderer.streamed_meshes) {
+				mesh_renderer.render_meshes.get(mesh_handle).is_uploaded = true;
+			}
+
+			mesh_renderer.asset_reads.clear();
+			mesh_renderer.streamed_buffer_uploads.clear();
+			mesh_renderer.streamed_image_uploads.clear();
+			mesh_renderer.streamed_textures.clear();
+			mesh_renderer.streamed_meshes.clear();
+			mesh_renderer.asset_reads_fence = nullptr;
+		} else if (mesh_renderer.asset_reads_frame != upload_buffer.i_frame) {
+			// The reads are late, the upload buffer must not reuse their spans
+			upload_buffer.retain_previous_frames();
+		}
+	}
+	// Only one batch of reads is in flight, new uploads are streamed once it has been submitted
+	const bool can_stream = mesh_renderer.asset_reads_fence == nullptr;
+
 	// Upload new textures
 	for (auto [handle, p_render_texture] : mesh_renderer.render_textures) {
-		if (p_render_texture->frame_uploaded == u64_invalid) {
+		if (can_stream && p_render_texture->frame_uploaded == u64_invalid) {
 
 			auto *texture                       = asset_manager->get_asset_t<Texture>(p_render_texture->texture_asset);
 			auto [p_upload_data, upload_offset] = upload_buffer.allocate(texture->pixels_data_size);
@@ -283,14 +407,14 @@ void register_upload_nodes(RenderGraph &graph,
 				upload_offset,
 				upload_buffer.i_frame);
 
-			asset_manager->read_blob(texture->pixels_hash, p_upload_data);
-			mesh_renderer.image_uploads.push(RenderImageUpload{
+			mesh_renderer.asset_reads.push(BlobReadRequest{.blob_id = texture->pixels_hash, .data = p_upload_data});
+			mesh_renderer.streamed_image_uploads.push(RenderImageUpload{
 				.dst_image     = p_render_texture->image,
 				.upload_offset = upload_offset,
 				.upload_size   = texture->pixels_data_size,
 				.extent        = int3(texture->width, texture->height, texture->depth),
 			});
-			p_render_texture->frame_uploaded = graph.i_frame + 3;
+			mesh_renderer.streamed_textures.push(handle);
 		}
 	}
 
@@ -364,7 +488,7 @@ void register_upload_nodes(RenderGraph &graph,
 			}
 		}
 
-		if (!p_render_mesh->is_uploaded && materials_uploaded) {
+		if (can_stream && !p_render_mesh->is_uploaded && materials_uploaded) {
 
 			auto indices_size         = device.get_buffer_size(p_render_mesh->index_buffer);
 			auto positions_size       = device.get_buffer_size(p_render_mesh->positions_buffer);
@@ -384,26 +508,56 @@ void register_upload_nodes(RenderGraph &graph,
 				upload_offset,
 				upload_buffer.i_frame);
 
-			auto bread = asset_manager->read_blob(mesh_asset->indices_hash, p_upload_data);
-			mesh_renderer.buffer_uploads.push(RenderUploads{
+			// The reads of a mesh loaded from a baked file do not touch the Mesh asset
+			const void *decode_data      = mesh_asset;
+			auto        decode_indices   = decode_mesh_indices;
+			auto        decode_positions = decode_mesh_positions;
+			auto        decode_uvs       = decode_mesh_uvs;
+			if (const auto *baked_file = asset_manager->get_baked_file(mesh_asset->uuid)) {
+				decode_data      = baked_file;
+				decode_indices   = decode_baked_mesh_indices;
+				decode_positions = decode_baked_mesh_positions;
+				decode_uvs       = decode_baked_mesh_uvs;
+			}
+
+			mesh_renderer.asset_reads.push(BlobReadRequest{
+				.blob_id     = mesh_asset->indices_hash,
+				.data        = exo::Span<u8>(p_upload_data.data(), mesh_asset->indices_byte_size),
+				.decode      = decode_indices,
+				.decode_data = decode_data,
+			});
+			mesh_renderer.streamed_buffer_uploads.push(RenderUploads{
 				.dst_buffer    = p_render_mesh->index_buffer,
 				.upload_offset = upload_offset,
 				.upload_size   = indices_size,
 			});
+			usize bread = indices_size;
 
-			bread += asset_manager->read_blob(mesh_asset->positions_hash, p_upload_data.subspan(bread));
-			mesh_renderer.buffer_uploads.push(RenderUploads{
+			mesh_renderer.asset_reads.push(BlobReadRequest{
+				.blob_id     = mesh_asset->positions_hash,
+				.data        = exo::Span<u8>(p_upload_data.data() + bread, mesh_asset->positions_byte_size),
+				.decode      = decode_positions,
+				.decode_data = decode_data,
+			});
+			mesh_renderer.streamed_buffer_uploads.push(RenderUploads{
 				.dst_buffer    = p_render_mesh->positions_buffer,
 				.upload_offset = upload_offset + indices_size,
 				.upload_size   = positions_size,
 			});
+			bread += positions_size;
 
-			bread += asset_manager->read_blob(mesh_asset->uvs_hash, p_upload_data.subspan(bread));
-			mesh_renderer.buffer_uploads.push(RenderUploads{
+			mesh_renderer.asset_reads.push(BlobReadRequest{
+				.blob_id     = mesh_asset->uvs_hash,
+				.data        = exo::Span<u8>(p_upload_data.data() + bread, mesh_asset->uvs_byte_size),
+				.decode      = decode_uvs,
+				.decode_data = decode_data,
+			});
+			mesh_renderer.streamed_buffer_uploads.push(RenderUploads{
 				.dst_buffer    = p_render_mesh->uvs_buffer,
 				.upload_offset = upload_offset + indices_size + positions_size,
 				.upload_size   = uvs_size,
 			});
+			bread += uvs_size;
 
 			auto p_upload_submeshes = exo::reinterpret_span<SubmeshDescriptor>(p_upload_data.subspan(bread));
 			for (usize i_submesh = 0; i_submesh < mesh_asset->submeshes.len(); ++i_submesh) {
@@ -420,7 +574,7 @@ void register_upload_nodes(RenderGraph &graph,
 				}
 			}
 			bread += submeshes_size;
-			mesh_renderer.buffer_uploads.push(RenderUploads{
+			mesh_renderer.streamed_buffer_uploads.push(RenderUploads{
 				.dst_buffer    = p_render_mesh->submesh_buffer,
 				.upload_offset = upload_offset + indices_size + positions_size + uvs_size,
 				.upload_size   = submeshes_size,
@@ -434,18 +588,24 @@ void register_upload_nodes(RenderGraph &graph,
 			p_upload_descriptor[0].uvs_buffer_descriptor = device.get_buffer_storage_index(p_render_mesh->uvs_buffer);
 			p_upload_descriptor[0].submesh_buffer_descriptor =
 				device.get_buffer_storage_index(p_render_mesh->submesh_buffer);
-			mesh_renderer.buffer_uploads.push(RenderUploads{
+			mesh_renderer.streamed_buffer_uploads.push(RenderUploads{
 				.dst_buffer    = mesh_renderer.meshes_buffer,
 				.dst_offset    = handle.get_index() * sizeof(MeshDescriptor),
 				.upload_offset = upload_offset + indices_size + positions_size + uvs_size + submeshes_size,
 				.upload_size   = sizeof(MeshDescriptor),
 			});
 
-			p_render_mesh->is_uploaded = true;
+			mesh_renderer.streamed_meshes.push(handle);
 			break;
 		}
 	}
 
+	// Read the blobs of the new uploads in the background
+	if (can_stream && !mesh_renderer.asset_reads.is_empty()) {
+		mesh_renderer.asset_reads_fence = asset_manager->read_blobs_async(mesh_renderer.asset_reads);
+		mesh_renderer.asset_reads_frame = upload_buffer.i_frame;
+	}
+
 	// Submit upload commands
 	if (!mesh_renderer.image_uploads.is_empty()) {
 		exo::Span<RenderImageUpload> uploads_span = mesh_renderer.image_uploads;
@@ -491,10 +651,27 @@ void register_upload_nodes(RenderGraph &graph,
 		});
 		mesh_renderer.buffer_uploads.clear();
 	}
+	if (!mesh_renderer.instance_uploads.is_empty()) {
+		// The previous frames can still read the instances
+		exo::Span<RenderUploads> uploads_span     = mesh_renderer.instance_uploads;
+		auto                     instances_buffer = mesh_renderer.instances_buffer;
+		graph.raw_pass(
+			[uploads_span, instances_buffer](RenderGraph & /*graph*/, PassApi &api, vulkan::ComputeWork &cmd) {
+				cmd.barrier(instances_buffer, vulkan::BufferUsage::TransferDst);
+				for (const auto &upload : uploads_span) {
+					std::tuple<usize, usize, usize> offsets_size = {upload.upload_offset,
+						upload.dst_offset,
+						upload.upload_size};
+					cmd.copy_buffer(api.upload_buffer.buffer, upload.dst_buffer, exo::Span{&offsets_size, 1});
+				}
+				cmd.barrier(instances_buffer, vulkan::BufferUsage::GraphicsShaderRead);
+			});
+		mesh_renderer.instance_uploads.clear();
+	}
 
 	mesh_renderer.view                 = world.main_camera_view;
 	mesh_renderer.projection           = world.main_camera_projection;
-	mesh_renderer.instances_descriptor = device.get_buffer_storage_index(mesh_renderer.instances_buffer.buffer);
+	mesh_renderer.instances_descriptor = device.get_buffer_storage_index(mesh_renderer.instances_buffer);
 	mesh_renderer.meshes_descriptor    = device.get_buffer_storage_index(mesh_renderer.meshes_buffer);
 	mesh_renderer.materials_descriptor = device.get_buffer_storage_index(mesh_renderer.materials_buffer);
 }
@@ -5,15 +5,20 @@
 #include "exo/collections/vector.h"
 #include "exo/maths/matrices.h"
 #include "exo/maths/u128.h"
+#include "exo/memory/arena_allocator.h"
 
 #include "render/ring_buffer.h"
 #include "render/vulkan/buffer.h"
 #include "render/vulkan/pipelines.h"
 
 #include "assets/asset_id.h"
+#include "cross/jobs/waitable.h"
+
+#include <memory>
 
 struct RenderWorld;
 struct AssetManager;
+struct BlobReadRequest;
 struct RenderGraph;
 struct TextureDesc;
 namespace vulkan
@@ -73,12 +78,6 @@ struct RenderMesh
 	bool                   is_uploaded      = false;
 };
 
-struct BlobReadRequest
-{
-	exo::u128     blob_id;
-	exo::Span<u8> data;
-};
-
 // -- Draw
 
 struct SimpleDraw
@@ -106,16 +105,30 @@ struct MeshRenderer
 	exo::Map<AssetId, Handle<RenderTexture>> texture_uuid_map;
 	exo::Pool<RenderTexture>                 render_textures;
 
-	RingBuffer instances_buffer;
-	u32        instances_descriptor = u32_invalid;
+	// Instance descriptors are stored in the slot of their drawable instance, only the changed slots are uploaded
+	static constexpr u32    MAX_INSTANCES = 1 << 17;
+	Handle<vulkan::Buffer>  instances_buffer;
+	u32                     instances_descriptor = u32_invalid;
+	Vec<Handle<RenderMesh>> instance_meshes; // invalid for free slots
+	u64                     world_update_index = u64_invalid; // last update of the render world that was uploaded
 
 	Handle<vulkan::GraphicsProgram> simple_program;
 
-	// store intermediate result
+	// store intermediate result, they are allocated in the frame arena
+	exo::ArenaAllocator    frame_arena;
 	Vec<RenderUploads>     buffer_uploads;
 	Vec<RenderImageUpload> image_uploads;
-	Vec<BlobReadRequest>   asset_reads;
+	Vec<RenderUploads>     instance_uploads;
 	Vec<SimpleDraw>        drawcalls;
+
+	// Uploads whose blobs are read by the job manager, they are submitted the frame after the fence is done
+	Vec<BlobReadRequest>             asset_reads;
+	Vec<RenderUploads>               streamed_buffer_uploads;
+	Vec<RenderImageUpload>           streamed_image_uploads;
+	Vec<Handle<RenderTexture>>       streamed_textures;
+	Vec<Handle<RenderMesh>>          streamed_meshes;
+	std::unique_ptr<cross::Waitable> asset_reads_fence;
+	u32                              asset_reads_frame = 0;
 	float4x4               view       = {};
 	float4x4               projection = {};
 
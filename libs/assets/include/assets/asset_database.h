@@ -2,6 +2,7 @@
 #include "assets/asset_database.h"
 #include "assets/asset_id.h"
 #include "cross/jobs/waitable.h"
+#include "cross/mapped_file.h"
 #include "exo/collections/map.h"
 #include "exo/collections/pool.h"
 #include "exo/collections/set.h"
@@ -22,6 +23,12 @@ struct JobManager;
 struct Asset;
 struct AssetManager;
 
+// Version of the layout of the compiled assets, bump it when the serialization of an asset changes. A database written
+// with another version (or another BAKED_ASSET_VERSION) is discarded, its resources are imported again and their
+// compiled assets are overwritten.
+inline constexpr u32 ASSET_FORMAT_VERSION = 1;
+inline constexpr u32 ASSET_DATABASE_MAGIC = 0x58424441; // "ADBX"
+
 struct Resource
 {
 	AssetId asset_id = {};
@@ -36,6 +43,7 @@ struct AssetAsyncRequest
 	{
 		AssetId asset_id = {};
 		refl::BasePtr<Asset> result = {};
+		std::unique_ptr<cross::MappedFile> baked_file = {}; // kept mapped when `result` was read in place
 	};
 	std::unique_ptr<Data> data = {};
 	std::unique_ptr<cross::Waitable> waitable = {};
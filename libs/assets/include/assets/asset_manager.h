@@ -2,19 +2,26 @@
 #include "assets/asset.h"
 #include "assets/asset_database.h"
 #include "assets/asset_id.h"
+#include "assets/blob_archive.h"
 #include "assets/importers/importer.h"
 #include "exo/collections/dynamic_array.h"
+#include "exo/collections/map.h"
 #include "exo/maths/u128.h"
+#include "exo/memory/string_repository.h"
 #include "exo/path.h"
 #include "exo/profile.h"
 #include "reflection/reflection.h"
 
+#include <memory>
+#include <mutex>
+
 namespace cross
 {
 struct FileWatcher;
 struct Watch;
 struct WatchEvent;
 struct JobManager;
+struct Waitable;
 } // namespace cross
 
 enum struct AssetErrors : int
@@ -26,11 +33,27 @@ enum struct AssetErrors : int
 	InvalidUUID,
 };
 
+struct BlobReadRequest
+{
+	exo::u128     blob_id = {};
+	exo::Span<u8> data    = {};
+	// Optional, called by the read job to decode the blob into `data` instead of copying it
+	void (*decode)(exo::Span<const u8> blob, exo::Span<u8> out_data, const void *decode_data) = nullptr;
+	const void *decode_data                                                                  = nullptr;
+
+	// Filled by `read_blobs_async`
+	Option<exo::Span<const u8>> packed_blob = {};
+	usize                       bytes_read  = 0;
+};
+
 struct AssetManager
 {
 	exo::DynamicArray<Importer *, 16> importers; // import resource into assets
 	AssetDatabase                     database;
+	BlobArchive                       blob_archive;
 	cross::JobManager                *jobmanager;
+	// Baked files of the loaded assets, they stay mapped to be read in place until the asset is unloaded
+	exo::Map<AssetId, std::unique_ptr<cross::MappedFile>> baked_files;
 
 	// --
 
@@ -54,6 +77,9 @@ struct AssetManager
 
 	void unload_asset(const AssetId &id);
 
+	// Returns the mapped file of an asset that was loaded from a baked file, null otherwise
+	const cross::MappedFile *get_baked_file(const AssetId &id);
+
 	// -- Async loading
 	bool is_loaded(const AssetId &id)
 	{
@@ -79,15 +105,34 @@ struct AssetManager
 	// Binary data in assets is serialized as 'blobs' and is addresed using content hash
 	usize     read_blob(exo::u128 blob_hash, exo::Span<u8> out_data);
 	exo::u128 save_blob(exo::Span<const u8> blob_data);
-
-	static refl::BasePtr<Asset> _load_from_disk(const AssetId &id);
+	// Returns a slice of the mapped blob archive, valid until the archive is closed
+	Option<exo::Span<const u8>> get_blob(exo::u128 blob_hash);
+	// Fill the requests' data from the job manager, the returned waitable is the fence of all the reads.
+	// The requests must stay alive and the blob archive must not be closed until it is done.
+	std::unique_ptr<cross::Waitable> read_blobs_async(exo::Span<BlobReadRequest> requests);
+	// Rewrite the blob archive with only the blobs referenced by compiled assets, returns the number of bytes reclaimed
+	usize compact_blobs();
+
+	// Returns an invalid asset when the file cannot be read, the file is kept in `out_baked_file` when it is baked
+	static refl::BasePtr<Asset> _load_from_disk(const AssetId &id, std::unique_ptr<cross::MappedFile> &out_baked_file);
+	void                        _reimport_on_next_start(exo::Span<const AssetId> failed_assets);
 	void                        _save_to_disk(refl::BasePtr<Asset> asset);
 	void                        _import_resources(exo::Span<const Handle<Resource>> records);
 };
 
+// Resources are imported in parallel, the database, the blob archive and the string repository are shared by all
+// importers
+struct ImportLocks
+{
+	std::mutex database;
+	std::mutex blobs;
+	std::mutex strings;
+};
+
 struct ImporterApi
 {
 	AssetManager &manager;
+	ImportLocks  &locks;
 
 	// --
 
@@ -102,6 +147,8 @@ struct ImporterApi
 
 		T *new_asset    = static_cast<T *>(asset_ptr);
 		new_asset->uuid = id;
+
+		std::lock_guard lock{locks.database};
 		manager.database.insert_asset(refl::BasePtr<Asset>(new_asset));
 		return new_asset;
 	}
@@ -110,8 +157,19 @@ struct ImporterApi
 	template <typename T>
 	T *retrieve_asset(AssetId id)
 	{
+		std::lock_guard lock{locks.database};
 		return manager.get_asset_t<T>(id);
 	}
 
-	inline exo::u128 save_blob(exo::Span<const u8> data) { return manager.save_blob(data); }
+	inline exo::u128 save_blob(exo::Span<const u8> data)
+	{
+		std::lock_guard lock{locks.blobs};
+		return manager.save_blob(data);
+	}
+
+	inline const char *intern(exo::StringView s)
+	{
+		std::lock_guard lock{locks.strings};
+		return exo::tls_string_repository->intern(s);
+	}
 };
@@ -0,0 +1,146 @@
+#pragma once
+#include "exo/collections/span.h"
+#include "exo/collections/vector.h"
+#include "exo/maths/numerics.h"
+#include "exo/maths/u128.h"
+#include "exo/maths/vectors.h"
+#include "exo/option.h"
+#include "reflection/reflection.h"
+
+#include "assets/mesh.h"
+
+struct Asset;
+
+/**
+   Baked assets are stored in a layout that is read in place from the mapped `.asset` file, instead of being
+   reconstructed field by field by the serializer.
+
+   The file is a BakedAssetHeader followed by the root struct of the asset (BakedMesh, BakedTexture). Arrays and
+   strings are BakedArray: an offset from the start of the file and a length, every array starts on BAKED_ALIGNMENT.
+   `validate_baked_asset` checks that every array is inside of the file, the views returned afterwards can be used
+   without checks as long as the file is mapped.
+   Files that do not start with BAKED_ASSET_MAGIC are serialized assets, they are read with the serializer.
+ **/
+inline constexpr u32   BAKED_ASSET_MAGIC   = 0x454b4142; // "BAKE"
+inline constexpr u32   BAKED_ASSET_VERSION = 1;
+inline constexpr usize BAKED_ALIGNMENT     = 16;
+
+enum struct BakedAssetType : u32
+{
+	Mesh,
+	Texture,
+	Count
+};
+
+struct BakedAssetHeader
+{
+	u32            magic    = BAKED_ASSET_MAGIC;
+	u32            version  = BAKED_ASSET_VERSION;
+	BakedAssetType type     = BakedAssetType::Count;
+	u32            padding  = 0;
+	u64            size     = 0; // size of the whole file
+	u64            padding1 = 0;
+};
+static_assert(sizeof(BakedAssetHeader) == 32);
+
+template <typename T>
+struct BakedArray
+{
+	u64 offset = 0; // from the start of the file
+	u64 len    = 0;
+
+	exo::Span<const T> view(exo::Span<const u8> file) const
+	{
+		return exo::Span<const T>(reinterpret_cast<const T *>(file.data() + this->offset), this->len);
+	}
+};
+
+struct BakedHash
+{
+	u64 hash0 = 0;
+	u64 hash1 = 0;
+
+	exo::u128 get() const { return exo::u128_from_u64(this->hash1, this->hash0); }
+};
+
+struct BakedAssetId
+{
+	BakedArray<char> name;
+	u64              name_hash = 0;
+};
+
+// Fields of Asset
+struct BakedAssetInfo
+{
+	BakedAssetId             uuid;
+	BakedArray<char>         name;
+	BakedArray<BakedAssetId> dependencies;
+};
+
+struct BakedSubMesh
+{
+	u32          first_index  = 0;
+	u32          first_vertex = 0;
+	u32          index_count  = 0;
+	u32          padding      = 0;
+	BakedAssetId material     = {};
+	float3       bounds_min   = {};
+	float3       bounds_max   = {};
+};
+
+struct BakedMeshLod
+{
+	BakedHash              indices_hash      = {};
+	u64                    indices_byte_size = 0;
+	float                  error             = 0.0f;
+	u32                    padding           = 0;
+	BakedArray<SubMeshLod> submeshes;
+};
+
+struct BakedMesh
+{
+	BakedAssetInfo           asset;
+	MeshEncoding             encoding = {};
+	u32                      padding  = 0;
+	BakedHash                indices_hash;
+	u64                      indices_byte_size = 0;
+	BakedHash                positions_hash;
+	u64                      positions_byte_size = 0;
+	BakedHash                uvs_hash;
+	u64                      uvs_byte_size = 0;
+	BakedHash                bvh_hash;
+	u64                      bvh_byte_size = 0;
+	BakedArray<BakedSubMesh> submeshes;
+	BakedArray<BakedMeshLod> lods;
+};
+static_assert(sizeof(MeshEncoding) == 4);
+
+struct BakedTexture
+{
+	BakedAssetInfo  asset;
+	u16             format    = 0; // PixelFormat
+	u16             extension = 0; // ImageExtension
+	i32             width     = 0;
+	i32             height    = 0;
+	i32             depth     = 0;
+	i32             levels    = 0;
+	u32             padding   = 0;
+	BakedArray<u64> mip_offsets;
+	BakedHash       pixels_hash;
+	u64             pixels_data_size = 0;
+};
+
+// Write `asset` in the baked layout, returns false when its type cannot be baked (it has to be serialized)
+bool bake_asset(refl::BasePtr<Asset> asset, Vec<u8> &out_file);
+
+// True when the file starts with a baked header, even of another version
+bool is_baked_asset(exo::Span<const u8> file);
+// Check the header and the bounds of every array, returns the type of the asset when the file can be read in place
+Option<BakedAssetType> validate_baked_asset(exo::Span<const u8> file);
+
+// Views of a validated file
+const BakedMesh    *get_baked_mesh(exo::Span<const u8> file);
+const BakedTexture *get_baked_texture(exo::Span<const u8> file);
+
+// Create the asset of a validated file, arrays are copied at once
+refl::BasePtr<Asset> unbake_asset(exo::Span<const u8> file);
@@ -0,0 +1,122 @@
+#pragma once
+#include "cross/mapped_file.h"
+#include "exo/collections/span.h"
+#include "exo/collections/vector.h"
+#include "exo/maths/numerics.h"
+#include "exo/maths/u128.h"
+#include "exo/option.h"
+#include "exo/path.h"
+
+#include <cstdio>
+
+/**
+   Content-addressed blobs packed in a single append-only file.
+
+   The pack is a sequence of records, each record is a BlobRecordHeader followed by the blob bytes and starts on
+   BLOB_ALIGNMENT. The index file is a BlobIndexHeader followed by BlobIndexEntry sorted by hash, it is mapped once
+   when opening the archive and binary searched.
+   Saved blobs are appended to the pack and kept in a pending list until `commit` rewrites the index, records that
+   were appended after the last commit (crash, no commit) are recovered from the pack when opening it.
+ **/
+inline constexpr usize       BLOB_ALIGNMENT     = 16;
+inline constexpr u32         BLOB_INDEX_MAGIC   = 0x58444942;         // "BIDX"
+inline constexpr u32         BLOB_INDEX_VERSION = 1;
+inline constexpr u64         BLOB_RECORD_MAGIC  = 0x424f4c424b434150; // "PACKBLOB"
+inline constexpr const char *BLOB_PACK_NAME     = "blobs.pack";
+inline constexpr const char *BLOB_INDEX_NAME    = "blobs.index";
+
+struct BlobIndexHeader
+{
+	u32 magic       = BLOB_INDEX_MAGIC;
+	u32 version     = BLOB_INDEX_VERSION;
+	u64 entries_len = 0;
+	u64 pack_size   = 0; // size of the pack when the index was written
+	u64 padding     = 0;
+};
+static_assert(sizeof(BlobIndexHeader) == 32);
+
+struct BlobIndexEntry
+{
+	u64 hash0  = 0;
+	u64 hash1  = 0;
+	u64 offset = 0; // offset of the blob bytes in the pack
+	u64 size   = 0;
+};
+static_assert(sizeof(BlobIndexEntry) == 32);
+
+struct BlobRecordHeader
+{
+	u64 magic = BLOB_RECORD_MAGIC;
+	u64 hash0 = 0;
+	u64 hash1 = 0;
+	u64 size  = 0;
+};
+static_assert(sizeof(BlobRecordHeader) == 32);
+
+// Blob hash split in two words, exo::u128 is a vector type and cannot be stored in containers without losing its
+// alignment attribute
+struct BlobHash
+{
+	u64 hash0 = 0;
+	u64 hash1 = 0;
+
+	static BlobHash from(exo::u128 blob_hash)
+	{
+		BlobHash result = {};
+		exo::u128_to_u64(blob_hash, &result.hash0, &result.hash1);
+		return result;
+	}
+	exo::u128 get() const { return exo::u128_from_u64(this->hash1, this->hash0); }
+};
+
+struct BlobPackSegment
+{
+	usize             offset = 0;
+	cross::MappedFile file   = {};
+};
+
+struct BlobArchive
+{
+	exo::Path pack_path;
+	exo::Path index_path;
+
+	// Sorted entries of the last commit
+	cross::MappedFile               index_file;
+	exo::Span<const BlobIndexEntry> indexed_entries;
+	// Blobs appended since the last commit
+	Vec<BlobIndexEntry> pending_entries;
+
+	// The pack is mapped in segments: a blob that was appended after the last mapping maps the new tail of the pack.
+	// Segments are only unmapped when closing the archive, slices returned by `get` stay valid until then.
+	Vec<BlobPackSegment> pack_segments;
+	usize                pack_mapped_size = 0;
+	usize                pack_size        = 0;
+	FILE                *pack_fp          = nullptr;
+
+	// --
+
+	// Open (or create) the archive stored in `directory`
+	static BlobArchive open(const exo::Path &directory);
+	// Write the index and unmap everything
+	void close();
+
+	// Returns a slice of the mapped pack, or nothing when the blob is not in the archive
+	Option<exo::Span<const u8>> get(exo::u128 blob_hash);
+	// Copy a blob into `out_data` and returns its size, 0 when the blob is not in the archive
+	usize read(exo::u128 blob_hash, exo::Span<u8> out_data);
+	bool  contains(exo::u128 blob_hash) const;
+
+	// Append a blob to the pack, blobs that are already in the archive are not written again
+	void save(exo::u128 blob_hash, exo::Span<const u8> blob_data);
+
+	// Merge the pending entries in the index and write it to disk
+	void commit();
+
+	// Rewrite the pack stored in `directory` with only the blobs in `live_blobs`, returns the number of bytes
+	// reclaimed. The archive of that directory must be closed.
+	// The old index is removed before the pack is replaced, an interrupted compaction is recovered from the pack.
+	static usize compact(const exo::Path &directory, exo::Span<const BlobHash> live_blobs);
+
+	const BlobIndexEntry *_find(exo::u128 blob_hash) const;
+	Option<exo::Span<const u8>> _map_entry(const BlobIndexEntry &entry);
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include "exo/collections/span.h"
+#include "exo/collections/vector.h"
+#include "exo/maths/aabb.h"
+#include "exo/maths/numerics.h"
+#include "exo/maths/vectors.h"
+#include <limits>
+
+namespace cross
+{
+struct JobManager;
+}
+
+/**
+   Bounding volume hierarchies in the layout traversed by engine/bvh.h.
+   Nodes are stored depth-first: the first child of an inner node is the next node, `next_node` is the node following
+   its subtree (u32_invalid for the last one). Leaves contain exactly one primitive, so a tree over N primitives has
+   2N - 1 nodes and the range of every subtree is known before building it.
+ **/
+
+// Matches BVHNode in engine/globals.h
+struct BVHNode
+{
+	float3 bbox_min;
+	u32    prim_index = u32_invalid; // u32_invalid for inner nodes
+	float3 bbox_max;
+	u32    next_node = u32_invalid;
+};
+static_assert(sizeof(BVHNode) == 8 * sizeof(u32));
+
+struct BVHBuildSettings
+{
+	u32 bin_count = 16; // SAH bins per axis, at most 32
+	// Subtrees with less primitives are built by a single job
+	u32 parallel_threshold = 16 << 10;
+};
+
+// Matches Ray in engine/raytracing.h
+struct BVHRay
+{
+	float3 origin;
+	float  t_min = 0.0f;
+	float3 direction;
+	float  t_max = std::numeric_limits<float>::infinity();
+};
+
+struct BVHHit
+{
+	float  d               = std::numeric_limits<float>::infinity();
+	u32    box_inter_count = 0;
+	float3 barycentrics;
+	u32    triangle_id = u32_invalid; // first index of the triangle
+};
+
+// Binned SAH builders, the subtrees are built in parallel when `jobmanager` is not null.
+// The BLAS leaves reference the first index of their triangle, the TLAS leaves the index of their bounds.
+void build_blas(const BVHBuildSettings &settings,
+	const cross::JobManager            *jobmanager,
+	exo::Span<const u32>                indices,
+	exo::Span<const float4>             positions,
+	Vec<BVHNode>                       &out_nodes);
+void build_tlas(const BVHBuildSettings &settings,
+	const cross::JobManager            *jobmanager,
+	exo::Span<const exo::AABB>          instance_bounds,
+	Vec<BVHNode>                       &out_nodes);
+
+// Updates the bounds of a TLAS after its instances moved, the topology is kept so its quality slowly degrades
+void refit_tlas(exo::Span<BVHNode> nodes, exo::Span<const exo::AABB> instance_bounds);
+
+// Reference traversal on the CPU, same as blas_closest_hit in engine/bvh.h
+bool blas_closest_hit(exo::Span<const BVHNode> nodes,
+	exo::Span<const u32>                       indices,
+	exo::Span<const float4>                    positions,
+	const BVHRay                              &ray,
+	BVHHit                                    &hit);
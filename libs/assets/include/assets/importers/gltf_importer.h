@@ -1,5 +1,7 @@
 #pragma once
 #include "assets/importers/importer.h"
+#include "assets/importers/mesh_processing.h"
+#include "assets/mesh.h"
 
 enum struct GLTFError
 {
@@ -11,6 +13,15 @@ struct GLTFImporter final : Importer
 {
 	static constexpr u64 importer_id = 0x1;
 
+	MeshProcessingSettings mesh_settings = {};
+	// 16-bit indices are only used without the codec, when every submesh has less than 65536 vertices
+	MeshEncoding mesh_encoding = {
+		.indices_u16       = true,
+		.positions_unorm16 = true,
+		.uvs_half          = true,
+		.meshopt_codec     = true,
+	};
+
 	bool can_import_extension(exo::Span<exo::StringView const> extensions) override;
 	bool can_import_blob(exo::Span<u8 const> data) override;
 
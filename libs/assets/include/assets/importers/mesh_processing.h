@@ -0,0 +1,38 @@
+#pragma once
+#include "exo/collections/vector.h"
+#include "exo/maths/numerics.h"
+#include "exo/maths/vectors.h"
+
+struct SubMesh;
+struct SubMeshLod;
+
+struct MeshProcessingSettings
+{
+	// Deduplicate vertices, reorder triangles for the vertex cache and overdraw, and vertices for fetch locality
+	bool optimize = true;
+	// Number of simplified index buffers generated for each mesh
+	u32   lod_count        = 0;
+	float lod_index_ratio  = 0.5f;  // index count of a lod relative to the previous level
+	float lod_target_error = 0.02f; // relative to the mesh extents
+	// Build a BVH over the triangles of the most detailed level for the path tracer
+	bool build_bvh = true;
+};
+
+// Vertex and index streams of a mesh being imported, submeshes own contiguous ranges of vertices and indices
+struct MeshStreams
+{
+	Vec<float4>  positions;
+	Vec<float2>  uvs;
+	Vec<u32>     indices;
+	Vec<SubMesh> submeshes;
+};
+
+struct MeshLodStreams
+{
+	Vec<u32>        indices;
+	Vec<SubMeshLod> submeshes;
+	float           error = 0.0f;
+};
+
+// Optimizes each submesh of `mesh` in place and fills `out_lods` with `settings.lod_count` levels
+void process_mesh(const MeshProcessingSettings &settings, MeshStreams &mesh, Vec<MeshLodStreams> &out_lods);
@@ -13,17 +13,53 @@ struct SubMesh
 	u32     first_vertex = 0;
 	u32     index_count  = 0;
 	AssetId material     = {};
+	float3  bounds_min   = {};
+	float3  bounds_max   = {};
 
 	inline bool operator==(const SubMesh &other) const = default;
 };
 void serialize(exo::Serializer &serializer, SubMesh &data);
 
+struct SubMeshLod
+{
+	u32 first_index = 0;
+	u32 index_count = 0;
+
+	inline bool operator==(const SubMeshLod &other) const = default;
+};
+void serialize(exo::Serializer &serializer, SubMeshLod &data);
+
+// Simplified index buffer of a whole mesh, it indexes the vertices of the full detail mesh
+struct MeshLod
+{
+	exo::u128       indices_hash;
+	usize           indices_byte_size = 0;
+	float           error             = 0.0f; // simplification error, relative to the mesh extents
+	Vec<SubMeshLod> submeshes;                // one per submesh of the mesh
+};
+void serialize(exo::Serializer &serializer, MeshLod &data);
+
+// How the blobs of a mesh are stored, they are decoded to u32 indices, float4 positions and float2 uvs when loaded.
+struct MeshEncoding
+{
+	bool indices_u16       = false; // indices are relative to the first vertex of their submesh, unused by the codec
+	bool positions_unorm16 = false; // 4 x u16 per position, relative to the bounds of its submesh
+	bool uvs_half          = false;
+	bool meshopt_codec     = false; // blobs are compressed with the vertex and index codecs of meshoptimizer
+
+	inline bool operator==(const MeshEncoding &other) const = default;
+};
+void serialize(exo::Serializer &serializer, MeshEncoding &data);
+
 struct Mesh : Asset
 {
 	using Self  = Mesh;
 	using Super = Asset;
 	REFL_REGISTER_TYPE_WITH_SUPER("Mesh")
 
+	MeshEncoding encoding = {};
+
+	// The byte sizes are the sizes of the decoded streams
 	exo::u128 indices_hash;
 	usize     indices_byte_size;
 
@@ -33,7 +69,13 @@ struct Mesh : Asset
 	exo::u128 uvs_hash;
 	usize     uvs_byte_size;
 
+	// BVHNode array over the triangles of the mesh, stored as is (bvh_byte_size is 0 when there is none)
+	exo::u128 bvh_hash      = {};
+	usize     bvh_byte_size = 0;
+
 	Vec<SubMesh> submeshes;
+	// From the most detailed to the least detailed
+	Vec<MeshLod> lods;
 
 	// --
 	void serialize(exo::Serializer &serializer) final;
@@ -0,0 +1,55 @@
+#pragma once
+#include "exo/collections/span.h"
+#include "exo/collections/vector.h"
+#include "exo/maths/numerics.h"
+#include "exo/maths/vectors.h"
+
+struct MeshEncoding;
+struct SubMesh;
+struct SubMeshLod;
+struct Mesh;
+struct BakedSubMesh;
+
+/**
+   Encoding and decoding of the mesh blobs, see MeshEncoding.
+   The streams are decoded to the layout used by the GPU buffers: u32 indices (relative to the mesh), float4
+   positions and float2 uvs. Decoding is done by the jobs that read the blobs, it uses SSE4.1/AVX2/F16C when available.
+ **/
+namespace assets
+{
+// `indices` are relative to the mesh, `index_ranges` are the submeshes ranges (the submeshes when empty)
+void encode_mesh_indices(const MeshEncoding &encoding,
+	exo::Span<const SubMesh>               submeshes,
+	exo::Span<const SubMeshLod>            index_ranges,
+	exo::Span<const u32>                   indices,
+	Vec<u8>                               &out_blob);
+void encode_mesh_positions(const MeshEncoding &encoding,
+	exo::Span<const SubMesh>                 submeshes,
+	exo::Span<const float4>                  positions,
+	Vec<u8>                                 &out_blob);
+void encode_mesh_uvs(const MeshEncoding &encoding, exo::Span<const float2> uvs, Vec<u8> &out_blob);
+
+void decode_mesh_indices(const MeshEncoding &encoding,
+	exo::Span<const SubMesh>               submeshes,
+	exo::Span<const SubMeshLod>            index_ranges,
+	exo::Span<const u8>                    blob,
+	exo::Span<u32>                         out_indices);
+void decode_mesh_positions(const MeshEncoding &encoding,
+	exo::Span<const SubMesh>                 submeshes,
+	exo::Span<const u8>                      blob,
+	exo::Span<float4>                        out_positions);
+// Same as above with the submeshes of a baked file, read in place
+void decode_mesh_indices(const MeshEncoding &encoding,
+	exo::Span<const BakedSubMesh>          submeshes,
+	exo::Span<const SubMeshLod>            index_ranges,
+	exo::Span<const u8>                    blob,
+	exo::Span<u32>                         out_indices);
+void decode_mesh_positions(const MeshEncoding &encoding,
+	exo::Span<const BakedSubMesh>            submeshes,
+	exo::Span<const u8>                      blob,
+	exo::Span<float4>                        out_positions);
+void decode_mesh_uvs(const MeshEncoding &encoding, exo::Span<const u8> blob, exo::Span<float2> out_uvs);
+
+// Can encode the indices of every submesh on 16 bits
+bool can_use_u16_indices(exo::Span<const SubMesh> submeshes, usize vertex_count);
+} // namespace assets
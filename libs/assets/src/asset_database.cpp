@@ -1,9 +1,11 @@
 #include "assets/asset_database.h"
 #include "assets/asset.h"
+#include "assets/baked_asset.h"
 #include "cross/jobmanager.h"
 #include "cross/jobs/foreach.h"
 #include "cross/mapped_file.h"
 #include "exo/hash.h"
+#include "exo/logger.h"
 #include "exo/serialization/handle_serializer.h"
 #include "exo/serialization/map_serializer.h"
 #include "exo/serialization/path_serializer.h"
@@ -56,6 +58,7 @@ void AssetDatabase::track_resource_changes(
 		this,
 		[](ResourceTracker &tracker, const AssetDatabase *self) {
 			auto resource_file = cross::MappedFile::open(tracker.resource_path.view()).value();
+			resource_file.advise({.sequential = true});
 			tracker.hash = exo::RawHash{assets::hash_file64(resource_file.content())};
 			resource_file.close();
 
@@ -169,6 +172,19 @@ void serialize(exo::Serializer &serializer, Resource &data)
 
 void serialize(exo::Serializer &serializer, AssetDatabase &db)
 {
+	u32 magic         = ASSET_DATABASE_MAGIC;
+	u32 version       = ASSET_FORMAT_VERSION;
+	u32 baked_version = BAKED_ASSET_VERSION;
+	exo::serialize(serializer, magic);
+	exo::serialize(serializer, version);
+	exo::serialize(serializer, baked_version);
+	const bool is_outdated =
+		magic != ASSET_DATABASE_MAGIC || version != ASSET_FORMAT_VERSION || baked_version != BAKED_ASSET_VERSION;
+	if (!serializer.is_writing && is_outdated) {
+		exo::logger::info("[AssetDatabase] The compiled assets are outdated, all resources will be imported again.\n");
+		return;
+	}
+
 	exo::serialize(serializer, db.resource_path_map);
 	exo::serialize(serializer, db.resource_content_map);
 	exo::serialize(serializer, db.resource_records);
@@ -1,11 +1,16 @@
 #include "assets/asset_manager.h"
 #include "assets/asset.h"
+#include "assets/baked_asset.h"
 #include "assets/importers/gltf_importer.h"
 #include "assets/importers/ktx2_importer.h"
 #include "assets/importers/png_importer.h"
+#include "assets/mesh.h"
+#include "assets/texture.h"
 #include "cross/jobmanager.h"
 #include "cross/jobs/custom.h"
+#include "cross/jobs/foreach.h"
 #include "cross/mapped_file.h"
+#include "exo/collections/map.h"
 #include "exo/collections/span.h"
 #include "exo/format.h"
 #include "exo/hash.h"
@@ -16,6 +21,8 @@
 #include "hash_file.h"
 #include "reflection/reflection.h"
 #include "reflection/reflection_serializer.h"
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <cstring> // for memcpy
 
@@ -44,18 +51,61 @@ AssetManager AssetManager::create(cross::JobManager &jobmanager)
 		exo::serializer_helper::read_object(resource_file.content(), asset_manager.database);
 	}
 
+	asset_manager.blob_archive = BlobArchive::open(CompiledAssetPath);
+
 	Vec<Handle<Resource>> outdated_resources;
 	asset_manager.database.track_resource_changes(jobmanager, AssetPath, outdated_resources);
 	asset_manager._import_resources(outdated_resources);
 
+	asset_manager.blob_archive.commit();
 	exo::serializer_helper::write_object_to_file(DatabasePath.view(), asset_manager.database);
 
 	return asset_manager;
 }
 
-static void import_resource(AssetManager &manager, AssetId id, const exo::Path &path)
+// -- Import graph
+
+// Resources are imported as a DAG: creating the assets is cheap and gives the dependencies of each resource, then
+// every resource is processed in its own job once all its dependencies have been processed.
+struct ImportNode
+{
+	AssetId   id;
+	exo::Path path;
+	Importer *importer = nullptr;
+
+	// Nodes that can be processed once this one is done
+	Vec<u32> dependents;
+	u32      dependencies_len = 0;
+
+	// Filled by the job
+	exo::RawHash resource_hash = {};
+};
+
+struct ImportGraph;
+struct ImportTask
 {
-	auto file_extension = path.extension();
+	ImportGraph *graph  = nullptr;
+	u32          i_node = u32_invalid;
+};
+
+struct ImportGraph
+{
+	AssetManager &manager;
+	ImportLocks   locks;
+
+	// Nodes are sorted in post-order, a node comes after all its dependencies
+	Vec<ImportNode>                        nodes;
+	exo::Map<AssetId, u32>                 node_indices;
+	Vec<ImportTask>                        tasks;
+	Vec<std::shared_ptr<cross::CustomJob>> jobs;
+	std::unique_ptr<std::atomic<u32>[]>    pending_dependencies;
+};
+
+// Create the asset of a resource and add the nodes of its dependencies, returns u32_invalid if it cannot be imported
+static u32 add_import_node(ImportGraph &graph, AssetId id, const exo::Path &path)
+{
+	auto &manager        = graph.manager;
+	auto  file_extension = path.extension();
 
 	// Find an importer for this resource
 	u32 i_found_importer = u32_invalid;
@@ -67,7 +117,7 @@ static void import_resource(AssetManager &manager, AssetId id, const exo::Path &
 	}
 	if (i_found_importer == u32_invalid) {
 		exo::logger::error("Importer not found. %s\n", path.view().data());
-		return;
+		return u32_invalid;
 	}
 
 	auto &importer = *manager.importers[i_found_importer];
@@ -79,69 +129,254 @@ static void import_resource(AssetManager &manager, AssetId id, const exo::Path &
 	auto create_resp = std::move(importer.create_asset(create_req).value());
 	ASSERT(create_resp.new_id.is_valid());
 
-	// Create and process its dependencies
+	// A resource can be a dependency of several resources, it is imported only once
+	if (const u32 *i_existing = graph.node_indices.at(create_resp.new_id)) {
+		return *i_existing;
+	}
+
+	// Create its dependencies
+	Vec<u32> dependencies;
 	for (u32 i_dep = 0; i_dep < create_resp.dependencies_id.len(); ++i_dep) {
-		import_resource(manager, create_resp.dependencies_id[i_dep], create_resp.dependencies_paths[i_dep]);
+		const u32 i_dep_node =
+			add_import_node(graph, create_resp.dependencies_id[i_dep], create_resp.dependencies_paths[i_dep]);
+		if (i_dep_node != u32_invalid) {
+			dependencies.push(i_dep_node);
+		}
+	}
+
+	const u32 i_node = u32(graph.nodes.len());
+	for (const u32 i_dep_node : dependencies) {
+		graph.nodes[i_dep_node].dependents.push(i_node);
 	}
 
+	auto &node            = graph.nodes.push();
+	node.id               = create_resp.new_id;
+	node.path             = path;
+	node.importer         = &importer;
+	node.dependencies_len = u32(dependencies.len());
+	graph.node_indices.insert(node.id, i_node);
+
+	dependencies.buffer.destroy();
+	return i_node;
+}
+
+static void process_import_node(ImportGraph &graph, u32 i_node)
+{
+	EXO_PROFILE_SCOPE
+
+	auto &manager = graph.manager;
+	auto &node    = graph.nodes[i_node];
+
 	// Process this new asset
-	ImporterApi api{manager};
+	ImporterApi    api{manager, graph.locks};
 	ProcessRequest process_req{.importer_api = api};
-	process_req.asset = create_resp.new_id;
-	process_req.path = path;
-	auto process_resp = std::move(importer.process_asset(process_req).value());
+	process_req.asset = node.id;
+	process_req.path = node.path;
+	auto process_resp = std::move(node.importer->process_asset(process_req).value());
 	ASSERT(!process_resp.products.is_empty());
 
-	// Update the resource in the database
-	auto resource_file = cross::MappedFile::open(path.view()).value();
-	auto resource_hash = exo::RawHash{assets::hash_file64(resource_file.content())};
+	auto resource_file = cross::MappedFile::open(node.path.view()).value();
+	resource_file.advise({.sequential = true});
+	node.resource_hash = exo::RawHash{assets::hash_file64(resource_file.content())};
 	resource_file.close();
-	auto &asset_record = manager.database.get_resource_from_content(resource_hash);
-	if (asset_record.asset_id != process_req.asset) {
-		ASSERT(!asset_record.asset_id.is_valid());
-		asset_record.asset_id = process_req.asset;
-	}
-	asset_record.last_imported_hash = resource_hash;
 
 	// write the assets produced by this resource to disk
 	for (const auto &product : process_resp.products) {
-		auto asset = manager.load_asset(product);
+		auto asset = refl::BasePtr<Asset>::invalid();
+		{
+			std::lock_guard lock{graph.locks.database};
+			asset = manager.load_asset(product);
+		}
 		manager._save_to_disk(asset);
 	}
+
+	// Queue the resources that were only waiting for this one
+	for (const u32 i_dependent : node.dependents) {
+		if (graph.pending_dependencies[i_dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			manager.jobmanager->queue_job(*graph.jobs[i_dependent]);
+		}
+	}
 }
 
 void AssetManager::_import_resources(exo::Span<const Handle<Resource>> records)
 {
+	EXO_PROFILE_SCOPE
+
+	ImportGraph graph{.manager = *this};
+
 	for (auto handle : records) {
 		auto &asset_record = this->database.resource_records.get(handle);
 		const auto &asset_path = asset_record.resource_path;
 
 		auto resource_file = cross::MappedFile::open(asset_path.view()).value();
+		resource_file.advise({.sequential = true});
 		auto resource_hash = exo::RawHash{assets::hash_file64(resource_file.content())};
 		resource_file.close();
 
 		if (asset_record.last_imported_hash != resource_hash) {
-			import_resource(*this, asset_record.asset_id, asset_path);
+			add_import_node(graph, asset_record.asset_id, asset_path);
 		}
 	}
+
+	if (graph.nodes.is_empty()) {
+		return;
+	}
+
+	// All the jobs are added to the waitable before queueing any of them, it would be done after the first job
+	// otherwise.
+	const u32 nodes_len = graph.nodes.len();
+	auto      waitable  = std::make_unique<cross::Waitable>();
+	waitable->jobs.reserve(nodes_len);
+	graph.tasks.reserve(nodes_len);
+	graph.jobs.reserve(nodes_len);
+	graph.pending_dependencies = std::make_unique<std::atomic<u32>[]>(nodes_len);
+
+	for (u32 i_node = 0; i_node < nodes_len; ++i_node) {
+		graph.tasks.push(ImportTask{.graph = &graph, .i_node = i_node});
+		graph.pending_dependencies[i_node].store(graph.nodes[i_node].dependencies_len, std::memory_order_relaxed);
+
+		auto job       = std::make_shared<cross::CustomJob>(cross::CustomJob{.done_counter = &waitable->jobs_finished});
+		job->type      = cross::CustomJob::TASK_TYPE;
+		job->user_data = &graph.tasks[i_node];
+		job->callback  = [](cross::CustomJob &import_job) {
+			auto *task = static_cast<ImportTask *>(import_job.user_data);
+			process_import_node(*task->graph, task->i_node);
+		};
+		graph.jobs.push(job);
+		waitable->jobs.push(std::move(job));
+	}
+
+	for (u32 i_node = 0; i_node < nodes_len; ++i_node) {
+		if (graph.nodes[i_node].dependencies_len == 0) {
+			this->jobmanager->queue_job(*graph.jobs[i_node]);
+		}
+	}
+	waitable->wait();
+
+	// Update the resources in the database, in the same order as a sequential import
+	for (auto &node : graph.nodes) {
+		auto &asset_record = this->database.get_resource_from_content(node.resource_hash);
+		if (asset_record.asset_id != node.id) {
+			ASSERT(!asset_record.asset_id.is_valid());
+			asset_record.asset_id = node.id;
+		}
+		asset_record.last_imported_hash = node.resource_hash;
+	}
+
+	for (auto &node : graph.nodes) {
+		node.dependents.buffer.destroy();
+	}
+	graph.nodes.clear();
+	graph.nodes.buffer.destroy();
+	graph.tasks.buffer.destroy();
+	graph.jobs.clear();
+	graph.jobs.buffer.destroy();
+	waitable->jobs.clear();
+	waitable->jobs.buffer.destroy();
 }
 
-refl::BasePtr<Asset> AssetManager::_load_from_disk(const AssetId &id)
+// Baked assets are copied from the mapped file at once, the other files are deserialized
+static refl::BasePtr<Asset> read_asset_file(exo::Span<const u8> content, exo::StringView path)
 {
-	auto asset_path = AssetManager::get_asset_path(id);
-	const auto fs_path = std::filesystem::path{asset_path.view().data()};
-	ASSERT(std::filesystem::exists(fs_path));
-	auto resource_file = cross::MappedFile::open(asset_path.view()).value();
-	auto new_asset = refl::BasePtr<Asset>::invalid();
-	exo::serializer_helper::read_object(resource_file.content(), new_asset);
+	if (!is_baked_asset(content)) {
+		auto asset = refl::BasePtr<Asset>::invalid();
+		exo::serializer_helper::read_object(content, asset);
+		return asset;
+	}
+
+	if (!validate_baked_asset(content)) {
+		exo::logger::error("[AssetManager] Invalid or outdated baked asset %s.\n", path.data());
+		return refl::BasePtr<Asset>::invalid();
+	}
+	return unbake_asset(content);
+}
+
+refl::BasePtr<Asset> AssetManager::_load_from_disk(
+	const AssetId &id, std::unique_ptr<cross::MappedFile> &out_baked_file)
+{
+	auto asset_path    = AssetManager::get_asset_path(id);
+	auto resource_file = cross::MappedFile::open(asset_path.view());
+	if (!resource_file) {
+		exo::logger::error("[AssetManager] Compiled asset %s is missing.\n", asset_path.view().data());
+		return refl::BasePtr<Asset>::invalid();
+	}
+
+	const auto content   = resource_file->content();
+	auto       new_asset = read_asset_file(content, asset_path.view());
+	if (!new_asset.is_valid()) {
+		return new_asset;
+	}
 	new_asset->state = AssetState::LoadedWaitingForDeps;
+
+	if (is_baked_asset(content)) {
+		out_baked_file = std::make_unique<cross::MappedFile>(std::move(resource_file.value()));
+	}
 	return new_asset;
 }
 
+// The database does not store the assets produced by a resource: an asset is either the main asset of a resource, or
+// a dependency of an asset that was loaded before it, up to the main asset of its resource
+static Resource *find_producing_resource(AssetDatabase &database, const AssetId &id)
+{
+	AssetId asset_id = id;
+	// Bounded by the number of loaded assets in case of a dependency cycle
+	for (u32 i_parent = 0; i_parent <= database.asset_id_map.size; ++i_parent) {
+		for (auto [handle, p_resource] : database.resource_records) {
+			if (p_resource->asset_id == asset_id) {
+				return p_resource;
+			}
+		}
+
+		const AssetId *parent_id = nullptr;
+		for (auto &[loaded_id, loaded_asset] : database.asset_id_map) {
+			const auto &dependencies = loaded_asset->dependencies;
+			if (std::find(dependencies.begin(), dependencies.end(), asset_id) != dependencies.end()) {
+				parent_id = &loaded_id;
+				break;
+			}
+		}
+		if (!parent_id) {
+			break;
+		}
+		asset_id = *parent_id;
+	}
+	return nullptr;
+}
+
+// The resources that produced the assets are marked as outdated in the database, their asset ids are kept
+void AssetManager::_reimport_on_next_start(exo::Span<const AssetId> failed_assets)
+{
+	for (const auto &failed_id : failed_assets) {
+		auto *p_resource = find_producing_resource(this->database, failed_id);
+		if (!p_resource) {
+			exo::logger::error("[AssetManager] No resource produced %s, it cannot be imported again.\n",
+				failed_id.name.c_str());
+			continue;
+		}
+		exo::logger::error("[AssetManager] Failed to load %s, %s will be imported at the next start.\n",
+			failed_id.name.c_str(),
+			p_resource->resource_path.view().data());
+		p_resource->last_imported_hash = {};
+	}
+	exo::serializer_helper::write_object_to_file(DatabasePath.view(), this->database);
+}
+
 void AssetManager::_save_to_disk(refl::BasePtr<Asset> asset)
 {
 	auto asset_path = AssetManager::get_asset_path(asset->uuid);
-	exo::serializer_helper::write_object_to_file(asset_path.view(), asset);
+
+	Vec<u8> baked_file;
+	if (bake_asset(asset, baked_file)) {
+		FILE *fp = fopen(asset_path.view().data(), "wb");
+		ASSERT(fp != nullptr);
+		const usize bwritten = fwrite(baked_file.data(), 1, baked_file.len(), fp);
+		ASSERT(bwritten == baked_file.len());
+		fclose(fp);
+	} else {
+		exo::serializer_helper::write_object_to_file(asset_path.view(), asset);
+	}
+	baked_file.buffer.destroy();
+
 	exo::logger::info("Saving %s\n", asset_path.view().data());
 }
 
@@ -184,15 +419,36 @@ void AssetManager::update_async()
 	// Update the state of assets that finished loading asynchronously
 	to_remove.clear();
 	to_remove.reserve(this->database.asset_async_requests.size);
-	for (const auto &[asset_id, req] : this->database.asset_async_requests) {
+	Vec<AssetId> failed_assets;
+	for (auto &[asset_id, req] : this->database.asset_async_requests) {
 		if (req.waitable->is_done()) {
-			this->finish_loading_async(req.data->result);
+			if (req.data->result.is_valid()) {
+				if (req.data->baked_file) {
+					this->baked_files.insert(asset_id, std::move(req.data->baked_file));
+				}
+				this->finish_loading_async(req.data->result);
+			} else {
+				failed_assets.push(asset_id);
+			}
 			to_remove.push(asset_id);
 		}
 	}
 	for (const auto &asset_id : to_remove) {
 		this->database.asset_async_requests.remove(asset_id);
 	}
+
+	// The asset stays unloaded, its compiled file will be written again by the next import
+	if (!failed_assets.is_empty()) {
+		this->_reimport_on_next_start(failed_assets);
+	}
+	failed_assets.clear();
+	failed_assets.buffer.destroy();
+}
+
+const cross::MappedFile *AssetManager::get_baked_file(const AssetId &id)
+{
+	const auto *p_baked_file = this->baked_files.at(id);
+	return p_baked_file ? p_baked_file->get() : nullptr;
 }
 
 void AssetManager::load_asset_async(const AssetId &id)
@@ -212,7 +468,9 @@ void AssetManager::load_asset_async(const AssetId &id)
 
 	req->waitable = cross::custom_job<AssetAsyncRequest::Data>(*this->jobmanager,
 		req->data.get(),
-		[](AssetAsyncRequest::Data *data) { data->result = AssetManager::_load_from_disk(data->asset_id); });
+		[](AssetAsyncRequest::Data *data) {
+			data->result = AssetManager::_load_from_disk(data->asset_id, data->baked_file);
+		});
 }
 
 void AssetManager::finish_loading_async(refl::BasePtr<Asset> asset)
@@ -239,12 +497,26 @@ void AssetManager::finish_loading_async(refl::BasePtr<Asset> asset)
 	}
 }
 
-void AssetManager::unload_asset(const AssetId &id) { this->database.remove_asset(id); }
+void AssetManager::unload_asset(const AssetId &id)
+{
+	this->database.remove_asset(id);
+	if (this->baked_files.at(id)) {
+		this->baked_files.remove(id);
+	}
+}
 
 usize AssetManager::read_blob(exo::u128 blob_hash, exo::Span<u8> out_data)
 {
+	if (auto blob = this->blob_archive.get(blob_hash)) {
+		ASSERT(out_data.len() >= blob->len());
+		std::memcpy(out_data.data(), blob->data(), blob->len());
+		return blob->len();
+	}
+
+	// Blobs saved before the archive existed are stored in their own file until the next compaction
 	auto path = get_blob_path(blob_hash);
 	auto blob_file = cross::MappedFile::open(path.view()).value();
+	blob_file.advise({.sequential = true, .will_need = true});
 	auto blob_content = blob_file.content();
 	ASSERT(out_data.len() >= blob_content.len());
 	std::memcpy(out_data.data(), blob_content.data(), blob_content.len());
@@ -254,12 +526,134 @@ usize AssetManager::read_blob(exo::u128 blob_hash, exo::Span<u8> out_data)
 exo::u128 AssetManager::save_blob(exo::Span<const u8> blob_data)
 {
 	auto blob_hash = assets::hash_file128(blob_data);
-	auto path = get_blob_path(blob_hash);
+	this->blob_archive.save(blob_hash, blob_data);
+	return blob_hash;
+}
 
-	FILE *fp = fopen(path.view().data(), "wb");
-	auto bwritten = fwrite(blob_data.data(), 1, blob_data.len(), fp);
-	ASSERT(bwritten == blob_data.len());
-	fclose(fp);
+Option<exo::Span<const u8>> AssetManager::get_blob(exo::u128 blob_hash) { return this->blob_archive.get(blob_hash); }
 
-	return blob_hash;
+std::unique_ptr<cross::Waitable> AssetManager::read_blobs_async(exo::Span<BlobReadRequest> requests)
+{
+	EXO_PROFILE_SCOPE
+
+	// The archive is not thread-safe, resolve the slices before queueing the copies. Blobs that are not packed yet
+	// are rare (they are migrated by `compact_blobs`), they are read here.
+	for (auto &request : requests) {
+		request.packed_blob = this->blob_archive.get(request.blob_id);
+		if (request.packed_blob) {
+			ASSERT(request.decode || request.data.len() >= request.packed_blob->len());
+		} else if (request.decode) {
+			auto path      = get_blob_path(request.blob_id);
+			auto blob_file = cross::MappedFile::open(path.view()).value();
+			request.decode(blob_file.content(), request.data, request.decode_data);
+			request.bytes_read = request.data.len();
+		} else {
+			request.bytes_read = this->read_blob(request.blob_id, request.data);
+		}
+	}
+
+	// Copying from the mapped pack makes the workers take the page faults (and decode) instead of the calling thread
+	return cross::parallel_foreach_userdata<BlobReadRequest, void>(
+		*this->jobmanager,
+		requests,
+		nullptr,
+		[](BlobReadRequest &request, void * /*user_data*/) {
+			if (request.packed_blob) {
+				const auto blob = request.packed_blob.value();
+				if (request.decode) {
+					request.decode(blob, request.data, request.decode_data);
+					request.bytes_read = request.data.len();
+				} else {
+					std::copy(blob.begin(), blob.end(), request.data.begin());
+					request.bytes_read = blob.len();
+				}
+			}
+		},
+		1);
+}
+
+usize AssetManager::compact_blobs()
+{
+	EXO_PROFILE_SCOPE
+
+	const auto compiled_assets_fs_path = std::filesystem::path{CompiledAssetPath.view().data()};
+
+	// Collect the blobs referenced by the compiled assets
+	Vec<BlobHash> live_blobs;
+	for (const auto &file_entry : std::filesystem::directory_iterator{compiled_assets_fs_path}) {
+		if (!file_entry.is_regular_file() || file_entry.path().extension() != ".asset") {
+			continue;
+		}
+
+		auto path_string = file_entry.path().string();
+		auto asset_file = cross::MappedFile::open(exo::StringView{path_string.c_str(), path_string.size()}).value();
+		const auto content = asset_file.content();
+
+		// Baked assets are read in place
+		if (const auto baked_type = validate_baked_asset(content)) {
+			if (*baked_type == BakedAssetType::Mesh) {
+				const auto *mesh = get_baked_mesh(content);
+				live_blobs.push(BlobHash::from(mesh->indices_hash.get()));
+				live_blobs.push(BlobHash::from(mesh->positions_hash.get()));
+				live_blobs.push(BlobHash::from(mesh->uvs_hash.get()));
+				if (mesh->bvh_byte_size > 0) {
+					live_blobs.push(BlobHash::from(mesh->bvh_hash.get()));
+				}
+				for (const auto &lod : mesh->lods.view(content)) {
+					live_blobs.push(BlobHash::from(lod.indices_hash.get()));
+				}
+			} else if (*baked_type == BakedAssetType::Texture) {
+				live_blobs.push(BlobHash::from(get_baked_texture(content)->pixels_hash.get()));
+			}
+			continue;
+		}
+
+		auto asset = read_asset_file(content, exo::StringView{path_string.c_str(), path_string.size()});
+		if (!asset.is_valid()) {
+			continue;
+		}
+
+		if (auto *mesh = asset.as<Mesh>()) {
+			live_blobs.push(BlobHash::from(mesh->indices_hash));
+			live_blobs.push(BlobHash::from(mesh->positions_hash));
+			live_blobs.push(BlobHash::from(mesh->uvs_hash));
+			if (mesh->bvh_byte_size > 0) {
+				live_blobs.push(BlobHash::from(mesh->bvh_hash));
+			}
+			for (const auto &lod : mesh->lods) {
+				live_blobs.push(BlobHash::from(lod.indices_hash));
+			}
+		} else if (auto *texture = asset.as<Texture>()) {
+			live_blobs.push(BlobHash::from(texture->pixels_hash));
+		}
+
+		void *asset_memory = asset.get();
+		asset.typeinfo().dtor(asset_memory);
+		free(asset_memory);
+	}
+
+	// Move the blobs stored in their own file into the archive
+	for (const auto &live_blob : live_blobs) {
+		const auto blob_hash = live_blob.get();
+		if (this->blob_archive.contains(blob_hash)) {
+			continue;
+		}
+		auto path = get_blob_path(blob_hash);
+		if (auto blob_file = cross::MappedFile::open(path.view())) {
+			this->blob_archive.save(blob_hash, blob_file->content());
+		}
+	}
+
+	this->blob_archive.close();
+	const usize reclaimed = BlobArchive::compact(CompiledAssetPath, live_blobs);
+	this->blob_archive = BlobArchive::open(CompiledAssetPath);
+	live_blobs.buffer.destroy();
+
+	for (const auto &file_entry : std::filesystem::directory_iterator{compiled_assets_fs_path}) {
+		if (file_entry.is_regular_file() && file_entry.path().extension() == ".bin") {
+			std::filesystem::remove(file_entry.path());
+		}
+	}
+
+	return reclaimed;
 }
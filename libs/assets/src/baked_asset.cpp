@@ -0,0 +1,386 @@
+#include "assets/baked_asset.h"
+
+#include "assets/asset.h"
+#include "assets/mesh.h"
+#include "assets/texture.h"
+#include "exo/macros/assert.h"
+#include "exo/maths/pointer.h"
+#include "exo/profile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static_assert(sizeof(usize) == sizeof(u64), "Texture::mip_offsets is baked as u64");
+
+// -- Writing
+
+// Append `size` bytes on BAKED_ALIGNMENT and returns their offset
+static u64 append_bytes(Vec<u8> &file, const void *data, usize size)
+{
+	const usize offset   = exo::round_up_to_alignment(BAKED_ALIGNMENT, file.len());
+	const usize new_size = offset + size;
+	if (new_size > file.capacity()) {
+		file.reserve(u32(std::max(new_size, 2 * usize(file.capacity()))));
+	}
+	// The padding is zeroed by resize
+	file.resize(u32(new_size));
+	if (size > 0) {
+		std::memcpy(file.data() + offset, data, size);
+	}
+	return offset;
+}
+
+template <typename T>
+static BakedArray<T> append_array(Vec<u8> &file, exo::Span<const T> elements)
+{
+	return BakedArray<T>{.offset = append_bytes(file, elements.data(), elements.size_bytes()), .len = elements.len()};
+}
+
+static BakedArray<char> append_string(Vec<u8> &file, const exo::String &string)
+{
+	return append_array(file, exo::Span<const char>(string.data(), string.len()));
+}
+
+static BakedAssetId append_asset_id(Vec<u8> &file, const AssetId &id)
+{
+	return BakedAssetId{.name = append_string(file, id.name), .name_hash = id.name_hash};
+}
+
+static BakedAssetInfo append_asset_info(Vec<u8> &file, const Asset &asset)
+{
+	BakedAssetInfo info = {};
+	info.uuid           = append_asset_id(file, asset.uuid);
+	info.name           = append_string(file, asset.name);
+
+	Vec<BakedAssetId> dependencies = Vec<BakedAssetId>::with_capacity(asset.dependencies.len());
+	for (const auto &dependency : asset.dependencies) {
+		dependencies.push(append_asset_id(file, dependency));
+	}
+	info.dependencies = append_array(file, exo::Span<const BakedAssetId>(dependencies));
+	dependencies.buffer.destroy();
+
+	return info;
+}
+
+static BakedHash to_baked_hash(exo::u128 hash)
+{
+	BakedHash result = {};
+	exo::u128_to_u64(hash, &result.hash0, &result.hash1);
+	return result;
+}
+
+static BakedMesh bake_mesh(Vec<u8> &file, const Mesh &mesh)
+{
+	BakedMesh baked           = {};
+	baked.asset               = append_asset_info(file, mesh);
+	baked.encoding            = mesh.encoding;
+	baked.indices_hash        = to_baked_hash(mesh.indices_hash);
+	baked.indices_byte_size   = mesh.indices_byte_size;
+	baked.positions_hash      = to_baked_hash(mesh.positions_hash);
+	baked.positions_byte_size = mesh.positions_byte_size;
+	baked.uvs_hash            = to_baked_hash(mesh.uvs_hash);
+	baked.uvs_byte_size       = mesh.uvs_byte_size;
+	baked.bvh_hash            = to_baked_hash(mesh.bvh_hash);
+	baked.bvh_byte_size       = mesh.bvh_byte_size;
+
+	Vec<BakedSubMesh> submeshes = Vec<BakedSubMesh>::with_capacity(mesh.submeshes.len());
+	for (const auto &submesh : mesh.submeshes) {
+		submeshes.push(BakedSubMesh{
+			.first_index  = submesh.first_index,
+			.first_vertex = submesh.first_vertex,
+			.index_count  = submesh.index_count,
+			.material     = append_asset_id(file, submesh.material),
+			.bounds_min   = submesh.bounds_min,
+			.bounds_max   = submesh.bounds_max,
+		});
+	}
+	baked.submeshes = append_array(file, exo::Span<const BakedSubMesh>(submeshes));
+	submeshes.buffer.destroy();
+
+	Vec<BakedMeshLod> lods = Vec<BakedMeshLod>::with_capacity(mesh.lods.len());
+	for (const auto &lod : mesh.lods) {
+		lods.push(BakedMeshLod{
+			.indices_hash      = to_baked_hash(lod.indices_hash),
+			.indices_byte_size = lod.indices_byte_size,
+			.error             = lod.error,
+			.submeshes         = append_array(file, exo::Span<const SubMeshLod>(lod.submeshes)),
+		});
+	}
+	baked.lods = append_array(file, exo::Span<const BakedMeshLod>(lods));
+	lods.buffer.destroy();
+
+	return baked;
+}
+
+static BakedTexture bake_texture(Vec<u8> &file, const Texture &texture)
+{
+	const auto mip_offsets =
+		exo::Span<const u64>(reinterpret_cast<const u64 *>(texture.mip_offsets.data()), texture.mip_offsets.len());
+
+	BakedTexture baked     = {};
+	baked.asset            = append_asset_info(file, texture);
+	baked.format           = u16(texture.format);
+	baked.extension        = u16(texture.extension);
+	baked.width            = texture.width;
+	baked.height           = texture.height;
+	baked.depth            = texture.depth;
+	baked.levels           = texture.levels;
+	baked.mip_offsets      = append_array(file, mip_offsets);
+	baked.pixels_hash      = to_baked_hash(texture.pixels_hash);
+	baked.pixels_data_size = texture.pixels_data_size;
+	return baked;
+}
+
+template <typename Root>
+static void write_root(Vec<u8> &file, BakedAssetType type, const Root &root)
+{
+	BakedAssetHeader header = {};
+	header.type             = type;
+	header.size             = file.len();
+	std::memcpy(file.data(), &header, sizeof(header));
+	std::memcpy(file.data() + sizeof(header), &root, sizeof(root));
+}
+
+bool bake_asset(refl::BasePtr<Asset> asset, Vec<u8> &out_file)
+{
+	EXO_PROFILE_SCOPE
+
+	out_file.clear();
+
+	// The header and the root struct are written last, once the offsets of the arrays are known
+	if (auto *mesh = asset.as<Mesh>()) {
+		out_file.resize(u32(sizeof(BakedAssetHeader) + sizeof(BakedMesh)));
+		const auto baked = bake_mesh(out_file, *mesh);
+		write_root(out_file, BakedAssetType::Mesh, baked);
+		return true;
+	} else if (auto *texture = asset.as<Texture>()) {
+		out_file.resize(u32(sizeof(BakedAssetHeader) + sizeof(BakedTexture)));
+		const auto baked = bake_texture(out_file, *texture);
+		write_root(out_file, BakedAssetType::Texture, baked);
+		return true;
+	}
+
+	return false;
+}
+
+// -- Validation
+
+template <typename T>
+static bool is_array_valid(exo::Span<const u8> file, const BakedArray<T> &array)
+{
+	return array.offset % BAKED_ALIGNMENT == 0 && array.offset <= file.len() &&
+	       array.len <= (file.len() - array.offset) / sizeof(T);
+}
+
+static bool is_asset_id_valid(exo::Span<const u8> file, const BakedAssetId &id)
+{
+	return is_array_valid(file, id.name);
+}
+
+static bool is_asset_info_valid(exo::Span<const u8> file, const BakedAssetInfo &info)
+{
+	if (!is_asset_id_valid(file, info.uuid) || !is_array_valid(file, info.name) ||
+		!is_array_valid(file, info.dependencies)) {
+		return false;
+	}
+	for (const auto &dependency : info.dependencies.view(file)) {
+		if (!is_asset_id_valid(file, dependency)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool is_mesh_valid(exo::Span<const u8> file, const BakedMesh &mesh)
+{
+	if (!is_asset_info_valid(file, mesh.asset) || !is_array_valid(file, mesh.submeshes) ||
+		!is_array_valid(file, mesh.lods)) {
+		return false;
+	}
+	for (const auto &submesh : mesh.submeshes.view(file)) {
+		if (!is_asset_id_valid(file, submesh.material)) {
+			return false;
+		}
+	}
+	for (const auto &lod : mesh.lods.view(file)) {
+		if (!is_array_valid(file, lod.submeshes) || lod.submeshes.len != mesh.submeshes.len) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool is_texture_valid(exo::Span<const u8> file, const BakedTexture &texture)
+{
+	return is_asset_info_valid(file, texture.asset) && is_array_valid(file, texture.mip_offsets);
+}
+
+bool is_baked_asset(exo::Span<const u8> file)
+{
+	u32 magic = 0;
+	if (file.len() >= sizeof(magic)) {
+		std::memcpy(&magic, file.data(), sizeof(magic));
+	}
+	return magic == BAKED_ASSET_MAGIC;
+}
+
+Option<BakedAssetType> validate_baked_asset(exo::Span<const u8> file)
+{
+	EXO_PROFILE_SCOPE
+
+	// The views are read in place, the file has to be aligned like the mapped files
+	if (file.len() < sizeof(BakedAssetHeader) || reinterpret_cast<usize>(file.data()) % BAKED_ALIGNMENT != 0) {
+		return {};
+	}
+
+	const auto &header = *reinterpret_cast<const BakedAssetHeader *>(file.data());
+	if (header.magic != BAKED_ASSET_MAGIC || header.version != BAKED_ASSET_VERSION || header.size != file.len()) {
+		return {};
+	}
+
+	const usize root_size = file.len() - sizeof(BakedAssetHeader);
+	switch (header.type) {
+	case BakedAssetType::Mesh:
+		if (root_size >= sizeof(BakedMesh) && is_mesh_valid(file, *get_baked_mesh(file))) {
+			return header.type;
+		}
+		break;
+	case BakedAssetType::Texture:
+		if (root_size >= sizeof(BakedTexture) && is_texture_valid(file, *get_baked_texture(file))) {
+			return header.type;
+		}
+		break;
+	default:
+		break;
+	}
+	return {};
+}
+
+const BakedMesh *get_baked_mesh(exo::Span<const u8> file)
+{
+	return reinterpret_cast<const BakedMesh *>(file.data() + sizeof(BakedAssetHeader));
+}
+
+const BakedTexture *get_baked_texture(exo::Span<const u8> file)
+{
+	return reinterpret_cast<const BakedTexture *>(file.data() + sizeof(BakedAssetHeader));
+}
+
+// -- Reading
+
+template <typename T>
+static T *create_asset()
+{
+	const auto &type_info = refl::typeinfo<T>();
+	void       *memory    = malloc(type_info.size);
+	return static_cast<T *>(type_info.placement_ctor(memory));
+}
+
+static exo::StringView to_string_view(exo::Span<const u8> file, const BakedArray<char> &string)
+{
+	return exo::StringView(string.view(file).data(), string.len);
+}
+
+static AssetId to_asset_id(exo::Span<const u8> file, const BakedAssetId &id)
+{
+	return AssetId{.name = exo::String(to_string_view(file, id.name)), .name_hash = id.name_hash};
+}
+
+template <typename T>
+static void copy_array(exo::Span<const u8> file, const BakedArray<T> &array, Vec<T> &out)
+{
+	out.resize(u32(array.len));
+	if (array.len > 0) {
+		std::memcpy(out.data(), file.data() + array.offset, array.len * sizeof(T));
+	}
+}
+
+static void unbake_asset_info(exo::Span<const u8> file, const BakedAssetInfo &info, Asset &asset)
+{
+	asset.uuid = to_asset_id(file, info.uuid);
+	asset.name = exo::String(to_string_view(file, info.name));
+
+	const auto dependencies = info.dependencies.view(file);
+	asset.dependencies.reserve(u32(dependencies.len()));
+	for (const auto &dependency : dependencies) {
+		asset.dependencies.push(to_asset_id(file, dependency));
+	}
+}
+
+static Mesh *unbake_mesh(exo::Span<const u8> file, const BakedMesh &baked)
+{
+	auto *mesh = create_asset<Mesh>();
+	unbake_asset_info(file, baked.asset, *mesh);
+	mesh->encoding            = baked.encoding;
+	mesh->indices_hash        = baked.indices_hash.get();
+	mesh->indices_byte_size   = baked.indices_byte_size;
+	mesh->positions_hash      = baked.positions_hash.get();
+	mesh->positions_byte_size = baked.positions_byte_size;
+	mesh->uvs_hash            = baked.uvs_hash.get();
+	mesh->uvs_byte_size       = baked.uvs_byte_size;
+	mesh->bvh_hash            = baked.bvh_hash.get();
+	mesh->bvh_byte_size       = baked.bvh_byte_size;
+
+	const auto submeshes = baked.submeshes.view(file);
+	mesh->submeshes.reserve(u32(submeshes.len()));
+	for (const auto &submesh : submeshes) {
+		mesh->submeshes.push(SubMesh{
+			.first_index  = submesh.first_index,
+			.first_vertex = submesh.first_vertex,
+			.index_count  = submesh.index_count,
+			.material     = to_asset_id(file, submesh.material),
+			.bounds_min   = submesh.bounds_min,
+			.bounds_max   = submesh.bounds_max,
+		});
+	}
+
+	const auto lods = baked.lods.view(file);
+	mesh->lods.resize(u32(lods.len()));
+	for (u32 i_lod = 0; i_lod < lods.len(); ++i_lod) {
+		auto &lod             = mesh->lods[i_lod];
+		lod.indices_hash      = lods[i_lod].indices_hash.get();
+		lod.indices_byte_size = lods[i_lod].indices_byte_size;
+		lod.error             = lods[i_lod].error;
+		copy_array(file, lods[i_lod].submeshes, lod.submeshes);
+	}
+
+	return mesh;
+}
+
+static Texture *unbake_texture(exo::Span<const u8> file, const BakedTexture &baked)
+{
+	auto *texture = create_asset<Texture>();
+	unbake_asset_info(file, baked.asset, *texture);
+	texture->format           = PixelFormat(baked.format);
+	texture->extension        = ImageExtension(baked.extension);
+	texture->width            = baked.width;
+	texture->height           = baked.height;
+	texture->depth            = baked.depth;
+	texture->levels           = baked.levels;
+	texture->pixels_hash      = baked.pixels_hash.get();
+	texture->pixels_data_size = baked.pixels_data_size;
+
+	const auto mip_offsets = baked.mip_offsets.view(file);
+	texture->mip_offsets.resize(u32(mip_offsets.len()));
+	if (!mip_offsets.empty()) {
+		std::memcpy(texture->mip_offsets.data(), mip_offsets.data(), mip_offsets.size_bytes());
+	}
+	return texture;
+}
+
+refl::BasePtr<Asset> unbake_asset(exo::Span<const u8> file)
+{
+	EXO_PROFILE_SCOPE
+
+	const auto &header = *reinterpret_cast<const BakedAssetHeader *>(file.data());
+	switch (header.type) {
+	case BakedAssetType::Mesh:
+		return refl::BasePtr<Asset>(unbake_mesh(file, *get_baked_mesh(file)));
+	case BakedAssetType::Texture:
+		return refl::BasePtr<Asset>(unbake_texture(file, *get_baked_texture(file)));
+	default:
+		ASSERT(false);
+		return refl::BasePtr<Asset>::invalid();
+	}
+}
@@ -0,0 +1,407 @@
+#include "assets/blob_archive.h"
+
+#include "exo/logger.h"
+#include "exo/macros/assert.h"
+#include "exo/maths/pointer.h"
+#include "exo/profile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+// -- Helpers
+
+static BlobIndexEntry entry_from_hash(exo::u128 blob_hash)
+{
+	BlobIndexEntry entry = {};
+	exo::u128_to_u64(blob_hash, &entry.hash0, &entry.hash1);
+	return entry;
+}
+
+static bool entry_less(const BlobIndexEntry &lhs, const BlobIndexEntry &rhs)
+{
+	return lhs.hash1 != rhs.hash1 ? lhs.hash1 < rhs.hash1 : lhs.hash0 < rhs.hash0;
+}
+
+static bool entry_same_hash(const BlobIndexEntry &lhs, const BlobIndexEntry &rhs)
+{
+	return lhs.hash0 == rhs.hash0 && lhs.hash1 == rhs.hash1;
+}
+
+// Append a record at the end of the pack and returns the offset of the blob bytes
+static u64 append_record(FILE *fp, usize &pack_size, const BlobIndexEntry &hash, exo::Span<const u8> blob_data)
+{
+	static constexpr u8 padding[BLOB_ALIGNMENT] = {};
+
+	const usize record_offset = exo::round_up_to_alignment(BLOB_ALIGNMENT, pack_size);
+	const usize padding_size  = record_offset - pack_size;
+
+	BlobRecordHeader header = {};
+	header.hash0            = hash.hash0;
+	header.hash1            = hash.hash1;
+	header.size             = blob_data.len();
+
+	usize written = fwrite(padding, 1, padding_size, fp);
+	written += fwrite(&header, 1, sizeof(header), fp);
+	written += fwrite(blob_data.data(), 1, blob_data.len(), fp);
+	ASSERT(written == padding_size + sizeof(header) + blob_data.len());
+
+	pack_size = record_offset + sizeof(header) + blob_data.len();
+	return record_offset + sizeof(header);
+}
+
+// Write the sorted union of `entries_a` and `entries_b` to `path`
+static void write_index(const exo::Path &path,
+	exo::Span<const BlobIndexEntry>     entries_a,
+	exo::Span<const BlobIndexEntry>     entries_b,
+	usize                               pack_size)
+{
+	EXO_PROFILE_SCOPE
+
+	const usize entries_len = entries_a.len() + entries_b.len();
+
+	auto index_file =
+		cross::MappedFile::create(path.view(), sizeof(BlobIndexHeader) + entries_len * sizeof(BlobIndexEntry));
+	ASSERT(index_file.has_value());
+
+	auto content = index_file->content_mut();
+	auto entries = exo::Span<BlobIndexEntry>(
+		reinterpret_cast<BlobIndexEntry *>(content.data() + sizeof(BlobIndexHeader)),
+		entries_len);
+	std::copy(entries_a.begin(), entries_a.end(), entries.begin());
+	std::copy(entries_b.begin(), entries_b.end(), entries.begin() + entries_a.len());
+	std::sort(entries.begin(), entries.end(), entry_less);
+	auto *unique_end = std::unique(entries.begin(), entries.end(), entry_same_hash);
+
+	BlobIndexHeader header = {};
+	header.entries_len     = u64(unique_end - entries.begin());
+	header.pack_size       = pack_size;
+	std::memcpy(content.data(), &header, sizeof(header));
+
+	index_file->flush();
+	index_file->close();
+}
+
+static exo::Path tmp_path_of(const exo::Path &path)
+{
+	return exo::Path::from_owned_string(path.view() + exo::StringView{".tmp"});
+}
+
+static void replace_file(const exo::Path &from, const exo::Path &to)
+{
+	std::filesystem::rename(std::filesystem::path{from.view().data()}, std::filesystem::path{to.view().data()});
+}
+
+// Map the index file, returns the size of the pack covered by the index
+static usize load_index(BlobArchive &archive)
+{
+	auto index_file = cross::MappedFile::open(archive.index_path.view());
+	if (!index_file) {
+		return 0;
+	}
+
+	const auto content = index_file->content();
+
+	BlobIndexHeader header = {};
+	if (content.len() >= sizeof(header)) {
+		std::memcpy(&header, content.data(), sizeof(header));
+	}
+
+	const bool is_valid = content.len() >= sizeof(header) && header.magic == BLOB_INDEX_MAGIC &&
+	                      header.version == BLOB_INDEX_VERSION &&
+	                      header.entries_len <= (content.len() - sizeof(header)) / sizeof(BlobIndexEntry) &&
+	                      header.pack_size <= archive.pack_size;
+	if (!is_valid) {
+		exo::logger::error("[BlobArchive] Invalid index %s, rebuilding it from the pack.\n",
+			archive.index_path.view().data());
+		return 0;
+	}
+
+	archive.index_file      = std::move(index_file.value());
+	archive.indexed_entries = exo::Span<const BlobIndexEntry>(
+		reinterpret_cast<const BlobIndexEntry *>(archive.index_file.content().data() + sizeof(header)),
+		header.entries_len);
+	return header.pack_size;
+}
+
+// Add the records stored after `offset` to the pending entries
+static void recover_records(BlobArchive &archive, usize offset)
+{
+	if (offset >= archive.pack_size) {
+		return;
+	}
+
+	ASSERT(archive.pack_segments.len() == 1);
+	const auto pack_content = archive.pack_segments[0].file.content();
+
+	u32 recovered = 0;
+	while (true) {
+		offset = exo::round_up_to_alignment(BLOB_ALIGNMENT, offset);
+		if (offset + sizeof(BlobRecordHeader) > pack_content.len()) {
+			break;
+		}
+
+		BlobRecordHeader header = {};
+		std::memcpy(&header, pack_content.data() + offset, sizeof(header));
+		if (header.magic != BLOB_RECORD_MAGIC || header.size > pack_content.len() - offset - sizeof(header)) {
+			break;
+		}
+
+		BlobIndexEntry entry = {};
+		entry.hash0          = header.hash0;
+		entry.hash1          = header.hash1;
+		entry.offset         = offset + sizeof(header);
+		entry.size           = header.size;
+		archive.pending_entries.push(entry);
+
+		offset = entry.offset + entry.size;
+		recovered += 1;
+	}
+
+	if (offset < pack_content.len()) {
+		exo::logger::error("[BlobArchive] %s has %zu invalid bytes at offset %zu, compact it to reclaim them.\n",
+			archive.pack_path.view().data(),
+			pack_content.len() - offset,
+			offset);
+	}
+	if (recovered > 0) {
+		exo::logger::info("[BlobArchive] Recovered %u blobs that were not in the index.\n", recovered);
+	}
+}
+
+// -- BlobArchive
+
+BlobArchive BlobArchive::open(const exo::Path &directory)
+{
+	EXO_PROFILE_SCOPE
+
+	BlobArchive archive = {};
+	archive.pack_path   = exo::Path::join(directory, exo::StringView{BLOB_PACK_NAME});
+	archive.index_path  = exo::Path::join(directory, exo::StringView{BLOB_INDEX_NAME});
+
+	// Writes to a file opened in append mode always go to the end of the file
+	archive.pack_fp = fopen(archive.pack_path.view().data(), "ab");
+	ASSERT(archive.pack_fp != nullptr);
+	archive.pack_size = std::filesystem::file_size(std::filesystem::path{archive.pack_path.view().data()});
+
+	if (archive.pack_size > 0) {
+		auto pack_file = cross::MappedFile::open(archive.pack_path.view());
+		ASSERT(pack_file.has_value());
+		archive.pack_segments.push(BlobPackSegment{.offset = 0, .file = std::move(pack_file.value())});
+		archive.pack_mapped_size = archive.pack_size;
+	}
+
+	const usize indexed_pack_size = load_index(archive);
+	recover_records(archive, indexed_pack_size);
+
+	return archive;
+}
+
+void BlobArchive::close()
+{
+	EXO_PROFILE_SCOPE
+
+	this->commit();
+
+	if (this->pack_fp) {
+		fclose(this->pack_fp);
+		this->pack_fp = nullptr;
+	}
+
+	this->index_file.close();
+	this->indexed_entries = {};
+	this->pending_entries.clear();
+	this->pending_entries.buffer.destroy();
+	this->pack_segments.clear();
+	this->pack_segments.buffer.destroy();
+	this->pack_mapped_size = 0;
+	this->pack_size        = 0;
+}
+
+const BlobIndexEntry *BlobArchive::_find(exo::u128 blob_hash) const
+{
+	const auto to_find = entry_from_hash(blob_hash);
+
+	const auto *it = std::lower_bound(this->indexed_entries.begin(), this->indexed_entries.end(), to_find, entry_less);
+	if (it != this->indexed_entries.end() && entry_same_hash(*it, to_find)) {
+		return it;
+	}
+
+	// Only blobs saved since the last commit are pending, a linear search is enough
+	for (const auto &entry : this->pending_entries) {
+		if (entry_same_hash(entry, to_find)) {
+			return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+Option<exo::Span<const u8>> BlobArchive::_map_entry(const BlobIndexEntry &entry)
+{
+	if (entry.offset > this->pack_size || entry.size > this->pack_size - entry.offset) {
+		exo::logger::error("[BlobArchive] Blob at offset %zu (%zu bytes) is outside of the pack (%zu bytes).\n",
+			usize(entry.offset),
+			usize(entry.size),
+			this->pack_size);
+		return {};
+	}
+
+	if (entry.size == 0) {
+		return exo::Span<const u8>{};
+	}
+
+	// The blob was appended after the last mapping, map the new part of the pack
+	if (entry.offset + entry.size > this->pack_mapped_size) {
+		fflush(this->pack_fp);
+		auto segment_file = cross::MappedFile::open_range(this->pack_path.view(),
+			this->pack_mapped_size,
+			this->pack_size - this->pack_mapped_size);
+		ASSERT(segment_file.has_value());
+		this->pack_segments.push(
+			BlobPackSegment{.offset = this->pack_mapped_size, .file = std::move(segment_file.value())});
+		this->pack_mapped_size = this->pack_size;
+	}
+
+	for (const auto &segment : this->pack_segments) {
+		const auto content = segment.file.content();
+		if (segment.offset <= entry.offset && entry.offset + entry.size <= segment.offset + content.len()) {
+			return exo::Span<const u8>{content.data() + (entry.offset - segment.offset), usize(entry.size)};
+		}
+	}
+
+	// Records are appended completely before being mapped, a record cannot span two segments
+	ASSERT(false);
+	return {};
+}
+
+Option<exo::Span<const u8>> BlobArchive::get(exo::u128 blob_hash)
+{
+	const auto *entry = this->_find(blob_hash);
+	if (!entry) {
+		return {};
+	}
+	return this->_map_entry(*entry);
+}
+
+usize BlobArchive::read(exo::u128 blob_hash, exo::Span<u8> out_data)
+{
+	auto blob = this->get(blob_hash);
+	if (!blob) {
+		return 0;
+	}
+
+	ASSERT(out_data.len() >= blob->len());
+	std::copy(blob->begin(), blob->end(), out_data.begin());
+	return blob->len();
+}
+
+bool BlobArchive::contains(exo::u128 blob_hash) const { return this->_find(blob_hash) != nullptr; }
+
+void BlobArchive::save(exo::u128 blob_hash, exo::Span<const u8> blob_data)
+{
+	EXO_PROFILE_SCOPE
+
+	if (this->contains(blob_hash)) {
+		return;
+	}
+
+	auto entry   = entry_from_hash(blob_hash);
+	entry.offset = append_record(this->pack_fp, this->pack_size, entry, blob_data);
+	entry.size   = blob_data.len();
+	this->pending_entries.push(entry);
+}
+
+void BlobArchive::commit()
+{
+	EXO_PROFILE_SCOPE
+
+	if (this->pending_entries.is_empty()) {
+		return;
+	}
+
+	// The index must describe data that is on disk
+	fflush(this->pack_fp);
+
+	// The temporary index cannot replace the current one while it is mapped
+	Vec<BlobIndexEntry> indexed_copy = Vec<BlobIndexEntry>::with_length(u32(this->indexed_entries.len()));
+	std::copy(this->indexed_entries.begin(), this->indexed_entries.end(), indexed_copy.begin());
+	this->index_file.close();
+	this->indexed_entries = {};
+
+	// The index is replaced in one rename, a crash while writing it keeps the previous one
+	const auto tmp_index_path = tmp_path_of(this->index_path);
+	write_index(tmp_index_path, indexed_copy, this->pending_entries, this->pack_size);
+	replace_file(tmp_index_path, this->index_path);
+	indexed_copy.buffer.destroy();
+	this->pending_entries.clear();
+
+	const usize indexed_pack_size = load_index(*this);
+	ASSERT(indexed_pack_size == this->pack_size);
+}
+
+usize BlobArchive::compact(const exo::Path &directory, exo::Span<const BlobHash> live_blobs)
+{
+	EXO_PROFILE_SCOPE
+
+	auto archive = BlobArchive::open(directory);
+
+	// Sort the live blobs to write them in the same order as the index, a blob can be referenced multiple times
+	Vec<BlobIndexEntry> live_entries = Vec<BlobIndexEntry>::with_capacity(u32(live_blobs.len()));
+	for (auto blob_hash : live_blobs) {
+		BlobIndexEntry entry = {};
+		entry.hash0          = blob_hash.hash0;
+		entry.hash1          = blob_hash.hash1;
+		live_entries.push(entry);
+	}
+	std::sort(live_entries.begin(), live_entries.end(), entry_less);
+	auto *unique_end = std::unique(live_entries.begin(), live_entries.end(), entry_same_hash);
+	live_entries.resize(u32(unique_end - live_entries.begin()));
+
+	const auto tmp_pack_path = tmp_path_of(archive.pack_path);
+	FILE      *tmp_pack_fp   = fopen(tmp_pack_path.view().data(), "wb");
+	ASSERT(tmp_pack_fp != nullptr);
+
+	usize new_pack_size = 0;
+	u32   i_written     = 0;
+	for (u32 i_live = 0; i_live < live_entries.len(); ++i_live) {
+		const auto &live_entry = live_entries[i_live];
+
+		const auto blob_hash = exo::u128_from_u64(live_entry.hash1, live_entry.hash0);
+		auto       blob      = archive.get(blob_hash);
+		if (!blob) {
+			exo::logger::error("[BlobArchive] Blob %llx%llx is referenced but missing from the archive.\n",
+				(unsigned long long)live_entry.hash0,
+				(unsigned long long)live_entry.hash1);
+			continue;
+		}
+
+		auto new_entry   = live_entry;
+		new_entry.offset = append_record(tmp_pack_fp, new_pack_size, live_entry, blob.value());
+		new_entry.size   = blob->len();
+		live_entries[i_written++] = new_entry;
+	}
+	live_entries.resize(i_written);
+	fclose(tmp_pack_fp);
+
+	const usize old_pack_size = archive.pack_size;
+	archive.close();
+
+	const auto tmp_index_path = tmp_path_of(archive.index_path);
+	write_index(tmp_index_path, live_entries, {}, new_pack_size);
+	live_entries.buffer.destroy();
+
+	// The old index must never describe the new pack. Without an index, opening the archive recovers every record
+	// of the pack that is present: the old one if the pack was not replaced yet, the new one otherwise.
+	std::filesystem::remove(std::filesystem::path{archive.index_path.view().data()});
+	replace_file(tmp_pack_path, archive.pack_path);
+	replace_file(tmp_index_path, archive.index_path);
+
+	exo::logger::info("[BlobArchive] Compacted %s: %u blobs, %zu -> %zu bytes.\n",
+		archive.pack_path.view().data(),
+		i_written,
+		old_pack_size,
+		new_pack_size);
+
+	return old_pack_size > new_pack_size ? old_pack_size - new_pack_size : 0;
+}
@@ -0,0 +1,362 @@
+#include "assets/bvh.h"
+
+#include "cross/jobmanager.h"
+#include "cross/jobs/foreach.h"
+#include "cross/jobs/waitable.h"
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+
+#include <algorithm>
+
+static constexpr u32 MAX_BINS = 32;
+
+struct BuildPrimitive
+{
+	exo::AABB bounds;
+	float3    centroid;
+	u32       prim_index;
+};
+
+// Primitives [begin, end) are built into the nodes starting at `i_node`
+struct BuildTask
+{
+	u32 begin;
+	u32 end;
+	u32 i_node;
+};
+
+struct BuildContext
+{
+	const BVHBuildSettings    &settings;
+	exo::Span<BuildPrimitive> primitives;
+	exo::Span<BVHNode>        nodes;
+};
+
+struct Bin
+{
+	exo::AABB bounds;
+	u32       count = 0;
+};
+
+static float3 min3(float3 a, float3 b) { return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)}; }
+static float3 max3(float3 a, float3 b) { return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)}; }
+
+static exo::AABB merge(const exo::AABB &a, const exo::AABB &b)
+{
+	return exo::AABB{.min = min3(a.min, b.min), .max = max3(a.max, b.max)};
+}
+
+// Returns the first primitive of the right child, the range is partitioned in place
+static u32 split_range(const BuildContext &ctx, const BuildTask &task, const exo::AABB &centroid_bounds)
+{
+	const u32 bin_count = std::clamp(ctx.settings.bin_count, 2u, MAX_BINS);
+
+	float best_cost  = std::numeric_limits<float>::infinity();
+	u32   best_axis  = u32_invalid;
+	u32   best_split = 0; // last bin of the left child
+
+	for (u32 axis = 0; axis < 3; ++axis) {
+		const float axis_min    = centroid_bounds.min[axis];
+		const float axis_extent = centroid_bounds.max[axis] - axis_min;
+		if (axis_extent <= 0.0f) {
+			continue;
+		}
+
+		Bin         bins[MAX_BINS] = {};
+		const float scale          = float(bin_count) / axis_extent;
+		for (u32 i_prim = task.begin; i_prim < task.end; ++i_prim) {
+			const auto &primitive = ctx.primitives[i_prim];
+			const u32   i_bin     = std::min(bin_count - 1, u32((primitive.centroid[axis] - axis_min) * scale));
+			bins[i_bin].count += 1;
+			bins[i_bin].bounds = merge(bins[i_bin].bounds, primitive.bounds);
+		}
+
+		// Sweep from the right to get the cost of the right side of each split
+		float     right_costs[MAX_BINS] = {};
+		exo::AABB right_bounds          = {};
+		u32       right_count           = 0;
+		for (u32 i_bin = bin_count - 1; i_bin > 0; --i_bin) {
+			right_bounds = merge(right_bounds, bins[i_bin].bounds);
+			right_count += bins[i_bin].count;
+			right_costs[i_bin - 1] = right_count > 0 ? exo::surface(right_bounds) * float(right_count) : 0.0f;
+		}
+
+		exo::AABB left_bounds = {};
+		u32       left_count  = 0;
+		for (u32 i_split = 0; i_split + 1 < bin_count; ++i_split) {
+			left_bounds = merge(left_bounds, bins[i_split].bounds);
+			left_count += bins[i_split].count;
+
+			const u32 split_right_count = (task.end - task.begin) - left_count;
+			if (left_count == 0 || split_right_count == 0) {
+				continue;
+			}
+			const float cost = exo::surface(left_bounds) * float(left_count) + right_costs[i_split];
+			if (cost < best_cost) {
+				best_cost  = cost;
+				best_axis  = axis;
+				best_split = i_split;
+			}
+		}
+	}
+
+	auto *begin = ctx.primitives.data() + task.begin;
+	auto *end   = ctx.primitives.data() + task.end;
+
+	if (best_axis != u32_invalid) {
+		const float axis_min = centroid_bounds.min[best_axis];
+		const float scale    = float(bin_count) / (centroid_bounds.max[best_axis] - axis_min);
+		auto       *middle   = std::partition(begin, end, [&](const BuildPrimitive &primitive) {
+            const u32 i_bin = std::min(bin_count - 1, u32((primitive.centroid[best_axis] - axis_min) * scale));
+            return i_bin <= best_split;
+        });
+		if (middle != begin && middle != end) {
+			return u32(middle - ctx.primitives.data());
+		}
+	}
+
+	// All the centroids are at the same position, split in the middle
+	auto *middle = begin + (end - begin) / 2;
+	std::nth_element(begin, middle, end, [](const BuildPrimitive &lhs, const BuildPrimitive &rhs) {
+		return lhs.prim_index < rhs.prim_index;
+	});
+	return u32(middle - ctx.primitives.data());
+}
+
+// Writes the node of `task` and returns the tasks of its children, if any
+static u32 build_node(const BuildContext &ctx, const BuildTask &task, BuildTask (&out_children)[2])
+{
+	exo::AABB bounds          = {};
+	exo::AABB centroid_bounds = {};
+	for (u32 i_prim = task.begin; i_prim < task.end; ++i_prim) {
+		const auto &primitive = ctx.primitives[i_prim];
+		bounds                = merge(bounds, primitive.bounds);
+		centroid_bounds       = merge(centroid_bounds, exo::AABB{.min = primitive.centroid, .max = primitive.centroid});
+	}
+
+	const u32 subtree_size = 2 * (task.end - task.begin) - 1;
+	const u32 next_node    = task.i_node + subtree_size;
+
+	auto &node     = ctx.nodes[task.i_node];
+	node.bbox_min  = bounds.min;
+	node.bbox_max  = bounds.max;
+	node.next_node = next_node < ctx.nodes.len() ? next_node : u32_invalid;
+
+	if (task.end - task.begin == 1) {
+		node.prim_index = ctx.primitives[task.begin].prim_index;
+		return 0;
+	}
+
+	node.prim_index = u32_invalid;
+	const u32 split = split_range(ctx, task, centroid_bounds);
+	out_children[0] = BuildTask{.begin = task.begin, .end = split, .i_node = task.i_node + 1};
+	out_children[1] = BuildTask{.begin = split, .end = task.end, .i_node = task.i_node + 2 * (split - task.begin)};
+	return 2;
+}
+
+static void build_subtree(const BuildContext &ctx, const BuildTask &root)
+{
+	Vec<BuildTask> stack;
+	stack.push(root);
+	while (!stack.is_empty()) {
+		const BuildTask task = stack.pop();
+
+		BuildTask children[2];
+		const u32 children_count = build_node(ctx, task, children);
+		for (u32 i_child = 0; i_child < children_count; ++i_child) {
+			stack.push(children[i_child]);
+		}
+	}
+	stack.buffer.destroy();
+}
+
+static void build_bvh(const BVHBuildSettings &settings,
+	const cross::JobManager                  *jobmanager,
+	exo::Span<BuildPrimitive>                 primitives,
+	Vec<BVHNode>                             &out_nodes)
+{
+	EXO_PROFILE_SCOPE
+
+	out_nodes.clear();
+	if (primitives.empty()) {
+		return;
+	}
+	out_nodes.resize(2 * u32(primitives.len()) - 1);
+
+	const BuildContext ctx = {.settings = settings, .primitives = primitives, .nodes = out_nodes};
+	const BuildTask    root{.begin = 0, .end = u32(primitives.len()), .i_node = 0};
+
+	if (jobmanager == nullptr || primitives.len() <= settings.parallel_threshold) {
+		build_subtree(ctx, root);
+		return;
+	}
+
+	// Split the top of the tree on this thread until the subtrees are small enough to be built by one job
+	Vec<BuildTask> pending;
+	Vec<BuildTask> subtrees;
+	pending.push(root);
+	while (!pending.is_empty()) {
+		const BuildTask task = pending.pop();
+
+		if (task.end - task.begin <= settings.parallel_threshold) {
+			subtrees.push(task);
+			continue;
+		}
+
+		BuildTask children[2];
+		const u32 children_count = build_node(ctx, task, children);
+		for (u32 i_child = 0; i_child < children_count; ++i_child) {
+			pending.push(children[i_child]);
+		}
+	}
+
+	auto waitable = cross::parallel_foreach_userdata<BuildTask, const BuildContext>(
+		*jobmanager,
+		subtrees,
+		&ctx,
+		[](BuildTask &task, const BuildContext *build_ctx) { build_subtree(*build_ctx, task); },
+		1);
+	waitable->wait();
+
+	pending.buffer.destroy();
+	subtrees.buffer.destroy();
+}
+
+void build_blas(const BVHBuildSettings &settings,
+	const cross::JobManager            *jobmanager,
+	exo::Span<const u32>                indices,
+	exo::Span<const float4>             positions,
+	Vec<BVHNode>                       &out_nodes)
+{
+	EXO_PROFILE_SCOPE
+
+	ASSERT(indices.len() % 3 == 0);
+	auto primitives = Vec<BuildPrimitive>::with_length(u32(indices.len() / 3));
+	for (u32 i_triangle = 0; i_triangle < primitives.len(); ++i_triangle) {
+		auto &primitive      = primitives[i_triangle];
+		primitive.bounds     = {};
+		primitive.prim_index = 3 * i_triangle;
+		for (u32 i_vertex = 0; i_vertex < 3; ++i_vertex) {
+			const auto &position = positions[indices[3 * i_triangle + i_vertex]];
+			exo::extend(primitive.bounds, float3(position.x, position.y, position.z));
+		}
+		primitive.centroid = exo::center(primitive.bounds);
+	}
+
+	build_bvh(settings, jobmanager, primitives, out_nodes);
+	primitives.buffer.destroy();
+}
+
+void build_tlas(const BVHBuildSettings &settings,
+	const cross::JobManager            *jobmanager,
+	exo::Span<const exo::AABB>          instance_bounds,
+	Vec<BVHNode>                       &out_nodes)
+{
+	EXO_PROFILE_SCOPE
+
+	auto primitives = Vec<BuildPrimitive>::with_length(u32(instance_bounds.len()));
+	for (u32 i_instance = 0; i_instance < primitives.len(); ++i_instance) {
+		primitives[i_instance] = BuildPrimitive{
+			.bounds     = instance_bounds[i_instance],
+			.centroid   = exo::center(instance_bounds[i_instance]),
+			.prim_index = i_instance,
+		};
+	}
+
+	build_bvh(settings, jobmanager, primitives, out_nodes);
+	primitives.buffer.destroy();
+}
+
+void refit_tlas(exo::Span<BVHNode> nodes, exo::Span<const exo::AABB> instance_bounds)
+{
+	EXO_PROFILE_SCOPE
+
+	// Children are stored after their parent
+	for (usize i_node = nodes.len(); i_node-- > 0;) {
+		auto &node = nodes[i_node];
+		if (node.prim_index != u32_invalid) {
+			node.bbox_min = instance_bounds[node.prim_index].min;
+			node.bbox_max = instance_bounds[node.prim_index].max;
+		} else {
+			const auto &left  = nodes[i_node + 1];
+			const auto &right = nodes[left.next_node];
+			node.bbox_min     = min3(left.bbox_min, right.bbox_min);
+			node.bbox_max     = max3(left.bbox_max, right.bbox_max);
+		}
+	}
+}
+
+// -- Traversal
+
+static bool fast_box_intersection(const BVHNode &node, const BVHRay &ray, float3 inv_ray_dir)
+{
+	const float3 t0   = (node.bbox_min - ray.origin) * inv_ray_dir;
+	const float3 t1   = (node.bbox_max - ray.origin) * inv_ray_dir;
+	const float3 tmin = min3(t0, t1);
+	const float3 tmax = max3(t0, t1);
+	const float  t_enter = std::max(std::max(std::max(tmin.x, tmin.y), tmin.z), ray.t_min);
+	const float  t_exit  = std::min(std::min(std::min(tmax.x, tmax.y), tmax.z), ray.t_max);
+	return t_enter <= t_exit;
+}
+
+static float3 triangle_intersection(const BVHRay &ray, float3 v0, float3 e0, float3 e1, float &o_d)
+{
+	const float3 rov0 = ray.origin - v0;
+	const float3 n    = exo::cross(e0, e1);
+	const float3 q    = exo::cross(rov0, ray.direction);
+	const float  d    = 1.0f / exo::dot(ray.direction, n);
+	const float  u    = -d * exo::dot(q, e1);
+	const float  v    = d * exo::dot(q, e0);
+	o_d               = -d * exo::dot(n, rov0);
+	if (u < 0.0f || u > 1.0f || v < 0.0f || (u + v) > 1.0f) {
+		o_d = -1.0f;
+	}
+	return float3(1.0f - u - v, u, v);
+}
+
+bool blas_closest_hit(exo::Span<const BVHNode> nodes,
+	exo::Span<const u32>                       indices,
+	exo::Span<const float4>                    positions,
+	const BVHRay                              &ray,
+	BVHHit                                    &hit)
+{
+	hit = {};
+	if (nodes.empty()) {
+		return false;
+	}
+
+	const float3 inv_ray_dir = float3(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+	u32 i_node = 0;
+	while (i_node != u32_invalid) {
+		const auto &node = nodes[i_node];
+
+		if (node.prim_index != u32_invalid) {
+			const auto &p0 = positions[indices[node.prim_index + 0]];
+			const auto &p1 = positions[indices[node.prim_index + 1]];
+			const auto &p2 = positions[indices[node.prim_index + 2]];
+			const float3 v0 = float3(p0.x, p0.y, p0.z);
+
+			float        d            = 0.0f;
+			const float3 barycentrics = triangle_intersection(ray,
+				v0,
+				float3(p1.x, p1.y, p1.z) - v0,
+				float3(p2.x, p2.y, p2.z) - v0,
+				d);
+			if (0.0f < d && d < hit.d) {
+				hit.d            = d;
+				hit.barycentrics = barycentrics;
+				hit.triangle_id  = node.prim_index;
+			}
+		} else if (fast_box_intersection(node, ray, inv_ray_dir)) {
+			hit.box_inter_count += 1;
+			i_node += 1;
+			continue;
+		}
+
+		// the ray missed the triangle or the node's bounding box, skip the subtree
+		i_node = node.next_node;
+	}
+
+	return hit.d < std::numeric_limits<float>::infinity();
+}
@@ -0,0 +1,327 @@
+#include "importers/gltf_accessors.h"
+
+#include "exo/profile.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <immintrin.h>
+
+namespace gltf
+{
+static_assert(sizeof(float2) == 2 * sizeof(float));
+static_assert(sizeof(float4) == 4 * sizeof(float));
+
+template <typename T>
+static T load(const u8 *p)
+{
+	T value;
+	std::memcpy(&value, p, sizeof(T));
+	return value;
+}
+
+// Normalized integers are mapped to [0, 1] (unsigned) or [-1, 1] (signed)
+static float component_scale(ComponentType type, bool normalized)
+{
+	if (!normalized) {
+		return 1.0f;
+	}
+	switch (type) {
+	case ComponentType::Byte:
+		return 1.0f / 127.0f;
+	case ComponentType::UnsignedByte:
+		return 1.0f / 255.0f;
+	case ComponentType::Short:
+		return 1.0f / 32767.0f;
+	case ComponentType::UnsignedShort:
+		return 1.0f / 65535.0f;
+	default:
+		return 1.0f;
+	}
+}
+
+static float component_min(ComponentType type, bool normalized)
+{
+	const bool is_signed = type == ComponentType::Byte || type == ComponentType::Short;
+	return normalized && is_signed ? -1.0f : -FLT_MAX;
+}
+
+static float read_component(const u8 *p, ComponentType type, float scale, float min_value)
+{
+	float value = 0.0f;
+	switch (type) {
+	case ComponentType::Float:
+		return load<float>(p);
+	case ComponentType::Byte:
+		value = float(load<i8>(p));
+		break;
+	case ComponentType::UnsignedByte:
+		value = float(load<u8>(p));
+		break;
+	case ComponentType::Short:
+		value = float(load<i16>(p));
+		break;
+	case ComponentType::UnsignedShort:
+		value = float(load<u16>(p));
+		break;
+	case ComponentType::UnsignedInt:
+		value = float(load<u32>(p));
+		break;
+	default:
+		ASSERT(false);
+	}
+	return std::max(value * scale, min_value);
+}
+
+static u32 read_index(const u8 *p, ComponentType type)
+{
+	switch (type) {
+	case ComponentType::UnsignedByte:
+		return load<u8>(p);
+	case ComponentType::UnsignedShort:
+		return load<u16>(p);
+	case ComponentType::UnsignedInt:
+		return load<u32>(p);
+	default:
+		ASSERT(false);
+		return 0;
+	}
+}
+
+// -- Indices
+
+void decode_indices(const AccessorView &view, u32 base_vertex, exo::Span<u32> out)
+{
+	EXO_PROFILE_SCOPE
+	ASSERT(out.len() == view.count);
+	ASSERT(view.nb_component == 1);
+
+	const u8 *src   = view.data;
+	u32      *dst   = out.data();
+	usize     i     = 0;
+	const u32 count = view.count;
+
+	// Index buffers are tightly packed, other strides only go through the scalar loop
+	if (view.byte_stride == size_of(view.component_type)) {
+		const __m128i base4 = _mm_set1_epi32(i32(base_vertex));
+#if defined(__AVX2__)
+		const __m256i base8 = _mm256_set1_epi32(i32(base_vertex));
+#endif
+
+		switch (view.component_type) {
+		case ComponentType::UnsignedByte: {
+#if defined(__AVX2__)
+			for (; i + 8 <= count; i += 8) {
+				const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_add_epi32(indices, base8));
+			}
+#endif
+			for (; i + 4 <= count; i += 4) {
+				const __m128i indices = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(load<i32>(src + i)));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_add_epi32(indices, base4));
+			}
+			break;
+		}
+		case ComponentType::UnsignedShort: {
+#if defined(__AVX2__)
+			for (; i + 8 <= count; i += 8) {
+				const __m256i indices =
+					_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_add_epi32(indices, base8));
+			}
+#endif
+			for (; i + 4 <= count; i += 4) {
+				const __m128i indices = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + 2 * i)));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_add_epi32(indices, base4));
+			}
+			break;
+		}
+		case ComponentType::UnsignedInt: {
+#if defined(__AVX2__)
+			for (; i + 8 <= count; i += 8) {
+				const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 4 * i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_add_epi32(indices, base8));
+			}
+#endif
+			for (; i + 4 <= count; i += 4) {
+				const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * i));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_add_epi32(indices, base4));
+			}
+			break;
+		}
+		default:
+			ASSERT(false);
+		}
+	}
+
+	for (; i < count; ++i) {
+		dst[i] = base_vertex + read_index(src + i * view.byte_stride, view.component_type);
+	}
+}
+
+// -- Vertex attributes
+
+// Loads the first 4 components of an element, it can read up to 4 bytes past the 3rd component.
+template <ComponentType TYPE>
+static __m128 load_float4(const u8 *element, __m128 scale, __m128 min_value)
+{
+	if constexpr (TYPE == ComponentType::Float) {
+		return _mm_loadu_ps(reinterpret_cast<const float *>(element));
+	} else {
+		__m128i ints;
+		if constexpr (TYPE == ComponentType::Byte) {
+			ints = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(load<i32>(element)));
+		} else if constexpr (TYPE == ComponentType::UnsignedByte) {
+			ints = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(load<i32>(element)));
+		} else if constexpr (TYPE == ComponentType::Short) {
+			ints = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(element)));
+		} else {
+			static_assert(TYPE == ComponentType::UnsignedShort);
+			ints = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(element)));
+		}
+		return _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(ints), scale), min_value);
+	}
+}
+
+// Loads exactly the first 2 components of an element
+template <ComponentType TYPE>
+static __m128 load_float2(const u8 *element, __m128 scale, __m128 min_value)
+{
+	if constexpr (TYPE == ComponentType::Float) {
+		return _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(element)));
+	} else {
+		__m128i ints;
+		if constexpr (TYPE == ComponentType::Byte) {
+			ints = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(load<u16>(element)));
+		} else if constexpr (TYPE == ComponentType::UnsignedByte) {
+			ints = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(load<u16>(element)));
+		} else if constexpr (TYPE == ComponentType::Short) {
+			ints = _mm_cvtepi16_epi32(_mm_cvtsi32_si128(load<i32>(element)));
+		} else {
+			static_assert(TYPE == ComponentType::UnsignedShort);
+			ints = _mm_cvtepu16_epi32(_mm_cvtsi32_si128(load<i32>(element)));
+		}
+		return _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(ints), scale), min_value);
+	}
+}
+
+template <ComponentType TYPE>
+static void decode_positions_kernel(const AccessorView &view, exo::Span<float4> out)
+{
+	const float  scale     = component_scale(TYPE, view.normalized);
+	const float  min_value = component_min(TYPE, view.normalized);
+	const __m128 scale4    = _mm_set1_ps(scale);
+	const __m128 min4      = _mm_set1_ps(min_value);
+	const __m128 one4      = _mm_set1_ps(1.0f);
+
+	// The vector loads read past the 3rd component, it is part of the next element except for the last one.
+	u32 i = 0;
+	for (; i + 1 < view.count; ++i) {
+		const __m128 position = load_float4<TYPE>(view.data + i * view.byte_stride, scale4, min4);
+		_mm_storeu_ps(&out[i].x, _mm_blend_ps(position, one4, 0b1000));
+	}
+	for (; i < view.count; ++i) {
+		const u8   *element = view.data + i * view.byte_stride;
+		const usize size    = size_of(TYPE);
+		const float x       = read_component(element, TYPE, scale, min_value);
+		const float y       = read_component(element + size, TYPE, scale, min_value);
+		const float z       = read_component(element + 2 * size, TYPE, scale, min_value);
+		out[i]              = float4(x, y, z, 1.0f);
+	}
+}
+
+void decode_positions(const AccessorView &view, exo::Span<float4> out)
+{
+	EXO_PROFILE_SCOPE
+	ASSERT(out.len() == view.count);
+	ASSERT(view.nb_component >= 3);
+
+	switch (view.component_type) {
+	case ComponentType::Float:
+		decode_positions_kernel<ComponentType::Float>(view, out);
+		break;
+	case ComponentType::Byte:
+		decode_positions_kernel<ComponentType::Byte>(view, out);
+		break;
+	case ComponentType::UnsignedByte:
+		decode_positions_kernel<ComponentType::UnsignedByte>(view, out);
+		break;
+	case ComponentType::Short:
+		decode_positions_kernel<ComponentType::Short>(view, out);
+		break;
+	case ComponentType::UnsignedShort:
+		decode_positions_kernel<ComponentType::UnsignedShort>(view, out);
+		break;
+	default:
+		ASSERT(false);
+	}
+}
+
+template <ComponentType TYPE>
+static void decode_uvs_kernel(const AccessorView &view, exo::Span<float2> out)
+{
+	const float  scale     = component_scale(TYPE, view.normalized);
+	const float  min_value = component_min(TYPE, view.normalized);
+	const __m128 scale4    = _mm_set1_ps(scale);
+	const __m128 min4      = _mm_set1_ps(min_value);
+
+	u32 i = 0;
+#if defined(__AVX2__)
+	// Tightly packed 16-bit UVs, 4 UVs per iteration
+	if constexpr (TYPE == ComponentType::Short || TYPE == ComponentType::UnsignedShort) {
+		if (view.byte_stride == 2 * sizeof(u16)) {
+			const __m256 scale8 = _mm256_set1_ps(scale);
+			const __m256 min8   = _mm256_set1_ps(min_value);
+			for (; i + 4 <= view.count; i += 4) {
+				const __m128i shorts = _mm_loadu_si128(reinterpret_cast<const __m128i *>(view.data + i * view.byte_stride));
+				__m256i       ints;
+				if constexpr (TYPE == ComponentType::Short) {
+					ints = _mm256_cvtepi16_epi32(shorts);
+				} else {
+					ints = _mm256_cvtepu16_epi32(shorts);
+				}
+				const __m256 uvs = _mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale8), min8);
+				_mm256_storeu_ps(&out[i].x, uvs);
+			}
+		}
+	}
+#endif
+
+	for (; i < view.count; ++i) {
+		const __m128 uv = load_float2<TYPE>(view.data + i * view.byte_stride, scale4, min4);
+		_mm_storel_pi(reinterpret_cast<__m64 *>(&out[i].x), uv);
+	}
+}
+
+void decode_uvs(const AccessorView &view, exo::Span<float2> out)
+{
+	EXO_PROFILE_SCOPE
+	ASSERT(out.len() == view.count);
+	ASSERT(view.nb_component >= 2);
+
+	switch (view.component_type) {
+	case ComponentType::Float:
+		// Same layout as the destination
+		if (view.byte_stride == sizeof(float2)) {
+			std::copy(view.data, view.data + usize(view.count) * sizeof(float2), reinterpret_cast<u8 *>(out.data()));
+		} else {
+			decode_uvs_kernel<ComponentType::Float>(view, out);
+		}
+		break;
+	case ComponentType::Byte:
+		decode_uvs_kernel<ComponentType::Byte>(view, out);
+		break;
+	case ComponentType::UnsignedByte:
+		decode_uvs_kernel<ComponentType::UnsignedByte>(view, out);
+		break;
+	case ComponentType::Short:
+		decode_uvs_kernel<ComponentType::Short>(view, out);
+		break;
+	case ComponentType::UnsignedShort:
+		decode_uvs_kernel<ComponentType::UnsignedShort>(view, out);
+		break;
+	default:
+		ASSERT(false);
+	}
+}
+} // namespace gltf
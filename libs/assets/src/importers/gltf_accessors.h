@@ -0,0 +1,63 @@
+#pragma once
+#include "exo/collections/span.h"
+#include "exo/macros/assert.h"
+#include "exo/maths/numerics.h"
+#include "exo/maths/vectors.h"
+
+/**
+   Bulk decoding of glTF accessors.
+   Accessors are decoded all at once into the destination arrays instead of element by element, the common layouts
+   (tightly packed or interleaved floats, 8/16/32-bit indices, normalized integers) use SSE4.1/AVX2 kernels.
+ **/
+namespace gltf
+{
+enum struct ComponentType : i32
+{
+	Byte          = 5120,
+	UnsignedByte  = 5121,
+	Short         = 5122,
+	UnsignedShort = 5123,
+	UnsignedInt   = 5125,
+	Float         = 5126,
+	Invalid
+};
+
+inline u32 size_of(ComponentType type)
+{
+	switch (type) {
+	case ComponentType::Byte:
+	case ComponentType::UnsignedByte:
+		return 1;
+
+	case ComponentType::Short:
+	case ComponentType::UnsignedShort:
+		return 2;
+
+	case ComponentType::UnsignedInt:
+	case ComponentType::Float:
+		return 4;
+
+	default:
+		ASSERT(false);
+		return 4;
+	}
+}
+
+// The elements of an accessor in its buffer
+struct AccessorView
+{
+	const u8     *data           = nullptr; // first element
+	usize         byte_stride    = 0;
+	u32           count          = 0;
+	u32           nb_component   = 0;
+	ComponentType component_type = ComponentType::Invalid;
+	bool          normalized     = false;
+};
+
+// out[i] = base_vertex + indices[i]
+void decode_indices(const AccessorView &view, u32 base_vertex, exo::Span<u32> out);
+// Reads the first 3 components, w is set to 1
+void decode_positions(const AccessorView &view, exo::Span<float4> out);
+// Reads the first 2 components
+void decode_uvs(const AccessorView &view, exo::Span<float2> out);
+} // namespace gltf
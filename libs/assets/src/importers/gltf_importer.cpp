@@ -1,8 +1,10 @@
 #include "assets/importers/gltf_importer.h"
 #include "assets/asset_manager.h"
+#include "assets/bvh.h"
 #include "assets/importers/importer.h"
 #include "assets/material.h"
 #include "assets/mesh.h"
+#include "assets/mesh_encoding.h"
 #include "assets/subscene.h"
 #include "assets/texture.h"
 #include "cross/mapped_file.h"
@@ -10,7 +12,8 @@
 #include "exo/format.h"
 #include "exo/maths/pointer.h"
 #include "exo/memory/scope_stack.h"
-#include "exo/memory/string_repository.h"
+#include "importers/gltf_accessors.h"
+#include <algorithm>
 #include <rapidjson/document.h>
 #include <rapidjson/error/en.h>
 #include <rapidjson/filewritestream.h>
@@ -20,37 +23,6 @@
 
 namespace gltf
 {
-enum struct ComponentType : i32
-{
-	Byte          = 5120,
-	UnsignedByte  = 5121,
-	Short         = 5122,
-	UnsignedShort = 5123,
-	UnsignedInt   = 5125,
-	Float         = 5126,
-	Invalid
-};
-
-inline u32 size_of(ComponentType type)
-{
-	switch (type) {
-	case ComponentType::Byte:
-	case ComponentType::UnsignedByte:
-		return 1;
-
-	case ComponentType::Short:
-	case ComponentType::UnsignedShort:
-		return 2;
-
-	case ComponentType::UnsignedInt:
-	case ComponentType::Float:
-		return 4;
-
-	default:
-		ASSERT(false);
-		return 4;
-	}
-}
 enum struct ChunkType : u32
 {
 	Json   = 0x4E4F534A,
@@ -80,6 +52,7 @@ struct Accessor
 	u32           nb_component     = 0;
 	u32           bufferview_index = 0;
 	u32           byte_offset      = 0;
+	bool          normalized       = false;
 	float         min_float;
 	float         max_float;
 };
@@ -110,6 +83,10 @@ static Accessor get_accessor(const rapidjson::Value &object)
 
 	res.count = accessor["count"].GetUint();
 
+	if (accessor.HasMember("normalized")) {
+		res.normalized = accessor["normalized"].GetBool();
+	}
+
 	auto type = exo::StringView(accessor["type"].GetString());
 	if (type == "SCALAR") {
 		res.nb_component = 1;
@@ -167,9 +144,12 @@ struct ImporterContext
 	Vec<AssetId>               mesh_ids;
 	Vec<AssetId>               texture_ids;
 
-	Vec<uint>   indices;
-	Vec<float4> positions;
-	Vec<float2> uvs;
+	const MeshProcessingSettings &mesh_settings;
+	const MeshEncoding           &mesh_encoding;
+	MeshStreams                   mesh_streams;
+	Vec<MeshLodStreams>           mesh_lods;
+	Vec<u8>                       encoded_blob;
+	Vec<BVHNode>                  bvh_nodes;
 
 	[[nodiscard]] exo::Path relative_to_absolute_path(exo::StringView relative_path_str) const
 	{
@@ -185,14 +165,12 @@ struct ImporterContext
 	}
 };
 
-static exo::Span<const u8> get_binary_data(
-	ImporterContext &ctx, const gltf::BufferView &view, const gltf::Accessor &accessor, usize i_element = 0)
-
+static gltf::AccessorView get_accessor_view(
+	ImporterContext &ctx, const gltf::BufferView &view, const gltf::Accessor &accessor)
 {
-	const usize byte_stride =
-		view.byte_stride > 0 ? view.byte_stride : gltf::size_of(accessor.component_type) * accessor.nb_component;
-
-	const usize offset = view.byte_offset + accessor.byte_offset + i_element * byte_stride;
+	const usize element_size = gltf::size_of(accessor.component_type) * accessor.nb_component;
+	const usize byte_stride  = view.byte_stride > 0 ? view.byte_stride : element_size;
+	const usize offset       = view.byte_offset + accessor.byte_offset;
 
 	const u8 *source = nullptr;
 	if (view.i_buffer == u32_invalid) {
@@ -200,10 +178,29 @@ static exo::Span<const u8> get_binary_data(
 	} else {
 		source = ctx.buffers[view.i_buffer].data();
 		ASSERT(ctx.buffers[view.i_buffer].len() >= view.byte_offset + view.byte_length);
-		ASSERT(offset < view.byte_offset + view.byte_length);
+		ASSERT(accessor.count == 0 ||
+		       accessor.byte_offset + (accessor.count - 1) * byte_stride + element_size <= view.byte_length);
 	}
 	ASSERT(source != nullptr);
-	return exo::Span{exo::ptr_offset(source, offset), view.byte_length};
+
+	gltf::AccessorView res = {};
+	res.data               = exo::ptr_offset(source, offset);
+	res.byte_stride        = byte_stride;
+	res.count              = accessor.count;
+	res.nb_component       = accessor.nb_component;
+	res.component_type     = accessor.component_type;
+	res.normalized         = accessor.normalized;
+	return res;
+}
+
+static gltf::AccessorView get_accessor_view(ImporterContext &ctx, u32 i_accessor)
+{
+	const auto &j_accessors   = ctx.j_document["accessors"].GetArray();
+	const auto &j_bufferviews = ctx.j_document["bufferViews"].GetArray();
+
+	auto accessor   = gltf::get_accessor(j_accessors[i_accessor]);
+	auto bufferview = gltf::get_bufferview(j_bufferviews[accessor.bufferview_index]);
+	return get_accessor_view(ctx, bufferview, accessor);
 }
 
 static void import_buffers(ImporterContext &ctx)
@@ -221,6 +218,8 @@ static void import_buffers(ImporterContext &ctx)
 		auto bytelength    = j_buffer["byteLength"].GetUint();
 
 		ctx.files.push(cross::MappedFile::open(absolute_path.view()).value());
+		// Accessors are decoded mesh by mesh, start reading the whole buffer now
+		ctx.files.last().advise({.sequential = true, .will_need = true});
 
 		auto file_content = ctx.files.last().content();
 		ASSERT(file_content.len() == bytelength);
@@ -230,8 +229,7 @@ static void import_buffers(ImporterContext &ctx)
 
 static void import_meshes(ImporterContext &ctx)
 {
-	const auto &j_accessors   = ctx.j_document["accessors"].GetArray();
-	const auto &j_bufferviews = ctx.j_document["bufferViews"].GetArray();
+	EXO_PROFILE_SCOPE
 
 	if (!ctx.j_document.HasMember("meshes")) {
 		return;
@@ -255,114 +253,61 @@ static void import_meshes(ImporterContext &ctx)
 		auto mesh_uuid       = ctx.create_id<Mesh>(mesh_name);
 		ctx.mesh_ids[i_mesh] = mesh_uuid;
 		auto *new_mesh       = ctx.api.create_asset<Mesh>(mesh_uuid);
-		ctx.positions.clear();
-		ctx.uvs.clear();
-		ctx.indices.clear();
 
 		if (j_mesh.HasMember("name")) {
-			new_mesh->name = exo::tls_string_repository->intern(j_mesh["name"].GetString());
+			new_mesh->name = ctx.api.intern(j_mesh["name"].GetString());
 		}
 
+		// Size the vertex and index arrays of the whole mesh, accessors are then decoded in place
+		u32 mesh_index_count  = 0;
+		u32 mesh_vertex_count = 0;
 		for (auto &j_primitive : j_mesh["primitives"].GetArray()) {
+			ASSERT(j_primitive.HasMember("indices"));
 			ASSERT(j_primitive.HasMember("attributes"));
 			const auto &j_attributes = j_primitive["attributes"].GetObj();
 			ASSERT(j_attributes.HasMember("POSITION"));
 
-			new_mesh->submeshes.push();
-			auto &new_submesh = new_mesh->submeshes.last();
+			mesh_index_count += get_accessor_view(ctx, j_primitive["indices"].GetUint()).count;
+			mesh_vertex_count += get_accessor_view(ctx, j_attributes["POSITION"].GetUint()).count;
+		}
+		auto &streams = ctx.mesh_streams;
+		streams.positions.resize(mesh_vertex_count);
+		streams.uvs.resize(mesh_vertex_count);
+		streams.indices.resize(mesh_index_count);
+
+		u32 first_vertex = 0;
+		u32 first_index  = 0;
+		for (auto &j_primitive : j_mesh["primitives"].GetArray()) {
+			const auto &j_attributes = j_primitive["attributes"].GetObj();
+
+			auto &new_submesh = streams.submeshes.push();
 
 			new_submesh.index_count  = 0;
-			new_submesh.first_vertex = static_cast<u32>(ctx.positions.len());
-			new_submesh.first_index  = static_cast<u32>(ctx.indices.len());
+			new_submesh.first_vertex = first_vertex;
+			new_submesh.first_index  = first_index;
 			new_submesh.material     = {};
 
 			// -- Attributes
-			ASSERT(j_primitive.HasMember("indices"));
 			{
-				auto j_accessor = j_accessors[j_primitive["indices"].GetUint()].GetObj();
-				auto accessor   = gltf::get_accessor(j_accessor);
-				auto bufferview = gltf::get_bufferview(j_bufferviews[accessor.bufferview_index]);
-
-				// Copy the data from the binary buffer
-				ctx.indices.reserve(accessor.count);
-				for (usize i_index = 0; i_index < usize(accessor.count); i_index += 1) {
-					u32 index = u32_invalid;
-					if (accessor.component_type == gltf::ComponentType::UnsignedShort) {
-						index =
-							new_submesh.first_vertex +
-							*reinterpret_cast<const u16 *>(get_binary_data(ctx, bufferview, accessor, i_index).data());
-					} else if (accessor.component_type == gltf::ComponentType::UnsignedInt) {
-						index =
-							new_submesh.first_vertex +
-							*reinterpret_cast<const u32 *>(get_binary_data(ctx, bufferview, accessor, i_index).data());
-					} else {
-						ASSERT(false);
-					}
-					ctx.indices.push(index);
-				}
-
-				new_submesh.index_count = accessor.count;
+				auto view = get_accessor_view(ctx, j_primitive["indices"].GetUint());
+				gltf::decode_indices(view, first_vertex, exo::Span<u32>(streams.indices.data() + first_index, view.count));
+				new_submesh.index_count = view.count;
+				first_index += view.count;
 			}
 
-			usize vertex_count = 0;
-			{
-				auto j_accessor = j_accessors[j_attributes["POSITION"].GetUint()].GetObj();
-				auto accessor   = gltf::get_accessor(j_accessor);
-				vertex_count    = accessor.count;
-				auto bufferview = gltf::get_bufferview(j_bufferviews[accessor.bufferview_index]);
-
-				// Copy the data from the binary buffer
-				ctx.positions.reserve(accessor.count);
-				for (usize i_position = 0; i_position < usize(accessor.count); i_position += 1) {
-					float4 new_position = {1.0f};
-
-					if (accessor.component_type == gltf::ComponentType::UnsignedShort) {
-						const auto *components = reinterpret_cast<const u16 *>(
-							get_binary_data(ctx, bufferview, accessor, i_position).data());
-						new_position = {float(components[0]), float(components[1]), float(components[2]), 1.0f};
-					} else if (accessor.component_type == gltf::ComponentType::Float) {
-						const auto *components = reinterpret_cast<const float *>(
-							get_binary_data(ctx, bufferview, accessor, i_position).data());
-						new_position = {float(components[0]), float(components[1]), float(components[2]), 1.0f};
-					} else {
-						ASSERT(false);
-					}
-
-					ctx.positions.push(new_position);
-				}
-			}
+			auto      positions_view = get_accessor_view(ctx, j_attributes["POSITION"].GetUint());
+			const u32 vertex_count   = positions_view.count;
+			gltf::decode_positions(positions_view, exo::Span<float4>(streams.positions.data() + first_vertex, vertex_count));
 
+			auto uvs = exo::Span<float2>(streams.uvs.data() + first_vertex, vertex_count);
 			if (j_attributes.HasMember("TEXCOORD_0")) {
-				auto j_accessor = j_accessors[j_attributes["TEXCOORD_0"].GetUint()].GetObj();
-				auto accessor   = gltf::get_accessor(j_accessor);
-				ASSERT(accessor.count == vertex_count);
-				auto bufferview = gltf::get_bufferview(j_bufferviews[accessor.bufferview_index]);
-
-				// Copy the data from the binary buffer
-				ctx.uvs.reserve(accessor.count);
-				for (usize i_uv = 0; i_uv < usize(accessor.count); i_uv += 1) {
-					float2 new_uv = {1.0f};
-
-					if (accessor.component_type == gltf::ComponentType::UnsignedShort) {
-						const auto *components =
-							reinterpret_cast<const u16 *>(get_binary_data(ctx, bufferview, accessor, i_uv).data());
-						new_uv = {float(components[0]), float(components[1])};
-					} else if (accessor.component_type == gltf::ComponentType::Float) {
-						const auto *components =
-							reinterpret_cast<const float *>(get_binary_data(ctx, bufferview, accessor, i_uv).data());
-						new_uv = {float(components[0]), float(components[1])};
-					} else {
-						ASSERT(false);
-					}
-
-					ctx.uvs.push(new_uv);
-				}
+				auto view = get_accessor_view(ctx, j_attributes["TEXCOORD_0"].GetUint());
+				ASSERT(view.count == vertex_count);
+				gltf::decode_uvs(view, uvs);
 			} else {
-				ctx.uvs.reserve(vertex_count);
-				for (usize i = 0; i < vertex_count; i += 1) {
-					ctx.uvs.push(float2(0.0f, 0.0f));
-				}
+				std::fill(uvs.begin(), uvs.end(), float2(0.0f, 0.0f));
 			}
+			first_vertex += vertex_count;
 
 			if (j_primitive.HasMember("material")) {
 				const u32 i_material = j_primitive["material"].GetUint();
@@ -371,17 +316,52 @@ static void import_meshes(ImporterContext &ctx)
 			}
 		}
 
-		auto positions_bytes          = exo::span_to_bytes<float4>(ctx.positions);
-		new_mesh->positions_hash      = ctx.api.save_blob(positions_bytes);
-		new_mesh->positions_byte_size = positions_bytes.len();
-
-		auto uvs_bytes          = exo::span_to_bytes<float2>(ctx.uvs);
-		new_mesh->uvs_hash      = ctx.api.save_blob(uvs_bytes);
-		new_mesh->uvs_byte_size = uvs_bytes.len();
+		process_mesh(ctx.mesh_settings, streams, ctx.mesh_lods);
+		new_mesh->submeshes = std::move(streams.submeshes);
+
+		// The blobs are stored encoded, the byte sizes are the sizes of the decoded streams
+		auto &encoding       = new_mesh->encoding;
+		encoding             = ctx.mesh_encoding;
+		encoding.indices_u16 = encoding.indices_u16 &&
+		                       assets::can_use_u16_indices(new_mesh->submeshes, streams.positions.len());
+		auto &encoded_blob = ctx.encoded_blob;
+
+		assets::encode_mesh_positions(encoding, new_mesh->submeshes, streams.positions, encoded_blob);
+		new_mesh->positions_hash      = ctx.api.save_blob(encoded_blob);
+		new_mesh->positions_byte_size = streams.positions.len() * sizeof(float4);
+
+		assets::encode_mesh_uvs(encoding, streams.uvs, encoded_blob);
+		new_mesh->uvs_hash      = ctx.api.save_blob(encoded_blob);
+		new_mesh->uvs_byte_size = streams.uvs.len() * sizeof(float2);
+
+		assets::encode_mesh_indices(encoding, new_mesh->submeshes, {}, streams.indices, encoded_blob);
+		new_mesh->indices_hash      = ctx.api.save_blob(encoded_blob);
+		new_mesh->indices_byte_size = streams.indices.len() * sizeof(u32);
+
+		// The import already runs in a job, waiting for the subtree jobs runs other jobs meanwhile
+		if (ctx.mesh_settings.build_bvh && !streams.indices.is_empty()) {
+			build_blas(BVHBuildSettings{},
+				ctx.api.manager.jobmanager,
+				streams.indices,
+				streams.positions,
+				ctx.bvh_nodes);
+			auto bvh_bytes          = exo::span_to_bytes<BVHNode>(ctx.bvh_nodes);
+			new_mesh->bvh_hash      = ctx.api.save_blob(bvh_bytes);
+			new_mesh->bvh_byte_size = bvh_bytes.len();
+		}
 
-		auto indices_bytes          = exo::span_to_bytes<uint>(ctx.indices);
-		new_mesh->indices_hash      = ctx.api.save_blob(indices_bytes);
-		new_mesh->indices_byte_size = indices_bytes.len();
+		for (auto &lod_streams : ctx.mesh_lods) {
+			auto &lod = new_mesh->lods.push();
+			assets::encode_mesh_indices(encoding,
+				new_mesh->submeshes,
+				lod_streams.submeshes,
+				lod_streams.indices,
+				encoded_blob);
+			lod.indices_hash      = ctx.api.save_blob(encoded_blob);
+			lod.indices_byte_size = lod_streams.indices.len() * sizeof(u32);
+			lod.error             = lod_streams.error;
+			lod.submeshes         = std::move(lod_streams.submeshes);
+		}
 
 		ctx.new_scene->add_dependency_checked(new_mesh->uuid);
 	}
@@ -483,7 +463,7 @@ static void import_nodes(ImporterContext &ctx)
 
 		ctx.new_scene->names.push();
 		if (j_node.HasMember("name")) {
-			ctx.new_scene->names.last() = exo::tls_string_repository->intern(j_node["name"].GetString());
+			ctx.new_scene->names.last() = ctx.api.intern(j_node["name"].GetString());
 		} else {
 			ctx.new_scene->names.last() = "No name";
 		}
@@ -525,7 +505,7 @@ static void import_materials(ImporterContext &ctx)
 		ctx.material_ids[i_material] = material_uuid;
 
 		if (j_material.HasMember("name")) {
-			new_material->name = exo::tls_string_repository->intern(j_material["name"].GetString());
+			new_material->name = ctx.api.intern(j_material["name"].GetString());
 		}
 
 		auto load_texture = [&](auto &json_object, const char *texture_name) -> u32 {
@@ -724,11 +704,13 @@ Result<ProcessResponse> GLTFImporter::process_asset(const ProcessRequest &reques
 	auto *new_scene = request.importer_api.create_asset<SubScene>(request.asset);
 
 	ImporterContext ctx = {
-		.api        = request.importer_api,
-		.main_path  = request.path,
-		.new_scene  = new_scene,
-		.j_document = document,
-		.main_id    = request.asset,
+		.api           = request.importer_api,
+		.main_path     = request.path,
+		.new_scene     = new_scene,
+		.j_document    = document,
+		.main_id       = request.asset,
+		.mesh_settings = this->mesh_settings,
+		.mesh_encoding = this->mesh_encoding,
 	};
 
 	import_buffers(ctx);
@@ -737,6 +719,9 @@ Result<ProcessResponse> GLTFImporter::process_asset(const ProcessRequest &reques
 	import_meshes(ctx);
 	import_nodes(ctx);
 
+	// Unmap the buffers
+	ctx.files.clear();
+
 	ProcessResponse response{};
 	response.products.push(request.asset);
 	for (const auto &mesh : ctx.mesh_ids) {
@@ -0,0 +1,184 @@
+#include "assets/importers/mesh_processing.h"
+
+#include "assets/mesh.h"
+#include "exo/maths/aabb.h"
+#include "exo/profile.h"
+
+#include <algorithm>
+#include <meshoptimizer.h>
+
+// Local copy of the vertices and indices of one submesh, indices are relative to its first vertex
+struct SubMeshStreams
+{
+	Vec<float4> positions;
+	Vec<float2> uvs;
+	Vec<u32>    indices;
+
+	void destroy()
+	{
+		this->positions.buffer.destroy();
+		this->uvs.buffer.destroy();
+		this->indices.buffer.destroy();
+	}
+};
+
+// Apply a vertex remap table to the submesh, `new_vertex_count` is the number of vertices left after the remap
+static void remap_submesh(SubMeshStreams &submesh, const Vec<u32> &remap, u32 new_vertex_count)
+{
+	const usize vertex_count = submesh.positions.len();
+
+	auto new_positions = Vec<float4>::with_length(new_vertex_count);
+	auto new_uvs       = Vec<float2>::with_length(new_vertex_count);
+	meshopt_remapVertexBuffer(new_positions.data(), submesh.positions.data(), vertex_count, sizeof(float4), remap.data());
+	meshopt_remapVertexBuffer(new_uvs.data(), submesh.uvs.data(), vertex_count, sizeof(float2), remap.data());
+	meshopt_remapIndexBuffer(submesh.indices.data(), submesh.indices.data(), submesh.indices.len(), remap.data());
+
+	submesh.positions.buffer.destroy();
+	submesh.uvs.buffer.destroy();
+	submesh.positions = std::move(new_positions);
+	submesh.uvs       = std::move(new_uvs);
+}
+
+static void optimize_submesh(SubMeshStreams &submesh)
+{
+	EXO_PROFILE_SCOPE
+
+	const usize index_count = submesh.indices.len();
+	auto        remap       = Vec<u32>::with_length(submesh.positions.len());
+
+	// Merge the vertices that have the same position and uv
+	const meshopt_Stream streams[] = {
+		{submesh.positions.data(), sizeof(float4), sizeof(float4)},
+		{submesh.uvs.data(), sizeof(float2), sizeof(float2)},
+	};
+	const usize unique_vertex_count = meshopt_generateVertexRemapMulti(remap.data(),
+		submesh.indices.data(),
+		index_count,
+		submesh.positions.len(),
+		streams,
+		sizeof(streams) / sizeof(streams[0]));
+	remap_submesh(submesh, remap, u32(unique_vertex_count));
+
+	// Reorder the triangles for the post-transform cache, then to reduce overdraw without hurting the cache too much
+	meshopt_optimizeVertexCache(submesh.indices.data(), submesh.indices.data(), index_count, submesh.positions.len());
+	meshopt_optimizeOverdraw(submesh.indices.data(),
+		submesh.indices.data(),
+		index_count,
+		&submesh.positions[0].x,
+		submesh.positions.len(),
+		sizeof(float4),
+		1.05f);
+
+	// Reorder the vertices in the order they are used by the triangles, unused vertices are removed
+	const usize fetched_vertex_count =
+		meshopt_optimizeVertexFetchRemap(remap.data(), submesh.indices.data(), index_count, submesh.positions.len());
+	remap_submesh(submesh, remap, u32(fetched_vertex_count));
+
+	remap.buffer.destroy();
+}
+
+void process_mesh(const MeshProcessingSettings &settings, MeshStreams &mesh, Vec<MeshLodStreams> &out_lods)
+{
+	EXO_PROFILE_SCOPE
+
+	out_lods.resize(settings.lod_count);
+	for (auto &lod : out_lods) {
+		lod.indices.clear();
+		lod.submeshes.clear();
+		lod.error = 0.0f;
+	}
+
+	MeshStreams processed = {};
+	processed.positions.reserve(mesh.positions.len());
+	processed.uvs.reserve(mesh.uvs.len());
+	processed.indices.reserve(mesh.indices.len());
+	processed.submeshes.reserve(mesh.submeshes.len());
+
+	Vec<u32> lod_indices;
+	for (u32 i_submesh = 0; i_submesh < mesh.submeshes.len(); ++i_submesh) {
+		const auto &submesh    = mesh.submeshes[i_submesh];
+		const u32   end_vertex = i_submesh + 1 < mesh.submeshes.len() ? mesh.submeshes[i_submesh + 1].first_vertex
+		                                                              : mesh.positions.len();
+
+		SubMeshStreams streams = {};
+		streams.positions.resize(end_vertex - submesh.first_vertex);
+		streams.uvs.resize(end_vertex - submesh.first_vertex);
+		streams.indices.resize(submesh.index_count);
+		std::copy(mesh.positions.data() + submesh.first_vertex,
+			mesh.positions.data() + end_vertex,
+			streams.positions.data());
+		std::copy(mesh.uvs.data() + submesh.first_vertex, mesh.uvs.data() + end_vertex, streams.uvs.data());
+		for (u32 i_index = 0; i_index < submesh.index_count; ++i_index) {
+			streams.indices[i_index] = mesh.indices[submesh.first_index + i_index] - submesh.first_vertex;
+		}
+
+		if (settings.optimize && submesh.index_count > 0) {
+			optimize_submesh(streams);
+		}
+
+		auto &new_submesh        = processed.submeshes.push(submesh);
+		new_submesh.first_vertex = processed.positions.len();
+		new_submesh.first_index  = processed.indices.len();
+		new_submesh.index_count  = streams.indices.len();
+
+		if (!streams.positions.is_empty()) {
+			exo::AABB bounds = {};
+			for (const auto &position : streams.positions) {
+				exo::extend(bounds, float3(position.x, position.y, position.z));
+			}
+			new_submesh.bounds_min = bounds.min;
+			new_submesh.bounds_max = bounds.max;
+		}
+
+		for (const auto &position : streams.positions) {
+			processed.positions.push(position);
+		}
+		for (const auto &uv : streams.uvs) {
+			processed.uvs.push(uv);
+		}
+		for (const u32 index : streams.indices) {
+			processed.indices.push(new_submesh.first_vertex + index);
+		}
+
+		// Each level simplifies the previous one, a level that cannot be simplified further keeps the same triangles
+		for (auto &lod : out_lods) {
+			const usize previous_count = streams.indices.len();
+			const usize target_count   = usize(float(previous_count / 3) * settings.lod_index_ratio) * 3;
+
+			float lod_error = 0.0f;
+			lod_indices.resize(u32(previous_count));
+			usize lod_index_count = 0;
+			if (previous_count > 0) {
+				lod_index_count = meshopt_simplify(lod_indices.data(),
+					streams.indices.data(),
+					previous_count,
+					&streams.positions[0].x,
+					streams.positions.len(),
+					sizeof(float4),
+					target_count,
+					settings.lod_target_error,
+					&lod_error);
+				meshopt_optimizeVertexCache(lod_indices.data(), lod_indices.data(), lod_index_count, streams.positions.len());
+			}
+
+			lod.submeshes.push(SubMeshLod{.first_index = lod.indices.len(), .index_count = u32(lod_index_count)});
+			for (u32 i_index = 0; i_index < lod_index_count; ++i_index) {
+				lod.indices.push(new_submesh.first_vertex + lod_indices[i_index]);
+			}
+			lod.error = std::max(lod.error, lod_error);
+
+			streams.indices.resize(u32(lod_index_count));
+			std::copy(lod_indices.data(), lod_indices.data() + lod_index_count, streams.indices.data());
+		}
+
+		streams.destroy();
+	}
+	lod_indices.buffer.destroy();
+
+	mesh.positions.buffer.destroy();
+	mesh.uvs.buffer.destroy();
+	mesh.indices.buffer.destroy();
+	mesh.submeshes.clear();
+	mesh.submeshes.buffer.destroy();
+	mesh = std::move(processed);
+}
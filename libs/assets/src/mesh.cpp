@@ -4,10 +4,13 @@
 #include "exo/serialization/u128_serializer.h"
 #include "exo/serialization/uuid_serializer.h"
 
+// The layout is versioned by ASSET_FORMAT_VERSION
 void Mesh::serialize(exo::Serializer &serializer)
 {
 	Asset::serialize(serializer);
 
+	::serialize(serializer, this->encoding);
+
 	exo::serialize(serializer, this->indices_hash);
 	exo::serialize(serializer, this->indices_byte_size);
 
@@ -17,7 +20,11 @@ void Mesh::serialize(exo::Serializer &serializer)
 	exo::serialize(serializer, this->uvs_hash);
 	exo::serialize(serializer, this->uvs_byte_size);
 
+	exo::serialize(serializer, this->bvh_hash);
+	exo::serialize(serializer, this->bvh_byte_size);
+
 	exo::serialize(serializer, this->submeshes);
+	exo::serialize(serializer, this->lods);
 }
 
 void serialize(exo::Serializer &serializer, SubMesh &data)
@@ -26,4 +33,28 @@ void serialize(exo::Serializer &serializer, SubMesh &data)
 	exo::serialize(serializer, data.first_vertex);
 	exo::serialize(serializer, data.index_count);
 	exo::serialize(serializer, data.material);
+	exo::serialize(serializer, data.bounds_min);
+	exo::serialize(serializer, data.bounds_max);
+}
+
+void serialize(exo::Serializer &serializer, MeshEncoding &data)
+{
+	exo::serialize(serializer, data.indices_u16);
+	exo::serialize(serializer, data.positions_unorm16);
+	exo::serialize(serializer, data.uvs_half);
+	exo::serialize(serializer, data.meshopt_codec);
+}
+
+void serialize(exo::Serializer &serializer, SubMeshLod &data)
+{
+	exo::serialize(serializer, data.first_index);
+	exo::serialize(serializer, data.index_count);
+}
+
+void serialize(exo::Serializer &serializer, MeshLod &data)
+{
+	exo::serialize(serializer, data.indices_hash);
+	exo::serialize(serializer, data.indices_byte_size);
+	exo::serialize(serializer, data.error);
+	exo::serialize(serializer, data.submeshes);
 }
@@ -0,0 +1,405 @@
+#include "assets/mesh_encoding.h"
+
+#include "assets/baked_asset.h"
+#include "assets/mesh.h"
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+#include <meshoptimizer.h>
+
+namespace assets
+{
+static constexpr usize UNORM16_POSITION_SIZE = 4 * sizeof(u16);
+static constexpr usize HALF_UV_SIZE          = 2 * sizeof(u16);
+
+// The decoders read the ranges of SubMesh and BakedSubMesh, only their first index, first vertex and bounds are used
+template <typename SubMeshT>
+static u32 submesh_vertex_end(exo::Span<const SubMeshT> submeshes, usize i_submesh, usize vertex_count)
+{
+	return i_submesh + 1 < submeshes.len() ? submeshes[i_submesh + 1].first_vertex : u32(vertex_count);
+}
+
+template <typename SubMeshT>
+static SubMeshLod submesh_index_range(
+	exo::Span<const SubMeshT> submeshes, exo::Span<const SubMeshLod> index_ranges, usize i_submesh)
+{
+	if (index_ranges.empty()) {
+		return SubMeshLod{.first_index = submeshes[i_submesh].first_index,
+			.index_count               = submeshes[i_submesh].index_count};
+	}
+	ASSERT(index_ranges.len() == submeshes.len());
+	return index_ranges[i_submesh];
+}
+
+static float half_to_float(u16 half)
+{
+	const u32 sign     = u32(half & 0x8000) << 16;
+	const u32 exponent = (half >> 10) & 0x1f;
+	const u32 mantissa = half & 0x3ff;
+
+	if (exponent == 0) {
+		// zero and denormals
+		const float value = float(mantissa) * (1.0f / 16777216.0f);
+		return sign ? -value : value;
+	}
+
+	u32 bits = 0;
+	if (exponent == 31) {
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	} else {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float value;
+	std::memcpy(&value, &bits, sizeof(float));
+	return value;
+}
+
+template <typename T>
+static void write_blob(Vec<u8> &out_blob, const T *data, usize count)
+{
+	out_blob.resize(u32(count * sizeof(T)));
+	if (count > 0) {
+		std::memcpy(out_blob.data(), data, count * sizeof(T));
+	}
+}
+
+static void write_vertex_codec_blob(Vec<u8> &out_blob, const void *vertices, usize vertex_count, usize vertex_size)
+{
+	out_blob.resize(u32(meshopt_encodeVertexBufferBound(vertex_count, vertex_size)));
+	const usize size =
+		meshopt_encodeVertexBuffer(out_blob.data(), out_blob.len(), vertices, vertex_count, vertex_size);
+	ASSERT(size > 0);
+	out_blob.resize(u32(size));
+}
+
+static void decode_vertex_codec_blob(void *out_vertices, usize vertex_count, usize vertex_size, exo::Span<const u8> blob)
+{
+	const int res = meshopt_decodeVertexBuffer(out_vertices, vertex_count, vertex_size, blob.data(), blob.len());
+	ASSERT(res == 0);
+}
+
+// -- SIMD kernels
+
+// dst[i] = base + src[i]
+static void widen_indices(const u16 *src, u32 *dst, usize count, u32 base)
+{
+	usize i = 0;
+#if defined(__AVX2__)
+	const __m256i base8 = _mm256_set1_epi32(i32(base));
+	for (; i + 8 <= count; i += 8) {
+		const __m256i indices = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_add_epi32(indices, base8));
+	}
+#endif
+	const __m128i base4 = _mm_set1_epi32(i32(base));
+	for (; i + 4 <= count; i += 4) {
+		const __m128i indices = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_add_epi32(indices, base4));
+	}
+	for (; i < count; ++i) {
+		dst[i] = base + src[i];
+	}
+}
+
+// dst[i] = float4(min + src[i].xyz * scale, 1)
+static void dequantize_positions(const u16 *src, float4 *dst, usize count, float3 min, float3 scale)
+{
+	usize i = 0;
+#if defined(__AVX2__)
+	const __m256 min8   = _mm256_setr_ps(min.x, min.y, min.z, 0.0f, min.x, min.y, min.z, 0.0f);
+	const __m256 scale8 = _mm256_setr_ps(scale.x, scale.y, scale.z, 0.0f, scale.x, scale.y, scale.z, 0.0f);
+	const __m256 one8   = _mm256_set1_ps(1.0f);
+	for (; i + 2 <= count; i += 2) {
+		const __m256i ints = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * i)));
+		const __m256  positions = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale8), min8);
+		_mm256_storeu_ps(&dst[i].x, _mm256_blend_ps(positions, one8, 0b10001000));
+	}
+#endif
+	const __m128 min4   = _mm_setr_ps(min.x, min.y, min.z, 0.0f);
+	const __m128 scale4 = _mm_setr_ps(scale.x, scale.y, scale.z, 0.0f);
+	const __m128 one4   = _mm_set1_ps(1.0f);
+	for (; i < count; ++i) {
+		const __m128i ints     = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + 4 * i)));
+		const __m128  position = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(ints), scale4), min4);
+		_mm_storeu_ps(&dst[i].x, _mm_blend_ps(position, one4, 0b1000));
+	}
+}
+
+// Converts `count` half floats
+static void halfs_to_floats(const u16 *src, float *dst, usize count)
+{
+	usize i = 0;
+#if defined(__F16C__)
+#if defined(__AVX__)
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i))));
+	}
+#endif
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(dst + i, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i))));
+	}
+#endif
+	for (; i < count; ++i) {
+		dst[i] = half_to_float(src[i]);
+	}
+}
+
+// -- Indices
+
+bool can_use_u16_indices(exo::Span<const SubMesh> submeshes, usize vertex_count)
+{
+	for (usize i_submesh = 0; i_submesh < submeshes.len(); ++i_submesh) {
+		const u32 end = submesh_vertex_end(submeshes, i_submesh, vertex_count);
+		if (end - submeshes[i_submesh].first_vertex > 0x10000) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void encode_mesh_indices(const MeshEncoding &encoding,
+	exo::Span<const SubMesh>                 submeshes,
+	exo::Span<const SubMeshLod>              index_ranges,
+	exo::Span<const u32>                     indices,
+	Vec<u8>                                 &out_blob)
+{
+	EXO_PROFILE_SCOPE
+
+	// The codec does not care about the index size and compresses better the indices relative to the mesh
+	if (encoding.meshopt_codec) {
+		u32 max_index = 0;
+		for (const u32 index : indices) {
+			max_index = std::max(max_index, index);
+		}
+		out_blob.resize(u32(meshopt_encodeIndexBufferBound(indices.len(), max_index + 1)));
+		const usize size = meshopt_encodeIndexBuffer(out_blob.data(), out_blob.len(), indices.data(), indices.len());
+		ASSERT(size > 0);
+		out_blob.resize(u32(size));
+	} else if (encoding.indices_u16) {
+		out_blob.resize(u32(indices.len() * sizeof(u16)));
+		auto *out_indices = reinterpret_cast<u16 *>(out_blob.data());
+		for (usize i_submesh = 0; i_submesh < submeshes.len(); ++i_submesh) {
+			const auto range        = submesh_index_range(submeshes, index_ranges, i_submesh);
+			const u32  first_vertex = submeshes[i_submesh].first_vertex;
+			for (u32 i_index = range.first_index; i_index < range.first_index + range.index_count; ++i_index) {
+				ASSERT(indices[i_index] - first_vertex <= 0xffff);
+				out_indices[i_index] = u16(indices[i_index] - first_vertex);
+			}
+		}
+	} else {
+		write_blob(out_blob, indices.data(), indices.len());
+	}
+}
+
+template <typename SubMeshT>
+static void decode_mesh_indices_impl(const MeshEncoding &encoding,
+	exo::Span<const SubMeshT>                          submeshes,
+	exo::Span<const SubMeshLod>                        index_ranges,
+	exo::Span<const u8>                                blob,
+	exo::Span<u32>                                     out_indices)
+{
+	EXO_PROFILE_SCOPE
+
+	if (encoding.meshopt_codec) {
+		const int res =
+			meshopt_decodeIndexBuffer(out_indices.data(), out_indices.len(), sizeof(u32), blob.data(), blob.len());
+		ASSERT(res == 0);
+	} else if (encoding.indices_u16) {
+		ASSERT(blob.len() == out_indices.len() * sizeof(u16));
+		const auto *src = reinterpret_cast<const u16 *>(blob.data());
+		for (usize i_submesh = 0; i_submesh < submeshes.len(); ++i_submesh) {
+			const auto range = submesh_index_range(submeshes, index_ranges, i_submesh);
+			widen_indices(src + range.first_index,
+				out_indices.data() + range.first_index,
+				range.index_count,
+				submeshes[i_submesh].first_vertex);
+		}
+	} else {
+		ASSERT(blob.len() == out_indices.len() * sizeof(u32));
+		std::copy(blob.begin(), blob.end(), reinterpret_cast<u8 *>(out_indices.data()));
+	}
+}
+
+void decode_mesh_indices(const MeshEncoding &encoding,
+	exo::Span<const SubMesh>                 submeshes,
+	exo::Span<const SubMeshLod>              index_ranges,
+	exo::Span<const u8>                      blob,
+	exo::Span<u32>                           out_indices)
+{
+	decode_mesh_indices_impl(encoding, submeshes, index_ranges, blob, out_indices);
+}
+
+void decode_mesh_indices(const MeshEncoding &encoding,
+	exo::Span<const BakedSubMesh>            submeshes,
+	exo::Span<const SubMeshLod>              index_ranges,
+	exo::Span<const u8>                      blob,
+	exo::Span<u32>                           out_indices)
+{
+	decode_mesh_indices_impl(encoding, submeshes, index_ranges, blob, out_indices);
+}
+
+// -- Positions
+
+void encode_mesh_positions(const MeshEncoding &encoding,
+	exo::Span<const SubMesh>                   submeshes,
+	exo::Span<const float4>                    positions,
+	Vec<u8>                                   &out_blob)
+{
+	EXO_PROFILE_SCOPE
+
+	if (!encoding.positions_unorm16) {
+		if (encoding.meshopt_codec) {
+			write_vertex_codec_blob(out_blob, positions.data(), positions.len(), sizeof(float4));
+		} else {
+			write_blob(out_blob, positions.data(), positions.len());
+		}
+		return;
+	}
+
+	Vec<u16> quantized = Vec<u16>::with_length(u32(4 * positions.len()));
+	for (usize i_submesh = 0; i_submesh < submeshes.len(); ++i_submesh) {
+		const auto &submesh = submeshes[i_submesh];
+		const u32   end     = submesh_vertex_end(submeshes, i_submesh, positions.len());
+		const auto  extent  = submesh.bounds_max - submesh.bounds_min;
+
+		for (u32 i_vertex = submesh.first_vertex; i_vertex < end; ++i_vertex) {
+			const auto &position = positions[i_vertex];
+			for (u32 i_component = 0; i_component < 3; ++i_component) {
+				const float relative = extent[i_component] > 0.0f
+				                           ? (position[i_component] - submesh.bounds_min[i_component]) / extent[i_component]
+				                           : 0.0f;
+				quantized[4 * i_vertex + i_component] = u16(meshopt_quantizeUnorm(relative, 16));
+			}
+			quantized[4 * i_vertex + 3] = 0;
+		}
+	}
+
+	if (encoding.meshopt_codec) {
+		write_vertex_codec_blob(out_blob, quantized.data(), positions.len(), UNORM16_POSITION_SIZE);
+	} else {
+		write_blob(out_blob, quantized.data(), quantized.len());
+	}
+	quantized.buffer.destroy();
+}
+
+template <typename SubMeshT>
+static void decode_mesh_positions_impl(const MeshEncoding &encoding,
+	exo::Span<const SubMeshT>                            submeshes,
+	exo::Span<const u8>                                  blob,
+	exo::Span<float4>                                    out_positions)
+{
+	EXO_PROFILE_SCOPE
+
+	const usize vertex_count = out_positions.len();
+	if (!encoding.positions_unorm16) {
+		if (encoding.meshopt_codec) {
+			decode_vertex_codec_blob(out_positions.data(), vertex_count, sizeof(float4), blob);
+		} else {
+			ASSERT(blob.len() == vertex_count * sizeof(float4));
+			std::copy(blob.begin(), blob.end(), reinterpret_cast<u8 *>(out_positions.data()));
+		}
+		return;
+	}
+
+	const u16 *quantized      = reinterpret_cast<const u16 *>(blob.data());
+	void      *decoded_buffer = nullptr;
+	if (encoding.meshopt_codec) {
+		decoded_buffer = malloc(vertex_count * UNORM16_POSITION_SIZE);
+		decode_vertex_codec_blob(decoded_buffer, vertex_count, UNORM16_POSITION_SIZE, blob);
+		quantized = static_cast<const u16 *>(decoded_buffer);
+	} else {
+		ASSERT(blob.len() == vertex_count * UNORM16_POSITION_SIZE);
+	}
+
+	for (usize i_submesh = 0; i_submesh < submeshes.len(); ++i_submesh) {
+		const auto &submesh = submeshes[i_submesh];
+		const u32   end     = submesh_vertex_end(submeshes, i_submesh, vertex_count);
+		const auto  scale   = (1.0f / 65535.0f) * (submesh.bounds_max - submesh.bounds_min);
+		dequantize_positions(quantized + 4 * submesh.first_vertex,
+			out_positions.data() + submesh.first_vertex,
+			end - submesh.first_vertex,
+			submesh.bounds_min,
+			scale);
+	}
+
+	free(decoded_buffer);
+}
+
+void decode_mesh_positions(const MeshEncoding &encoding,
+	exo::Span<const SubMesh>                   submeshes,
+	exo::Span<const u8>                        blob,
+	exo::Span<float4>                          out_positions)
+{
+	decode_mesh_positions_impl(encoding, submeshes, blob, out_positions);
+}
+
+void decode_mesh_positions(const MeshEncoding &encoding,
+	exo::Span<const BakedSubMesh>              submeshes,
+	exo::Span<const u8>                        blob,
+	exo::Span<float4>                          out_positions)
+{
+	decode_mesh_positions_impl(encoding, submeshes, blob, out_positions);
+}
+
+// -- UVs
+
+void encode_mesh_uvs(const MeshEncoding &encoding, exo::Span<const float2> uvs, Vec<u8> &out_blob)
+{
+	EXO_PROFILE_SCOPE
+
+	if (!encoding.uvs_half) {
+		if (encoding.meshopt_codec) {
+			write_vertex_codec_blob(out_blob, uvs.data(), uvs.len(), sizeof(float2));
+		} else {
+			write_blob(out_blob, uvs.data(), uvs.len());
+		}
+		return;
+	}
+
+	Vec<u16> halfs = Vec<u16>::with_length(u32(2 * uvs.len()));
+	for (u32 i_uv = 0; i_uv < uvs.len(); ++i_uv) {
+		halfs[2 * i_uv + 0] = meshopt_quantizeHalf(uvs[i_uv].x);
+		halfs[2 * i_uv + 1] = meshopt_quantizeHalf(uvs[i_uv].y);
+	}
+
+	if (encoding.meshopt_codec) {
+		write_vertex_codec_blob(out_blob, halfs.data(), uvs.len(), HALF_UV_SIZE);
+	} else {
+		write_blob(out_blob, halfs.data(), halfs.len());
+	}
+	halfs.buffer.destroy();
+}
+
+void decode_mesh_uvs(const MeshEncoding &encoding, exo::Span<const u8> blob, exo::Span<float2> out_uvs)
+{
+	EXO_PROFILE_SCOPE
+
+	const usize uv_count = out_uvs.len();
+	if (uv_count == 0) {
+		return;
+	}
+	if (!encoding.uvs_half) {
+		if (encoding.meshopt_codec) {
+			decode_vertex_codec_blob(out_uvs.data(), uv_count, sizeof(float2), blob);
+		} else {
+			ASSERT(blob.len() == uv_count * sizeof(float2));
+			std::copy(blob.begin(), blob.end(), reinterpret_cast<u8 *>(out_uvs.data()));
+		}
+		return;
+	}
+
+	// The halfs are decoded in the second half of the output to avoid a temporary buffer
+	auto *halfs = reinterpret_cast<u16 *>(out_uvs.data()) + 2 * uv_count;
+	if (encoding.meshopt_codec) {
+		decode_vertex_codec_blob(halfs, uv_count, HALF_UV_SIZE, blob);
+	} else {
+		ASSERT(blob.len() == uv_count * HALF_UV_SIZE);
+		std::copy(blob.begin(), blob.end(), reinterpret_cast<u8 *>(halfs));
+	}
+	halfs_to_floats(halfs, &out_uvs.data()->x, 2 * uv_count);
+}
+} // namespace assets
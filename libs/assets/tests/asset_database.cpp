@@ -0,0 +1,153 @@
+#include "assets/asset_database.h"
+#include "assets/baked_asset.h"
+#include "exo/memory/dynamic_buffer.h"
+#include "exo/serialization/serializer.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+static void write_database(AssetDatabase &database, exo::DynamicBuffer &output, usize &out_size)
+{
+	auto writer = exo::Serializer::create_growable_writer(output);
+	serialize(writer, database);
+	out_size = writer.offset;
+}
+
+TEST_CASE("AssetDatabase is discarded when the asset format changes", "[asset_database]")
+{
+	AssetDatabase database = {};
+
+	const auto path           = exo::Path::from_string("assets/scene.gltf");
+	const auto hash           = exo::RawHash{0x1234};
+	Resource   record         = {};
+	record.asset_id           = AssetId::create<Resource>("scene");
+	record.resource_path      = path;
+	record.last_imported_hash = hash;
+	const auto handle         = database.resource_records.add(std::move(record));
+	database.resource_path_map.insert(path, handle);
+	database.resource_content_map.insert(hash, handle);
+
+	exo::DynamicBuffer output = {};
+	usize              size   = 0;
+	write_database(database, output, size);
+
+	{
+		AssetDatabase read_database = {};
+		auto          reader        = exo::Serializer::create_reader(exo::Span<const u8>(output.content().data(), size));
+		serialize(reader, read_database);
+		REQUIRE(reader.offset == size);
+		REQUIRE(read_database.resource_records.size == 1);
+		REQUIRE(read_database.resource_path_map.at(path) != nullptr);
+		REQUIRE(read_database.resource_content_map.at(hash) != nullptr);
+	}
+
+	// The header is the magic, ASSET_FORMAT_VERSION and BAKED_ASSET_VERSION
+	const u32 outdated_versions[] = {ASSET_FORMAT_VERSION + 1, BAKED_ASSET_VERSION + 1};
+	for (u32 i_version = 0; i_version < 2; ++i_version) {
+		exo::DynamicBuffer outdated = {};
+		exo::DynamicBuffer::init(outdated, size);
+		std::memcpy(outdated.ptr, output.ptr, size);
+		std::memcpy(static_cast<u8 *>(outdated.ptr) + (1 + i_version) * sizeof(u32),
+			&outdated_versions[i_version],
+			sizeof(u32));
+
+		// Every resource is new again and will be imported
+		AssetDatabase read_database = {};
+		auto          reader = exo::Serializer::create_reader(exo::Span<const u8>(outdated.content().data(), size));
+		serialize(reader, read_database);
+		REQUIRE(read_database.resource_records.size == 0);
+		REQUIRE(read_database.resource_path_map.at(path) == nullptr);
+
+		outdated.destroy();
+	}
+
+	output.destroy();
+}
+
+struct AssetIdHash
+{
+	usize operator()(const AssetId &id) const { return usize(hash_value(id)); }
+};
+
+TEST_CASE("AssetId map benchmark", "[.][asset_database][benchmark]")
+{
+	// A project with a million assets, half of the ids are looked up without being in the maps
+	constexpr u32 ASSET_COUNT = 1u << 20;
+
+	Vec<AssetId> ids         = {};
+	Vec<AssetId> missing_ids = {};
+	for (u32 i_asset = 0; i_asset < 2 * ASSET_COUNT; ++i_asset) {
+		char name[32] = {};
+		std::snprintf(name, sizeof(name), "assets/mesh_%u.gltf", i_asset);
+		(i_asset % 2 ? missing_ids : ids).push(AssetId::create<Resource>(exo::StringView{name}));
+	}
+
+	BENCHMARK("insert")
+	{
+		exo::Map<AssetId, u32> map = {};
+		for (u32 i_asset = 0; i_asset < ids.len(); ++i_asset) {
+			map.insert(ids[i_asset], u32(i_asset));
+		}
+		return map.size;
+	};
+
+	BENCHMARK("std insert")
+	{
+		std::unordered_map<AssetId, u32, AssetIdHash> std_map = {};
+		for (u32 i_asset = 0; i_asset < ids.len(); ++i_asset) {
+			std_map.emplace(ids[i_asset], i_asset);
+		}
+		return std_map.size();
+	};
+
+	exo::Map<AssetId, u32>                        map     = {};
+	std::unordered_map<AssetId, u32, AssetIdHash> std_map = {};
+	for (u32 i_asset = 0; i_asset < ids.len(); ++i_asset) {
+		map.insert(ids[i_asset], u32(i_asset));
+		std_map.emplace(ids[i_asset], i_asset);
+	}
+
+	BENCHMARK("lookup hit")
+	{
+		u32 sum = 0;
+		for (const auto &id : ids) {
+			sum += *map.at(id);
+		}
+		return sum;
+	};
+
+	BENCHMARK("std lookup hit")
+	{
+		u32 sum = 0;
+		for (const auto &id : ids) {
+			sum += std_map.find(id)->second;
+		}
+		return sum;
+	};
+
+	BENCHMARK("lookup miss")
+	{
+		u32 count = 0;
+		for (const auto &id : missing_ids) {
+			count += map.at(id) == nullptr ? 1 : 0;
+		}
+		return count;
+	};
+
+	BENCHMARK("std lookup miss")
+	{
+		u32 count = 0;
+		for (const auto &id : missing_ids) {
+			count += std_map.find(id) == std_map.end() ? 1 : 0;
+		}
+		return count;
+	};
+
+	missing_ids.clear();
+	ids.clear();
+	missing_ids.buffer.destroy();
+	ids.buffer.destroy();
+}
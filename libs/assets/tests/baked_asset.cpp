@@ -0,0 +1,258 @@
+#include "assets/baked_asset.h"
+#include "assets/mesh.h"
+#include "assets/mesh_encoding.h"
+#include "assets/texture.h"
+#include "exo/maths/pointer.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+template <typename T>
+static T *create_test_asset(exo::StringView name)
+{
+	// Done by main in the apps
+	refl::details::call_all_registers();
+
+	const auto &type_info = refl::typeinfo<T>();
+	T          *asset     = static_cast<T *>(type_info.placement_ctor(malloc(type_info.size)));
+	asset->uuid           = AssetId::create<T>(name);
+	asset->name           = exo::String(name);
+	return asset;
+}
+
+static void destroy_test_asset(refl::BasePtr<Asset> asset)
+{
+	void *memory = asset.get();
+	asset.typeinfo().dtor(memory);
+	free(memory);
+}
+
+// The baked file is read in place, it needs the alignment of a mapped file
+static exo::Span<const u8> aligned_copy(const Vec<u8> &file, void *&out_memory)
+{
+	out_memory = std::aligned_alloc(BAKED_ALIGNMENT, exo::round_up_to_alignment(BAKED_ALIGNMENT, file.len()));
+	std::memcpy(out_memory, file.data(), file.len());
+	return exo::Span<const u8>(static_cast<const u8 *>(out_memory), file.len());
+}
+
+static Mesh *create_test_mesh()
+{
+	auto *mesh                = create_test_asset<Mesh>("mesh");
+	mesh->encoding            = MeshEncoding{.indices_u16 = true, .uvs_half = true};
+	mesh->indices_hash        = exo::u128_from_u64(1, 2);
+	mesh->indices_byte_size   = 300;
+	mesh->positions_hash      = exo::u128_from_u64(3, 4);
+	mesh->positions_byte_size = 1600;
+	mesh->uvs_hash            = exo::u128_from_u64(5, 6);
+	mesh->uvs_byte_size       = 800;
+	mesh->add_dependency_checked(AssetId::create<Mesh>("material_a"));
+	mesh->add_dependency_checked(AssetId::create<Mesh>("material_b"));
+
+	for (u32 i_submesh = 0; i_submesh < 3; ++i_submesh) {
+		mesh->submeshes.push(SubMesh{
+			.first_index  = 100 * i_submesh,
+			.first_vertex = 50 * i_submesh,
+			.index_count  = 100,
+			.material     = mesh->dependencies[i_submesh % 2],
+			.bounds_min   = float3(float(i_submesh)),
+			.bounds_max   = float3(float(i_submesh) + 1.0f),
+		});
+	}
+
+	auto &lod     = mesh->lods.push();
+	lod.error     = 0.25f;
+	lod.submeshes = {SubMeshLod{0, 30}, SubMeshLod{30, 30}, SubMeshLod{60, 30}};
+	return mesh;
+}
+
+TEST_CASE("Baked mesh", "[baked_asset]")
+{
+	auto *mesh = create_test_mesh();
+
+	Vec<u8> file;
+	REQUIRE(bake_asset(refl::BasePtr<Asset>(mesh), file));
+
+	void *memory  = nullptr;
+	auto  content = aligned_copy(file, memory);
+	REQUIRE(is_baked_asset(content));
+	REQUIRE(validate_baked_asset(content) == BakedAssetType::Mesh);
+
+	// Views of the file
+	const auto *baked = get_baked_mesh(content);
+	REQUIRE(baked->submeshes.len == 3);
+	REQUIRE(baked->submeshes.view(content)[1].first_index == 100);
+	REQUIRE(baked->lods.view(content)[0].submeshes.view(content)[2] == mesh->lods[0].submeshes[2]);
+
+	auto  asset     = unbake_asset(content);
+	auto *read_mesh = asset.as<Mesh>();
+	REQUIRE(read_mesh != nullptr);
+	REQUIRE(read_mesh->uuid == mesh->uuid);
+	REQUIRE(read_mesh->uuid.name == mesh->uuid.name);
+	REQUIRE(read_mesh->name == mesh->name);
+	REQUIRE(read_mesh->dependencies.len() == 2);
+	REQUIRE(read_mesh->dependencies[1].name == "material_b");
+	REQUIRE(read_mesh->encoding == mesh->encoding);
+	REQUIRE(read_mesh->positions_byte_size == mesh->positions_byte_size);
+	REQUIRE(_mm_test_all_ones(_mm_cmpeq_epi64(read_mesh->uvs_hash, mesh->uvs_hash)));
+	REQUIRE(read_mesh->submeshes.len() == mesh->submeshes.len());
+	for (u32 i_submesh = 0; i_submesh < mesh->submeshes.len(); ++i_submesh) {
+		REQUIRE(read_mesh->submeshes[i_submesh] == mesh->submeshes[i_submesh]);
+		REQUIRE(read_mesh->submeshes[i_submesh].material.name == mesh->submeshes[i_submesh].material.name);
+	}
+	REQUIRE(read_mesh->lods.len() == 1);
+	REQUIRE(read_mesh->lods[0].error == 0.25f);
+	REQUIRE(read_mesh->lods[0].submeshes.len() == 3);
+	REQUIRE(read_mesh->lods[0].submeshes[1] == mesh->lods[0].submeshes[1]);
+
+	destroy_test_asset(asset);
+	destroy_test_asset(refl::BasePtr<Asset>(mesh));
+	free(memory);
+	file.buffer.destroy();
+}
+
+TEST_CASE("Baked mesh blobs are decoded with the submeshes of the file", "[baked_asset]")
+{
+	auto *mesh                       = create_test_mesh();
+	mesh->encoding.positions_unorm16 = true;
+
+	// 50 vertices and 100 indices per submesh, the positions are inside of the bounds of their submesh
+	Vec<float4> positions = Vec<float4>::with_length(150);
+	Vec<u32>    indices   = Vec<u32>::with_length(300);
+	for (u32 i_vertex = 0; i_vertex < positions.len(); ++i_vertex) {
+		const float submesh = float(i_vertex / 50);
+		positions[i_vertex] = float4(submesh + 0.5f, submesh + float(i_vertex % 50) / 50.0f, submesh, 1.0f);
+	}
+	for (u32 i_index = 0; i_index < indices.len(); ++i_index) {
+		indices[i_index] = 50 * (i_index / 100) + (i_index * 7) % 50;
+	}
+
+	Vec<u8> indices_blob;
+	Vec<u8> positions_blob;
+	assets::encode_mesh_indices(mesh->encoding, mesh->submeshes, {}, indices, indices_blob);
+	assets::encode_mesh_positions(mesh->encoding, mesh->submeshes, positions, positions_blob);
+
+	Vec<u8> file;
+	REQUIRE(bake_asset(refl::BasePtr<Asset>(mesh), file));
+	void *memory  = nullptr;
+	auto  content = aligned_copy(file, memory);
+	REQUIRE(validate_baked_asset(content) == BakedAssetType::Mesh);
+	const auto *baked = get_baked_mesh(content);
+
+	Vec<u32>    read_indices    = Vec<u32>::with_length(indices.len());
+	Vec<u32>    baked_indices   = Vec<u32>::with_length(indices.len());
+	Vec<float4> read_positions  = Vec<float4>::with_length(positions.len());
+	Vec<float4> baked_positions = Vec<float4>::with_length(positions.len());
+	assets::decode_mesh_indices(mesh->encoding, mesh->submeshes, {}, indices_blob, read_indices);
+	assets::decode_mesh_indices(baked->encoding, baked->submeshes.view(content), {}, indices_blob, baked_indices);
+	assets::decode_mesh_positions(mesh->encoding, mesh->submeshes, positions_blob, read_positions);
+	assets::decode_mesh_positions(baked->encoding, baked->submeshes.view(content), positions_blob, baked_positions);
+
+	for (u32 i_index = 0; i_index < indices.len(); ++i_index) {
+		REQUIRE(baked_indices[i_index] == indices[i_index]);
+		REQUIRE(read_indices[i_index] == indices[i_index]);
+	}
+	for (u32 i_vertex = 0; i_vertex < positions.len(); ++i_vertex) {
+		REQUIRE(baked_positions[i_vertex] == read_positions[i_vertex]);
+		REQUIRE(std::abs(baked_positions[i_vertex].y - positions[i_vertex].y) < 1e-4f);
+	}
+
+	destroy_test_asset(refl::BasePtr<Asset>(mesh));
+	free(memory);
+	file.buffer.destroy();
+	positions.buffer.destroy();
+	indices.buffer.destroy();
+	indices_blob.buffer.destroy();
+	positions_blob.buffer.destroy();
+	read_indices.buffer.destroy();
+	baked_indices.buffer.destroy();
+	read_positions.buffer.destroy();
+	baked_positions.buffer.destroy();
+}
+
+TEST_CASE("Baked texture", "[baked_asset]")
+{
+	auto *texture             = create_test_asset<Texture>("texture");
+	texture->format           = PixelFormat::BC7_SRGB;
+	texture->extension        = ImageExtension::KTX2;
+	texture->width            = 256;
+	texture->height           = 128;
+	texture->depth            = 1;
+	texture->levels           = 3;
+	texture->mip_offsets      = {0, 32768, 40960};
+	texture->pixels_hash      = exo::u128_from_u64(7, 8);
+	texture->pixels_data_size = 43008;
+
+	Vec<u8> file;
+	REQUIRE(bake_asset(refl::BasePtr<Asset>(texture), file));
+
+	void *memory  = nullptr;
+	auto  content = aligned_copy(file, memory);
+	REQUIRE(validate_baked_asset(content) == BakedAssetType::Texture);
+	REQUIRE(get_baked_texture(content)->mip_offsets.view(content)[2] == 40960);
+
+	auto  asset        = unbake_asset(content);
+	auto *read_texture = asset.as<Texture>();
+	REQUIRE(read_texture != nullptr);
+	REQUIRE(read_texture->format == texture->format);
+	REQUIRE(read_texture->extension == texture->extension);
+	REQUIRE(read_texture->width == 256);
+	REQUIRE(read_texture->levels == 3);
+	REQUIRE(read_texture->mip_offsets.len() == 3);
+	REQUIRE(read_texture->mip_offsets[1] == 32768);
+	REQUIRE(read_texture->pixels_data_size == texture->pixels_data_size);
+
+	destroy_test_asset(asset);
+	destroy_test_asset(refl::BasePtr<Asset>(texture));
+	free(memory);
+	file.buffer.destroy();
+}
+
+TEST_CASE("Baked asset validation", "[baked_asset]")
+{
+	auto   *mesh = create_test_mesh();
+	Vec<u8> file;
+	REQUIRE(bake_asset(refl::BasePtr<Asset>(mesh), file));
+
+	void *memory  = nullptr;
+	auto  content = aligned_copy(file, memory);
+	auto *bytes   = static_cast<u8 *>(memory);
+
+	SECTION("outdated version")
+	{
+		reinterpret_cast<BakedAssetHeader *>(bytes)->version = BAKED_ASSET_VERSION + 1;
+		REQUIRE(is_baked_asset(content));
+		REQUIRE(!validate_baked_asset(content));
+	}
+
+	SECTION("truncated file")
+	{
+		REQUIRE(!validate_baked_asset(exo::Span<const u8>(content.data(), content.len() - 16)));
+	}
+
+	SECTION("array out of bounds")
+	{
+		auto *baked          = reinterpret_cast<BakedMesh *>(bytes + sizeof(BakedAssetHeader));
+		baked->submeshes.len = 1000;
+		REQUIRE(!validate_baked_asset(content));
+	}
+
+	SECTION("nested array out of bounds")
+	{
+		auto *baked     = reinterpret_cast<BakedMesh *>(bytes + sizeof(BakedAssetHeader));
+		auto *submeshes = reinterpret_cast<BakedSubMesh *>(bytes + baked->submeshes.offset);
+		submeshes[2].material.name.offset = content.len() + BAKED_ALIGNMENT;
+		REQUIRE(!validate_baked_asset(content));
+	}
+
+	SECTION("serialized asset")
+	{
+		bytes[0] = 0;
+		REQUIRE(!is_baked_asset(content));
+	}
+
+	destroy_test_asset(refl::BasePtr<Asset>(mesh));
+	free(memory);
+	file.buffer.destroy();
+}
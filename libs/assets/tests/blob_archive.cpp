@@ -0,0 +1,79 @@
+#include "assets/blob_archive.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+
+static exo::Path create_test_directory(const char *name)
+{
+	const auto directory = std::filesystem::temp_directory_path() / name;
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	return exo::Path::from_string(exo::StringView{directory.string().c_str()});
+}
+
+static exo::u128 test_hash(u64 i_blob) { return exo::u128_from_u64(i_blob, ~i_blob); }
+
+static void save_test_blob(BlobArchive &archive, u8 i_blob)
+{
+	const u8 blob[3] = {i_blob, u8(i_blob + 1), u8(i_blob + 2)};
+	archive.save(test_hash(i_blob), exo::Span<const u8>(blob, 3));
+}
+
+static bool has_test_blob(BlobArchive &archive, u8 i_blob)
+{
+	const auto blob = archive.get(test_hash(i_blob));
+	return blob.has_value() && blob->len() == 3 && (*blob)[0] == i_blob && (*blob)[2] == u8(i_blob + 2);
+}
+
+TEST_CASE("BlobArchive compaction keeps the live blobs", "[blob_archive]")
+{
+	const auto directory = create_test_directory("blob_archive_compact");
+
+	auto archive = BlobArchive::open(directory);
+	for (u8 i_blob = 0; i_blob < 8; ++i_blob) {
+		save_test_blob(archive, i_blob);
+	}
+	archive.close();
+
+	const BlobHash live_blobs[] = {
+		BlobHash::from(test_hash(5)),
+		BlobHash::from(test_hash(1)),
+		BlobHash::from(test_hash(5)),
+	};
+	REQUIRE(BlobArchive::compact(directory, exo::Span<const BlobHash>(live_blobs, 3)) > 0);
+
+	archive = BlobArchive::open(directory);
+	REQUIRE(archive.pending_entries.is_empty());
+	REQUIRE(archive.indexed_entries.len() == 2);
+	REQUIRE(has_test_blob(archive, 1));
+	REQUIRE(has_test_blob(archive, 5));
+	REQUIRE(!archive.contains(test_hash(0)));
+	archive.close();
+
+	std::filesystem::remove_all(std::filesystem::path{directory.view().data()});
+}
+
+TEST_CASE("BlobArchive recovers a compaction interrupted before writing the index", "[blob_archive]")
+{
+	const auto directory = create_test_directory("blob_archive_interrupted");
+
+	auto archive = BlobArchive::open(directory);
+	for (u8 i_blob = 0; i_blob < 8; ++i_blob) {
+		save_test_blob(archive, i_blob);
+	}
+	archive.close();
+
+	const BlobHash live_blobs[] = {BlobHash::from(test_hash(6))};
+	BlobArchive::compact(directory, exo::Span<const BlobHash>(live_blobs, 1));
+
+	// State of a crash after the pack was replaced
+	std::filesystem::remove(std::filesystem::path{archive.index_path.view().data()});
+
+	archive = BlobArchive::open(directory);
+	REQUIRE(archive.pending_entries.len() == 1);
+	REQUIRE(has_test_blob(archive, 6));
+	REQUIRE(!archive.contains(test_hash(0)));
+	archive.close();
+
+	std::filesystem::remove_all(std::filesystem::path{directory.view().data()});
+}
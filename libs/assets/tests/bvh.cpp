@@ -0,0 +1,241 @@
+#include "assets/bvh.h"
+#include "cross/jobmanager.h"
+#include "exo/tests/random.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+// Triangle soup with random sizes and positions
+struct TestMesh
+{
+	Vec<float4> positions;
+	Vec<u32>    indices;
+
+	void destroy()
+	{
+		this->positions.buffer.destroy();
+		this->indices.buffer.destroy();
+	}
+};
+
+using exo::tests::Random;
+
+static TestMesh make_mesh(u32 triangle_count, float triangle_size, Random &random)
+{
+	TestMesh mesh = {};
+	for (u32 i_triangle = 0; i_triangle < triangle_count; ++i_triangle) {
+		const float3 center = 100.0f * random.next3();
+		for (u32 i_vertex = 0; i_vertex < 3; ++i_vertex) {
+			const float3 position = center + triangle_size * random.next3();
+			mesh.indices.push(mesh.positions.len());
+			mesh.positions.push(float4(position.x, position.y, position.z, 1.0f));
+		}
+	}
+	return mesh;
+}
+
+static BVHRay make_ray(Random &random)
+{
+	BVHRay ray    = {};
+	ray.origin    = 120.0f * random.next3() - float3(10.0f);
+	ray.direction = exo::normalize(random.next3() - float3(0.5f));
+	return ray;
+}
+
+// Intersects every triangle with the same leaf test as the traversal
+static BVHHit brute_force_hit(const TestMesh &mesh, const BVHRay &ray)
+{
+	Vec<BVHNode> leaf;
+	leaf.resize(1);
+
+	BVHHit closest = {};
+	for (u32 i_index = 0; i_index < mesh.indices.len(); i_index += 3) {
+		leaf[0].prim_index = i_index;
+		BVHHit hit         = {};
+		if (blas_closest_hit(leaf, mesh.indices, mesh.positions, ray, hit) && hit.d < closest.d) {
+			closest = hit;
+		}
+	}
+	leaf.buffer.destroy();
+	return closest;
+}
+
+static bool contains(const BVHNode &parent, const BVHNode &child)
+{
+	for (u32 i_comp = 0; i_comp < 3; ++i_comp) {
+		if (child.bbox_min[i_comp] < parent.bbox_min[i_comp] || child.bbox_max[i_comp] > parent.bbox_max[i_comp]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void check_tree(exo::Span<const BVHNode> nodes, u32 prim_count, u32 prim_stride)
+{
+	REQUIRE(nodes.len() == 2 * prim_count - 1);
+
+	Vec<u32> prim_seen = Vec<u32>::with_length(prim_count);
+	for (u32 &seen : prim_seen) {
+		seen = 0;
+	}
+
+	for (u32 i_node = 0; i_node < nodes.len(); ++i_node) {
+		const auto &node = nodes[i_node];
+		if (node.prim_index != u32_invalid) {
+			REQUIRE(node.prim_index % prim_stride == 0);
+			prim_seen[node.prim_index / prim_stride] += 1;
+		} else {
+			const auto &left = nodes[i_node + 1];
+			REQUIRE(left.next_node != u32_invalid);
+			const auto &right = nodes[left.next_node];
+			REQUIRE(right.next_node == node.next_node);
+			REQUIRE(contains(node, left));
+			REQUIRE(contains(node, right));
+		}
+	}
+
+	for (u32 seen : prim_seen) {
+		REQUIRE(seen == 1);
+	}
+	prim_seen.buffer.destroy();
+}
+
+TEST_CASE("BVH build", "[bvh]")
+{
+	Random   random = {};
+	TestMesh mesh   = make_mesh(1000, 10.0f, random);
+
+	Vec<BVHNode> nodes;
+	build_blas(BVHBuildSettings{}, nullptr, mesh.indices, mesh.positions, nodes);
+	check_tree(nodes, 1000, 3);
+
+	SECTION("parallel build")
+	{
+		auto jobmanager = cross::JobManager::create();
+
+		Vec<BVHNode> parallel_nodes;
+		const BVHBuildSettings settings = {.parallel_threshold = 64};
+		build_blas(settings, &jobmanager, mesh.indices, mesh.positions, parallel_nodes);
+		check_tree(parallel_nodes, 1000, 3);
+
+		// The subtrees are split the same way by the jobs
+		for (u32 i_node = 0; i_node < nodes.len(); ++i_node) {
+			REQUIRE(parallel_nodes[i_node].prim_index == nodes[i_node].prim_index);
+			REQUIRE(parallel_nodes[i_node].next_node == nodes[i_node].next_node);
+		}
+
+		parallel_nodes.buffer.destroy();
+		jobmanager.destroy();
+	}
+
+	SECTION("single triangle")
+	{
+		build_blas(BVHBuildSettings{}, nullptr, exo::Span(mesh.indices.data(), 3), mesh.positions, nodes);
+		REQUIRE(nodes.len() == 1);
+		REQUIRE(nodes[0].prim_index == 0);
+		REQUIRE(nodes[0].next_node == u32_invalid);
+	}
+
+	nodes.buffer.destroy();
+	mesh.destroy();
+}
+
+TEST_CASE("BVH traversal", "[bvh]")
+{
+	Random   random = {};
+	TestMesh mesh   = make_mesh(500, 10.0f, random);
+
+	Vec<BVHNode> nodes;
+	build_blas(BVHBuildSettings{}, nullptr, mesh.indices, mesh.positions, nodes);
+
+	u32 hit_count = 0;
+	for (u32 i_ray = 0; i_ray < 1000; ++i_ray) {
+		const BVHRay ray      = make_ray(random);
+		const BVHHit expected = brute_force_hit(mesh, ray);
+
+		BVHHit     hit     = {};
+		const bool has_hit = blas_closest_hit(nodes, mesh.indices, mesh.positions, ray, hit);
+		REQUIRE(has_hit == (expected.triangle_id != u32_invalid));
+		REQUIRE(hit.triangle_id == expected.triangle_id);
+		REQUIRE(hit.d == expected.d);
+		hit_count += hit.triangle_id != u32_invalid ? 1 : 0;
+	}
+	// Make sure the rays are not all missing
+	REQUIRE(hit_count > 100);
+
+	nodes.buffer.destroy();
+	mesh.destroy();
+}
+
+TEST_CASE("TLAS refit", "[bvh]")
+{
+	Random         random = {};
+	Vec<exo::AABB> bounds;
+	for (u32 i_instance = 0; i_instance < 100; ++i_instance) {
+		const float3 min = 100.0f * random.next3();
+		bounds.push(exo::AABB{.min = min, .max = min + float3(1.0f)});
+	}
+
+	Vec<BVHNode> nodes;
+	build_tlas(BVHBuildSettings{}, nullptr, bounds, nodes);
+	check_tree(nodes, 100, 1);
+
+	for (auto &instance_bounds : bounds) {
+		const float3 offset = 10.0f * random.next3();
+		instance_bounds.min = instance_bounds.min + offset;
+		instance_bounds.max = instance_bounds.max + offset;
+	}
+	refit_tlas(nodes, bounds);
+	check_tree(nodes, 100, 1);
+
+	for (const auto &node : nodes) {
+		if (node.prim_index != u32_invalid) {
+			REQUIRE(node.bbox_min == bounds[node.prim_index].min);
+			REQUIRE(node.bbox_max == bounds[node.prim_index].max);
+		}
+	}
+
+	nodes.buffer.destroy();
+	bounds.buffer.destroy();
+}
+
+TEST_CASE("BVH benchmark", "[.][bvh][benchmark]")
+{
+	Random   random = {};
+	TestMesh mesh   = make_mesh(100'000, 2.0f, random);
+
+	auto         jobmanager = cross::JobManager::create();
+	Vec<BVHNode> nodes;
+
+	BENCHMARK("build 100k triangles")
+	{
+		build_blas(BVHBuildSettings{}, nullptr, mesh.indices, mesh.positions, nodes);
+		return nodes.len();
+	};
+
+	BENCHMARK("parallel build 100k triangles")
+	{
+		build_blas(BVHBuildSettings{}, &jobmanager, mesh.indices, mesh.positions, nodes);
+		return nodes.len();
+	};
+
+	constexpr u32 RAY_COUNT = 100'000;
+	Vec<BVHRay>   rays;
+	for (u32 i_ray = 0; i_ray < RAY_COUNT; ++i_ray) {
+		rays.push(make_ray(random));
+	}
+
+	BENCHMARK("closest hit 100k rays")
+	{
+		u32 hit_count = 0;
+		for (const auto &ray : rays) {
+			BVHHit hit = {};
+			hit_count += blas_closest_hit(nodes, mesh.indices, mesh.positions, ray, hit) ? 1 : 0;
+		}
+		return hit_count;
+	};
+
+	rays.buffer.destroy();
+	nodes.buffer.destroy();
+	jobmanager.destroy();
+	mesh.destroy();
+}
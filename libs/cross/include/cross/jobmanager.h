@@ -4,7 +4,9 @@
 
 namespace cross
 {
-inline constexpr usize THREAD_POOL_LENGTH = 24;
+// Upper bound of worker threads, the actual count follows the number of hardware threads.
+// (64 is also the maximum number of handles that WaitForMultipleObjects accepts)
+inline constexpr usize MAX_THREAD_POOL_LENGTH = 64;
 
 struct Job;
 
@@ -16,7 +18,8 @@ struct Thread
 
 struct JobManager
 {
-	Thread threads[THREAD_POOL_LENGTH];
+	Thread threads[MAX_THREAD_POOL_LENGTH];
+	u32    threads_len = 0;
 
 	struct Impl;
 	exo::ForwardContainer<Impl> impl;
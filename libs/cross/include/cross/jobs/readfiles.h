@@ -36,4 +36,9 @@ struct ReadFileJobDesc
 };
 
 std::unique_ptr<Waitable> read_files(const JobManager &jobmanager, exo::Span<const ReadFileJobDesc> jobs);
+
+// Register destination buffers with the OS to avoid mapping them for every read, reads whose dst lies inside one of
+// them will use it. It must be called when no reads are in flight, returns false if it is not supported.
+bool register_read_buffers(const JobManager &jobmanager, exo::Span<const exo::Span<u8>> buffers);
+void unregister_read_buffers(const JobManager &jobmanager);
 } // namespace cross
@@ -1,38 +1,75 @@
 #pragma once
 #include "exo/collections/span.h"
+#include "exo/macros/assert.h"
 #include "exo/maths/numerics.h"
 #include "exo/option.h"
 #include "exo/string_view.h"
 
 namespace cross
 {
+enum struct MappedFileAccess
+{
+	ReadOnly,
+	ReadWrite,
+};
+
+// Hints about how the mapped pages will be accessed
+struct MappedFileHints
+{
+	bool sequential = false; // pages are read in order, read ahead aggressively and drop them early
+	bool will_need  = false; // start reading the pages in the background now
+	bool huge_pages = false; // back the mapping with huge pages when the OS supports it
+};
+
 struct MappedFile
 {
 #if defined(PLATFORM_WINDOWS)
-#else
-	int fd = -1;
+	void *mapping = nullptr;
 #endif
+	// The view starts on the allocation granularity, base_addr points to the requested offset inside of it
+	void *view      = nullptr;
+	usize view_size = 0;
 
-	const void *base_addr = nullptr;
-	void *mapping = nullptr;
-	usize size = 0;
+	const void      *base_addr = nullptr;
+	usize            size      = 0;
+	MappedFileAccess access    = MappedFileAccess::ReadOnly;
 
 	MappedFile() = default;
 	~MappedFile();
 
-	MappedFile(const MappedFile &copied) = delete;
+	MappedFile(const MappedFile &copied)            = delete;
 	MappedFile &operator=(const MappedFile &copied) = delete;
 
 	MappedFile(MappedFile &&moved) noexcept;
 	MappedFile &operator=(MappedFile &&moved) noexcept;
 
+	// Map a whole file for reading
 	static Option<MappedFile> open(const exo::StringView &path);
+	// Map [offset, offset + size) of a file, a size of 0 maps until the end of the file
+	static Option<MappedFile> open_range(const exo::StringView &path,
+		usize                                                   offset,
+		usize                                                   size,
+		MappedFileAccess                                        access = MappedFileAccess::ReadOnly);
+	// Create (or truncate) a file of `size` bytes and map it for writing
+	static Option<MappedFile> create(const exo::StringView &path, usize size);
 
-	inline exo::Span<const u8> content()
+	inline exo::Span<const u8> content() const
 	{
 		return exo::Span<const u8>{reinterpret_cast<const u8 *>(this->base_addr), this->size};
 	}
 
+	inline exo::Span<u8> content_mut()
+	{
+		ASSERT(this->access == MappedFileAccess::ReadWrite);
+		return exo::Span<u8>{const_cast<u8 *>(reinterpret_cast<const u8 *>(this->base_addr)), this->size};
+	}
+
+	// Advise the OS about the access pattern of the whole mapping or of a range relative to base_addr
+	void advise(MappedFileHints hints);
+	void advise_range(usize offset, usize size, MappedFileHints hints);
+
+	// Write the modified pages back to the file
+	void flush();
 	void close();
 };
 }; // namespace cross
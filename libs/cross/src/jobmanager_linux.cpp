@@ -0,0 +1,330 @@
+#include "cross/jobmanager.h"
+
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+
+#include "cross/jobs/custom.h"
+#include "cross/jobs/foreach.h"
+#include "cross/jobs/readfiles.h"
+
+// for Impls
+#include "jobmanager_linux.h"
+#include "jobs/io_ring_linux.h"
+#include "jobs/readfiles_linux.h"
+
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace cross
+{
+// Number of failed lookups before an idle worker goes to sleep
+inline constexpr u32 IDLE_SPIN_COUNT = 64;
+
+// The worker running on the current thread, nullptr on threads outside the pool
+static thread_local Worker *tls_worker = nullptr;
+
+// -- Futex
+
+static void futex_wait(std::atomic<u32> *address, u32 expected)
+{
+	syscall(SYS_futex, reinterpret_cast<u32 *>(address), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<u32> *address, int count)
+{
+	syscall(SYS_futex, reinterpret_cast<u32 *>(address), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+// -- WorkStealingDeque
+
+bool WorkStealingDeque::push(Job *job)
+{
+	const i64 b = this->bottom.load(std::memory_order_relaxed);
+	const i64 t = this->top.load(std::memory_order_acquire);
+	if (b - t >= CAPACITY) {
+		return false;
+	}
+
+	this->ring[b & MASK].store(job, std::memory_order_relaxed);
+	this->bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+Job *WorkStealingDeque::pop()
+{
+	const i64 b = this->bottom.load(std::memory_order_relaxed) - 1;
+	this->bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	i64 t = this->top.load(std::memory_order_relaxed);
+
+	if (t > b) {
+		// The deque was empty
+		this->bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job *job = this->ring[b & MASK].load(std::memory_order_relaxed);
+	if (t == b) {
+		// Last element, race against thieves
+		if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		this->bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job *WorkStealingDeque::steal()
+{
+	i64 t = this->top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const i64 b = this->bottom.load(std::memory_order_acquire);
+
+	if (t >= b) {
+		return nullptr;
+	}
+
+	Job *job = this->ring[t & MASK].load(std::memory_order_relaxed);
+	if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return job;
+}
+
+// -- InjectionQueue
+
+InjectionQueue::InjectionQueue()
+{
+	for (usize i = 0; i < CAPACITY; ++i) {
+		this->cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+bool InjectionQueue::push(Job *job)
+{
+	Cell *cell = nullptr;
+	usize pos  = this->enqueue_pos.load(std::memory_order_relaxed);
+	while (true) {
+		cell           = &this->cells[pos & MASK];
+		const usize sequence = cell->sequence.load(std::memory_order_acquire);
+		const isize diff     = isize(sequence) - isize(pos);
+		if (diff == 0) {
+			if (this->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// full
+			return false;
+		} else {
+			pos = this->enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->job = job;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+Job *InjectionQueue::pop()
+{
+	Cell *cell = nullptr;
+	usize pos  = this->dequeue_pos.load(std::memory_order_relaxed);
+	while (true) {
+		cell                 = &this->cells[pos & MASK];
+		const usize sequence = cell->sequence.load(std::memory_order_acquire);
+		const isize diff     = isize(sequence) - isize(pos + 1);
+		if (diff == 0) {
+			if (this->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// empty
+			return nullptr;
+		} else {
+			pos = this->dequeue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	Job *job = cell->job;
+	cell->sequence.store(pos + MASK + 1, std::memory_order_release);
+	return job;
+}
+
+// -- Workers
+
+static void execute_job(Job *p_job)
+{
+	EXO_PROFILE_SCOPE_NAMED("Job execution")
+	ASSERT(p_job->type != u32_invalid);
+	if (p_job->type == ForeachJob::TASK_TYPE) {
+		auto &foreachjob = *reinterpret_cast<ForeachJob *>(p_job);
+		foreachjob.callback(foreachjob);
+		__atomic_fetch_add(foreachjob.done_counter, 1, __ATOMIC_ACQ_REL);
+	} else if (p_job->type == ReadFileJob::TASK_TYPE) {
+		auto &readfile_job = *reinterpret_cast<ReadFileJob *>(p_job);
+		worker_thread_read_file(readfile_job);
+	} else if (p_job->type == CustomJob::TASK_TYPE) {
+		auto &custom_job = *reinterpret_cast<CustomJob *>(p_job);
+		custom_job.callback(custom_job);
+		__atomic_fetch_add(custom_job.done_counter, 1, __ATOMIC_ACQ_REL);
+	} else {
+		ASSERT(false);
+	}
+}
+
+static Job *find_job(JobQueues &queues, Worker &worker)
+{
+	if (Job *job = worker.deque.pop()) {
+		return job;
+	}
+
+	if (Job *job = queues.injection.pop()) {
+		return job;
+	}
+
+	// Steal from the other workers, starting with the next one to spread the contention
+	for (u32 i_offset = 1; i_offset < queues.workers_len; ++i_offset) {
+		auto &victim = queues.workers[(worker.index + i_offset) % queues.workers_len];
+		if (Job *job = victim.deque.steal()) {
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+bool worker_help_one_job()
+{
+	if (!tls_worker) {
+		return false;
+	}
+
+	Job *job = find_job(*tls_worker->queues, *tls_worker);
+	if (job) {
+		execute_job(job);
+	}
+	return job != nullptr;
+}
+
+static void *worker_thread_proc(void *param)
+{
+	auto &worker = *static_cast<Worker *>(param);
+	auto &queues = *worker.queues;
+	tls_worker   = &worker;
+
+	while (!queues.stop.load(std::memory_order_acquire)) {
+		Job *job = nullptr;
+		for (u32 i_spin = 0; i_spin < IDLE_SPIN_COUNT && !job; ++i_spin) {
+			job = find_job(queues, worker);
+			if (!job) {
+				cpu_relax();
+			}
+		}
+
+		if (!job) {
+			// Announce that we are going to sleep, then check the queues one last time before waiting on the epoch.
+			// A job queued after the epoch was read will change it and make the futex wait return immediately.
+			queues.sleepers.fetch_add(1, std::memory_order_seq_cst);
+			const u32 epoch = queues.wake_epoch.load(std::memory_order_seq_cst);
+			job             = find_job(queues, worker);
+			if (!job && !queues.stop.load(std::memory_order_acquire)) {
+				futex_wait(&queues.wake_epoch, epoch);
+			}
+			queues.sleepers.fetch_sub(1, std::memory_order_seq_cst);
+		}
+
+		if (job) {
+			execute_job(job);
+		}
+	}
+
+	tls_worker = nullptr;
+	return nullptr;
+}
+
+// -- JobManager
+
+JobManager JobManager::create()
+{
+	EXO_PROFILE_SCOPE
+
+	JobManager jobmanager;
+	auto      &impl = jobmanager.impl.get();
+
+	const u32 hardware_threads = std::thread::hardware_concurrency();
+	jobmanager.threads_len     = hardware_threads > 0 ? hardware_threads : 1;
+	if (jobmanager.threads_len > MAX_THREAD_POOL_LENGTH) {
+		jobmanager.threads_len = MAX_THREAD_POOL_LENGTH;
+	}
+
+	impl.queues              = new JobQueues;
+	impl.queues->workers_len = jobmanager.threads_len;
+	impl.queues->io_ring     = IoRing::create();
+
+	// Initialize threads
+	for (u32 i_thread = 0; i_thread < jobmanager.threads_len; ++i_thread) {
+		auto &worker  = impl.queues->workers[i_thread];
+		worker.queues = impl.queues;
+		worker.index  = i_thread;
+
+		auto &thread_impl = jobmanager.threads[i_thread].impl.get();
+		auto  res         = pthread_create(&thread_impl.handle, nullptr, worker_thread_proc, &worker);
+		ASSERT(res == 0);
+	}
+	return jobmanager;
+}
+
+void JobManager::queue_job(Job &job) const
+{
+	EXO_PROFILE_SCOPE
+	const auto &manager_impl = this->impl.get();
+	auto       &queues       = *manager_impl.queues;
+
+	// Jobs queued from a job go to the worker's own deque, the others to the shared queue
+	bool queued = tls_worker && tls_worker->queues == &queues && tls_worker->deque.push(&job);
+	while (!queued) {
+		queued = queues.injection.push(&job);
+		if (!queued) {
+			// The queue is full, help the workers instead of waiting
+			if (Job *other_job = queues.injection.pop()) {
+				execute_job(other_job);
+			}
+		}
+	}
+
+	queues.wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+	if (queues.sleepers.load(std::memory_order_seq_cst) > 0) {
+		futex_wake(&queues.wake_epoch, 1);
+	}
+}
+
+void JobManager::destroy()
+{
+	EXO_PROFILE_SCOPE
+
+	auto &manager_impl = this->impl.get();
+
+	if (manager_impl.queues->io_ring) {
+		manager_impl.queues->io_ring->destroy();
+		delete manager_impl.queues->io_ring;
+		manager_impl.queues->io_ring = nullptr;
+	}
+
+	manager_impl.queues->stop.store(true, std::memory_order_release);
+	manager_impl.queues->wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+	futex_wake(&manager_impl.queues->wake_epoch, INT_MAX);
+
+	for (u32 i_thread = 0; i_thread < this->threads_len; ++i_thread) {
+		auto &thread_impl = this->threads[i_thread].impl.get();
+		pthread_join(thread_impl.handle, nullptr);
+		thread_impl.handle = {};
+	}
+	this->threads_len = 0;
+
+	delete manager_impl.queues;
+	manager_impl.queues = nullptr;
+}
+}; // namespace cross
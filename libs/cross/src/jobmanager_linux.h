@@ -0,0 +1,103 @@
+#pragma once
+#include "cross/jobmanager.h"
+
+#include <atomic>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace cross
+{
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#endif
+}
+
+/**
+   Chase-Lev work-stealing deque ("Dynamic Circular Work-Stealing Deque", D. Chase and Y. Lev), using the memory
+   orderings from "Correct and Efficient Work-Stealing for Weak Memory Models" (N. M. Le et al.).
+   Only the owning worker can push and pop at the bottom, any thread can steal from the top.
+   The ring has a fixed capacity to avoid reclaiming old rings, push fails when it is full and the caller falls back to
+   the global queue.
+ **/
+struct WorkStealingDeque
+{
+	static constexpr i64 CAPACITY = 4096;
+	static constexpr i64 MASK     = CAPACITY - 1;
+
+	alignas(64) std::atomic<i64> top    = 0;
+	alignas(64) std::atomic<i64> bottom = 0;
+	std::atomic<Job *>           ring[CAPACITY] = {};
+
+	// owner only
+	bool push(Job *job);
+	Job *pop();
+	// any thread
+	Job *steal();
+};
+
+/**
+   Bounded multi-producer multi-consumer queue (D. Vyukov), jobs queued from threads outside the pool end up here.
+ **/
+struct InjectionQueue
+{
+	static constexpr usize CAPACITY = 16384;
+	static constexpr usize MASK     = CAPACITY - 1;
+
+	struct Cell
+	{
+		std::atomic<usize> sequence = 0;
+		Job               *job      = nullptr;
+	};
+
+	alignas(64) std::atomic<usize> enqueue_pos = 0;
+	alignas(64) std::atomic<usize> dequeue_pos = 0;
+	Cell cells[CAPACITY];
+
+	InjectionQueue();
+	bool push(Job *job);
+	Job *pop();
+};
+
+struct IoRing;
+struct JobQueues;
+struct Worker
+{
+	WorkStealingDeque deque;
+	JobQueues        *queues = nullptr;
+	u32               index  = 0;
+};
+
+// State shared by all workers, it is heap allocated because JobManager is moved around after creation.
+struct JobQueues
+{
+	Worker         workers[MAX_THREAD_POOL_LENGTH];
+	InjectionQueue injection;
+
+	// Idle workers sleep on the epoch futex, every queued job bumps it.
+	alignas(64) std::atomic<u32> wake_epoch = 0;
+	std::atomic<u32>             sleepers   = 0;
+	std::atomic<bool>            stop       = false;
+	u32                          workers_len = 0;
+
+	// nullptr when io_uring is not available, reads are done by the workers then
+	IoRing *io_ring = nullptr;
+};
+
+struct Thread::Impl
+{
+	pthread_t handle = {};
+};
+
+struct JobManager::Impl
+{
+	JobQueues *queues = nullptr;
+};
+
+// Execute one pending job if the calling thread is a worker, it lets a job wait on the jobs it queued.
+bool worker_help_one_job();
+} // namespace cross
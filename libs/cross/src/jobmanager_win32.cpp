@@ -13,6 +13,7 @@
 #include "jobs/readfiles_win32.h"
 
 #include <cstdio>
+#include <thread>
 #include <windows.h>
 
 namespace cross
@@ -25,11 +26,17 @@ JobManager JobManager::create()
 	JobManager jobmanager;
 	auto      &impl = jobmanager.impl.get();
 
-	impl.completion_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, NULL, THREAD_POOL_LENGTH);
+	const u32 hardware_threads = std::thread::hardware_concurrency();
+	jobmanager.threads_len     = hardware_threads > 0 ? hardware_threads : 1;
+	if (jobmanager.threads_len > MAX_THREAD_POOL_LENGTH) {
+		jobmanager.threads_len = MAX_THREAD_POOL_LENGTH;
+	}
+
+	impl.completion_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, NULL, jobmanager.threads_len);
 
 	// Initialize threads
-	for (auto &thread : jobmanager.threads) {
-		auto &thread_impl = thread.impl.get();
+	for (u32 i_thread = 0; i_thread < jobmanager.threads_len; ++i_thread) {
+		auto &thread_impl = jobmanager.threads[i_thread].impl.get();
 
 		void *thread_param = impl.completion_port;
 		auto *thread_id    = &thread_impl.id;
@@ -57,16 +64,16 @@ void JobManager::destroy()
 
 	CloseHandle(manager_impl.completion_port);
 
-	HANDLE thread_handles[THREAD_POOL_LENGTH];
-	for (usize i_thread = 0; i_thread < THREAD_POOL_LENGTH; ++i_thread) {
+	HANDLE thread_handles[MAX_THREAD_POOL_LENGTH];
+	for (u32 i_thread = 0; i_thread < this->threads_len; ++i_thread) {
 		const auto &thread_impl  = this->threads[i_thread].impl.get();
 		thread_handles[i_thread] = thread_impl.handle;
 	}
 
-	WaitForMultipleObjects(THREAD_POOL_LENGTH, thread_handles, TRUE, INFINITE);
+	WaitForMultipleObjects(this->threads_len, thread_handles, TRUE, INFINITE);
 
-	for (auto &thread : this->threads) {
-		auto &thread_impl = thread.impl.get();
+	for (u32 i_thread = 0; i_thread < this->threads_len; ++i_thread) {
+		auto &thread_impl = this->threads[i_thread].impl.get();
 		CloseHandle(thread_impl.handle);
 		thread_impl.handle = nullptr;
 	}
@@ -91,10 +98,62 @@ void worker_thread_read_file(ReadFileJob &job)
 	ASSERT(!res && last_error == ERROR_IO_PENDING);
 }
 
+// The completion port of the job manager that owns the calling thread, null outside of the workers
+static thread_local HANDLE tls_completion_port = nullptr;
+
+static void execute_job(OVERLAPPED *overlapped, unsigned long bytes_transferred, ULONG_PTR completion_key)
+{
+	EXO_PROFILE_SCOPE_NAMED("Job execution")
+	auto *p_job = (Job *)overlapped;
+	ASSERT(p_job->type != u32_invalid);
+	if (p_job->type == ForeachJob::TASK_TYPE) {
+		auto &foreachjob = *reinterpret_cast<ForeachJob *>(p_job);
+		foreachjob.callback(foreachjob);
+		InterlockedIncrement64(foreachjob.done_counter);
+	} else if (p_job->type == ReadFileJob::TASK_TYPE) {
+		auto &readfile_job = *reinterpret_cast<ReadFileJob *>(p_job);
+		worker_thread_read_file(readfile_job);
+	} else if (p_job->type == ReadFileCompletedJob::TASK_TYPE) {
+		auto readcomplete_job = reinterpret_cast<ReadFileCompletedJob *>(p_job);
+		ASSERT(readcomplete_job->read_size >= bytes_transferred);
+		InterlockedIncrement64(readcomplete_job->done_counter);
+		delete readcomplete_job;
+
+		auto file_handle = (HANDLE)(completion_key);
+		CloseHandle(file_handle);
+	} else if (p_job->type == CustomJob::TASK_TYPE) {
+		auto &custom_job = *reinterpret_cast<CustomJob *>(p_job);
+		custom_job.callback(custom_job);
+		InterlockedIncrement64(custom_job.done_counter);
+	} else {
+		ASSERT(false);
+	}
+}
+
+bool worker_help_one_job()
+{
+	if (!tls_completion_port) {
+		return false;
+	}
+
+	unsigned long bytes_transferred = 0;
+	ULONG_PTR     completion_key    = NULL;
+	LPOVERLAPPED  overlapped        = nullptr;
+
+	// Don't block, the caller keeps checking its waitable
+	BOOL res = GetQueuedCompletionStatus(tls_completion_port, &bytes_transferred, &completion_key, &overlapped, 0);
+	if (!overlapped || !res) {
+		return false;
+	}
+
+	execute_job(overlapped, bytes_transferred, completion_key);
+	return true;
+}
+
 DWORD worker_thread_proc(void *param)
 {
 	HANDLE completion_port = param;
-	// DWORD  thread_id       = GetCurrentThreadId();
+	tls_completion_port    = completion_port;
 
 	unsigned long bytes_transferred = 0;
 	ULONG_PTR     completion_key    = NULL;
@@ -107,31 +166,7 @@ DWORD worker_thread_proc(void *param)
 			break;
 		}
 
-		EXO_PROFILE_SCOPE_NAMED("Job execution")
-		auto *p_job = (Job *)overlapped;
-		ASSERT(p_job->type != u32_invalid);
-		if (p_job->type == ForeachJob::TASK_TYPE) {
-			auto &foreachjob = *reinterpret_cast<ForeachJob *>(p_job);
-			foreachjob.callback(foreachjob);
-			InterlockedIncrement64(foreachjob.done_counter);
-		} else if (p_job->type == ReadFileJob::TASK_TYPE) {
-			auto &readfile_job = *reinterpret_cast<ReadFileJob *>(p_job);
-			worker_thread_read_file(readfile_job);
-		} else if (p_job->type == ReadFileCompletedJob::TASK_TYPE) {
-			auto readcomplete_job = reinterpret_cast<ReadFileCompletedJob *>(p_job);
-			ASSERT(readcomplete_job->read_size >= bytes_transferred);
-			InterlockedIncrement64(readcomplete_job->done_counter);
-			delete readcomplete_job;
-
-			auto file_handle = (HANDLE)(completion_key);
-			CloseHandle(file_handle);
-		} else if (p_job->type == CustomJob::TASK_TYPE) {
-			auto &custom_job = *reinterpret_cast<CustomJob *>(p_job);
-			custom_job.callback(custom_job);
-			InterlockedIncrement64(custom_job.done_counter);
-		} else {
-			ASSERT(false);
-		}
+		execute_job(overlapped, bytes_transferred, completion_key);
 	}
 	return 0;
 }
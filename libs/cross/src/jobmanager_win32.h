@@ -14,4 +14,7 @@ struct JobManager::Impl
 {
 	HANDLE completion_port = {};
 };
+
+// Execute one pending job if the calling thread is a worker, it lets a job wait on the jobs it queued.
+bool worker_help_one_job();
 } // namespace cross
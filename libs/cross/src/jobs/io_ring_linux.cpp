@@ -0,0 +1,317 @@
+#include "jobs/io_ring_linux.h"
+
+#include "exo/logger.h"
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+
+#include "cross/jobs/readfiles.h"
+
+#include "jobmanager_linux.h"
+#include "jobs/readfiles_linux.h"
+
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace cross
+{
+// -- Syscalls
+
+static int io_uring_setup(u32 entries, io_uring_params *params)
+{
+	return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int ring_fd, u32 to_submit, u32 min_complete, u32 flags)
+{
+	return int(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int io_uring_register(int ring_fd, u32 opcode, const void *arg, u32 nr_args)
+{
+	return int(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+// -- Submission
+
+static void lock(std::atomic_flag &flag)
+{
+	while (flag.test_and_set(std::memory_order_acquire)) {
+		cpu_relax();
+	}
+}
+
+static void unlock(std::atomic_flag &flag) { flag.clear(std::memory_order_release); }
+
+// Must be called with the submission lock held
+static void flush_submissions(IoRing &ring)
+{
+	while (ring.sq_pending > 0) {
+		const int res = io_uring_enter(ring.ring_fd, ring.sq_pending, 0, 0);
+		if (res < 0) {
+			// EBUSY: the completion queue overflowed, the reaper is draining it
+			ASSERT(errno == EINTR || errno == EAGAIN || errno == EBUSY);
+			sched_yield();
+			continue;
+		}
+		ring.sq_pending -= u32(res);
+	}
+}
+
+// Must be called with the submission lock held
+static io_uring_sqe *get_sqe(IoRing &ring)
+{
+	const u32 tail = ring.sq_tail->load(std::memory_order_relaxed);
+	if (tail - ring.sq_head->load(std::memory_order_acquire) >= IoRing::SQ_ENTRIES) {
+		flush_submissions(ring);
+	}
+
+	const u32 index      = tail & ring.sq_mask;
+	ring.sq_array[index] = index;
+	io_uring_sqe *sqe    = &ring.sqes[index];
+	std::memset(sqe, 0, sizeof(io_uring_sqe));
+	return sqe;
+}
+
+// Must be called with the submission lock held
+static void push_sqe(IoRing &ring)
+{
+	ring.sq_tail->fetch_add(1, std::memory_order_release);
+	ring.sq_pending += 1;
+}
+
+void IoRing::submit_reads(exo::Span<ReadFileJob *const> jobs)
+{
+	EXO_PROFILE_SCOPE
+	lock(this->submit_lock);
+
+	for (auto *job : jobs) {
+		auto &readjob_impl = job->readfilejob_impl.get();
+
+		const usize remaining = job->size - readjob_impl.bytes_read;
+		const usize read_size = remaining < MAX_READ_SIZE ? remaining : MAX_READ_SIZE;
+		u8         *dst       = job->dst.data() + readjob_impl.bytes_read;
+
+		io_uring_sqe *sqe = get_sqe(*this);
+		sqe->fd           = readjob_impl.fd;
+		sqe->off          = readjob_impl.offset + readjob_impl.bytes_read;
+		sqe->addr         = reinterpret_cast<u64>(dst);
+		sqe->len          = u32(read_size);
+		sqe->user_data    = reinterpret_cast<u64>(job);
+		if (readjob_impl.buffer_index != u32_invalid) {
+			sqe->opcode    = IORING_OP_READ_FIXED;
+			sqe->buf_index = u16(readjob_impl.buffer_index);
+		} else {
+			sqe->opcode = IORING_OP_READ;
+		}
+		push_sqe(*this);
+	}
+
+	flush_submissions(*this);
+	unlock(this->submit_lock);
+}
+
+// -- Completion
+
+static void complete_read(ReadFileJob &job)
+{
+	auto &readjob_impl = job.readfilejob_impl.get();
+	::close(readjob_impl.fd);
+	readjob_impl.fd = -1;
+	__atomic_fetch_add(job.done_counter, 1, __ATOMIC_ACQ_REL);
+}
+
+static void *reaper_thread_proc(void *param)
+{
+	auto &ring = *static_cast<IoRing *>(param);
+
+	ReadFileJob *to_resubmit[IoRing::CQ_ENTRIES];
+	while (!ring.stop.load(std::memory_order_acquire)) {
+		const int res = io_uring_enter(ring.ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+		if (res < 0 && errno != EINTR) {
+			ASSERT(errno == EAGAIN || errno == EBUSY);
+		}
+
+		u32       to_resubmit_len = 0;
+		u32       head            = ring.cq_head->load(std::memory_order_relaxed);
+		const u32 tail            = ring.cq_tail->load(std::memory_order_acquire);
+		for (; head != tail; ++head) {
+			const io_uring_cqe &cqe = ring.cqes[head & ring.cq_mask];
+			if (cqe.user_data == 0) {
+				// wake up nop
+				continue;
+			}
+
+			auto &job          = *reinterpret_cast<ReadFileJob *>(cqe.user_data);
+			auto &readjob_impl = job.readfilejob_impl.get();
+			if (cqe.res > 0) {
+				readjob_impl.bytes_read += usize(cqe.res);
+				if (readjob_impl.bytes_read < job.size) {
+					// short read, queue the remaining part (a read of 0 bytes means end of file)
+					to_resubmit[to_resubmit_len++] = &job;
+					continue;
+				}
+			} else if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+				to_resubmit[to_resubmit_len++] = &job;
+				continue;
+			} else if (cqe.res < 0) {
+				exo::logger::error("[IoRing] Failed to read %.*s: %s\n",
+					int(job.path.len()),
+					job.path.data(),
+					strerror(-cqe.res));
+			}
+
+			complete_read(job);
+		}
+		// Release the completion slots before resubmitting so the kernel has room for the new completions
+		ring.cq_head->store(head, std::memory_order_release);
+
+		if (to_resubmit_len > 0) {
+			ring.submit_reads(exo::Span<ReadFileJob *const>(to_resubmit, to_resubmit_len));
+		}
+	}
+
+	return nullptr;
+}
+
+// -- IoRing
+
+IoRing *IoRing::create()
+{
+	EXO_PROFILE_SCOPE
+
+	io_uring_params params = {};
+	params.flags           = IORING_SETUP_CQSIZE;
+	params.cq_entries      = CQ_ENTRIES;
+
+	const int ring_fd = io_uring_setup(SQ_ENTRIES, &params);
+	if (ring_fd < 0) {
+		// Not supported by the kernel or forbidden by a seccomp filter, read_files falls back to the workers.
+		return nullptr;
+	}
+
+	// The reaper can be late, we rely on the kernel keeping overflowing completions
+	if (!(params.features & IORING_FEAT_NODROP)) {
+		::close(ring_fd);
+		return nullptr;
+	}
+
+	auto *ring    = new IoRing;
+	ring->ring_fd = ring_fd;
+
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	ring->sqes_size    = params.sq_entries * sizeof(io_uring_sqe);
+
+	const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single_mmap) {
+		ring->sq_ring_size = ring->sq_ring_size > ring->cq_ring_size ? ring->sq_ring_size : ring->cq_ring_size;
+		ring->cq_ring_size = 0;
+	}
+
+	ring->sq_ring =
+		mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	ASSERT(ring->sq_ring != MAP_FAILED);
+
+	if (single_mmap) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(nullptr,
+			ring->cq_ring_size,
+			PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE,
+			ring_fd,
+			IORING_OFF_CQ_RING);
+		ASSERT(ring->cq_ring != MAP_FAILED);
+	}
+
+	void *sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+	ASSERT(sqes != MAP_FAILED);
+
+	auto *sq_base  = static_cast<u8 *>(ring->sq_ring);
+	ring->sq_head  = reinterpret_cast<std::atomic<u32> *>(sq_base + params.sq_off.head);
+	ring->sq_tail  = reinterpret_cast<std::atomic<u32> *>(sq_base + params.sq_off.tail);
+	ring->sq_mask  = *reinterpret_cast<u32 *>(sq_base + params.sq_off.ring_mask);
+	ring->sq_array = reinterpret_cast<u32 *>(sq_base + params.sq_off.array);
+	ring->sqes     = static_cast<io_uring_sqe *>(sqes);
+
+	auto *cq_base = static_cast<u8 *>(ring->cq_ring);
+	ring->cq_head = reinterpret_cast<std::atomic<u32> *>(cq_base + params.cq_off.head);
+	ring->cq_tail = reinterpret_cast<std::atomic<u32> *>(cq_base + params.cq_off.tail);
+	ring->cq_mask = *reinterpret_cast<u32 *>(cq_base + params.cq_off.ring_mask);
+	ring->cqes    = reinterpret_cast<io_uring_cqe *>(cq_base + params.cq_off.cqes);
+
+	auto res = pthread_create(&ring->reaper, nullptr, reaper_thread_proc, ring);
+	ASSERT(res == 0);
+
+	return ring;
+}
+
+void IoRing::destroy()
+{
+	EXO_PROFILE_SCOPE
+
+	// Wake up the reaper with a nop
+	this->stop.store(true, std::memory_order_release);
+	lock(this->submit_lock);
+	io_uring_sqe *sqe = get_sqe(*this);
+	sqe->opcode       = IORING_OP_NOP;
+	sqe->user_data    = 0;
+	push_sqe(*this);
+	flush_submissions(*this);
+	unlock(this->submit_lock);
+
+	pthread_join(this->reaper, nullptr);
+
+	munmap(this->sqes, this->sqes_size);
+	if (this->cq_ring != this->sq_ring) {
+		munmap(this->cq_ring, this->cq_ring_size);
+	}
+	munmap(this->sq_ring, this->sq_ring_size);
+	::close(this->ring_fd);
+	this->ring_fd = -1;
+}
+
+bool IoRing::register_buffers(exo::Span<const exo::Span<u8>> buffers)
+{
+	EXO_PROFILE_SCOPE
+	ASSERT(this->registered_buffers_len == 0);
+	if (buffers.len() > MAX_REGISTERED_BUFFERS) {
+		return false;
+	}
+
+	iovec iovecs[MAX_REGISTERED_BUFFERS] = {};
+	for (usize i_buffer = 0; i_buffer < buffers.len(); ++i_buffer) {
+		iovecs[i_buffer].iov_base = buffers[i_buffer].data();
+		iovecs[i_buffer].iov_len  = buffers[i_buffer].len();
+	}
+
+	// Can fail when the buffers are bigger than RLIMIT_MEMLOCK, the reads will not use the fixed buffers then
+	const int res = io_uring_register(this->ring_fd, IORING_REGISTER_BUFFERS, iovecs, u32(buffers.len()));
+	if (res < 0) {
+		return false;
+	}
+
+	for (usize i_buffer = 0; i_buffer < buffers.len(); ++i_buffer) {
+		this->registered_buffers[i_buffer] = buffers[i_buffer];
+	}
+	this->registered_buffers_len = u32(buffers.len());
+	return true;
+}
+
+void IoRing::unregister_buffers()
+{
+	EXO_PROFILE_SCOPE
+	if (this->registered_buffers_len == 0) {
+		return;
+	}
+
+	io_uring_register(this->ring_fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+	this->registered_buffers_len = 0;
+}
+} // namespace cross
@@ -0,0 +1,69 @@
+#pragma once
+#include "exo/collections/span.h"
+#include "exo/maths/numerics.h"
+
+#include <atomic>
+#include <pthread.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace cross
+{
+struct ReadFileJob;
+
+/**
+   Minimal io_uring wrapper over the raw syscalls, used to batch file reads.
+   Any thread can submit under the submission lock, a dedicated thread reaps the completion queue and completes the
+   Waitable counters of the read jobs.
+ **/
+struct IoRing
+{
+	static constexpr u32 SQ_ENTRIES = 256;
+	static constexpr u32 CQ_ENTRIES = 4096;
+	// The length of a read sqe is 32-bit, bigger reads are split and resubmitted on completion
+	static constexpr usize MAX_READ_SIZE = 1_GiB;
+	static constexpr u32   MAX_REGISTERED_BUFFERS = 64;
+
+	int ring_fd = -1;
+
+	// submission queue
+	std::atomic<u32> *sq_head    = nullptr;
+	std::atomic<u32> *sq_tail    = nullptr;
+	u32               sq_mask    = 0;
+	u32              *sq_array   = nullptr;
+	io_uring_sqe     *sqes       = nullptr;
+	u32               sq_pending = 0;
+
+	// completion queue
+	std::atomic<u32> *cq_head = nullptr;
+	std::atomic<u32> *cq_tail = nullptr;
+	u32               cq_mask = 0;
+	io_uring_cqe     *cqes    = nullptr;
+
+	// mappings
+	void *sq_ring      = nullptr;
+	usize sq_ring_size = 0;
+	void *cq_ring      = nullptr;
+	usize cq_ring_size = 0;
+	usize sqes_size    = 0;
+
+	// registered buffers
+	exo::Span<u8> registered_buffers[MAX_REGISTERED_BUFFERS] = {};
+	u32           registered_buffers_len = 0;
+
+	std::atomic_flag  submit_lock = ATOMIC_FLAG_INIT;
+	std::atomic<bool> stop        = false;
+	pthread_t         reaper      = {};
+
+	// --
+	static IoRing *create();
+	void           destroy();
+
+	bool register_buffers(exo::Span<const exo::Span<u8>> buffers);
+	void unregister_buffers();
+
+	// Queue the (remaining part of the) read and submit it, the job must be alive until its counter is completed.
+	void submit_reads(exo::Span<ReadFileJob *const> jobs);
+};
+} // namespace cross
@@ -0,0 +1,139 @@
+#include "cross/jobs/readfiles.h"
+
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+
+#include "cross/jobmanager.h"
+#include "cross/jobs/waitable.h"
+
+#include "jobmanager_linux.h"
+#include "jobs/io_ring_linux.h"
+#include "jobs/readfiles_linux.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cross
+{
+// O_DIRECT needs the destination, the offset and the size aligned to the logical block size of the device
+inline constexpr usize DIRECT_IO_ALIGNMENT = 4096;
+
+static bool is_direct_io_aligned(const ReadFileJobDesc &job_desc)
+{
+	const auto address = reinterpret_cast<usize>(job_desc.dst.data());
+	return (address % DIRECT_IO_ALIGNMENT) == 0 && (job_desc.offset % DIRECT_IO_ALIGNMENT) == 0 &&
+	       (job_desc.size % DIRECT_IO_ALIGNMENT) == 0;
+}
+
+static u32 find_registered_buffer(const IoRing &io_ring, exo::Span<u8> dst)
+{
+	for (u32 i_buffer = 0; i_buffer < io_ring.registered_buffers_len; ++i_buffer) {
+		const auto &buffer = io_ring.registered_buffers[i_buffer];
+		if (buffer.data() <= dst.data() && dst.data() + dst.len() <= buffer.data() + buffer.len()) {
+			return i_buffer;
+		}
+	}
+	return u32_invalid;
+}
+
+std::unique_ptr<Waitable> read_files(const JobManager &jobmanager, exo::Span<const ReadFileJobDesc> job_descs)
+{
+	EXO_PROFILE_SCOPE
+	auto *io_ring = jobmanager.impl.get().queues->io_ring;
+
+	auto waitable = std::make_unique<Waitable>();
+	waitable->jobs.reserve(u32(job_descs.len()));
+
+	// Reads are submitted to the ring in batches
+	ReadFileJob *batch[IoRing::SQ_ENTRIES];
+	u32          batch_len = 0;
+
+	for (const auto &job_desc : job_descs) {
+		EXO_PROFILE_SCOPE_NAMED("Prepare job")
+
+		auto  job          = std::make_shared<ReadFileJob>(ReadFileJob{.done_counter = &waitable->jobs_finished});
+		auto &readjob_impl = job->readfilejob_impl.get();
+		readjob_impl       = {}; // the forward container is only zero-initialized
+
+		ASSERT(job_desc.size <= job_desc.dst.len());
+		job->type           = ReadFileJob::TASK_TYPE;
+		job->path           = job_desc.path;
+		job->size           = job_desc.size;
+		job->dst            = job_desc.dst;
+		readjob_impl.offset = job_desc.offset;
+
+		if (io_ring) {
+			EXO_PROFILE_SCOPE_NAMED("Open file")
+			if (is_direct_io_aligned(job_desc)) {
+				readjob_impl.fd = ::open(job_desc.path.data(), O_RDONLY | O_DIRECT);
+			}
+			// Some filesystems (tmpfs for example) do not support O_DIRECT
+			if (readjob_impl.fd < 0) {
+				readjob_impl.fd = ::open(job_desc.path.data(), O_RDONLY);
+			}
+			ASSERT(readjob_impl.fd >= 0);
+
+			readjob_impl.buffer_index = find_registered_buffer(*io_ring, job_desc.dst);
+
+			batch[batch_len++] = job.get();
+			if (batch_len == IoRing::SQ_ENTRIES) {
+				io_ring->submit_reads(exo::Span<ReadFileJob *const>(batch, batch_len));
+				batch_len = 0;
+			}
+		} else {
+			jobmanager.queue_job(*job);
+		}
+
+		waitable->jobs.push(std::move(job));
+	}
+
+	if (batch_len > 0) {
+		io_ring->submit_reads(exo::Span<ReadFileJob *const>(batch, batch_len));
+	}
+
+	return waitable;
+}
+
+bool register_read_buffers(const JobManager &jobmanager, exo::Span<const exo::Span<u8>> buffers)
+{
+	auto *io_ring = jobmanager.impl.get().queues->io_ring;
+	return io_ring && io_ring->register_buffers(buffers);
+}
+
+void unregister_read_buffers(const JobManager &jobmanager)
+{
+	auto *io_ring = jobmanager.impl.get().queues->io_ring;
+	if (io_ring) {
+		io_ring->unregister_buffers();
+	}
+}
+
+// Fallback when io_uring is not available
+void worker_thread_read_file(ReadFileJob &job)
+{
+	EXO_PROFILE_SCOPE
+	const auto &readjob_impl = job.readfilejob_impl.get();
+
+	int fd = -1;
+	{
+		EXO_PROFILE_SCOPE_NAMED("Open file")
+		fd = ::open(job.path.data(), O_RDONLY);
+		ASSERT(fd >= 0);
+	}
+
+	ASSERT(job.size <= job.dst.len());
+	usize read_size = 0;
+	while (read_size < job.size) {
+		const auto res = pread(fd, job.dst.data() + read_size, job.size - read_size, off_t(readjob_impl.offset + read_size));
+		ASSERT(res >= 0);
+		if (res <= 0) {
+			// end of file
+			break;
+		}
+		read_size += usize(res);
+	}
+
+	::close(fd);
+	__atomic_fetch_add(job.done_counter, 1, __ATOMIC_ACQ_REL);
+}
+} // namespace cross
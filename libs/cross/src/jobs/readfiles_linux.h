@@ -0,0 +1,17 @@
+#pragma once
+#include "cross/jobs/job.h"
+#include "cross/jobs/readfiles.h"
+
+namespace cross
+{
+struct ReadFileJob::Impl
+{
+	usize offset       = 0;
+	usize bytes_read   = 0;
+	int   fd           = -1;
+	u32   buffer_index = u32_invalid; // index of the registered buffer containing dst
+};
+
+// Executed by a worker thread when it dequeues a ReadFileJob
+void worker_thread_read_file(ReadFileJob &job);
+} // namespace cross
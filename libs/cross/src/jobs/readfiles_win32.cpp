@@ -65,4 +65,12 @@ std::unique_ptr<Waitable> read_files(const JobManager &jobmanager, exo::Span<con
 
 	return waitable;
 }
+
+bool register_read_buffers(const JobManager & /*jobmanager*/, exo::Span<const exo::Span<u8>> /*buffers*/)
+{
+	// Overlapped reads with FILE_FLAG_NO_BUFFERING already go directly to the destination
+	return false;
+}
+
+void unregister_read_buffers(const JobManager & /*jobmanager*/) {}
 } // namespace cross
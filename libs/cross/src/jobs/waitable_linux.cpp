@@ -0,0 +1,44 @@
+#include "cross/jobs/waitable.h"
+
+#include "exo/profile.h"
+
+#include "jobmanager_linux.h"
+
+#include <sched.h>
+
+namespace cross
+{
+// Number of spins before yielding the thread while waiting
+inline constexpr u32 WAIT_SPIN_COUNT = 256;
+
+static bool try_complete(Waitable &waitable)
+{
+	const i64 comperand = i64(waitable.jobs.len());
+	const i64 done      = comperand + 1;
+	i64       expected  = comperand;
+	const bool exchanged = __atomic_compare_exchange_n(
+		&waitable.jobs_finished, &expected, done, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	return exchanged || expected == done;
+}
+
+void Waitable::wait()
+{
+	EXO_PROFILE_SCOPE
+
+	for (u32 i_spin = 0; !try_complete(*this); ++i_spin) {
+		if (worker_help_one_job()) {
+			i_spin = 0;
+		} else if (i_spin < WAIT_SPIN_COUNT) {
+			cpu_relax();
+		} else {
+			sched_yield();
+		}
+	}
+}
+
+bool Waitable::is_done()
+{
+	EXO_PROFILE_SCOPE
+	return try_complete(*this);
+}
+} // namespace cross
@@ -2,21 +2,35 @@
 
 #include "exo/profile.h"
 
+#include "jobmanager_win32.h"
+
 #include <windows.h>
 
 namespace cross
 {
+// Number of spins before yielding the thread while waiting
+inline constexpr u32 WAIT_SPIN_COUNT = 256;
+
 void Waitable::wait()
 {
 	EXO_PROFILE_SCOPE
 
 	const int comperand = int(this->jobs.len());
 	const int done      = comperand + 1;
-	while (true) {
+	for (u32 i_spin = 0;; ++i_spin) {
 		auto res = InterlockedCompareExchange64(&this->jobs_finished, done, comperand);
 		if (res == done) {
 			break;
 		}
+
+		// A job waiting on the jobs it queued would deadlock once every worker waits, run them from here
+		if (worker_help_one_job()) {
+			i_spin = 0;
+		} else if (i_spin < WAIT_SPIN_COUNT) {
+			YieldProcessor();
+		} else {
+			SwitchToThread();
+		}
 	}
 }
 
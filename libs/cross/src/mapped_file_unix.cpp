@@ -1,67 +1,159 @@
 #include "cross/mapped_file.h"
+
+#include "exo/macros/assert.h"
+
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <utility>
 
 namespace cross
 {
-MappedFile::MappedFile(MappedFile &&moved) noexcept { *this = std::move(moved); }
-
-MappedFile::~MappedFile()
+static usize get_page_size()
 {
-	if (this->fd > 0) {
-		this->close();
-	}
+	static const usize page_size = usize(sysconf(_SC_PAGESIZE));
+	return page_size;
 }
 
+MappedFile::MappedFile(MappedFile &&moved) noexcept { *this = std::move(moved); }
+
+MappedFile::~MappedFile() { this->close(); }
+
 MappedFile &MappedFile::operator=(MappedFile &&moved) noexcept
 {
 	if (this != &moved) {
-		fd = moved.fd;
-		base_addr = moved.base_addr;
-		size = moved.size;
-
-		moved.fd = -1;
-		moved.base_addr = nullptr;
-		moved.size = 0;
+		this->close();
+		this->view      = std::exchange(moved.view, nullptr);
+		this->view_size = std::exchange(moved.view_size, 0);
+		this->base_addr = std::exchange(moved.base_addr, nullptr);
+		this->size      = std::exchange(moved.size, 0);
+		this->access    = moved.access;
 	}
 	return *this;
 }
 
-Option<MappedFile> MappedFile::open(const exo::StringView &path)
+static Option<MappedFile> map_fd(int fd, usize offset, usize size, MappedFileAccess access)
 {
 	MappedFile file{};
+	file.access = access;
+	file.size   = size;
 
-	file.fd = -1;
-	file.size = 0;
-	file.base_addr = nullptr;
+	if (size == 0) {
+		// mmap does not accept empty mappings
+		return file;
+	}
 
-	int res = 0;
+	const usize page_offset = offset % get_page_size();
+	file.view_size          = page_offset + size;
 
-	res = ::open(path.data(), O_RDONLY);
-	if (res < 0) {
+	const int prot = access == MappedFileAccess::ReadWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+	void     *view = mmap(nullptr, file.view_size, prot, MAP_SHARED, fd, off_t(offset - page_offset));
+	if (view == MAP_FAILED) {
 		return {};
 	}
 
-	file.fd = res;
+	file.view      = view;
+	file.base_addr = static_cast<const u8 *>(view) + page_offset;
+	return file;
+}
+
+Option<MappedFile> MappedFile::open(const exo::StringView &path)
+{
+	return MappedFile::open_range(path, 0, 0, MappedFileAccess::ReadOnly);
+}
+
+Option<MappedFile> MappedFile::open_range(
+	const exo::StringView &path, usize offset, usize size, MappedFileAccess access)
+{
+	const int fd = ::open(path.data(), access == MappedFileAccess::ReadWrite ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
+		return {};
+	}
 
 	struct stat file_stat = {};
-	res = fstat(file.fd, &file_stat);
-	if (res < 0) {
+	if (fstat(fd, &file_stat) < 0) {
+		::close(fd);
+		return {};
+	}
+
+	const usize file_size = usize(file_stat.st_size);
+	if (offset > file_size || (size != 0 && offset + size > file_size)) {
+		::close(fd);
 		return {};
 	}
+	if (size == 0) {
+		size = file_size - offset;
+	}
 
-	file.size = file_stat.st_size;
+	// The mapping keeps a reference to the file, the descriptor is not needed anymore
+	auto file = map_fd(fd, offset, size, access);
+	::close(fd);
+	return file;
+}
 
-	file.base_addr = mmap(nullptr, file.size, PROT_READ, 0, file.fd, 0);
-	if (reinterpret_cast<isize>(file.base_addr) < 0) {
+Option<MappedFile> MappedFile::create(const exo::StringView &path, usize size)
+{
+	const int fd = ::open(path.data(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
 		return {};
 	}
 
+	if (ftruncate(fd, off_t(size)) < 0) {
+		::close(fd);
+		return {};
+	}
+
+	auto file = map_fd(fd, 0, size, MappedFileAccess::ReadWrite);
+	::close(fd);
 	return file;
 }
 
-void MappedFile::close() { ::close(fd); }
+void MappedFile::advise(MappedFileHints hints) { this->advise_range(0, this->size, hints); }
+
+void MappedFile::advise_range(usize offset, usize advised_size, MappedFileHints hints)
+{
+	if (!this->view) {
+		return;
+	}
+	ASSERT(offset + advised_size <= this->size);
+
+	// madvise needs a page aligned address
+	const auto  view_offset = usize(static_cast<const u8 *>(this->base_addr) - static_cast<const u8 *>(this->view));
+	const usize start       = view_offset + offset;
+	const usize page_start  = start - (start % get_page_size());
+	u8         *address     = static_cast<u8 *>(this->view) + page_start;
+	const usize length      = start + advised_size - page_start;
+
+	// The hints are best effort, the errors are ignored
+	if (hints.sequential) {
+		madvise(address, length, MADV_SEQUENTIAL);
+	}
+	if (hints.will_need) {
+		madvise(address, length, MADV_WILLNEED);
+	}
+	if (hints.huge_pages) {
+		madvise(address, length, MADV_HUGEPAGE);
+	}
+}
+
+void MappedFile::flush()
+{
+	if (this->view && this->access == MappedFileAccess::ReadWrite) {
+		auto res = msync(this->view, this->view_size, MS_SYNC);
+		ASSERT(res == 0);
+	}
+}
+
+void MappedFile::close()
+{
+	if (this->view) {
+		munmap(this->view, this->view_size);
+	}
+	this->view      = nullptr;
+	this->view_size = 0;
+	this->base_addr = nullptr;
+	this->size      = 0;
+}
 }; // namespace cross
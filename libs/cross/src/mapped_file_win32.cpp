@@ -1,12 +1,19 @@
 #include "cross/mapped_file.h"
 
-#include "utils_win32.h"
 #include "exo/macros/defer.h"
+#include "utils_win32.h"
 
 #include <windows.h>
 
 namespace cross
 {
+static usize get_allocation_granularity()
+{
+	SYSTEM_INFO system_info;
+	GetSystemInfo(&system_info);
+	return system_info.dwAllocationGranularity;
+}
+
 MappedFile::MappedFile(MappedFile &&moved) noexcept { *this = std::move(moved); }
 
 MappedFile::~MappedFile() { this->close(); }
@@ -14,49 +21,154 @@ MappedFile::~MappedFile() { this->close(); }
 MappedFile &MappedFile::operator=(MappedFile &&moved) noexcept
 {
 	if (this != &moved) {
-		this->base_addr = std::exchange(moved.base_addr, nullptr);
+		this->close();
 		this->mapping   = std::exchange(moved.mapping, nullptr);
+		this->view      = std::exchange(moved.view, nullptr);
+		this->view_size = std::exchange(moved.view_size, 0);
+		this->base_addr = std::exchange(moved.base_addr, nullptr);
 		this->size      = std::exchange(moved.size, 0);
+		this->access    = moved.access;
 	}
 	return *this;
 }
 
-Option<MappedFile> MappedFile::open(const exo::StringView &path)
+static Option<MappedFile> map_handle(HANDLE fd, usize offset, usize size, MappedFileAccess access)
 {
 	MappedFile file{};
+	file.access = access;
+	file.size   = size;
 
-	auto utf16_path = utils::utf8_to_utf16(path);
+	if (size == 0) {
+		// CreateFileMapping does not accept empty files
+		return file;
+	}
+
+	const bool writable = access == MappedFileAccess::ReadWrite;
+	file.mapping        = CreateFileMapping(fd, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+	if (!utils::is_handle_valid(file.mapping)) {
+		file.mapping = nullptr;
+		return {};
+	}
+
+	const usize granularity_offset = offset % get_allocation_granularity();
+	const u64   view_offset        = offset - granularity_offset;
+	file.view_size                 = granularity_offset + size;
+
+	file.view = MapViewOfFile(file.mapping,
+		writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+		DWORD(view_offset >> 32),
+		DWORD(view_offset),
+		file.view_size);
+	if (!file.view) {
+		return {};
+	}
+
+	file.base_addr = static_cast<const u8 *>(file.view) + granularity_offset;
+	return file;
+}
+
+Option<MappedFile> MappedFile::open(const exo::StringView &path)
+{
+	return MappedFile::open_range(path, 0, 0, MappedFileAccess::ReadOnly);
+}
+
+Option<MappedFile> MappedFile::open_range(
+	const exo::StringView &path, usize offset, usize size, MappedFileAccess access)
+{
+	const bool writable   = access == MappedFileAccess::ReadWrite;
+	auto       utf16_path = utils::utf8_to_utf16(path);
 
-	auto fd = CreateFile(utf16_path.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	// Files can be mapped while another handle appends to them (blob archive)
+	auto fd = CreateFile(utf16_path.c_str(),
+		writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr);
 	if (!utils::is_handle_valid(fd)) {
 		return {};
 	}
 	DEFER { CloseHandle(fd); };
 
-	DWORD       hi = 0;
-	const DWORD lo = GetFileSize(fd, &hi);
-	file.size      = ((u64)hi << 32) | (u64)lo;
+	DWORD       hi        = 0;
+	const DWORD lo        = GetFileSize(fd, &hi);
+	const usize file_size = ((u64)hi << 32) | (u64)lo;
 
-	file.mapping = CreateFileMapping(fd, nullptr, PAGE_READONLY, 0, 0, nullptr);
-	if (!utils::is_handle_valid(file.mapping)) {
+	if (offset > file_size || (size != 0 && offset + size > file_size)) {
 		return {};
 	}
+	if (size == 0) {
+		size = file_size - offset;
+	}
 
-	file.base_addr = MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0);
-	if (!file.base_addr) {
+	return map_handle(fd, offset, size, access);
+}
+
+Option<MappedFile> MappedFile::create(const exo::StringView &path, usize size)
+{
+	auto utf16_path = utils::utf8_to_utf16(path);
+
+	auto fd = CreateFile(utf16_path.c_str(),
+		GENERIC_READ | GENERIC_WRITE,
+		0,
+		nullptr,
+		CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr);
+	if (!utils::is_handle_valid(fd)) {
 		return {};
 	}
+	DEFER { CloseHandle(fd); };
 
-	return file;
+	LARGE_INTEGER file_size = {};
+	file_size.QuadPart      = LONGLONG(size);
+	if (!SetFilePointerEx(fd, file_size, nullptr, FILE_BEGIN) || !SetEndOfFile(fd)) {
+		return {};
+	}
+
+	return map_handle(fd, 0, size, MappedFileAccess::ReadWrite);
+}
+
+void MappedFile::advise(MappedFileHints hints) { this->advise_range(0, this->size, hints); }
+
+void MappedFile::advise_range(usize offset, usize advised_size, MappedFileHints hints)
+{
+	if (!this->view) {
+		return;
+	}
+	ASSERT(offset + advised_size <= this->size);
+
+	// There is no read-ahead policy for views and file mappings cannot use large pages, prefetching is the only
+	// hint that applies.
+	if (hints.sequential || hints.will_need) {
+		WIN32_MEMORY_RANGE_ENTRY range = {};
+		range.VirtualAddress           = const_cast<u8 *>(static_cast<const u8 *>(this->base_addr) + offset);
+		range.NumberOfBytes            = advised_size;
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+}
+
+void MappedFile::flush()
+{
+	if (this->view && this->access == MappedFileAccess::ReadWrite) {
+		auto res = FlushViewOfFile(this->view, this->view_size);
+		ASSERT(res);
+	}
 }
 
 void MappedFile::close()
 {
-	if (base_addr) {
-		UnmapViewOfFile(this->base_addr);
+	if (this->view) {
+		UnmapViewOfFile(this->view);
+	}
+	if (this->mapping) {
 		CloseHandle(this->mapping);
-		this->base_addr = nullptr;
-		this->mapping   = nullptr;
 	}
+	this->mapping   = nullptr;
+	this->view      = nullptr;
+	this->view_size = 0;
+	this->base_addr = nullptr;
+	this->size      = 0;
 }
 }; // namespace cross
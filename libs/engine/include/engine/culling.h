@@ -0,0 +1,95 @@
+#pragma once
+#include "exo/collections/span.h"
+#include "exo/collections/vector.h"
+#include "exo/maths/aabb.h"
+#include "exo/maths/matrices.h"
+#include "exo/maths/numerics.h"
+#include "exo/maths/vectors.h"
+
+namespace cross
+{
+struct JobManager;
+}
+
+// A point p is inside the frustum when dot(plane.xyz, p) + plane.w >= 0 for all its planes
+struct Frustum
+{
+	float4 planes[6] = {};
+	u32    planes_len = 0; // degenerate planes are left out, e.g. the far plane of an infinite projection
+};
+
+// Extracts the planes of the clip volume (-w <= x, y <= w and 0 <= z <= w) in the space before `view_projection`
+Frustum frustum_from_matrix(const float4x4 &view_projection);
+
+// Bounds of the instances as one array per coordinate to test several instances at once.
+// Empty bounds (min > max) are never visible.
+struct InstanceBounds
+{
+	Vec<float> min_x = {};
+	Vec<float> min_y = {};
+	Vec<float> min_z = {};
+	Vec<float> max_x = {};
+	Vec<float> max_y = {};
+	Vec<float> max_z = {};
+
+	void destroy();
+	void resize(u32 new_len); // new instances have empty bounds
+	void set(u32 i_instance, const exo::AABB &bounds);
+	u32  len() const { return min_x.len(); }
+};
+
+// Coarse depth buffer of the occluders, stores 1/w of the nearest occluder, 0 where there is none
+struct OcclusionBuffer
+{
+	int2       size   = {};
+	Vec<float> depths = {};
+};
+
+struct CullingSettings
+{
+	// The bounds of the occluders are rasterized in the occlusion buffer, they have to be solid. Occlusion is
+	// skipped without occluders.
+	bool                 occlusion             = false;
+	int2                 occlusion_buffer_size = int2(256, 128);
+	exo::Span<const u32> occluders             = {};
+};
+
+struct CullingStats
+{
+	u32    tested_instances  = 0;
+	u32    frustum_culled    = 0;
+	u32    occlusion_culled  = 0;
+	u32    occluders         = 0; // rasterized occluders
+	u32    visible_instances = 0;
+	double frustum_ms        = 0.0;
+	double occlusion_ms      = 0.0;
+};
+
+struct CullingChunk
+{
+	u32 begin            = 0;
+	u32 end              = 0;
+	u32 visible          = 0;
+	u32 frustum_culled   = 0;
+	u32 occlusion_culled = 0;
+};
+
+// Output of the culling, the buffers are reused between frames
+struct CullingResult
+{
+	Vec<u32>          visible_instances = {}; // sorted
+	Vec<u8>           visibility        = {}; // per instance
+	Vec<CullingChunk> chunks            = {};
+	OcclusionBuffer   occlusion_buffer  = {};
+	CullingStats      stats             = {};
+
+	void destroy();
+};
+
+// Tests the bounds against the frustum of `view_projection`, and optionally against the occlusion buffer, the chunks
+// of instances are tested in parallel when `jobmanager` is not null
+void cull_instances(const InstanceBounds &bounds,
+	const float4x4                       &view_projection,
+	const CullingSettings                &settings,
+	const cross::JobManager              *jobmanager,
+	CullingResult                        &result);
@@ -1,10 +1,14 @@
 #pragma once
 #include "exo/collections/map.h"
+#include "exo/collections/span.h"
 #include "exo/collections/vector.h"
 #include "exo/maths/aabb.h"
 #include "exo/maths/matrices.h"
 
 #include "assets/asset_id.h"
+#include "assets/bvh.h"
+
+#include "engine/culling.h"
 
 struct DrawableInstance
 {
@@ -13,6 +17,13 @@ struct DrawableInstance
 	exo::AABB world_bounds;
 };
 
+// Slots [begin, end) of the drawable instances
+struct InstanceRange
+{
+	u32 begin = 0;
+	u32 end   = 0;
+};
+
 // Description of the world that the renderer will use
 struct RenderWorld
 {
@@ -23,5 +34,31 @@ struct RenderWorld
 	float4x4 main_camera_projection_inverse;
 	float    main_camera_fov;
 
+	// An instance keeps its slot until it is removed, free slots have an invalid mesh asset and get reused
 	Vec<DrawableInstance> drawable_instances;
+	// Leaves are indices into drawable_instances
+	Vec<BVHNode> tlas;
+	// Bounds of the drawable instances, free slots have empty bounds
+	InstanceBounds instance_bounds;
+	// Instances left by the culling stage, it runs once the camera matrices are final
+	CullingResult culling;
+
+	// Changes of the instances during the last update, consumers that missed an update (update_index is not the
+	// next one) have to read all the slots again
+	u64                update_index          = 0;
+	Vec<u32>           added_instances       = {};
+	Vec<u32>           removed_instances     = {};
+	Vec<InstanceRange> dirty_instance_ranges = {}; // sorted slots of the added and modified instances
+
+	// --
+	// Slots to read for a consumer whose last read update is `last_update_index`, the dirty ranges of the last update
+	// or all the slots (stored in `all_instances`) when it missed one
+	exo::Span<const InstanceRange> get_ranges_to_read(u64 last_update_index, InstanceRange &all_instances) const
+	{
+		if (this->update_index == last_update_index + 1) {
+			return this->dirty_instance_ranges;
+		}
+		all_instances = InstanceRange{.begin = 0, .end = this->drawable_instances.len()};
+		return exo::Span<const InstanceRange>(&all_instances, 1);
+	}
 };
@@ -8,6 +8,7 @@
 struct RenderWorld;
 struct MeshComponent;
 struct CameraComponent;
+struct TransformHierarchy;
 
 struct PrepareRenderWorld : GlobalSystem
 {
@@ -28,6 +29,27 @@ struct PrepareRenderWorld : GlobalSystem
 	RenderWorld render_world;
 
 private:
-	CameraComponent                          *main_camera;
-	exo::Map<const Entity *, MeshComponent *> entities;
+	void mark_instance_dirty(u32 i_instance);
+	void extract_instance(u32 i_instance, const MeshComponent &mesh_component);
+
+	CameraComponent *main_camera = nullptr;
+
+	// Mesh components registered since the last update, and slots of the unregistered ones
+	Vec<MeshComponent *> added_components  = {};
+	Vec<u32>             removed_instances = {};
+
+	// Only the instances of the added components and of the nodes that changed in the transform hierarchy are
+	// extracted
+	exo::Map<const MeshComponent *, u32> component_to_instance      = {};
+	Vec<MeshComponent *>                 instance_components        = {}; // null for free slots
+	Vec<u32>                             instance_transform_nodes   = {};
+	Vec<u32>                             transform_node_to_instance = {}; // u32_invalid for nodes without instance
+	Vec<u32>                             free_instances             = {};
+	Vec<u32>                             dirty_instances            = {};
+	Vec<u8>                              is_instance_dirty          = {};
+	TransformHierarchy                  *transform_hierarchy        = nullptr;
+
+	// The TLAS is refitted unless mesh components were added or removed
+	bool           rebuild_tlas    = true;
+	Vec<exo::AABB> instance_bounds = {};
 };
@@ -0,0 +1,530 @@
+#include "engine/culling.h"
+
+#include "cross/jobmanager.h"
+#include "cross/jobs/foreach.h"
+#include "cross/jobs/waitable.h"
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+#include "exo/timer.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+#include <iterator>
+#include <limits>
+
+// Instances are tested in chunks, a chunk is a job
+static constexpr u32 CHUNK_SIZE = 4096;
+// Boxes with a corner closer to the camera plane are not projected: they are never occluded and never occlude
+static constexpr float OCCLUSION_MIN_W = 1e-3f;
+
+struct CullingContext
+{
+	const InstanceBounds  *bounds;
+	const Frustum         *frustum;
+	const OcclusionBuffer *occlusion_buffer;
+	float4x4               view_projection;
+	u8                    *visibility;
+	u32                   *visible_instances; // a chunk writes its visible instances from its first index
+};
+
+// -- Bounds
+
+void InstanceBounds::destroy()
+{
+	min_x.buffer.destroy();
+	min_y.buffer.destroy();
+	min_z.buffer.destroy();
+	max_x.buffer.destroy();
+	max_y.buffer.destroy();
+	max_z.buffer.destroy();
+}
+
+void InstanceBounds::resize(u32 new_len)
+{
+	const float inf = std::numeric_limits<float>::infinity();
+	min_x.resize(new_len, inf);
+	min_y.resize(new_len, inf);
+	min_z.resize(new_len, inf);
+	max_x.resize(new_len, -inf);
+	max_y.resize(new_len, -inf);
+	max_z.resize(new_len, -inf);
+}
+
+void InstanceBounds::set(u32 i_instance, const exo::AABB &bounds)
+{
+	min_x[i_instance] = bounds.min.x;
+	min_y[i_instance] = bounds.min.y;
+	min_z[i_instance] = bounds.min.z;
+	max_x[i_instance] = bounds.max.x;
+	max_y[i_instance] = bounds.max.y;
+	max_z[i_instance] = bounds.max.z;
+}
+
+static exo::AABB get_bounds(const InstanceBounds &bounds, u32 i_instance)
+{
+	return exo::AABB{
+		.min = float3(bounds.min_x[i_instance], bounds.min_y[i_instance], bounds.min_z[i_instance]),
+		.max = float3(bounds.max_x[i_instance], bounds.max_y[i_instance], bounds.max_z[i_instance]),
+	};
+}
+
+void CullingResult::destroy()
+{
+	visible_instances.buffer.destroy();
+	visibility.buffer.destroy();
+	chunks.buffer.destroy();
+	occlusion_buffer.depths.buffer.destroy();
+}
+
+// -- Frustum
+
+Frustum frustum_from_matrix(const float4x4 &view_projection)
+{
+	const auto row = [&](usize i_row) {
+		return float4(view_projection.at(i_row, 0),
+			view_projection.at(i_row, 1),
+			view_projection.at(i_row, 2),
+			view_projection.at(i_row, 3));
+	};
+	const float4 x = row(0);
+	const float4 y = row(1);
+	const float4 z = row(2);
+	const float4 w = row(3);
+
+	const float4 clip_planes[] = {w + x, w - x, w + y, w - y, z, w - z};
+
+	Frustum frustum = {};
+	for (const auto &plane : clip_planes) {
+		const float normal_length = exo::length(plane.xyz());
+		if (normal_length < 1e-6f) {
+			continue;
+		}
+		frustum.planes[frustum.planes_len] = (1.0f / normal_length) * plane;
+		frustum.planes_len += 1;
+	}
+	return frustum;
+}
+
+// Writes the visible instances of [begin, end) to `out_visible` and returns their count. A box is outside when its
+// corner that is the farthest along the normal of a plane is behind it, that corner only depends on the plane so the
+// test reads the bounds directly.
+static u32 frustum_cull_range(
+	const InstanceBounds &bounds, const Frustum &frustum, u32 begin, u32 end, u8 *visibility, u32 *out_visible)
+{
+	const float *xs[6];
+	const float *ys[6];
+	const float *zs[6];
+	for (u32 i_plane = 0; i_plane < frustum.planes_len; ++i_plane) {
+		const float4 &plane = frustum.planes[i_plane];
+		xs[i_plane]         = plane.x >= 0.0f ? bounds.max_x.data() : bounds.min_x.data();
+		ys[i_plane]         = plane.y >= 0.0f ? bounds.max_y.data() : bounds.min_y.data();
+		zs[i_plane]         = plane.z >= 0.0f ? bounds.max_z.data() : bounds.min_z.data();
+	}
+
+	// The comparisons are ordered: NaN distances of empty bounds are outside
+	u32 visible    = 0;
+	u32 i_instance = begin;
+#if defined(__AVX__)
+	for (; i_instance + 8 <= end; i_instance += 8) {
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (u32 i_plane = 0; i_plane < frustum.planes_len; ++i_plane) {
+			const float4 &plane = frustum.planes[i_plane];
+			const __m256  x     = _mm256_loadu_ps(xs[i_plane] + i_instance);
+			const __m256  y     = _mm256_loadu_ps(ys[i_plane] + i_instance);
+			const __m256  z     = _mm256_loadu_ps(zs[i_plane] + i_instance);
+
+			__m256 distance = _mm256_set1_ps(plane.w);
+			distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.x), x));
+			distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.y), y));
+			distance        = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), z));
+			inside          = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		const u32 mask = u32(_mm256_movemask_ps(inside));
+		for (u32 i_lane = 0; i_lane < 8; ++i_lane) {
+			visibility[i_instance + i_lane] = u8((mask >> i_lane) & 1);
+		}
+		for (u32 lanes = mask; lanes != 0; lanes &= lanes - 1) {
+			out_visible[visible] = i_instance + u32(std::countr_zero(lanes));
+			visible += 1;
+		}
+	}
+#endif
+	for (; i_instance + 4 <= end; i_instance += 4) {
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (u32 i_plane = 0; i_plane < frustum.planes_len; ++i_plane) {
+			const float4 &plane = frustum.planes[i_plane];
+			const __m128  x     = _mm_loadu_ps(xs[i_plane] + i_instance);
+			const __m128  y     = _mm_loadu_ps(ys[i_plane] + i_instance);
+			const __m128  z     = _mm_loadu_ps(zs[i_plane] + i_instance);
+
+			__m128 distance = _mm_set1_ps(plane.w);
+			distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.x), x));
+			distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), y));
+			distance        = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), z));
+			inside          = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+		}
+
+		const u32 mask = u32(_mm_movemask_ps(inside));
+		for (u32 i_lane = 0; i_lane < 4; ++i_lane) {
+			visibility[i_instance + i_lane] = u8((mask >> i_lane) & 1);
+		}
+		for (u32 lanes = mask; lanes != 0; lanes &= lanes - 1) {
+			out_visible[visible] = i_instance + u32(std::countr_zero(lanes));
+			visible += 1;
+		}
+	}
+	for (; i_instance < end; ++i_instance) {
+		bool inside = true;
+		for (u32 i_plane = 0; i_plane < frustum.planes_len; ++i_plane) {
+			const float4 &plane    = frustum.planes[i_plane];
+			const float   distance = plane.x * xs[i_plane][i_instance] + plane.y * ys[i_plane][i_instance] +
+			                       plane.z * zs[i_plane][i_instance] + plane.w;
+			inside = inside && distance >= 0.0f;
+		}
+		visibility[i_instance] = u8(inside);
+		if (inside) {
+			out_visible[visible] = i_instance;
+			visible += 1;
+		}
+	}
+	return visible;
+}
+
+// -- Occlusion
+
+// Projects the corners of a box to (screen x, screen y, 1/w), the index of a corner has one bit per axis
+static bool project_box(const float4x4 &view_projection, const exo::AABB &box, int2 size, float3 (&corners)[8])
+{
+	// The clip position of a corner is the sum of the matrix columns scaled by its coordinates
+	const __m128 col_x[2] = {_mm_mul_ps(_mm_loadu_ps(&view_projection.col(0).x), _mm_set1_ps(box.min.x)),
+		_mm_mul_ps(_mm_loadu_ps(&view_projection.col(0).x), _mm_set1_ps(box.max.x))};
+	const __m128 col_y[2] = {_mm_mul_ps(_mm_loadu_ps(&view_projection.col(1).x), _mm_set1_ps(box.min.y)),
+		_mm_mul_ps(_mm_loadu_ps(&view_projection.col(1).x), _mm_set1_ps(box.max.y))};
+	const __m128 col_z[2] = {_mm_mul_ps(_mm_loadu_ps(&view_projection.col(2).x), _mm_set1_ps(box.min.z)),
+		_mm_mul_ps(_mm_loadu_ps(&view_projection.col(2).x), _mm_set1_ps(box.max.z))};
+	const __m128 col_w    = _mm_loadu_ps(&view_projection.col(3).x);
+
+	for (u32 i_corner = 0; i_corner < 8; ++i_corner) {
+		const __m128 clip_xy = _mm_add_ps(col_x[i_corner & 1], col_y[(i_corner >> 1) & 1]);
+		const __m128 clip_zw = _mm_add_ps(col_z[(i_corner >> 2) & 1], col_w);
+		float4       clip;
+		_mm_storeu_ps(&clip.x, _mm_add_ps(clip_xy, clip_zw));
+
+		if (!(clip.w >= OCCLUSION_MIN_W)) {
+			return false;
+		}
+		const float inv_w = 1.0f / clip.w;
+		corners[i_corner] = float3((clip.x * inv_w * 0.5f + 0.5f) * float(size.x),
+			(clip.y * inv_w * 0.5f + 0.5f) * float(size.y),
+			inv_w);
+	}
+	return true;
+}
+
+static float edge_function(float3 a, float3 b, float px, float py)
+{
+	return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+// Writes the depth of the pixels fully covered by a convex polygon of either winding, a pixel is covered when its four
+// corners are inside. The depth is interpolated on the plane of the first three vertices and taken at the farthest
+// corner of the pixel, so an occluder never hides more than it covers.
+static void rasterize_convex_polygon(OcclusionBuffer &buffer, const float3 *vertices, u32 vertices_len)
+{
+	ASSERT(3 <= vertices_len && vertices_len <= 8);
+	const float3 a    = vertices[0];
+	const float3 b    = vertices[1];
+	const float3 c    = vertices[2];
+	const float  area = edge_function(a, b, c.x, c.y);
+	if (area == 0.0f) {
+		return;
+	}
+
+	float min_x = a.x;
+	float max_x = a.x;
+	float min_y = a.y;
+	float max_y = a.y;
+	for (u32 i_vertex = 1; i_vertex < vertices_len; ++i_vertex) {
+		min_x = std::min(min_x, vertices[i_vertex].x);
+		max_x = std::max(max_x, vertices[i_vertex].x);
+		min_y = std::min(min_y, vertices[i_vertex].y);
+		max_y = std::max(max_y, vertices[i_vertex].y);
+	}
+
+	// Only the pixels inside the bounds can be fully covered
+	const i32 x0 = i32(std::max(std::ceil(min_x), 0.0f));
+	const i32 x1 = i32(std::min(std::floor(max_x), float(buffer.size.x)));
+	const i32 y0 = i32(std::max(std::ceil(min_y), 0.0f));
+	const i32 y1 = i32(std::min(std::floor(max_y), float(buffer.size.y)));
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	// An edge function is linear, its smallest value on a pixel is at the pixel center minus half of its gradient
+	// along each axis
+	const float orientation = area > 0.0f ? 1.0f : -1.0f;
+	float       edge_margins[8];
+	for (u32 i_edge = 0; i_edge < vertices_len; ++i_edge) {
+		const float3 from    = vertices[i_edge];
+		const float3 to      = vertices[(i_edge + 1) % vertices_len];
+		edge_margins[i_edge] = 0.5f * (std::abs(to.x - from.x) + std::abs(to.y - from.y));
+	}
+
+	const float depth_dx     = ((b.y - c.y) * a.z + (c.y - a.y) * b.z + (a.y - b.y) * c.z) / area;
+	const float depth_dy     = ((c.x - b.x) * a.z + (a.x - c.x) * b.z + (b.x - a.x) * c.z) / area;
+	const float depth_margin = 0.5f * (std::abs(depth_dx) + std::abs(depth_dy));
+
+	for (i32 y = y0; y < y1; ++y) {
+		const float py = float(y) + 0.5f;
+		for (i32 x = x0; x < x1; ++x) {
+			const float px      = float(x) + 0.5f;
+			bool        covered = true;
+			for (u32 i_edge = 0; covered && i_edge < vertices_len; ++i_edge) {
+				const float3 from = vertices[i_edge];
+				const float3 to   = vertices[(i_edge + 1) % vertices_len];
+				covered           = orientation * edge_function(from, to, px, py) >= edge_margins[i_edge];
+			}
+			if (!covered) {
+				continue;
+			}
+
+			const float depth = a.z + depth_dx * (px - a.x) + depth_dy * (py - a.y) - depth_margin;
+			float      &pixel = buffer.depths[u32(y * buffer.size.x + x)];
+			pixel             = std::max(pixel, depth);
+		}
+	}
+}
+
+// Convex hull of the projected corners in counter-clockwise order (Andrew's monotone chain), returns its length
+static u32 convex_hull(const float3 (&corners)[8], float3 (&out_hull)[16])
+{
+	float3 points[8];
+	std::copy(std::begin(corners), std::end(corners), std::begin(points));
+	std::sort(std::begin(points), std::end(points), [](const float3 &lhs, const float3 &rhs) {
+		return lhs.x < rhs.x || (lhs.x == rhs.x && lhs.y < rhs.y);
+	});
+
+	// Drops the last points of the hull until `point` turns left
+	u32        len        = 0;
+	const auto push_point = [&](const float3 &point, u32 min_len) {
+		while (len >= min_len && edge_function(out_hull[len - 2], out_hull[len - 1], point.x, point.y) <= 0.0f) {
+			len -= 1;
+		}
+		out_hull[len++] = point;
+	};
+
+	// Lower hull from left to right, then upper hull from right to left
+	for (u32 i_point = 0; i_point < 8; ++i_point) {
+		push_point(points[i_point], 2);
+	}
+	const u32 lower_len = len + 1;
+	for (u32 i_point = 7; i_point-- > 0;) {
+		push_point(points[i_point], lower_len);
+	}
+	// The first point is repeated at the end
+	return len - 1;
+}
+
+static bool rasterize_box(OcclusionBuffer &buffer, const float4x4 &view_projection, const exo::AABB &box)
+{
+	float3 corners[8];
+	if (box.min.x > box.max.x || !project_box(view_projection, box, buffer.size, corners)) {
+		return false;
+	}
+
+	// Faces as quads of corners, they are rasterized whole as the pixels along a diagonal are not fully covered by
+	// either of its triangles
+	constexpr u32 faces[6][4] = {
+		{0, 2, 6, 4},
+		{1, 3, 7, 5},
+		{0, 1, 5, 4},
+		{2, 3, 7, 6},
+		{0, 1, 3, 2},
+		{4, 5, 7, 6},
+	};
+	for (const auto &face : faces) {
+		const float3 quad[4] = {corners[face[0]], corners[face[1]], corners[face[2]], corners[face[3]]};
+		rasterize_convex_polygon(buffer, quad, 4);
+	}
+
+	// The same goes for the pixels along the edges shared by two faces, the silhouette of the box covers them at the
+	// depth of its farthest corner
+	float3    silhouette[16];
+	const u32 silhouette_len = convex_hull(corners, silhouette);
+	if (silhouette_len >= 3) {
+		float farthest_depth = corners[0].z;
+		for (const auto &corner : corners) {
+			farthest_depth = std::min(farthest_depth, corner.z);
+		}
+		for (u32 i_vertex = 0; i_vertex < silhouette_len; ++i_vertex) {
+			silhouette[i_vertex].z = farthest_depth;
+		}
+		rasterize_convex_polygon(buffer, silhouette, silhouette_len);
+	}
+	return true;
+}
+
+// The nearest point of a box is one of its corners, it is occluded when the occluders are nearer in all the pixels
+// covered by its screen rectangle
+static bool is_occluded(const OcclusionBuffer &buffer, const float4x4 &view_projection, const exo::AABB &box)
+{
+	float3 corners[8];
+	if (!project_box(view_projection, box, buffer.size, corners)) {
+		return false;
+	}
+
+	float3 min = corners[0];
+	float3 max = corners[0];
+	for (const auto &corner : corners) {
+		for (u32 i_axis = 0; i_axis < 3; ++i_axis) {
+			min[i_axis] = std::min(min[i_axis], corner[i_axis]);
+			max[i_axis] = std::max(max[i_axis], corner[i_axis]);
+		}
+	}
+	if (max.x <= 0.0f || max.y <= 0.0f || min.x >= float(buffer.size.x) || min.y >= float(buffer.size.y)) {
+		return false;
+	}
+
+	const i32 x0 = i32(std::max(std::floor(min.x), 0.0f));
+	const i32 x1 = i32(std::min(std::ceil(max.x), float(buffer.size.x)));
+	const i32 y0 = i32(std::max(std::floor(min.y), 0.0f));
+	const i32 y1 = i32(std::min(std::ceil(max.y), float(buffer.size.y)));
+	for (i32 y = y0; y < y1; ++y) {
+		for (i32 x = x0; x < x1; ++x) {
+			if (!(buffer.depths[u32(y * buffer.size.x + x)] > max.z)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// -- Culling
+
+static void run_chunks(const cross::JobManager *jobmanager,
+	Vec<CullingChunk>                          &chunks,
+	const CullingContext                       &ctx,
+	cross::ForEachUserDataFn<CullingChunk, const CullingContext> cull_chunk)
+{
+	if (jobmanager == nullptr || chunks.len() <= 1) {
+		for (auto &chunk : chunks) {
+			cull_chunk(chunk, &ctx);
+		}
+		return;
+	}
+
+	auto waitable = cross::parallel_foreach_userdata<CullingChunk, const CullingContext, true>(*jobmanager,
+		exo::Span<CullingChunk>(chunks.data(), chunks.len()),
+		&ctx,
+		cull_chunk,
+		1);
+	waitable->wait();
+}
+
+void cull_instances(const InstanceBounds &bounds,
+	const float4x4                       &view_projection,
+	const CullingSettings                &settings,
+	const cross::JobManager              *jobmanager,
+	CullingResult                        &result)
+{
+	EXO_PROFILE_SCOPE
+
+	const u32 instances_len       = bounds.len();
+	result.stats                  = {};
+	result.stats.tested_instances = instances_len;
+
+	// Every instance is written by the frustum pass
+	result.visibility.resize(instances_len);
+	result.visible_instances.resize(instances_len);
+	result.chunks.clear();
+	for (u32 begin = 0; begin < instances_len; begin += CHUNK_SIZE) {
+		result.chunks.push(CullingChunk{.begin = begin, .end = std::min(begin + CHUNK_SIZE, instances_len)});
+	}
+
+	const Frustum  frustum = frustum_from_matrix(view_projection);
+	CullingContext ctx     = {
+		.bounds            = &bounds,
+		.frustum           = &frustum,
+		.occlusion_buffer  = nullptr,
+		.view_projection   = view_projection,
+		.visibility        = result.visibility.data(),
+		.visible_instances = result.visible_instances.data(),
+	};
+
+	// -- Frustum
+	{
+		EXO_PROFILE_SCOPE_NAMED("Frustum")
+		const auto start = std::chrono::steady_clock::now();
+		run_chunks(jobmanager, result.chunks, ctx, [](CullingChunk &chunk, const CullingContext *chunk_ctx) {
+			chunk.visible        = frustum_cull_range(*chunk_ctx->bounds,
+				*chunk_ctx->frustum,
+				chunk.begin,
+				chunk.end,
+				chunk_ctx->visibility,
+				chunk_ctx->visible_instances + chunk.begin);
+			chunk.frustum_culled = chunk.end - chunk.begin - chunk.visible;
+		});
+		result.stats.frustum_ms = exo::elapsed_ms(start);
+	}
+
+	// -- Occlusion
+	if (settings.occlusion && !settings.occluders.empty()) {
+		EXO_PROFILE_SCOPE_NAMED("Occlusion")
+		const auto start = std::chrono::steady_clock::now();
+
+		auto &occlusion_buffer = result.occlusion_buffer;
+		ASSERT(settings.occlusion_buffer_size.x > 0 && settings.occlusion_buffer_size.y > 0);
+		occlusion_buffer.size = settings.occlusion_buffer_size;
+		occlusion_buffer.depths.clear();
+		occlusion_buffer.depths.resize(u32(occlusion_buffer.size.x * occlusion_buffer.size.y), 0.0f);
+
+		for (const u32 i_occluder : settings.occluders) {
+			ASSERT(i_occluder < instances_len);
+			if (result.visibility[i_occluder] &&
+				rasterize_box(occlusion_buffer, view_projection, get_bounds(bounds, i_occluder))) {
+				result.stats.occluders += 1;
+			}
+		}
+
+		if (result.stats.occluders > 0) {
+			ctx.occlusion_buffer = &occlusion_buffer;
+			run_chunks(jobmanager, result.chunks, ctx, [](CullingChunk &chunk, const CullingContext *chunk_ctx) {
+				// Only the instances that passed the frustum test are tested, the list is compacted in place
+				u32 *chunk_visible = chunk_ctx->visible_instances + chunk.begin;
+				u32  visible       = 0;
+				for (u32 i_visible = 0; i_visible < chunk.visible; ++i_visible) {
+					const u32 i_instance = chunk_visible[i_visible];
+					if (is_occluded(*chunk_ctx->occlusion_buffer,
+							chunk_ctx->view_projection,
+							get_bounds(*chunk_ctx->bounds, i_instance))) {
+						chunk_ctx->visibility[i_instance] = 0;
+					} else {
+						chunk_visible[visible] = i_instance;
+						visible += 1;
+					}
+				}
+				chunk.occlusion_culled = chunk.visible - visible;
+				chunk.visible          = visible;
+			});
+		}
+		result.stats.occlusion_ms = exo::elapsed_ms(start);
+	}
+
+	// -- Gather the visible instances of the chunks
+	u32 visible_len = 0;
+	for (const auto &chunk : result.chunks) {
+		std::memmove(result.visible_instances.data() + visible_len,
+			result.visible_instances.data() + chunk.begin,
+			chunk.visible * sizeof(u32));
+		visible_len += chunk.visible;
+		result.stats.frustum_culled += chunk.frustum_culled;
+		result.stats.occlusion_culled += chunk.occlusion_culled;
+	}
+	result.visible_instances.resize(visible_len);
+	result.stats.visible_instances = visible_len;
+}
@@ -3,28 +3,45 @@
 #include "exo/hash.h"
 #include "exo/profile.h"
 
+#include "gameplay/archetype_storage.h"
 #include "gameplay/components/camera_component.h"
 #include "gameplay/components/mesh_component.h"
 #include "gameplay/entity.h"
+#include "gameplay/transform_hierarchy.h"
+#include "gameplay/update_context.h"
 #include "gameplay/update_stages.h"
 #include "reflection/reflection.h"
 
+#include <algorithm>
+#include <bit>
+
+// Streaming through all the chunks is cheaper than following the pointers once 1 / CHUNK_EXTRACTION_RATIO of the
+// instances are dirty
+static constexpr u32 CHUNK_EXTRACTION_RATIO = 4;
+
 PrepareRenderWorld::PrepareRenderWorld()
 {
 	update_stage = UpdateStage::FrameEnd;
 	priority     = 1.0f;
+	access.read<MeshComponent>();
+	access.read<CameraComponent>();
+	// clear_changes() writes to the transform hierarchy, it stores the world transforms of every spatial component
+	access.write<SpatialComponent>();
 }
 
 void PrepareRenderWorld::initialize(const SystemRegistry &) {}
 
 void PrepareRenderWorld::shutdown() {}
 
-void PrepareRenderWorld::update(const UpdateContext &)
+void PrepareRenderWorld::update(const UpdateContext &update_context)
 {
 	EXO_PROFILE_SCOPE;
 
-	// -- Reset the render world
-	render_world.drawable_instances.clear();
+	// -- Reset the changes of the last update
+	render_world.update_index += 1;
+	render_world.added_instances.clear();
+	render_world.removed_instances.clear();
+	render_world.dirty_instance_ranges.clear();
 
 	// -- Fill the render world with data from the scene
 	ASSERT(main_camera != nullptr);
@@ -32,37 +49,179 @@ void PrepareRenderWorld::update(const UpdateContext &)
 	render_world.main_camera_fov          = main_camera->fov;
 	render_world.main_camera_view_inverse = main_camera->get_view_inverse();
 
-	for (auto &[p_entity, mesh_component] : entities) {
-		render_world.drawable_instances.push();
-		auto &new_drawable = render_world.drawable_instances.last();
+	// -- Free the slots of the removed components
+	for (const u32 i_instance : this->removed_instances) {
+		render_world.drawable_instances[i_instance] = {};
+		this->instance_bounds[i_instance]           = {};
+		render_world.instance_bounds.set(i_instance, {});
+		this->free_instances.push(i_instance);
+		render_world.removed_instances.push(i_instance);
+	}
+	this->removed_instances.clear();
+
+	// -- Give a slot to the new components
+	for (auto *mesh_component : this->added_components) {
+		u32 i_instance = u32_invalid;
+		if (!this->free_instances.is_empty()) {
+			i_instance = this->free_instances.pop();
+		} else {
+			i_instance = render_world.drawable_instances.len();
+			render_world.drawable_instances.push();
+			this->instance_components.push(nullptr);
+			this->instance_transform_nodes.push(u32_invalid);
+			this->instance_bounds.push();
+			this->is_instance_dirty.push(u8(0));
+			render_world.instance_bounds.resize(render_world.drawable_instances.len());
+		}
 
-		// HACK: update world transform here :D
-		mesh_component->set_local_transform(mesh_component->get_local_transform());
+		this->instance_components[i_instance] = mesh_component;
+		this->component_to_instance.insert(mesh_component, i_instance);
 
-		new_drawable.mesh_asset      = mesh_component->mesh_asset;
-		new_drawable.world_transform = mesh_component->get_world_transform();
-		new_drawable.world_bounds    = mesh_component->get_world_bounds();
+		const u32 transform_node = mesh_component->get_transform_node();
+		if (transform_node != u32_invalid) {
+			this->transform_hierarchy = mesh_component->get_transform_hierarchy();
+			if (transform_node >= this->transform_node_to_instance.len()) {
+				this->transform_node_to_instance.resize(transform_node + 1, u32_invalid);
+			}
+			this->transform_node_to_instance[transform_node] = i_instance;
+		}
+		this->instance_transform_nodes[i_instance] = transform_node;
+
+		render_world.added_instances.push(i_instance);
+		this->mark_instance_dirty(i_instance);
+	}
+	this->added_components.clear();
+
+	// -- Follow the nodes that moved since the last update
+	if (this->transform_hierarchy != nullptr) {
+		for (const u32 transform_node : this->transform_hierarchy->changed_handles) {
+			if (transform_node < this->transform_node_to_instance.len() &&
+				this->transform_node_to_instance[transform_node] != u32_invalid) {
+				this->mark_instance_dirty(this->transform_node_to_instance[transform_node]);
+			}
+		}
+		this->transform_hierarchy->clear_changes();
+	}
+
+	// -- Extract the dirty instances
+	// When many instances changed (first update, a moved root), the mesh components stored in the archetypes are
+	// extracted by streaming through their chunks, the others are read through their pointer.
+	if (update_context.component_storage != nullptr && !this->dirty_instances.is_empty() &&
+		this->dirty_instances.len() * CHUNK_EXTRACTION_RATIO >= this->instance_components.len()) {
+		update_context.component_storage->for_each_chunk<MeshComponent>([&](u64 occupancy, MeshComponent *meshes) {
+			for (; occupancy != 0; occupancy &= occupancy - 1) {
+				const auto &mesh_component = meshes[std::countr_zero(occupancy)];
+				const u32   transform_node = mesh_component.get_transform_node();
+				if (transform_node >= this->transform_node_to_instance.len()) {
+					continue;
+				}
+				const u32 i_instance = this->transform_node_to_instance[transform_node];
+				if (i_instance != u32_invalid && this->is_instance_dirty[i_instance] &&
+					this->instance_components[i_instance] == &mesh_component) {
+					this->extract_instance(i_instance, mesh_component);
+				}
+			}
+		});
+	}
+
+	// Consecutive slots are merged in ranges
+	std::sort(this->dirty_instances.begin(), this->dirty_instances.end());
+	for (const u32 i_instance : this->dirty_instances) {
+		if (this->is_instance_dirty[i_instance]) {
+			this->extract_instance(i_instance, *this->instance_components[i_instance]);
+		}
+
+		auto &ranges = render_world.dirty_instance_ranges;
+		if (!ranges.is_empty() && ranges.last().end == i_instance) {
+			ranges.last().end += 1;
+		} else {
+			ranges.push(InstanceRange{.begin = i_instance, .end = i_instance + 1});
+		}
+	}
+	this->dirty_instances.clear();
+
+	// -- Update the TLAS
+	if (this->rebuild_tlas) {
+		// Free slots are left out, the leaves are remapped from the live instances to their slot
+		Vec<u32>       live_instances = {};
+		Vec<exo::AABB> live_bounds    = {};
+		for (u32 i_instance = 0; i_instance < this->instance_components.len(); ++i_instance) {
+			if (this->instance_components[i_instance] != nullptr) {
+				live_instances.push(i_instance);
+				live_bounds.push(this->instance_bounds[i_instance]);
+			}
+		}
+
+		build_tlas(BVHBuildSettings{}, update_context.jobmanager, live_bounds, render_world.tlas);
+		for (auto &node : render_world.tlas) {
+			if (node.prim_index != u32_invalid) {
+				node.prim_index = live_instances[node.prim_index];
+			}
+		}
+		this->rebuild_tlas = false;
+
+		live_instances.buffer.destroy();
+		live_bounds.buffer.destroy();
+	} else if (!render_world.dirty_instance_ranges.is_empty()) {
+		refit_tlas(render_world.tlas, this->instance_bounds);
+	}
+}
+
+void PrepareRenderWorld::extract_instance(u32 i_instance, const MeshComponent &mesh_component)
+{
+	auto &drawable                      = render_world.drawable_instances[i_instance];
+	drawable.mesh_asset                 = mesh_component.mesh_asset;
+	drawable.world_transform            = mesh_component.get_world_transform();
+	drawable.world_bounds               = mesh_component.get_world_bounds();
+	this->instance_bounds[i_instance]   = drawable.world_bounds;
+	render_world.instance_bounds.set(i_instance, drawable.world_bounds);
+	this->is_instance_dirty[i_instance] = 0;
+}
+
+void PrepareRenderWorld::mark_instance_dirty(u32 i_instance)
+{
+	if (!this->is_instance_dirty[i_instance]) {
+		this->is_instance_dirty[i_instance] = 1;
+		this->dirty_instances.push(i_instance);
 	}
 }
 
-void PrepareRenderWorld::register_component(const Entity *entity, refl::BasePtr<BaseComponent> component)
+void PrepareRenderWorld::register_component(const Entity *, refl::BasePtr<BaseComponent> component)
 {
 	if (auto *mesh_component = component.as<MeshComponent>()) {
-		auto **entity_component = this->entities.at(entity);
-		if (entity_component == nullptr) {
-			this->entities.insert(entity, mesh_component);
-		} else {
-			*entity_component = mesh_component;
-		}
+		this->rebuild_tlas = true;
+		this->added_components.push(mesh_component);
 	}
 	if (auto camera_component = component.as<CameraComponent>()) {
 		main_camera = camera_component;
 	}
 }
 
-void PrepareRenderWorld::unregister_component(const Entity *entity, refl::BasePtr<BaseComponent> component)
+void PrepareRenderWorld::unregister_component(const Entity *, refl::BasePtr<BaseComponent> component)
 {
-	if (component.as<MeshComponent>()) {
-		entities.remove(entity);
+	if (auto *mesh_component = component.as<MeshComponent>()) {
+		this->rebuild_tlas = true;
+
+		// The component was not extracted yet
+		for (u32 i_added = 0; i_added < this->added_components.len(); ++i_added) {
+			if (this->added_components[i_added] == mesh_component) {
+				this->added_components.swap_remove(i_added);
+				return;
+			}
+		}
+
+		const u32 *p_instance = this->component_to_instance.at(mesh_component);
+		ASSERT(p_instance != nullptr);
+		const u32 i_instance = *p_instance;
+		this->component_to_instance.remove(mesh_component);
+
+		const u32 transform_node = this->instance_transform_nodes[i_instance];
+		if (transform_node != u32_invalid && this->transform_node_to_instance[transform_node] == i_instance) {
+			this->transform_node_to_instance[transform_node] = u32_invalid;
+		}
+		this->instance_transform_nodes[i_instance] = u32_invalid;
+		this->instance_components[i_instance]      = nullptr;
+
+		this->removed_instances.push(i_instance);
 	}
 }
@@ -26,6 +26,7 @@
 void Scene::init(AssetManager *_asset_manager, const Inputs *inputs)
 {
 	asset_manager = _asset_manager;
+	entity_world.jobmanager = asset_manager->jobmanager;
 
 	auto last_imported_scene = cross::MappedFile::open(ASSET_PATH "/last_imported_scene.asset");
 	if (last_imported_scene) {
@@ -33,6 +34,8 @@ void Scene::init(AssetManager *_asset_manager, const Inputs *inputs)
 	}
 
 	entity_world.create_system<PrepareRenderWorld>();
+	entity_world.create_system<EditorCameraInputSystem>(inputs);
+	entity_world.create_system<EditorCameraTransformSystem>();
 
 	Entity *camera_entity = nullptr;
 	for (auto *entity : entity_world.root_entities) {
@@ -41,19 +44,22 @@ void Scene::init(AssetManager *_asset_manager, const Inputs *inputs)
 			break;
 		}
 	}
+	// The editor camera systems only see the cameras stored in the archetypes, the saved camera is replaced as the
+	// editor state of its components is not serialized
+	if (camera_entity && !camera_entity->archetype_row.is_valid()) {
+		entity_world.destroy_entity(camera_entity);
+		camera_entity = nullptr;
+	}
 	if (!camera_entity) {
-		camera_entity = entity_world.create_entity("Main Camera");
-		camera_entity->create_component<CameraComponent>();
-		camera_entity->create_component<EditorCameraComponent>();
-		camera_entity->create_component<CameraInputComponent>();
+		camera_entity = entity_world.create_entity_with_components<CameraComponent,
+			EditorCameraComponent,
+			CameraInputComponent>("Main Camera");
 	}
-	camera_entity->create_system<EditorCameraInputSystem>(inputs);
-	camera_entity->create_system<EditorCameraTransformSystem>();
 
 	this->main_camera_entity = camera_entity;
 }
 
-void Scene::destroy() {}
+void Scene::destroy() { entity_world.destroy(); }
 
 static void tree_view_entity(ui::Ui &ui,
 	SceneUi &scene_ui,
@@ -286,15 +292,16 @@ Entity *Scene::import_subscene_rec(const SubScene *subscene, u32 i_node)
 	const auto &children = subscene->children[i_node];
 	const auto &name = subscene->names[i_node];
 
-	Entity *new_entity = entity_world.create_entity(name);
-
+	Entity *new_entity = nullptr;
 	SpatialComponent *entity_root = nullptr;
 	if (mesh_asset.is_valid()) {
-		auto *mesh_component = new_entity->create_component<MeshComponent>().as<MeshComponent>();
+		new_entity = entity_world.create_entity_with_components<MeshComponent>(name);
+		auto *mesh_component = new_entity->get_first_component<MeshComponent>();
 		mesh_component->mesh_asset = mesh_asset;
 		entity_root = static_cast<SpatialComponent *>(mesh_component);
 	} else {
-		entity_root = new_entity->create_component<SpatialComponent>().as<SpatialComponent>();
+		new_entity = entity_world.create_entity_with_components<SpatialComponent>(name);
+		entity_root = new_entity->get_first_component<SpatialComponent>();
 	}
 
 	entity_root->set_local_transform(transform);
@@ -0,0 +1,257 @@
+#include "cross/jobmanager.h"
+#include "engine/camera.h"
+#include "engine/culling.h"
+#include "exo/tests/random.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using exo::tests::Random;
+
+// Camera at the origin looking at -Z with a 90 degrees field of view
+static float4x4 make_view_projection()
+{
+	const float4x4 view       = camera::look_at(float3(0.0f), float3(0.0f, 0.0f, -1.0f), float3(0.0f, 1.0f, 0.0f));
+	const float4x4 projection = camera::infinite_perspective(90.0f, 1.0f, 0.1f);
+	return projection * view;
+}
+
+static exo::AABB make_box(float3 center, float half_extent)
+{
+	return exo::AABB{.min = center - float3(half_extent), .max = center + float3(half_extent)};
+}
+
+static void push_box(InstanceBounds &bounds, const exo::AABB &box)
+{
+	bounds.resize(bounds.len() + 1);
+	bounds.set(bounds.len() - 1, box);
+}
+
+// Scalar version of the test, a box is outside when all its corners are behind a plane
+static bool reference_is_visible(const Frustum &frustum, const exo::AABB &box)
+{
+	if (box.min.x > box.max.x) {
+		return false;
+	}
+	for (u32 i_plane = 0; i_plane < frustum.planes_len; ++i_plane) {
+		const float4 &plane          = frustum.planes[i_plane];
+		bool          corner_in_front = false;
+		for (u32 i_corner = 0; i_corner < 8; ++i_corner) {
+			const float3 corner = float3(i_corner & 1 ? box.max.x : box.min.x,
+				i_corner & 2 ? box.max.y : box.min.y,
+				i_corner & 4 ? box.max.z : box.min.z);
+			corner_in_front = corner_in_front || exo::dot(plane.xyz(), corner) + plane.w >= 0.0f;
+		}
+		if (!corner_in_front) {
+			return false;
+		}
+	}
+	return true;
+}
+
+TEST_CASE("Frustum culling", "[culling]")
+{
+	const float4x4 view_projection = make_view_projection();
+
+	// An infinite projection has no far plane
+	const Frustum frustum = frustum_from_matrix(view_projection);
+	REQUIRE(frustum.planes_len == 5);
+
+	const exo::AABB boxes[] = {
+		make_box(float3(0.0f, 0.0f, -10.0f), 1.0f),     // in front
+		make_box(float3(0.0f, 0.0f, 10.0f), 1.0f),      // behind
+		make_box(float3(100.0f, 0.0f, -10.0f), 1.0f),   // right
+		make_box(float3(0.0f, -100.0f, -10.0f), 1.0f),  // below
+		make_box(float3(10.5f, 0.0f, -10.0f), 1.0f),    // crosses the right plane
+		make_box(float3(0.0f, 0.0f, -1e6f), 1.0f),      // far away
+		make_box(float3(0.0f, 0.0f, 0.0f), 1.0f),       // contains the camera
+		exo::AABB{},                                    // empty
+	};
+	const bool expected[] = {true, false, false, false, true, true, true, false};
+
+	// Enough instances for the wide, narrow and scalar loops
+	InstanceBounds bounds = {};
+	for (u32 i_instance = 0; i_instance < 8 * 13 + 7; ++i_instance) {
+		push_box(bounds, boxes[i_instance % 8]);
+	}
+
+	CullingResult result = {};
+	cull_instances(bounds, view_projection, CullingSettings{}, nullptr, result);
+
+	u32 expected_visible = 0;
+	for (u32 i_instance = 0; i_instance < bounds.len(); ++i_instance) {
+		REQUIRE(bool(result.visibility[i_instance]) == expected[i_instance % 8]);
+		REQUIRE(reference_is_visible(frustum, boxes[i_instance % 8]) == expected[i_instance % 8]);
+		expected_visible += expected[i_instance % 8] ? 1 : 0;
+	}
+	REQUIRE(result.stats.tested_instances == bounds.len());
+	REQUIRE(result.stats.visible_instances == expected_visible);
+	REQUIRE(result.stats.frustum_culled == bounds.len() - expected_visible);
+	REQUIRE(result.visible_instances.len() == expected_visible);
+
+	result.destroy();
+	bounds.destroy();
+}
+
+TEST_CASE("Parallel frustum culling", "[culling]")
+{
+	const float4x4 view_projection = make_view_projection();
+	const Frustum  frustum         = frustum_from_matrix(view_projection);
+
+	Random         random = {};
+	InstanceBounds bounds = {};
+	Vec<exo::AABB> boxes  = {};
+	for (u32 i_instance = 0; i_instance < 50'000; ++i_instance) {
+		const float3 center = 200.0f * random.next3() - float3(100.0f);
+		boxes.push(make_box(center, 0.5f + 2.0f * random.next()));
+		push_box(bounds, boxes.last());
+	}
+
+	auto          jobmanager      = cross::JobManager::create();
+	CullingResult serial_result   = {};
+	CullingResult parallel_result = {};
+	cull_instances(bounds, view_projection, CullingSettings{}, nullptr, serial_result);
+	cull_instances(bounds, view_projection, CullingSettings{}, &jobmanager, parallel_result);
+
+	REQUIRE(serial_result.visible_instances.len() == parallel_result.visible_instances.len());
+	for (u32 i_visible = 0; i_visible < serial_result.visible_instances.len(); ++i_visible) {
+		REQUIRE(serial_result.visible_instances[i_visible] == parallel_result.visible_instances[i_visible]);
+	}
+	for (u32 i_instance = 0; i_instance < boxes.len(); ++i_instance) {
+		REQUIRE(bool(serial_result.visibility[i_instance]) == reference_is_visible(frustum, boxes[i_instance]));
+	}
+
+	serial_result.destroy();
+	parallel_result.destroy();
+	jobmanager.destroy();
+	boxes.buffer.destroy();
+	bounds.destroy();
+}
+
+TEST_CASE("Occlusion culling", "[culling]")
+{
+	const float4x4 view_projection = make_view_projection();
+
+	InstanceBounds bounds = {};
+	push_box(bounds, exo::AABB{.min = float3(-5.0f, -5.0f, -21.0f), .max = float3(5.0f, 5.0f, -20.0f)}); // wall
+	push_box(bounds, make_box(float3(0.0f, 0.0f, -40.0f), 1.0f));                                       // behind
+	push_box(bounds, make_box(float3(10.0f, 0.0f, -40.0f), 1.0f));  // partially behind
+	push_box(bounds, make_box(float3(15.0f, 0.0f, -40.0f), 1.0f));  // next to the wall
+	push_box(bounds, make_box(float3(0.0f, 0.0f, -10.0f), 1.0f));   // in front of the wall
+	push_box(bounds, make_box(float3(0.0f, 0.0f, 40.0f), 1.0f));    // behind the camera
+	const bool expected[] = {true, false, true, true, true, false};
+
+	const u32       occluders[] = {0};
+	CullingSettings settings    = {};
+	settings.occlusion          = true;
+	settings.occluders          = exo::Span<const u32>(occluders, 1);
+
+	CullingResult result = {};
+	cull_instances(bounds, view_projection, settings, nullptr, result);
+
+	for (u32 i_instance = 0; i_instance < bounds.len(); ++i_instance) {
+		REQUIRE(bool(result.visibility[i_instance]) == expected[i_instance]);
+	}
+	REQUIRE(result.stats.occluders == 1);
+	REQUIRE(result.stats.frustum_culled == 1);
+	REQUIRE(result.stats.occlusion_culled == 1);
+	REQUIRE(result.stats.visible_instances == 4);
+
+	// Without occlusion only the frustum culls
+	cull_instances(bounds, view_projection, CullingSettings{}, nullptr, result);
+	REQUIRE(result.stats.occlusion_culled == 0);
+	REQUIRE(result.stats.visible_instances == 5);
+
+	result.destroy();
+	bounds.destroy();
+}
+
+TEST_CASE("Occluders only hide the pixels they fully cover", "[culling]")
+{
+	const float4x4 view_projection = make_view_projection();
+
+	// The right edge of the wall is in the middle of a column of pixels: x = 160.7 in the 256 pixels wide buffer
+	const float wall_edge = (160.7f / 128.0f - 1.0f) * 20.0f;
+
+	InstanceBounds bounds = {};
+	push_box(bounds, exo::AABB{.min = float3(-5.0f, -5.0f, -21.0f), .max = float3(wall_edge, 5.0f, -20.0f)}); // wall
+	// Just past the wall edge, in the same column of pixels around x = 160.85
+	push_box(bounds, make_box(float3((160.85f / 128.0f - 1.0f) * 40.0f, 0.0f, -40.0f), 0.01f));
+	// Behind the wall, in the last column of pixels it fully covers
+	push_box(bounds, make_box(float3((159.5f / 128.0f - 1.0f) * 40.0f, 0.0f, -40.0f), 0.01f));
+	const bool expected[] = {true, true, false};
+
+	const u32       occluders[] = {0};
+	CullingSettings settings    = {};
+	settings.occlusion          = true;
+	settings.occluders          = exo::Span<const u32>(occluders, 1);
+
+	CullingResult result = {};
+	cull_instances(bounds, view_projection, settings, nullptr, result);
+
+	for (u32 i_instance = 0; i_instance < bounds.len(); ++i_instance) {
+		REQUIRE(bool(result.visibility[i_instance]) == expected[i_instance]);
+	}
+	REQUIRE(result.stats.occlusion_culled == 1);
+
+	// Pixels of the wall: the column cut by its edge is empty, the columns it covers are at its farthest depth
+	const auto &buffer = result.occlusion_buffer;
+	const u32   i_row  = u32(buffer.size.y / 2) * u32(buffer.size.x);
+	REQUIRE(buffer.depths[i_row + 160] == 0.0f);
+	REQUIRE(buffer.depths[i_row + 159] > 0.0f);
+	REQUIRE(buffer.depths[i_row + 159] <= 1.0f / 20.0f);
+
+	result.destroy();
+	bounds.destroy();
+}
+
+TEST_CASE("Culling benchmark", "[.][culling][benchmark]")
+{
+	const float4x4 view_projection = make_view_projection();
+
+	constexpr u32  INSTANCE_COUNT = 200'000;
+	Random         random         = {};
+	InstanceBounds bounds         = {};
+	bounds.resize(INSTANCE_COUNT);
+	for (u32 i_instance = 0; i_instance < INSTANCE_COUNT; ++i_instance) {
+		const float3 center = 1000.0f * random.next3() - float3(500.0f);
+		bounds.set(i_instance, make_box(center, 0.5f + 2.0f * random.next()));
+	}
+
+	// Big boxes in front of the camera as occluders
+	Vec<u32> occluders = {};
+	for (u32 i_occluder = 0; i_occluder < 64; ++i_occluder) {
+		const float3 center = float3(400.0f * random.next() - 200.0f, 400.0f * random.next() - 200.0f, -300.0f);
+		bounds.set(i_occluder, make_box(center, 20.0f));
+		occluders.push(i_occluder);
+	}
+
+	auto          jobmanager = cross::JobManager::create();
+	CullingResult result     = {};
+
+	CullingSettings occlusion_settings = {};
+	occlusion_settings.occlusion       = true;
+	occlusion_settings.occluders       = occluders;
+
+	BENCHMARK("frustum 200k instances")
+	{
+		cull_instances(bounds, view_projection, CullingSettings{}, nullptr, result);
+		return result.visible_instances.len();
+	};
+
+	BENCHMARK("parallel frustum 200k instances")
+	{
+		cull_instances(bounds, view_projection, CullingSettings{}, &jobmanager, result);
+		return result.visible_instances.len();
+	};
+
+	BENCHMARK("parallel frustum and occlusion 200k instances")
+	{
+		cull_instances(bounds, view_projection, occlusion_settings, &jobmanager, result);
+		return result.visible_instances.len();
+	};
+
+	result.destroy();
+	jobmanager.destroy();
+	occluders.buffer.destroy();
+	bounds.destroy();
+}
@@ -0,0 +1,258 @@
+#include "assets/mesh.h"
+#include "engine/render_world_system.h"
+#include "gameplay/archetype_storage.h"
+#include "gameplay/components/camera_component.h"
+#include "gameplay/components/mesh_component.h"
+#include "gameplay/transform_hierarchy.h"
+#include "gameplay/update_context.h"
+#include <catch2/catch_test_macros.hpp>
+
+static float4x4 translation(float3 offset)
+{
+	float4x4 transform = float4x4::identity();
+	transform.col(3)   = float4(offset, 1.0f);
+	return transform;
+}
+
+// Registers and unregisters the components like an entity does
+struct TestWorld
+{
+	TransformHierarchy hierarchy = {};
+	PrepareRenderWorld system    = {};
+	CameraComponent    camera    = {};
+
+	TestWorld()
+	{
+		this->hierarchy.add(this->camera);
+		this->system.register_component(nullptr, refl::BasePtr<BaseComponent>(&this->camera));
+	}
+
+	void add(MeshComponent &mesh)
+	{
+		this->hierarchy.add(mesh);
+		this->system.register_component(nullptr, refl::BasePtr<BaseComponent>(&mesh));
+	}
+
+	void remove(MeshComponent &mesh)
+	{
+		this->system.unregister_component(nullptr, refl::BasePtr<BaseComponent>(&mesh));
+		this->hierarchy.remove(mesh);
+	}
+
+	const RenderWorld &update(ArchetypeStorage *component_storage = nullptr)
+	{
+		this->hierarchy.update(nullptr);
+		this->system.update(UpdateContext{
+			.delta_t           = 0.0,
+			.stage             = UpdateStage::FrameEnd,
+			.component_storage = component_storage,
+		});
+		return this->system.render_world;
+	}
+};
+
+static void init_mesh(MeshComponent &mesh, u32 i_mesh)
+{
+	mesh.mesh_asset = AssetId::create<Mesh>(i_mesh % 2 ? "a.mesh" : "b.mesh");
+	mesh.set_local_bounds(exo::AABB{.min = float3(-1.0f), .max = float3(1.0f)});
+	mesh.set_local_transform(translation(float3(float(i_mesh) * 10.0f, 0.0f, 0.0f)));
+}
+
+static bool has_ranges(const RenderWorld &world, std::initializer_list<InstanceRange> ranges)
+{
+	if (world.dirty_instance_ranges.len() != ranges.size()) {
+		return false;
+	}
+	u32 i_range = 0;
+	for (const auto &range : ranges) {
+		const auto &dirty_range = world.dirty_instance_ranges[i_range++];
+		if (dirty_range.begin != range.begin || dirty_range.end != range.end) {
+			return false;
+		}
+	}
+	return true;
+}
+
+TEST_CASE("PrepareRenderWorld extracts the changes of the mesh components", "[render_world]")
+{
+	// Done by main in the apps
+	refl::details::call_all_registers();
+
+	TestWorld     test_world = {};
+	MeshComponent meshes[6]  = {};
+	for (u32 i_mesh = 0; i_mesh < 6; ++i_mesh) {
+		init_mesh(meshes[i_mesh], i_mesh);
+	}
+
+	// New components get consecutive slots
+	for (u32 i_mesh = 0; i_mesh < 4; ++i_mesh) {
+		test_world.add(meshes[i_mesh]);
+	}
+	const RenderWorld *world = &test_world.update();
+	REQUIRE(world->update_index == 1);
+	REQUIRE(world->drawable_instances.len() == 4);
+	REQUIRE(world->added_instances.len() == 4);
+	REQUIRE(world->removed_instances.is_empty());
+	REQUIRE(has_ranges(*world, {{0, 4}}));
+	for (u32 i_instance = 0; i_instance < 4; ++i_instance) {
+		REQUIRE(world->added_instances[i_instance] == i_instance);
+		REQUIRE(world->drawable_instances[i_instance].mesh_asset == meshes[i_instance].mesh_asset);
+		REQUIRE(world->drawable_instances[i_instance].world_transform == meshes[i_instance].get_world_transform());
+	}
+
+	// Nothing changed
+	world = &test_world.update();
+	REQUIRE(world->added_instances.is_empty());
+	REQUIRE(world->removed_instances.is_empty());
+	REQUIRE(world->dirty_instance_ranges.is_empty());
+
+	// Moved components are extracted again, consecutive slots are merged
+	meshes[1].set_local_transform(translation(float3(0.0f, 5.0f, 0.0f)));
+	meshes[3].set_local_transform(translation(float3(0.0f, 6.0f, 0.0f)));
+	world = &test_world.update();
+	REQUIRE(world->added_instances.is_empty());
+	REQUIRE(has_ranges(*world, {{1, 2}, {3, 4}}));
+	REQUIRE(world->drawable_instances[3].world_transform == translation(float3(0.0f, 6.0f, 0.0f)));
+
+	meshes[2].set_local_transform(translation(float3(0.0f, 7.0f, 0.0f)));
+	meshes[1].set_local_transform(translation(float3(0.0f, 8.0f, 0.0f)));
+	world = &test_world.update();
+	REQUIRE(has_ranges(*world, {{1, 3}}));
+
+	// The slot of a removed component is freed, then reused by the next one
+	test_world.remove(meshes[1]);
+	world = &test_world.update();
+	REQUIRE(world->removed_instances.len() == 1);
+	REQUIRE(world->removed_instances[0] == 1);
+	REQUIRE(!world->drawable_instances[1].mesh_asset.is_valid());
+	REQUIRE(world->dirty_instance_ranges.is_empty());
+
+	test_world.add(meshes[4]);
+	world = &test_world.update();
+	REQUIRE(world->drawable_instances.len() == 4);
+	REQUIRE(world->added_instances.len() == 1);
+	REQUIRE(world->added_instances[0] == 1);
+	REQUIRE(has_ranges(*world, {{1, 2}}));
+	REQUIRE(world->drawable_instances[1].mesh_asset == meshes[4].mesh_asset);
+
+	// A component removed before it was extracted never gets a slot
+	test_world.add(meshes[5]);
+	test_world.remove(meshes[5]);
+	world = &test_world.update();
+	REQUIRE(world->drawable_instances.len() == 4);
+	REQUIRE(world->added_instances.is_empty());
+	REQUIRE(world->removed_instances.is_empty());
+	REQUIRE(world->dirty_instance_ranges.is_empty());
+
+	// The leaves of the TLAS are the live slots
+	u32 leaves = 0;
+	for (const auto &node : world->tlas) {
+		if (node.prim_index != u32_invalid) {
+			REQUIRE(world->drawable_instances[node.prim_index].mesh_asset.is_valid());
+			leaves += 1;
+		}
+	}
+	REQUIRE(leaves == 4);
+
+	test_world.hierarchy.destroy();
+}
+
+TEST_CASE("RenderWorld consumers read all the slots after a missed update", "[render_world]")
+{
+	refl::details::call_all_registers();
+
+	TestWorld     test_world = {};
+	MeshComponent meshes[3]  = {};
+	for (u32 i_mesh = 0; i_mesh < 3; ++i_mesh) {
+		init_mesh(meshes[i_mesh], i_mesh);
+		test_world.add(meshes[i_mesh]);
+	}
+	test_world.update();
+	meshes[2].set_local_transform(translation(float3(0.0f, 1.0f, 0.0f)));
+	const RenderWorld &world = test_world.update();
+
+	InstanceRange all_instances = {};
+
+	// The consumer read the previous update
+	auto ranges = world.get_ranges_to_read(world.update_index - 1, all_instances);
+	REQUIRE(ranges.len() == 1);
+	REQUIRE(ranges[0].begin == 2);
+	REQUIRE(ranges[0].end == 3);
+
+	// It missed one, or never read the world
+	const u64 missed_update_indices[] = {world.update_index - 2, u64_invalid};
+	for (const u64 last_update_index : missed_update_indices) {
+		ranges = world.get_ranges_to_read(last_update_index, all_instances);
+		REQUIRE(ranges.len() == 1);
+		REQUIRE(ranges[0].begin == 0);
+		REQUIRE(ranges[0].end == 3);
+	}
+
+	test_world.hierarchy.destroy();
+}
+
+TEST_CASE("PrepareRenderWorld extracts the mesh components stored in the archetypes", "[render_world]")
+{
+	refl::details::call_all_registers();
+
+	TestWorld            test_world = {};
+	ArchetypeStorage     storage    = {};
+	MeshComponent       *meshes[9]  = {};
+	Handle<ArchetypeRow> rows[8]    = {};
+	for (u32 i_mesh = 0; i_mesh < 8; ++i_mesh) {
+		rows[i_mesh]   = storage.create<MeshComponent>();
+		meshes[i_mesh] = storage.get<MeshComponent>(rows[i_mesh]);
+	}
+	// The components of the entities created without their archetype are extracted too
+	MeshComponent individual_mesh = {};
+	meshes[8]                     = &individual_mesh;
+	for (u32 i_mesh = 0; i_mesh < 9; ++i_mesh) {
+		init_mesh(*meshes[i_mesh], i_mesh);
+		test_world.add(*meshes[i_mesh]);
+	}
+
+	const auto check_instances = [&](const RenderWorld &world) {
+		for (u32 i_instance = 0; i_instance < 9; ++i_instance) {
+			const auto &drawable = world.drawable_instances[i_instance];
+			REQUIRE(drawable.mesh_asset == meshes[i_instance]->mesh_asset);
+			REQUIRE(drawable.world_transform == meshes[i_instance]->get_world_transform());
+			REQUIRE(drawable.world_bounds.min == meshes[i_instance]->get_world_bounds().min);
+		}
+	};
+
+	const RenderWorld *world = &test_world.update(&storage);
+	REQUIRE(world->drawable_instances.len() == 9);
+	REQUIRE(has_ranges(*world, {{0, 9}}));
+	check_instances(*world);
+
+	// Few changes
+	meshes[5]->set_local_transform(translation(float3(0.0f, 3.0f, 0.0f)));
+	world = &test_world.update(&storage);
+	REQUIRE(has_ranges(*world, {{5, 6}}));
+	check_instances(*world);
+
+	// Most of the instances changed
+	for (u32 i_mesh = 1; i_mesh < 9; ++i_mesh) {
+		meshes[i_mesh]->set_local_transform(translation(float3(0.0f, float(i_mesh), 1.0f)));
+	}
+	world = &test_world.update(&storage);
+	REQUIRE(has_ranges(*world, {{1, 9}}));
+	check_instances(*world);
+
+	// A removed component leaves a hole in its chunk
+	test_world.remove(*meshes[2]);
+	storage.remove(rows[2]);
+	for (u32 i_mesh = 6; i_mesh < 9; ++i_mesh) {
+		meshes[i_mesh]->set_local_transform(translation(float3(0.0f, 0.0f, float(i_mesh))));
+	}
+	world = &test_world.update(&storage);
+	REQUIRE(world->removed_instances.len() == 1);
+	REQUIRE(has_ranges(*world, {{6, 9}}));
+	for (u32 i_instance = 6; i_instance < 9; ++i_instance) {
+		REQUIRE(world->drawable_instances[i_instance].world_transform ==
+				translation(float3(0.0f, 0.0f, float(i_instance))));
+	}
+
+	test_world.hierarchy.destroy();
+	storage.destroy();
+}
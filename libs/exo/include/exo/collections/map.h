@@ -6,10 +6,13 @@
 #include "exo/maths/numerics.h"
 #include "exo/memory/dynamic_buffer.h"
 
-#include "exo/collections/span.h"
 #include <bit>
+#include <concepts>
+#include <cstring>
+#include <immintrin.h>
 #include <new>
 #include <type_traits>
+#include <utility>
 
 namespace exo
 {
@@ -18,139 +21,204 @@ inline constexpr u32 EXO_MAP_MAX_LOAD_FACTOR_DENOM = 4;
 
 namespace details
 {
-union MapSlot
+// Every slot has a control byte: MAP_CTRL_EMPTY or the 7 low bits of the hash of its key (h2).
+// The control bytes are compared a group at a time with SIMD, keys are only compared when their h2 matches.
+inline constexpr u8 MAP_CTRL_EMPTY = 0x80;
+
+#if defined(__AVX2__)
+inline constexpr u32 MAP_GROUP_WIDTH = 32;
+#else
+inline constexpr u32 MAP_GROUP_WIDTH = 16;
+#endif
+
+struct MapHash
 {
-	struct
-	{
-		u32 is_filled : 1;
-		u32 psl : 31; // probe sequence length, iterations needed to lookup element
-		u32 hash;
-	} bits;
-	u64 raw;
+	u32 h1; // first probed slot
+	u8 h2; // control byte
 };
 
-// "Fast" modulo, only works with power of 2 divisors
-inline constexpr u32 power_of_2_modulo(u32 a, u32 b)
+inline MapHash split_map_hash(u64 hash)
 {
-	ASSERT(std::has_single_bit(b));
-	return a & (b - 1);
+	// The hashes of pointers and integers are weak, mix them before using their bits
+	const u64 mixed = hash * 0x9e3779b97f4a7c15ull;
+	return MapHash{.h1 = u32(mixed >> 32), .h2 = u8((mixed >> 25) & 0x7f)};
 }
 
-inline u32 probe_by_hash(const Span<const MapSlot> slots, const u64 hash)
+// Bitmask of the slots in the group starting at `ctrl` whose control byte is `h2`
+inline u32 match_group(const u8 *ctrl, u8 h2)
 {
-	// A temporary slot is created to trunc the hash to the same size as regular slots
-	MapSlot slot_to_find;
-	slot_to_find.bits.hash = u32(hash);
-
-	const u32 i_hash_slot = power_of_2_modulo(slot_to_find.bits.hash, u32(slots.len()));
+#if defined(__AVX2__)
+	const __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ctrl));
+	return u32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(char(h2)))));
+#else
+	const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+	return u32(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(char(h2)))));
+#endif
+}
 
-	// Start probing to find a slot with a matching hash
-	const u32 slots_length = u32(slots.len());
-	for (u32 i = 0; i < slots_length; ++i) {
-		const u32 i_slot = power_of_2_modulo((i_hash_slot + i), slots_length);
+// MAP_CTRL_EMPTY is the only control byte with its high bit set
+inline u32 match_group_empty(const u8 *ctrl)
+{
+#if defined(__AVX2__)
+	return u32(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ctrl))));
+#else
+	return u32(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl))));
+#endif
+}
 
-		if (slots[i_slot].bits.is_filled == 0) {
-			return u32_invalid;
-		}
+// The control bytes after the last slot mirror the first ones, groups can be loaded from any slot without wrapping
+inline usize map_ctrl_size(u32 capacity) { return capacity + MAP_GROUP_WIDTH; }
 
-		if (slots[i_slot].bits.is_filled == 1 && slots[i_slot].bits.hash == slot_to_find.bits.hash) {
-			return i_slot;
-		}
+inline void set_ctrl(u8 *ctrl, u32 capacity, u32 i_slot, u8 value)
+{
+	ctrl[i_slot] = value;
+	for (u32 i_mirror = capacity + i_slot; i_mirror < capacity + MAP_GROUP_WIDTH; i_mirror += capacity) {
+		ctrl[i_mirror] = value;
 	}
+}
 
-	return u32_invalid;
+inline void init_ctrl(DynamicBuffer &ctrl_buffer, u32 capacity)
+{
+	DynamicBuffer::init(ctrl_buffer, map_ctrl_size(capacity));
+	std::memset(ctrl_buffer.ptr, MAP_CTRL_EMPTY, map_ctrl_size(capacity));
 }
 
-template <typename T>
-inline u32 insert_slot(Span<MapSlot> slots, Span<T> values, MapSlot &&slot, T &&value)
+// How to get the key of a slot
+struct KeyValueKey
 {
-	// We need to keep track of the slot and value to insert to be able to swap them when needed
-	MapSlot slot_to_insert = std::move(slot);
-	T value_to_insert = std::move(value);
-
-	const u32 slots_length = u32(slots.len());
-	const u32 i_hash_slot = power_of_2_modulo(slot_to_insert.bits.hash, slots_length);
-
-	// Because we may "insert" multiple slots to reoder them, we need to keep track of the first "insert"
-	u32 i_original_key_slot = u32_invalid;
-	u32 i_slot = 0;
-
-	// Start probing for an empty slot
-	for (u32 i = 0; i < slots_length; ++i) {
-		i_slot = power_of_2_modulo((i_hash_slot + i), slots_length);
-		auto &current_slot = slots[i_slot];
-
-		// An empty slot if found
-		if (current_slot.bits.is_filled == 0) {
-			if (i_original_key_slot == u32_invalid) {
-				i_original_key_slot = i_slot;
-			}
-			break;
-		}
+	template <typename KeyValue>
+	static const auto &get(const KeyValue &keyvalue)
+	{
+		return keyvalue.key;
+	}
+};
 
-		// Detect hash colisions
-		ASSERT(current_slot.bits.hash != slot_to_insert.bits.hash);
+struct IdentityKey
+{
+	template <typename T>
+	static const T &get(const T &value)
+	{
+		return value;
+	}
+};
 
-		// Whenever the PSL of the key to insert becomes higher than the PSL of the probed key,
-		// Swap them, the new key to insert becomes the probed key
-		if (slot_to_insert.bits.psl > current_slot.bits.psl) {
-			if (i_original_key_slot == u32_invalid) {
-				i_original_key_slot = i_slot;
+// Types that can be used to lookup `Key`s, they must hash to the same value as the equal `Key`.
+// Only classes are accepted: integers and pointers convert implicitly to the key type and hash differently.
+template <typename Key, typename K>
+concept MapLookupKey = std::is_class_v<K> && requires(const Key &key, const K &other) {
+	{ key == other } -> std::convertible_to<bool>;
+	{ hash_value(other) } -> std::convertible_to<u64>;
+};
+
+/**
+   The slots are probed linearly group by group, and removals shift the following slots back instead of leaving
+   tombstones. So all the slots between the first probed slot of a key and the key itself are filled, and a lookup
+   can stop at the first group containing an empty slot.
+**/
+template <typename KeyOf, typename Slot, typename K>
+inline u32 find_slot(const u8 *ctrl, const Slot *slots, u32 capacity, const K &key, MapHash hash)
+{
+	const u32 mask = capacity - 1;
+	u32 pos = hash.h1 & mask;
+	for (u32 i_probe = 0; i_probe <= capacity; i_probe += MAP_GROUP_WIDTH) {
+		for (u32 matches = match_group(ctrl + pos, hash.h2); matches != 0; matches &= matches - 1) {
+			const u32 i_slot = (pos + u32(std::countr_zero(matches))) & mask;
+			if (KeyOf::get(slots[i_slot]) == key) [[likely]] {
+				return i_slot;
 			}
-			std::swap(values[i_slot], value_to_insert);
-			std::swap(current_slot, slot_to_insert);
 		}
-
-		slot_to_insert.bits.psl += 1;
+		if (match_group_empty(ctrl + pos) != 0) [[likely]] {
+			return u32_invalid;
+		}
+		pos = (pos + MAP_GROUP_WIDTH) & mask;
 	}
+	return u32_invalid;
+}
 
-	// Finally, insert the key at the empty slot
-	slots[i_slot] = slot_to_insert;
+inline u32 find_empty_slot(const u8 *ctrl, u32 capacity, MapHash hash)
+{
+	const u32 mask = capacity - 1;
+	u32 pos = hash.h1 & mask;
+	while (true) {
+		if (const u32 empties = match_group_empty(ctrl + pos); empties != 0) [[likely]] {
+			return (pos + u32(std::countr_zero(empties))) & mask;
+		}
+		pos = (pos + MAP_GROUP_WIDTH) & mask;
+	}
+}
 
-	if constexpr (std::is_move_constructible_v<T>) {
-		new (&values[i_slot]) T(std::move(value_to_insert));
-	} else {
-		new (&values[i_slot]) T(value_to_insert);
+// Destroys the slot and moves back the following slots that can be closer to their first probed slot
+template <typename KeyOf, typename Slot>
+inline void erase_slot(u8 *ctrl, Slot *slots, u32 capacity, u32 i_slot)
+{
+	const u32 mask = capacity - 1;
+	u32 hole = i_slot;
+	slots[hole].~Slot();
+
+	for (u32 i_next = (hole + 1) & mask; ctrl[i_next] != MAP_CTRL_EMPTY; i_next = (i_next + 1) & mask) {
+		const u32 home = split_map_hash(hash_value(KeyOf::get(slots[i_next]))).h1 & mask;
+		// The slot can be moved into the hole only if the hole is between its first probed slot and itself
+		if (((i_next - home) & mask) >= ((i_next - hole) & mask)) {
+			new (&slots[hole]) Slot(std::move(slots[i_next]));
+			slots[i_next].~Slot();
+			set_ctrl(ctrl, capacity, hole, ctrl[i_next]);
+			hole = i_next;
+		}
 	}
 
-	return i_original_key_slot;
+	set_ctrl(ctrl, capacity, hole, MAP_CTRL_EMPTY);
+}
+
+template <typename Slot>
+inline void destroy_slots(DynamicBuffer &ctrl_buffer, DynamicBuffer &slots_buffer, u32 capacity)
+{
+	if constexpr (!std::is_trivially_destructible_v<Slot>) {
+		if (ctrl_buffer.ptr != nullptr) {
+			const auto *ctrl = static_cast<const u8 *>(ctrl_buffer.ptr);
+			auto *slots = static_cast<Slot *>(slots_buffer.ptr);
+			for (u32 i_slot = 0; i_slot < capacity; ++i_slot) {
+				if (ctrl[i_slot] != MAP_CTRL_EMPTY) {
+					slots[i_slot].~Slot();
+				}
+			}
+		}
+	}
 }
 
-template <typename T>
-inline void resize_and_rehash(DynamicBuffer &slots_buffer, DynamicBuffer &keyvalues_buffer, u32 &capacity)
+template <typename KeyOf, typename Slot>
+inline void resize_and_rehash(DynamicBuffer &ctrl_buffer, DynamicBuffer &slots_buffer, u32 &capacity)
 {
-	auto new_capacity = capacity == 0 ? 2 : 2u * capacity;
+	const u32 new_capacity = capacity == 0 ? 8 : 2u * capacity;
 
-	// Create the new buffers to hold slots and values
+	DynamicBuffer new_ctrl_buffer = {};
 	DynamicBuffer new_slots_buffer = {};
-	DynamicBuffer new_keyvalues_buffer = {};
-	DynamicBuffer::init(new_slots_buffer, new_capacity * sizeof(MapSlot));
-	DynamicBuffer::init(new_keyvalues_buffer, new_capacity * sizeof(T));
-
-	// Update the map to point to new buffers, keep the old alloc to rehash slots
-	auto old_capacity = capacity;
-	DynamicBuffer old_slots_buffer = std::move(slots_buffer);
-	DynamicBuffer old_keyvalues_buffer = std::move(keyvalues_buffer);
-
-	// Rehash all filled values
-	const auto old_slots = exo::reinterpret_span<MapSlot>(old_slots_buffer.content());
-	const auto old_values = exo::reinterpret_span<T>(old_keyvalues_buffer.content());
-	const auto new_slots = exo::reinterpret_span<MapSlot>(new_slots_buffer.content());
-	const auto new_values = exo::reinterpret_span<T>(new_keyvalues_buffer.content());
-
-	for (u32 i = 0; i < old_capacity; ++i) {
-		if (old_slots[i].bits.is_filled) {
-			old_slots[i].bits.psl = 0;
-			details::insert_slot<T>(new_slots, new_values, std::move(old_slots[i]), std::move(old_values[i]));
+	new_ctrl_buffer.allocator = ctrl_buffer.allocator;
+	new_slots_buffer.allocator = slots_buffer.allocator;
+	init_ctrl(new_ctrl_buffer, new_capacity);
+	DynamicBuffer::init(new_slots_buffer, new_capacity * sizeof(Slot));
+
+	auto *new_ctrl = static_cast<u8 *>(new_ctrl_buffer.ptr);
+	auto *new_slots = static_cast<Slot *>(new_slots_buffer.ptr);
+	if (capacity > 0) {
+		const auto *old_ctrl = static_cast<const u8 *>(ctrl_buffer.ptr);
+		auto *old_slots = static_cast<Slot *>(slots_buffer.ptr);
+		for (u32 i_slot = 0; i_slot < capacity; ++i_slot) {
+			if (old_ctrl[i_slot] == MAP_CTRL_EMPTY) {
+				continue;
+			}
+			const auto hash = split_map_hash(hash_value(KeyOf::get(old_slots[i_slot])));
+			const u32 new_slot = find_empty_slot(new_ctrl, new_capacity, hash);
+			new (&new_slots[new_slot]) Slot(std::move(old_slots[i_slot]));
+			old_slots[i_slot].~Slot();
+			set_ctrl(new_ctrl, new_capacity, new_slot, hash.h2);
 		}
 	}
 
+	ctrl_buffer.destroy();
+	slots_buffer.destroy();
+	ctrl_buffer = std::move(new_ctrl_buffer);
 	slots_buffer = std::move(new_slots_buffer);
-	keyvalues_buffer = std::move(new_keyvalues_buffer);
 	capacity = new_capacity;
-
-	old_slots_buffer.destroy();
-	old_keyvalues_buffer.destroy();
 }
 } // namespace details
 
@@ -161,7 +229,8 @@ struct MapConstIterator;
 
 /**
    The exo::Map is a "flat" hashmap, implemented with open addressing to have contigous memory allocation.
-   It uses linear probing with robin-hood hashing.
+   It is a swiss table: control bytes are probed by SIMD groups, keys are compared with operator==.
+   Lookups also accept other types comparable to the key that hash the same (see details::MapLookupKey).
 **/
 template <typename Key, typename Value>
 struct Map
@@ -175,22 +244,34 @@ struct Map
 	u32 capacity = 0;
 	u32 size = 0;
 	DynamicBuffer keyvalues_buffer = {};
-	DynamicBuffer slots_buffer = {};
+	DynamicBuffer slots_buffer = {}; // control bytes
 
 	// --
 
 	Map() = default;
-	~Map()
-	{
-		this->keyvalues_buffer.destroy();
-		this->slots_buffer.destroy();
-	}
+	~Map() { this->destroy(); }
 
 	Map(const Map &copy) = delete;
 	Map &operator=(const Map &copy) = delete;
 
-	Map(Map &&moved) noexcept = default;
-	Map &operator=(Map &&moved) = default;
+	Map(Map &&moved) noexcept { *this = std::move(moved); }
+	Map &operator=(Map &&moved) noexcept
+	{
+		this->destroy();
+		this->capacity = std::exchange(moved.capacity, 0u);
+		this->size = std::exchange(moved.size, 0u);
+		this->keyvalues_buffer = std::move(moved.keyvalues_buffer);
+		this->slots_buffer = std::move(moved.slots_buffer);
+		return *this;
+	}
+
+	static Map with_allocator(Allocator *allocator)
+	{
+		Map map = {};
+		map.keyvalues_buffer.allocator = allocator;
+		map.slots_buffer.allocator = allocator;
+		return map;
+	}
 
 	static Map with_capacity(u32 new_capacity)
 	{
@@ -199,7 +280,7 @@ struct Map
 		Map map = {};
 		map.capacity = new_capacity;
 		DynamicBuffer::init(map.keyvalues_buffer, new_capacity * sizeof(Map::KeyValue));
-		DynamicBuffer::init(map.slots_buffer, new_capacity * sizeof(details::MapSlot));
+		details::init_ctrl(map.slots_buffer, new_capacity);
 		return map;
 	}
 
@@ -212,147 +293,144 @@ struct Map
 
 	// -- Capacity
 
-	bool is_empty() const { return this->size > 0; }
+	bool is_empty() const { return this->size == 0; }
 
 	// -- Modifiers
 
+	// Replaces the value if the key is already in the map
 	Value *insert(Key key, Value &&value)
 	{
-		auto max_load_size = (this->capacity * EXO_MAP_MAX_LOAD_FACTOR_NOM) / EXO_MAP_MAX_LOAD_FACTOR_DENOM;
-		if (this->size + 1 > max_load_size) [[unlikely]] {
-			details::resize_and_rehash<KeyValue>(this->slots_buffer, this->keyvalues_buffer, this->capacity);
+		const auto hash = details::split_map_hash(hash_value(key));
+		if (auto *keyvalue = this->find(key, hash)) {
+			keyvalue->value = std::move(value);
+			return &keyvalue->value;
 		}
-
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-		const auto keyvalues = exo::reinterpret_span<KeyValue>(this->keyvalues_buffer.content());
-
-		details::MapSlot slot_to_insert;
-		slot_to_insert.bits.is_filled = 1;
-		slot_to_insert.bits.psl = 0;
-		slot_to_insert.bits.hash = u32(hash_value(key));
-		u32 i_slot = details::insert_slot(slots, keyvalues, std::move(slot_to_insert), KeyValue{key, std::move(value)});
-
-		ASSERT(i_slot < this->capacity);
-		this->size += 1;
-		return &keyvalues[i_slot].value;
+		return &this->insert_new(hash, KeyValue{std::move(key), std::move(value)})->value;
 	}
 
 	Value *insert(Key key, const Value &value)
 	{
-		auto max_load_size = (this->capacity * EXO_MAP_MAX_LOAD_FACTOR_NOM) / EXO_MAP_MAX_LOAD_FACTOR_DENOM;
-		if (this->size == 0 || this->size + 1 > max_load_size) [[unlikely]] {
-			details::resize_and_rehash<KeyValue>(this->slots_buffer, this->keyvalues_buffer, this->capacity);
+		const auto hash = details::split_map_hash(hash_value(key));
+		if (auto *keyvalue = this->find(key, hash)) {
+			keyvalue->value = value;
+			return &keyvalue->value;
 		}
+		return &this->insert_new(hash, KeyValue{std::move(key), value})->value;
+	}
 
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-		const auto keyvalues = exo::reinterpret_span<KeyValue>(this->keyvalues_buffer.content());
-
-		details::MapSlot slot_to_insert;
-		slot_to_insert.bits.is_filled = 1;
-		slot_to_insert.bits.psl = 0;
-		slot_to_insert.bits.hash = u32(hash_value(key));
-		u32 i_slot = details::insert_slot(slots, keyvalues, std::move(slot_to_insert), KeyValue{key, value});
+	void remove(const Key &key) { this->remove_impl(key); }
 
-		ASSERT(i_slot < this->capacity);
-		this->size += 1;
-		return &keyvalues[i_slot].value;
+	template <typename K>
+		requires details::MapLookupKey<Key, K>
+	void remove(const K &key)
+	{
+		this->remove_impl(key);
 	}
 
-	void remove(const Key &key)
+	void clear()
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-		const auto hash = hash_value(key);
-
-		const u32 i_slot = details::probe_by_hash(slots, hash);
-
-		// Not found
-		if (i_slot == u32_invalid) {
-			ASSERT(false);
-			return;
+		details::destroy_slots<KeyValue>(this->slots_buffer, this->keyvalues_buffer, this->capacity);
+		if (this->slots_buffer.ptr != nullptr) {
+			std::memset(this->slots_buffer.ptr, details::MAP_CTRL_EMPTY, this->slots_buffer.size);
 		}
+		this->size = 0;
+	}
 
-		const auto keyvalues = exo::reinterpret_span<KeyValue>(this->keyvalues_buffer.content());
-
-		// The key was found at slot i_slot, remove it and backward shift all values to fill the hole
-		u32 i = 0;
-		for (; i < this->capacity; ++i) {
-			const auto current_slot = details::power_of_2_modulo((i_slot + i), this->capacity);
-			const auto next_slot = details::power_of_2_modulo((i_slot + i + 1), this->capacity);
-
-			if (slots[next_slot].bits.is_filled == 0 || slots[next_slot].bits.psl == 0) {
-				// All elements are shifted towards 0, so whenever we break, the current_slot was already copied to the
-				// previous_slot
-				slots[current_slot] = {};
-				keyvalues[current_slot].~KeyValue();
-				break;
-			}
+	// -- Lookup
 
-			slots[current_slot] = slots[next_slot];
-			ASSERT(slots[current_slot].bits.psl != 0);
-			slots[current_slot].bits.psl -= 1;
-			keyvalues[current_slot] = std::move(keyvalues[next_slot]);
-		}
+	Value *at(const Key &key) { return this->at_impl(key); }
+	const Value *at(const Key &key) const { return const_cast<Map *>(this)->at_impl(key); }
 
-		this->size -= 1;
+	template <typename K>
+		requires details::MapLookupKey<Key, K>
+	Value *at(const K &key)
+	{
+		return this->at_impl(key);
 	}
 
-	void clear()
+	template <typename K>
+		requires details::MapLookupKey<Key, K>
+	const Value *at(const K &key) const
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-		const auto keyvalues = exo::reinterpret_span<KeyValue>(this->keyvalues_buffer.content());
+		return const_cast<Map *>(this)->at_impl(key);
+	}
 
-		for (u32 i = 0; i < this->capacity; ++i) {
-			if (slots[i].bits.is_filled) {
-				keyvalues[i].~KeyValue();
-			}
-			slots[i] = {};
-		}
+	bool contains(const Key &key) const { return this->at(key) != nullptr; }
 
-		this->size = 0;
+	template <typename K>
+		requires details::MapLookupKey<Key, K>
+	bool contains(const K &key) const
+	{
+		return this->at(key) != nullptr;
 	}
 
-	// -- Lookup
+private:
+	void destroy()
+	{
+		details::destroy_slots<KeyValue>(this->slots_buffer, this->keyvalues_buffer, this->capacity);
+		this->keyvalues_buffer.destroy();
+		this->slots_buffer.destroy();
+		this->capacity = 0;
+		this->size = 0;
+	}
 
-	Value *at(const Key &key)
+	template <typename K>
+	KeyValue *find(const K &key, details::MapHash hash)
 	{
 		if (this->size == 0) {
 			return nullptr;
 		}
 
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-		const auto hash = hash_value(key);
+		const auto *ctrl = static_cast<const u8 *>(this->slots_buffer.ptr);
+		auto *keyvalues = static_cast<KeyValue *>(this->keyvalues_buffer.ptr);
+		const u32 i_slot = details::find_slot<details::KeyValueKey>(ctrl, keyvalues, this->capacity, key, hash);
+		return i_slot != u32_invalid ? &keyvalues[i_slot] : nullptr;
+	}
 
-		u32 i_slot = details::probe_by_hash(slots, hash);
+	template <typename K>
+	Value *at_impl(const K &key)
+	{
+		auto *keyvalue = this->find(key, details::split_map_hash(hash_value(key)));
+		return keyvalue ? &keyvalue->value : nullptr;
+	}
 
-		// key not found
-		if (i_slot == u32_invalid) {
-			return nullptr;
+	template <typename K>
+	void remove_impl(const K &key)
+	{
+		auto *keyvalue = this->find(key, details::split_map_hash(hash_value(key)));
+
+		// Not found
+		if (keyvalue == nullptr) {
+			ASSERT(false);
+			return;
 		}
 
-		ASSERT(slots[i_slot].bits.is_filled);
-		const auto keyvalues = exo::reinterpret_span<KeyValue>(this->keyvalues_buffer.content());
-		return &keyvalues[i_slot].value;
+		auto *keyvalues = static_cast<KeyValue *>(this->keyvalues_buffer.ptr);
+		const u32 i_slot = u32(keyvalue - keyvalues);
+		details::erase_slot<details::KeyValueKey>(static_cast<u8 *>(this->slots_buffer.ptr),
+			keyvalues,
+			this->capacity,
+			i_slot);
+		this->size -= 1;
 	}
 
-	const Value *at(const Key &key) const
+	KeyValue *insert_new(details::MapHash hash, KeyValue &&keyvalue)
 	{
-		if (this->size == 0) {
-			return nullptr;
+		const u32 max_load_size = (this->capacity * EXO_MAP_MAX_LOAD_FACTOR_NOM) / EXO_MAP_MAX_LOAD_FACTOR_DENOM;
+		if (this->size + 1 > max_load_size) [[unlikely]] {
+			details::resize_and_rehash<details::KeyValueKey, KeyValue>(this->slots_buffer,
+				this->keyvalues_buffer,
+				this->capacity);
 		}
 
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-		const auto hash = hash_value(key);
-
-		u32 i_slot = details::probe_by_hash(slots, hash);
-
-		// key not found
-		if (i_slot == u32_invalid) {
-			return nullptr;
-		}
+		auto *ctrl = static_cast<u8 *>(this->slots_buffer.ptr);
+		auto *keyvalues = static_cast<KeyValue *>(this->keyvalues_buffer.ptr);
+		const u32 i_slot = details::find_empty_slot(ctrl, this->capacity, hash);
+		new (&keyvalues[i_slot]) KeyValue(std::move(keyvalue));
+		details::set_ctrl(ctrl, this->capacity, i_slot, hash.h2);
 
-		ASSERT(slots[i_slot].bits.is_filled);
-		const auto keyvalues = exo::reinterpret_span<KeyValue>(this->keyvalues_buffer.content());
-		return &keyvalues[i_slot].value;
+		this->size += 1;
+		return &keyvalues[i_slot];
 	}
 };
 
@@ -365,8 +443,7 @@ struct MapIterator : IteratorFacade<MapIterator<K, V>>
 	MapIterator() = default;
 	MapIterator(Map<K, V> *_Map, u32 _index = 0) : map{_Map}, current_index{_index}
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->map->slots_buffer.content());
-		if (this->current_index < this->map->capacity && slots[this->current_index].bits.is_filled == 0) {
+		if (this->current_index < this->map->capacity && !this->is_filled()) {
 			this->increment();
 		}
 	}
@@ -379,10 +456,8 @@ struct MapIterator : IteratorFacade<MapIterator<K, V>>
 
 	void increment()
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->map->slots_buffer.content());
-
 		for (current_index = current_index + 1; current_index < this->map->capacity; current_index += 1) {
-			if (slots[current_index].bits.is_filled == 1) {
+			if (this->is_filled()) {
 				break;
 			}
 		}
@@ -393,6 +468,11 @@ struct MapIterator : IteratorFacade<MapIterator<K, V>>
 		return this->map == other.map && this->current_index == other.current_index;
 	}
 
+	bool is_filled() const
+	{
+		return static_cast<const u8 *>(this->map->slots_buffer.ptr)[this->current_index] != details::MAP_CTRL_EMPTY;
+	}
+
 	Map<K, V> *map = nullptr;
 	u32 current_index = u32_invalid;
 };
@@ -405,24 +485,21 @@ struct MapConstIterator : IteratorFacade<MapConstIterator<K, V>>
 	MapConstIterator() = default;
 	MapConstIterator(const Map<K, V> *_Map, u32 _index = 0) : map{_Map}, current_index{_index}
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->map->slots_buffer.content());
-		if (this->current_index < this->map->capacity && slots[this->current_index].bits.is_filled == 0) {
+		if (this->current_index < this->map->capacity && !this->is_filled()) {
 			this->increment();
 		}
 	}
 
 	const KeyValue &dereference() const
 	{
-		const auto keyvalues = exo::reinterpret_span<KeyValue>(this->map->keyvalues_buffer.content());
+		const auto keyvalues = exo::reinterpret_span<const KeyValue>(this->map->keyvalues_buffer.content());
 		return keyvalues[this->current_index];
 	}
 
 	void increment()
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->map->slots_buffer.content());
-
 		for (current_index = current_index + 1; current_index < this->map->capacity; current_index += 1) {
-			if (slots[current_index].bits.is_filled == 1) {
+			if (this->is_filled()) {
 				break;
 			}
 		}
@@ -433,6 +510,11 @@ struct MapConstIterator : IteratorFacade<MapConstIterator<K, V>>
 		return this->map == other.map && this->current_index == other.current_index;
 	}
 
+	bool is_filled() const
+	{
+		return static_cast<const u8 *>(this->map->slots_buffer.ptr)[this->current_index] != details::MAP_CTRL_EMPTY;
+	}
+
 	const Map<K, V> *map = nullptr;
 	u32 current_index = u32_invalid;
 };
@@ -2,10 +2,13 @@
 
 #include "exo/collections/handle.h"
 #include "exo/collections/iterator_facade.h"
+#include "exo/collections/vector.h"
 #include "exo/macros/assert.h"
 #include "exo/maths/pointer.h"
 #include "exo/memory/dynamic_buffer.h"
 
+#include <bit>
+#include <cstring>
 #include <utility>
 
 /**
@@ -14,9 +17,8 @@
    The Pool returns Handles instead of pointers, so that it can realloc memory blocks and detect use-after-free hazards.
    Performance:
      Adding/removing elements is O(1).
-     Iterating is O(capacity), elements are NOT tighly packed because of the free-list.
-
-   TODO: Add run length of holes in the metdata to skip big holes when iterating.
+     Iterating is O(size + capacity / 64), an occupancy bitmap is scanned to skip the holes 64 elements at a time.
+     Elements are NOT tighly packed because of the free-list, `compact` moves them to the front of the buffer.
  **/
 
 namespace exo
@@ -35,6 +37,7 @@ struct Pool
 
 	Pool() = default;
 	explicit Pool(u32 _capacity);
+	static Pool with_allocator(Allocator *allocator);
 	~Pool();
 
 	Pool(const Pool &other)            = delete;
@@ -50,6 +53,10 @@ struct Pool
 	void      remove(Handle<T> handle);
 	void      clear();
 
+	// Moves the elements into the first `size` slots, returns the new handle of each old index (invalid for holes).
+	// Handles to moved elements become invalid.
+	Vec<Handle<T>> compact();
+
 	PoolIterator<T> begin();
 	PoolIterator<T> end();
 
@@ -59,6 +66,7 @@ struct Pool
 	bool operator==(const Pool &rhs) const = default;
 
 	DynamicBuffer buffer        = {};
+	DynamicBuffer occupancy     = {}; // one bit per element
 	u32           freelist_head = u32_invalid;
 	u32           size          = 0;
 	u32           capacity      = 0;
@@ -92,6 +100,82 @@ const T *element_ptr(const Pool<T> &pool, u32 i)
 		ptr_offset(pool.buffer.ptr, i * (Pool<T>::ELEMENT_SIZE() + sizeof(ElementMetadata)) + sizeof(ElementMetadata)));
 }
 
+template <typename T>
+u64 *occupancy_ptr(Pool<T> &pool)
+{
+	return static_cast<u64 *>(pool.occupancy.ptr);
+}
+
+template <typename T>
+const u64 *occupancy_ptr(const Pool<T> &pool)
+{
+	return static_cast<const u64 *>(pool.occupancy.ptr);
+}
+
+template <typename T>
+void set_occupied(Pool<T> &pool, u32 i, bool is_occupied)
+{
+	u64 &word = occupancy_ptr(pool)[i / 64];
+	if (is_occupied) {
+		word |= u64(1) << (i % 64);
+	} else {
+		word &= ~(u64(1) << (i % 64));
+	}
+}
+
+// Grows the bitmap to the capacity of the pool, new elements are not occupied
+template <typename T>
+void resize_occupancy(Pool<T> &pool)
+{
+	const usize old_size = pool.occupancy.size;
+	const usize new_size = ((pool.capacity + 63) / 64) * sizeof(u64);
+	if (new_size <= old_size) {
+		return;
+	}
+
+	if (old_size == 0) {
+		DynamicBuffer::init(pool.occupancy, new_size);
+	} else {
+		pool.occupancy.resize(new_size);
+		std::memset(static_cast<u8 *>(pool.occupancy.ptr) + old_size, 0, new_size - old_size);
+	}
+}
+
+// Sizes the bitmap to the capacity of the pool with no element occupied, the bitmap may be reused from a previous
+// content of the pool
+template <typename T>
+void init_occupancy(Pool<T> &pool)
+{
+	resize_occupancy(pool);
+	if (pool.occupancy.ptr) {
+		std::memset(pool.occupancy.ptr, 0, pool.occupancy.size);
+	}
+}
+
+// Returns the first occupied index starting from `i`, or the capacity
+template <typename T>
+u32 next_occupied(const Pool<T> &pool, u32 i)
+{
+	const u64 *words      = occupancy_ptr(pool);
+	const u32  word_count = (pool.capacity + 63) / 64;
+
+	u32 i_word = i / 64;
+	if (i_word >= word_count) {
+		return pool.capacity;
+	}
+
+	// Mask the bits before `i` in the first word
+	u64 word = words[i_word] & (~u64(0) << (i % 64));
+	while (word == 0) {
+		i_word += 1;
+		if (i_word >= word_count) {
+			return pool.capacity;
+		}
+		word = words[i_word];
+	}
+	return i_word * 64 + u32(std::countr_zero(word));
+}
+
 template <typename T>
 u32 *freelist_ptr(Pool<T> &pool, u32 i)
 {
@@ -134,15 +218,7 @@ struct PoolIterator : IteratorFacade<PoolIterator<T>>
 		return std::make_pair(handle, element);
 	}
 
-	void increment()
-	{
-		for (current_index = current_index + 1; current_index < pool->capacity; current_index += 1) {
-			auto *metadata = metadata_ptr(*pool, current_index);
-			if (metadata->bits.is_occupied == 1) {
-				break;
-			}
-		}
-	}
+	void increment() { current_index = next_occupied(*pool, current_index + 1); }
 
 	bool equal_to(const PoolIterator &other) const
 	{
@@ -168,16 +244,7 @@ struct ConstPoolIterator : IteratorFacade<ConstPoolIterator<T>>
 		return std::make_pair(handle, element);
 	}
 
-	void increment()
-	{
-		for (current_index = current_index + 1; current_index < pool->capacity; current_index += 1) {
-			auto *metadata = metadata_ptr(*pool, current_index);
-			auto *element  = element_ptr(*pool, current_index);
-			if (metadata->bits.is_occupied == 1) {
-				break;
-			}
-		}
-	}
+	void increment() { current_index = next_occupied(*pool, current_index + 1); }
 
 	bool equal_to(const ConstPoolIterator &other) const
 	{
@@ -199,6 +266,7 @@ Pool<T>::Pool(u32 _capacity)
 
 	usize buffer_size = capacity * (Pool<T>::ELEMENT_SIZE() + sizeof(ElementMetadata));
 	DynamicBuffer::init(this->buffer, buffer_size);
+	init_occupancy(*this);
 
 	// Init the free list
 	freelist_head = 0;
@@ -214,10 +282,20 @@ Pool<T>::Pool(u32 _capacity)
 	*freelist_ptr(*this, capacity - 1)     = u32_invalid;
 }
 
+template <typename T>
+Pool<T> Pool<T>::with_allocator(Allocator *allocator)
+{
+	Pool pool                = {};
+	pool.buffer.allocator    = allocator;
+	pool.occupancy.allocator = allocator;
+	return pool;
+}
+
 template <typename T>
 Pool<T>::~Pool()
 {
 	this->buffer.destroy();
+	this->occupancy.destroy();
 }
 
 template <typename T>
@@ -229,7 +307,10 @@ Pool<T>::Pool(Pool &&other)
 template <typename T>
 Pool<T> &Pool<T>::operator=(Pool &&other)
 {
-	this->buffer        = std::exchange(other.buffer, {});
+	this->buffer.destroy();
+	this->occupancy.destroy();
+	this->buffer        = std::move(other.buffer);
+	this->occupancy     = std::move(other.occupancy);
 	this->freelist_head = std::exchange(other.freelist_head, u32_invalid);
 	this->size          = std::exchange(other.size, 0);
 	this->capacity      = std::exchange(other.capacity, 0);
@@ -265,6 +346,7 @@ Handle<T> Pool<T>::add(T &&value)
 		*freelist_ptr(*this, new_capacity - 1)     = u32_invalid;
 
 		capacity = new_capacity;
+		resize_occupancy(*this);
 	}
 
 	ASSERT(size + 1 <= capacity);
@@ -278,6 +360,7 @@ Handle<T> Pool<T>::add(T &&value)
 	auto *metadata = metadata_ptr(*this, i_element);
 	ASSERT(metadata->bits.is_occupied == 0);
 	metadata->bits.is_occupied = 1;
+	set_occupied(*this, i_element, true);
 
 	size += 1;
 
@@ -326,6 +409,7 @@ void Pool<T>::remove(Handle<T> handle)
 	element->~T();
 	metadata->bits.generation  = metadata->bits.generation + 1;
 	metadata->bits.is_occupied = 0;
+	set_occupied(*this, handle.index, false);
 
 	// Push this slot to the head of the free list
 	*freelist     = freelist_head;
@@ -337,8 +421,13 @@ void Pool<T>::remove(Handle<T> handle)
 template <typename T>
 void Pool<T>::clear()
 {
-	this->size          = 0;
+	this->size = 0;
+	if (this->capacity == 0) {
+		return;
+	}
+
 	this->freelist_head = 0;
+	std::memset(this->occupancy.ptr, 0, this->occupancy.size);
 
 	for (u32 i = 0; i < this->capacity; i += 1) {
 		auto *metadata = metadata_ptr(*this, i);
@@ -358,16 +447,56 @@ void Pool<T>::clear()
 }
 
 template <typename T>
-PoolIterator<T> Pool<T>::begin()
+Vec<Handle<T>> Pool<T>::compact()
 {
-	u32 i_element = 0;
-	for (; i_element < capacity; i_element += 1) {
-		auto *metadata = metadata_ptr(*this, i_element);
-		if (metadata->bits.is_occupied) {
+	auto remap = Vec<Handle<T>>::with_values(this->capacity, Handle<T>::invalid());
+
+	// Move the last elements into the first holes
+	u32 i_hole = 0;
+	u32 i_last = this->capacity;
+	while (true) {
+		while (i_hole < this->size && metadata_ptr(*this, i_hole)->bits.is_occupied) {
+			remap[i_hole] = {i_hole, metadata_ptr(*this, i_hole)->bits.generation};
+			i_hole += 1;
+		}
+		if (i_hole >= this->size) {
 			break;
 		}
+
+		do {
+			i_last -= 1;
+		} while (metadata_ptr(*this, i_last)->bits.is_occupied == 0);
+
+		auto *hole_metadata = metadata_ptr(*this, i_hole);
+		auto *last_metadata = metadata_ptr(*this, i_last);
+		auto *last_element  = element_ptr(*this, i_last);
+		new (element_ptr(*this, i_hole)) T{std::move(*last_element)};
+		last_element->~T();
+
+		// The hole keeps its generation, it is already newer than the handles of its previous elements
+		hole_metadata->bits.is_occupied = 1;
+		last_metadata->bits.is_occupied = 0;
+		last_metadata->bits.generation  = last_metadata->bits.generation + 1;
+		set_occupied(*this, i_hole, true);
+		set_occupied(*this, i_last, false);
+
+		remap[i_last] = {i_hole, hole_metadata->bits.generation};
+		i_hole += 1;
 	}
-	return PoolIterator<T>(this, i_element);
+
+	// Rebuild the free list in order so that new elements are added after the packed ones
+	this->freelist_head = this->size < this->capacity ? this->size : u32_invalid;
+	for (u32 i = this->size; i < this->capacity; i += 1) {
+		*freelist_ptr(*this, i) = i + 1 < this->capacity ? i + 1 : u32_invalid;
+	}
+
+	return remap;
+}
+
+template <typename T>
+PoolIterator<T> Pool<T>::begin()
+{
+	return PoolIterator<T>(this, next_occupied(*this, 0));
 }
 
 template <typename T>
@@ -379,14 +508,7 @@ PoolIterator<T> Pool<T>::end()
 template <typename T>
 ConstPoolIterator<T> Pool<T>::begin() const
 {
-	u32 i_element = 0;
-	for (; i_element < capacity; i_element += 1) {
-		auto *metadata = metadata_ptr(*this, i_element);
-		if (metadata->bits.is_occupied) {
-			break;
-		}
-	}
-	return ConstPoolIterator<T>(this, i_element);
+	return ConstPoolIterator<T>(this, next_occupied(*this, 0));
 }
 
 template <typename T>
@@ -14,7 +14,7 @@ struct SetConstIterator;
 
 /**
    The exo::Set is a "flat" hashset, implemented with open addressing to have contigous memory allocation.
-   It uses linear probing with robin-hood hashing.
+   It shares the swiss table implementation of exo::Map.
 **/
 template <typename T>
 struct Set
@@ -22,14 +22,10 @@ struct Set
 	u32           capacity      = 0;
 	u32           size          = 0;
 	DynamicBuffer values_buffer = {};
-	DynamicBuffer slots_buffer  = {};
+	DynamicBuffer slots_buffer  = {}; // control bytes
 
 	static Set with_capacity(u32 new_capacity);
-	inline ~Set()
-	{
-		this->values_buffer.destroy();
-		this->slots_buffer.destroy();
-	}
+	inline ~Set() { this->destroy(); }
 
 	Set() = default;
 
@@ -39,8 +35,9 @@ struct Set
 	inline Set(Set &&moved) noexcept { *this = std::move(moved); }
 	inline Set &operator=(Set &&moved) noexcept
 	{
-		this->capacity      = moved.capacity;
-		this->size          = moved.size;
+		this->destroy();
+		this->capacity      = std::exchange(moved.capacity, 0u);
+		this->size          = std::exchange(moved.size, 0u);
 		this->values_buffer = std::move(moved.values_buffer);
 		this->slots_buffer  = std::move(moved.slots_buffer);
 		return *this;
@@ -53,10 +50,15 @@ struct Set
 	SetConstIterator<T> begin() const { return SetConstIterator<T>(this); }
 	SetConstIterator<T> end() const { return SetConstIterator<T>(this, this->capacity); }
 
-	bool contains(const T &value);
+	bool contains(const T &value) const;
 	T   *insert(T &&value);
 	T   *insert(const T &value);
 	void remove(const T &value);
+
+private:
+	void destroy();
+	u32  find(const T &value, details::MapHash hash) const;
+	T   *insert_new(details::MapHash hash, T &&value);
 };
 
 template <typename T>
@@ -67,75 +69,82 @@ Set<T> Set<T>::with_capacity(u32 new_capacity)
 	Set set      = {};
 	set.capacity = new_capacity;
 	DynamicBuffer::init(set.values_buffer, new_capacity * sizeof(T));
-	DynamicBuffer::init(set.slots_buffer, new_capacity * sizeof(details::MapSlot));
+	details::init_ctrl(set.slots_buffer, new_capacity);
 	return set;
 }
 
 template <typename T>
-bool Set<T>::contains(const T &value)
+void Set<T>::destroy()
+{
+	details::destroy_slots<T>(this->slots_buffer, this->values_buffer, this->capacity);
+	this->values_buffer.destroy();
+	this->slots_buffer.destroy();
+	this->capacity = 0;
+	this->size     = 0;
+}
+
+template <typename T>
+u32 Set<T>::find(const T &value, details::MapHash hash) const
 {
 	if (this->size == 0) {
-		return false;
+		return u32_invalid;
 	}
 
-	const auto slots  = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-	const auto hash   = u32(hash_value(value));
-	u32        i_slot = details::probe_by_hash(slots, hash);
-
-	return i_slot != u32_invalid;
+	const auto *ctrl   = static_cast<const u8 *>(this->slots_buffer.ptr);
+	const auto *values = static_cast<const T *>(this->values_buffer.ptr);
+	return details::find_slot<details::IdentityKey>(ctrl, values, this->capacity, value, hash);
 }
 
 template <typename T>
-T *Set<T>::insert(T &&value)
+T *Set<T>::insert_new(details::MapHash hash, T &&value)
 {
 	auto max_load_size = (this->capacity * EXO_SET_MAX_LOAD_FACTOR_NOM) / EXO_SET_MAX_LOAD_FACTOR_DENOM;
 	if (this->size + 1 > max_load_size) [[unlikely]] {
-		details::resize_and_rehash<T>(this->slots_buffer, this->values_buffer, this->capacity);
+		details::resize_and_rehash<details::IdentityKey, T>(this->slots_buffer, this->values_buffer, this->capacity);
 	}
 
-	const auto slots  = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-	const auto values = exo::reinterpret_span<T>(this->values_buffer.content());
+	auto     *ctrl   = static_cast<u8 *>(this->slots_buffer.ptr);
+	auto     *values = static_cast<T *>(this->values_buffer.ptr);
+	const u32 i_slot = details::find_empty_slot(ctrl, this->capacity, hash);
+	new (&values[i_slot]) T(std::move(value));
+	details::set_ctrl(ctrl, this->capacity, i_slot, hash.h2);
 
-	details::MapSlot slot_to_insert;
-	slot_to_insert.bits.is_filled = 1;
-	slot_to_insert.bits.psl       = 0;
-	slot_to_insert.bits.hash      = u32(hash_value(value));
-	u32 i_slot                    = details::insert_slot(slots, values, std::move(slot_to_insert), std::move(value));
-
-	ASSERT(i_slot < this->capacity);
 	this->size += 1;
-	return &values[i_slot].value;
+	return &values[i_slot];
 }
 
 template <typename T>
-T *Set<T>::insert(const T &value)
+bool Set<T>::contains(const T &value) const
 {
-	auto max_load_size = (this->capacity * EXO_SET_MAX_LOAD_FACTOR_NOM) / EXO_SET_MAX_LOAD_FACTOR_DENOM;
-	if (this->size + 1 > max_load_size) [[unlikely]] {
-		details::resize_and_rehash<T>(this->slots_buffer, this->values_buffer, this->capacity);
-	}
-
-	const auto slots  = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-	const auto values = exo::reinterpret_span<T>(this->values_buffer.content());
+	return this->find(value, details::split_map_hash(hash_value(value))) != u32_invalid;
+}
 
-	details::MapSlot slot_to_insert;
-	slot_to_insert.bits.is_filled = 1;
-	slot_to_insert.bits.psl       = 0;
-	slot_to_insert.bits.hash      = u32(hash_value(value));
-	u32 i_slot                    = details::insert_slot(slots, values, std::move(slot_to_insert), T{value});
+template <typename T>
+T *Set<T>::insert(T &&value)
+{
+	const auto hash   = details::split_map_hash(hash_value(value));
+	const u32  i_slot = this->find(value, hash);
+	if (i_slot != u32_invalid) {
+		return &static_cast<T *>(this->values_buffer.ptr)[i_slot];
+	}
+	return this->insert_new(hash, std::move(value));
+}
 
-	ASSERT(i_slot < this->capacity);
-	this->size += 1;
-	return &values[i_slot];
+template <typename T>
+T *Set<T>::insert(const T &value)
+{
+	const auto hash   = details::split_map_hash(hash_value(value));
+	const u32  i_slot = this->find(value, hash);
+	if (i_slot != u32_invalid) {
+		return &static_cast<T *>(this->values_buffer.ptr)[i_slot];
+	}
+	return this->insert_new(hash, T{value});
 }
 
 template <typename T>
 void Set<T>::remove(const T &value)
 {
-	const auto slots = exo::reinterpret_span<details::MapSlot>(this->slots_buffer.content());
-	const auto hash  = u32(hash_value(value));
-
-	const u32 i_slot = details::probe_by_hash(slots, hash);
+	const u32 i_slot = this->find(value, details::split_map_hash(hash_value(value)));
 
 	// Not found
 	if (i_slot == u32_invalid) {
@@ -143,27 +152,10 @@ void Set<T>::remove(const T &value)
 		return;
 	}
 
-	const auto values = exo::reinterpret_span<T>(this->values_buffer.content());
-
-	// The key was found at slot i_slot, remove it and backward shift all values to fill the hole
-	for (u32 i = 0; i < this->capacity; ++i) {
-		const auto current_slot = details::power_of_2_modulo((i_slot + i), this->capacity);
-		const auto next_slot    = details::power_of_2_modulo((i_slot + i + 1), this->capacity);
-
-		if (slots[next_slot].bits.is_filled == 0 || slots[next_slot].bits.psl == 0) {
-			// All elements are shifted towards 0, so whenever we break, the current_slot was already copied to the
-			// previous_slot
-			slots[current_slot] = {};
-			values[current_slot].~T();
-			break;
-		}
-
-		slots[current_slot] = slots[next_slot];
-		ASSERT(slots[current_slot].bits.psl != 0);
-		slots[current_slot].bits.psl -= 1;
-		values[current_slot] = std::move(values[next_slot]);
-	}
-
+	details::erase_slot<details::IdentityKey>(static_cast<u8 *>(this->slots_buffer.ptr),
+		static_cast<T *>(this->values_buffer.ptr),
+		this->capacity,
+		i_slot);
 	this->size -= 1;
 }
 
@@ -174,8 +166,7 @@ struct SetIterator : IteratorFacade<SetIterator<T>>
 	SetIterator() = default;
 	SetIterator(Set<T> *_Set, u32 _index = 0) : set{_Set}, current_index{_index}
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->set->slots_buffer.content());
-		if (this->current_index < this->set->capacity && slots[this->current_index].bits.is_filled == 0) {
+		if (this->current_index < this->set->capacity && !this->is_filled()) {
 			this->increment();
 		}
 	}
@@ -188,10 +179,8 @@ struct SetIterator : IteratorFacade<SetIterator<T>>
 
 	void increment()
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->set->slots_buffer.content());
-
 		for (current_index = current_index + 1; current_index < this->set->capacity; current_index += 1) {
-			if (slots[current_index].bits.is_filled == 1) {
+			if (this->is_filled()) {
 				break;
 			}
 		}
@@ -202,34 +191,36 @@ struct SetIterator : IteratorFacade<SetIterator<T>>
 		return this->set == other.set && this->current_index == other.current_index;
 	}
 
+	bool is_filled() const
+	{
+		return static_cast<const u8 *>(this->set->slots_buffer.ptr)[this->current_index] != details::MAP_CTRL_EMPTY;
+	}
+
 	Set<T> *set           = nullptr;
 	u32     current_index = u32_invalid;
 };
 
 template <typename T>
-struct SetConstIterator : IteratorFacade<SetIterator<T>>
+struct SetConstIterator : IteratorFacade<SetConstIterator<T>>
 {
 	SetConstIterator() = default;
 	SetConstIterator(const Set<T> *_Set, u32 _index = 0) : set{_Set}, current_index{_index}
 	{
-		const auto slots = exo::reinterpret_span<const details::MapSlot>(this->set->slots_buffer.content());
-		if (this->current_index < this->set->capacity && slots[this->current_index].bits.is_filled == 0) {
+		if (this->current_index < this->set->capacity && !this->is_filled()) {
 			this->increment();
 		}
 	}
 
 	const T &dereference() const
 	{
-		const auto values = exo::reinterpret_span<T>(this->set->values_buffer.content());
+		const auto values = exo::reinterpret_span<const T>(this->set->values_buffer.content());
 		return values[this->current_index];
 	}
 
 	void increment()
 	{
-		const auto slots = exo::reinterpret_span<details::MapSlot>(this->set->slots_buffer.content());
-
 		for (current_index = current_index + 1; current_index < this->set->capacity; current_index += 1) {
-			if (slots[current_index].bits.is_filled == 1) {
+			if (this->is_filled()) {
 				break;
 			}
 		}
@@ -240,6 +231,11 @@ struct SetConstIterator : IteratorFacade<SetIterator<T>>
 		return this->set == other.set && this->current_index == other.current_index;
 	}
 
+	bool is_filled() const
+	{
+		return static_cast<const u8 *>(this->set->slots_buffer.ptr)[this->current_index] != details::MAP_CTRL_EMPTY;
+	}
+
 	const Set<T> *set           = nullptr;
 	u32           current_index = u32_invalid;
 };
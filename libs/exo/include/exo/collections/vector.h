@@ -38,6 +38,14 @@ struct Vec
 		return *this;
 	}
 
+	static Vec with_allocator(Allocator *allocator, u32 capacity = 0)
+	{
+		Vec result = {};
+		result.buffer.allocator = allocator;
+		result.reserve(capacity);
+		return result;
+	}
+
 	static Vec with_capacity(u32 capacity)
 	{
 		Vec result = {};
@@ -159,6 +167,7 @@ struct Vec
 		if (new_capacity_bytes > capacity_bytes) {
 			auto old_buffer = std::move(this->buffer);
 			DynamicBuffer new_buffer = {};
+			new_buffer.allocator = old_buffer.allocator;
 			DynamicBuffer::init(new_buffer, new_capacity_bytes);
 
 			const auto old_values = exo::reinterpret_span<T>(old_buffer.content());
@@ -0,0 +1,46 @@
+#pragma once
+#include "exo/maths/numerics.h"
+
+#include <cstddef>
+
+/**
+   Allocator is the interface used by the exo containers (through DynamicBuffer) to get their memory.
+   A null allocator means the global heap, so containers only need an allocator when they should live elsewhere,
+   for example in a per-frame ArenaAllocator or in a SizeClassAllocator for small fixed-size objects.
+
+   Allocators are NOT thread-safe, each allocator should be used by a single thread at a time.
+ **/
+
+namespace exo
+{
+struct AllocatorStats
+{
+	usize used_bytes       = 0; // bytes currently handed out
+	usize peak_used_bytes  = 0;
+	usize system_bytes     = 0; // bytes requested from the system (committed pages, heap blocks)
+	u64   allocation_count = 0; // total number of allocations
+};
+
+struct Allocator
+{
+	static constexpr usize DEFAULT_ALIGNMENT = alignof(std::max_align_t);
+
+	Allocator() = default;
+	explicit Allocator(const char *_name) : name{_name} {}
+	virtual ~Allocator() = default;
+
+	virtual void *allocate(usize size, usize alignment = DEFAULT_ALIGNMENT) = 0;
+	// The default implementation allocates a new block and copies the content
+	virtual void *reallocate(void *ptr, usize old_size, usize new_size, usize alignment = DEFAULT_ALIGNMENT);
+	virtual void  free(void *ptr, usize size) = 0;
+
+	// Must be a string literal, it is used as the name of the Tracy plot
+	const char    *name  = "Allocator";
+	AllocatorStats stats = {};
+
+protected:
+	void track_allocation(usize size);
+	void track_free(usize size);
+	void track_usage(usize used_bytes);
+};
+} // namespace exo
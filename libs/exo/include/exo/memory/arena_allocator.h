@@ -0,0 +1,50 @@
+#pragma once
+#include "exo/maths/numerics.h"
+#include "exo/memory/allocator.h"
+
+/**
+   An ArenaAllocator bumps a pointer in a virtual memory range that is reserved once and committed on demand, so it
+   can grow without moving its allocations.
+   Individual allocations are not freed (except the last one), the whole arena is rewound at once instead: a frame
+   arena is reset at the beginning of each frame.
+   Committed pages are kept when rewinding, they are released when the arena is destroyed.
+ **/
+
+namespace exo
+{
+struct ArenaAllocator final : Allocator
+{
+	static constexpr usize COMMIT_GRANULARITY = 64 << 10;
+
+	static ArenaAllocator with_reserve(usize reserve_size, const char *name = "Arena");
+
+	ArenaAllocator() = default;
+	~ArenaAllocator() override;
+
+	ArenaAllocator(const ArenaAllocator &other)            = delete;
+	ArenaAllocator &operator=(const ArenaAllocator &other) = delete;
+	ArenaAllocator(ArenaAllocator &&other) noexcept;
+	ArenaAllocator &operator=(ArenaAllocator &&other) noexcept;
+
+	void *allocate(usize size, usize alignment = DEFAULT_ALIGNMENT) override;
+	// The last allocation grows in place
+	void *reallocate(void *ptr, usize old_size, usize new_size, usize alignment = DEFAULT_ALIGNMENT) override;
+	// Only the last allocation is reclaimed
+	void free(void *ptr, usize size) override;
+
+	usize get_mark() const { return this->offset; }
+	void  rewind(usize mark);
+	void  reset() { this->rewind(0); }
+
+	usize get_reserved_size() const { return this->reserved_size; }
+
+private:
+	void commit_up_to(usize size);
+
+	u8   *base_address    = nullptr;
+	usize reserved_size   = 0;
+	usize committed_size  = 0;
+	usize offset          = 0;
+	usize last_allocation = usize(-1); // offset of the last allocation
+};
+} // namespace exo
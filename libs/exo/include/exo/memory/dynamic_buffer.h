@@ -4,10 +4,13 @@
 
 namespace exo
 {
+struct Allocator;
+
 struct DynamicBuffer
 {
-	void *ptr  = nullptr;
-	usize size = 0;
+	void      *ptr       = nullptr;
+	usize      size      = 0;
+	Allocator *allocator = nullptr; // the global heap when null
 
 	// --
 
@@ -18,21 +21,24 @@ struct DynamicBuffer
 
 	DynamicBuffer(DynamicBuffer &&moved) noexcept
 	{
-		this->ptr  = moved.ptr;
-		this->size = moved.size;
-		moved.ptr  = nullptr;
-		moved.size = 0;
+		this->ptr       = moved.ptr;
+		this->size      = moved.size;
+		this->allocator = moved.allocator;
+		moved.ptr       = nullptr;
+		moved.size      = 0;
 	}
 
 	DynamicBuffer &operator=(DynamicBuffer &&moved) noexcept
 	{
-		this->ptr  = moved.ptr;
-		this->size = moved.size;
-		moved.ptr  = nullptr;
-		moved.size = 0;
+		this->ptr       = moved.ptr;
+		this->size      = moved.size;
+		this->allocator = moved.allocator;
+		moved.ptr       = nullptr;
+		moved.size      = 0;
 		return *this;
 	}
 
+	// Allocates zeroed memory from `buffer.allocator`
 	static void init(DynamicBuffer &buffer, usize new_size);
 	void        destroy();
 
@@ -3,13 +3,21 @@
 
 namespace exo
 {
+/**
+   A LinearAllocator bumps a pointer and is rewound to a previous pointer (see ScopeStack), rewinds can be nested.
+   It either uses external memory, or reserves a virtual memory range and commits pages as it grows.
+ **/
 struct LinearAllocator
 {
 public:
+	static constexpr usize COMMIT_GRANULARITY = 64 << 10;
+
 	static LinearAllocator with_external_memory(void *p, usize len);
+	static LinearAllocator with_reserve(usize reserve_size);
 
-	LinearAllocator()                             = default;
-	LinearAllocator(const LinearAllocator &other) = delete;
+	LinearAllocator()                                        = default;
+	~LinearAllocator();
+	LinearAllocator(const LinearAllocator &other)            = delete;
 	LinearAllocator &operator=(const LinearAllocator &other) = delete;
 	LinearAllocator(LinearAllocator &&other) noexcept;
 	LinearAllocator &operator=(LinearAllocator &&other) noexcept;
@@ -24,12 +32,20 @@ public:
 
 	void *get_ptr() const { return ptr; }
 
+	usize get_used_size() const { return usize(this->ptr - this->base_address); }
+	// Maximum number of bytes used since the creation of the allocator
+	usize get_high_water_mark() const { return this->high_water_mark; }
+
 private:
-	u8 *base_address = nullptr;
-	u8 *ptr          = nullptr;
-	u8 *end          = nullptr;
+	void grow(usize size);
+
+	u8   *base_address    = nullptr;
+	u8   *ptr             = nullptr;
+	u8   *end             = nullptr; // end of the committed memory
+	u8   *reserved_end    = nullptr; // null when using external memory
+	usize high_water_mark = 0;
 };
 
-inline u8                tls_data[256 << 10];
-inline auto tls_allocator = LinearAllocator::with_external_memory(tls_data, sizeof(tls_data));
+// Scratch memory of the current thread, pages are committed on demand
+inline thread_local auto tls_allocator = LinearAllocator::with_reserve(256_MiB);
 }; // namespace exo
@@ -0,0 +1,54 @@
+#pragma once
+#include "exo/collections/vector.h"
+#include "exo/maths/numerics.h"
+#include "exo/memory/allocator.h"
+
+/**
+   A SizeClassAllocator serves small allocations from power-of-two size classes (16 to 2048 bytes).
+   Each size class carves its elements from 64 KiB blocks and keeps a free-list of released elements, so allocating
+   and freeing fixed-size objects (entities, components) are O(1) and do not fragment the heap.
+   Bigger allocations fall back to the heap. Blocks are released when the allocator is destroyed.
+ **/
+
+namespace exo
+{
+struct SizeClassAllocator final : Allocator
+{
+	static constexpr u32   MIN_SIZE_CLASS_SHIFT = 4;
+	static constexpr u32   SIZE_CLASS_COUNT     = 8;
+	static constexpr usize MAX_CLASS_SIZE       = usize(1) << (MIN_SIZE_CLASS_SHIFT + SIZE_CLASS_COUNT - 1);
+	static constexpr usize BLOCK_SIZE           = 64 << 10;
+
+	SizeClassAllocator() = default;
+	explicit SizeClassAllocator(const char *_name) : Allocator{_name} {}
+	~SizeClassAllocator() override;
+
+	SizeClassAllocator(const SizeClassAllocator &other)            = delete;
+	SizeClassAllocator &operator=(const SizeClassAllocator &other) = delete;
+	SizeClassAllocator(SizeClassAllocator &&other) noexcept;
+	SizeClassAllocator &operator=(SizeClassAllocator &&other) noexcept;
+
+	void *allocate(usize size, usize alignment = DEFAULT_ALIGNMENT) override;
+	void  free(void *ptr, usize size) override;
+
+	static u32 get_size_class(usize size);
+
+private:
+	struct FreeElement
+	{
+		FreeElement *next;
+	};
+
+	struct SizeClass
+	{
+		FreeElement *freelist_head = nullptr;
+		u8          *block_cursor  = nullptr; // never allocated part of the last block
+		u8          *block_end     = nullptr;
+	};
+
+	void release();
+
+	SizeClass   size_classes[SIZE_CLASS_COUNT] = {};
+	Vec<void *> blocks                         = {};
+};
+} // namespace exo
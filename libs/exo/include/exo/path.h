@@ -25,5 +25,7 @@ struct Path
 	static Path remove_filename(exo::Path path);
 };
 
+inline bool operator==(const Path &lhs, const Path &rhs) { return lhs.str == rhs.str; }
+
 [[nodiscard]] inline u64 hash_value(const exo::Path &path) { return hash_value(exo::StringView{path.str}); }
 } // namespace exo
@@ -12,9 +12,11 @@ inline void serialize(Serializer &serializer, Path &path)
 		auto path_c_str  = path_string.data();
 		exo::serialize(serializer, path_c_str);
 	} else {
-		const char *path_string = "";
-		exo::serialize(serializer, path_string);
-		path = exo::Path::from_string(path_string);
+		// Same layout as an interned string, but the path already owns a copy so it is not interned
+		usize len = 0;
+		exo::serialize(serializer, len);
+		const auto bytes = serializer.read_view(len);
+		path = exo::Path::from_string(exo::StringView(reinterpret_cast<const char *>(bytes.data()), len));
 	}
 }
 } // namespace exo
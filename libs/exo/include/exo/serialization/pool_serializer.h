@@ -9,6 +9,12 @@ namespace exo
 template <typename T>
 void serialize(Serializer &serializer, Pool<T> &data)
 {
+	// Loading replaces the content of the pool
+	if (!serializer.is_writing) {
+		data.clear();
+		data.buffer.destroy();
+	}
+
 	serialize(serializer, data.freelist_head);
 	serialize(serializer, data.size);
 	serialize(serializer, data.capacity);
@@ -16,6 +22,7 @@ void serialize(Serializer &serializer, Pool<T> &data)
 	usize buffer_size = data.capacity * (Pool<T>::ELEMENT_SIZE() + sizeof(ElementMetadata));
 	if (!serializer.is_writing && buffer_size > 0) {
 		DynamicBuffer::init(data.buffer, buffer_size);
+		init_occupancy(data);
 	}
 
 	u32 i_element = 0;
@@ -30,6 +37,7 @@ void serialize(Serializer &serializer, Pool<T> &data)
 			// constructors
 			if (!serializer.is_writing) {
 				new (element) T{};
+				set_occupied(data, i_element, true);
 			}
 
 			serialize(serializer, *element);
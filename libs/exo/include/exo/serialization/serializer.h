@@ -5,8 +5,13 @@
 
 #include "exo/collections/span.h"
 
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
 namespace exo
 {
+struct DynamicBuffer;
 struct StringRepository;
 struct ScopeStack;
 struct float4x4;
@@ -24,12 +29,55 @@ concept MemberSerializable = requires(T &a) {
 };
 // clang-format on
 
+// Called by a writer when `buffer` is full, it has to make room for at least one byte (or `len` bytes) and update
+// `buffer`, `offset` and `buffer_size`. It is also called with `len` == 0 by `flush()`.
+using SerializerSinkFn = void (*)(Serializer &serializer, usize len);
+
 struct Serializer
 {
 	static Serializer create(ScopeStack *s = nullptr, StringRepository *r = nullptr);
+	// Reads from `data` in place (the content of a MappedFile for example), strings are interned without a copy
+	static Serializer create_reader(Span<const u8> data, ScopeStack *s = nullptr, StringRepository *r = nullptr);
+	// Writes to `output`, growing it when full. The written size is `offset`.
+	static Serializer create_growable_writer(DynamicBuffer &output, ScopeStack *s = nullptr, StringRepository *r = nullptr);
+	// Writes to `file` every time `chunk` is full, `flush()` must be called at the end to write the remaining bytes
+	static Serializer create_file_writer(
+		FILE *file, Span<u8> chunk, ScopeStack *s = nullptr, StringRepository *r = nullptr);
+
+	void read_bytes(void *dst, usize len)
+	{
+		ASSERT(this->is_writing == false);
+		ASSERT(this->offset + len <= this->buffer_size);
+		std::memcpy(dst, static_cast<const u8 *>(this->buffer) + this->offset, len);
+		this->offset += len;
+	}
+
+	// Returns the next `len` bytes without copying them, they live as long as the read buffer
+	Span<const u8> read_view(usize len)
+	{
+		ASSERT(this->is_writing == false);
+		ASSERT(this->offset + len <= this->buffer_size);
+		const auto *bytes = static_cast<const u8 *>(this->buffer) + this->offset;
+		this->offset += len;
+		return Span<const u8>(bytes, len);
+	}
+
+	void write_bytes(const void *src, usize len)
+	{
+		ASSERT(this->is_writing == true);
+		if (this->offset + len > this->buffer_size) [[unlikely]] {
+			this->write_bytes_to_sink(src, len);
+			return;
+		}
+		std::memcpy(static_cast<u8 *>(this->buffer) + this->offset, src, len);
+		this->offset += len;
+	}
 
-	void read_bytes(void *dst, usize len);
-	void write_bytes(const void *src, usize len);
+	// Gives the buffered bytes to the sink
+	void flush();
+
+	// Total number of bytes written, including the ones already flushed
+	usize written_size() const { return this->flushed_size + this->offset; }
 
 	StringRepository *str_repo;
 	ScopeStack *scope;
@@ -38,6 +86,12 @@ struct Serializer
 	void *buffer;
 	usize offset;
 	usize buffer_size;
+	usize flushed_size;
+	SerializerSinkFn sink;
+	void *sink_userdata;
+
+private:
+	void write_bytes_to_sink(const void *src, usize len);
 };
 
 // builtin types
@@ -69,6 +123,22 @@ void serialize(Serializer &serializer, int2 &data);
 // exo types
 void serialize(Serializer &serializer, RawHash &data);
 
+// Types serialized as their raw bytes, a Vec of them is read and written at once
+template <typename T>
+inline constexpr bool is_bulk_serializable = std::is_arithmetic_v<T>;
+template <>
+inline constexpr bool is_bulk_serializable<float4x4> = true;
+template <>
+inline constexpr bool is_bulk_serializable<float4> = true;
+template <>
+inline constexpr bool is_bulk_serializable<float3> = true;
+template <>
+inline constexpr bool is_bulk_serializable<float2> = true;
+template <>
+inline constexpr bool is_bulk_serializable<int2> = true;
+template <>
+inline constexpr bool is_bulk_serializable<RawHash> = true;
+
 // templates last
 template <MemberSerializable T>
 void serialize(Serializer &serializer, T &data)
@@ -99,8 +169,19 @@ void serialize(Serializer &serializer, Vec<T> &data)
 	}
 
 	ASSERT(size == data.len());
-	for (usize i = 0; i < size; i += 1) {
-		serialize(serializer, data[i]);
+	if constexpr (is_bulk_serializable<T>) {
+		// Same bytes as serializing the elements one by one
+		if (size == 0) {
+			return;
+		} else if (serializer.is_writing) {
+			serializer.write_bytes(data.data(), size * sizeof(T));
+		} else {
+			serializer.read_bytes(data.data(), size * sizeof(T));
+		}
+	} else {
+		for (usize i = 0; i < size; i += 1) {
+			serialize(serializer, data[i]);
+		}
 	}
 }
 
@@ -1,9 +1,12 @@
 #pragma once
+#include "exo/memory/dynamic_buffer.h"
 #include "exo/memory/scope_stack.h"
 #include "exo/profile.h"
 #include "exo/serialization/serializer.h"
+#include "exo/string.h"
 
 #include <cstdio>
+#include <filesystem>
 #include "exo/collections/span.h"
 #include "exo/string_view.h"
 
@@ -14,33 +17,33 @@ static void read_object(exo::Span<const u8> data, T &object)
 {
 	exo::ScopeStack scope = exo::ScopeStack::with_allocator(&exo::tls_allocator);
 
-	auto serializer        = exo::Serializer::create(&scope);
-	serializer.buffer_size = data.size_bytes();
-	// const_cast, this pointer should always be READ if is_writing == false
-	serializer.buffer     = const_cast<u8 *>(data.data());
-	serializer.is_writing = false;
+	auto serializer = exo::Serializer::create_reader(data, &scope);
 	serialize(serializer, object);
 }
 
 template <typename T>
 static void write_object_to_file(exo::StringView output_path, T &object)
 {
-	exo::ScopeStack scope      = exo::ScopeStack::with_allocator(&exo::tls_allocator);
-	exo::Serializer serializer = exo::Serializer::create(&scope);
-	serializer.buffer_size     = 96_MiB;
-	serializer.buffer          = malloc(serializer.buffer_size);
-	serializer.is_writing      = true;
+	EXO_PROFILE_SCOPE
+
+	// The object is written next to the destination and moved over it once complete, a failure while serializing
+	// keeps the previous file
+	const exo::String tmp_path = output_path + exo::StringView{".tmp"};
+	FILE             *fp       = fopen(tmp_path.c_str(), "wb"); // non-Windows use "w"
+	ASSERT(fp != nullptr);
 
-	EXO_PROFILE_MALLOC(serializer.buffer, serializer.buffer_size);
+	// The object is written in chunks, its size is not known in advance
+	exo::DynamicBuffer chunk = {};
+	exo::DynamicBuffer::init(chunk, 1_MiB);
 
+	exo::ScopeStack scope      = exo::ScopeStack::with_allocator(&exo::tls_allocator);
+	exo::Serializer serializer = exo::Serializer::create_file_writer(fp, chunk.content(), &scope);
 	serialize(serializer, object);
+	serializer.flush();
 
-	FILE *fp       = fopen(output_path.data(), "wb"); // non-Windows use "w"
-	auto  bwritten = fwrite(serializer.buffer, 1, serializer.offset, fp);
-	ASSERT(bwritten == serializer.offset);
 	fclose(fp);
+	chunk.destroy();
 
-	EXO_PROFILE_MFREE(serializer.buffer);
-	free(serializer.buffer);
+	std::filesystem::rename(std::filesystem::path{tmp_path.c_str()}, std::filesystem::path{output_path.data()});
 }
 } // namespace exo::serializer_helper
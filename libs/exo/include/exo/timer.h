@@ -0,0 +1,11 @@
+#pragma once
+#include <chrono>
+
+namespace exo
+{
+// Milliseconds since `start`, to measure the cost of a step for the stats of the frame
+inline double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace exo
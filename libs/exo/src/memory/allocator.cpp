@@ -0,0 +1,34 @@
+#include "exo/memory/allocator.h"
+
+#include "exo/profile.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace exo
+{
+void *Allocator::reallocate(void *ptr, usize old_size, usize new_size, usize alignment)
+{
+	void *new_ptr = this->allocate(new_size, alignment);
+	if (ptr != nullptr) {
+		std::memcpy(new_ptr, ptr, std::min(old_size, new_size));
+		this->free(ptr, old_size);
+	}
+	return new_ptr;
+}
+
+void Allocator::track_allocation(usize size)
+{
+	this->stats.allocation_count += 1;
+	this->track_usage(this->stats.used_bytes + size);
+}
+
+void Allocator::track_free(usize size) { this->track_usage(this->stats.used_bytes - size); }
+
+void Allocator::track_usage(usize used_bytes)
+{
+	this->stats.used_bytes      = used_bytes;
+	this->stats.peak_used_bytes = std::max(this->stats.peak_used_bytes, used_bytes);
+	EXO_PROFILE_PLOT_VALUE(this->name, i64(used_bytes));
+}
+} // namespace exo
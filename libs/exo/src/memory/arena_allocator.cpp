@@ -0,0 +1,101 @@
+#include "exo/memory/arena_allocator.h"
+
+#include "exo/macros/assert.h"
+#include "exo/maths/pointer.h"
+#include "exo/memory/virtual_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace exo
+{
+ArenaAllocator ArenaAllocator::with_reserve(usize reserve_size, const char *name)
+{
+	const usize page_size = virtual_allocator::get_page_size();
+
+	ArenaAllocator arena = {};
+	arena.name           = name;
+	arena.reserved_size  = round_up_to_alignment(page_size, reserve_size);
+	arena.base_address   = static_cast<u8 *>(virtual_allocator::reserve(arena.reserved_size));
+	ASSERT(arena.base_address != nullptr);
+	return arena;
+}
+
+ArenaAllocator::~ArenaAllocator() { virtual_allocator::free(this->base_address); }
+
+ArenaAllocator::ArenaAllocator(ArenaAllocator &&other) noexcept { *this = std::move(other); }
+
+ArenaAllocator &ArenaAllocator::operator=(ArenaAllocator &&other) noexcept
+{
+	virtual_allocator::free(this->base_address);
+	this->name            = other.name;
+	this->stats           = std::exchange(other.stats, {});
+	this->base_address    = std::exchange(other.base_address, nullptr);
+	this->reserved_size   = std::exchange(other.reserved_size, 0);
+	this->committed_size  = std::exchange(other.committed_size, 0);
+	this->offset          = std::exchange(other.offset, 0);
+	this->last_allocation = std::exchange(other.last_allocation, usize(-1));
+	return *this;
+}
+
+void ArenaAllocator::commit_up_to(usize size)
+{
+	if (size <= this->committed_size) {
+		return;
+	}
+
+	ASSERT(size <= this->reserved_size);
+	const usize new_committed_size = std::min(round_up_to_alignment(COMMIT_GRANULARITY, size), this->reserved_size);
+	void *committed =
+		virtual_allocator::commit(this->base_address + this->committed_size, new_committed_size - this->committed_size);
+	ASSERT(committed != nullptr);
+	this->stats.system_bytes += new_committed_size - this->committed_size;
+	this->committed_size = new_committed_size;
+}
+
+void *ArenaAllocator::allocate(usize size, usize alignment)
+{
+	const usize allocation_offset = round_up_to_alignment(alignment, this->offset);
+	this->commit_up_to(allocation_offset + size);
+
+	this->offset          = allocation_offset + size;
+	this->last_allocation = allocation_offset;
+	this->stats.allocation_count += 1;
+	this->track_usage(this->offset);
+	return this->base_address + allocation_offset;
+}
+
+void *ArenaAllocator::reallocate(void *ptr, usize old_size, usize new_size, usize alignment)
+{
+	if (ptr != nullptr && ptr == this->base_address + this->last_allocation) {
+		this->commit_up_to(this->last_allocation + new_size);
+		this->offset = this->last_allocation + new_size;
+		this->track_usage(this->offset);
+		return ptr;
+	}
+
+	void *new_ptr = this->allocate(new_size, alignment);
+	if (ptr != nullptr) {
+		std::memcpy(new_ptr, ptr, std::min(old_size, new_size));
+	}
+	return new_ptr;
+}
+
+void ArenaAllocator::free(void *ptr, usize /*size*/)
+{
+	if (ptr != nullptr && ptr == this->base_address + this->last_allocation) {
+		this->offset          = this->last_allocation;
+		this->last_allocation = usize(-1);
+		this->track_usage(this->offset);
+	}
+}
+
+void ArenaAllocator::rewind(usize mark)
+{
+	ASSERT(mark <= this->offset);
+	this->offset          = mark;
+	this->last_allocation = usize(-1);
+	this->track_usage(this->offset);
+}
+} // namespace exo
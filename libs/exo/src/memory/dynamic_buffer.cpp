@@ -1,9 +1,11 @@
 #include "exo/memory/dynamic_buffer.h"
 
 #include "exo/macros/assert.h"
+#include "exo/memory/allocator.h"
 #include "exo/profile.h"
 
 #include <cstdlib> // for calloc, realloc, free
+#include <cstring>
 
 namespace exo
 {
@@ -13,8 +15,13 @@ void DynamicBuffer::init(DynamicBuffer &buffer, usize new_size)
 	ASSERT(buffer.ptr == nullptr);
 
 	buffer.size = new_size;
-	buffer.ptr  = calloc(1, new_size);
-	EXO_PROFILE_MALLOC(buffer.ptr, buffer.size);
+	if (buffer.allocator) {
+		buffer.ptr = buffer.allocator->allocate(new_size);
+		std::memset(buffer.ptr, 0, new_size);
+	} else {
+		buffer.ptr = calloc(1, new_size);
+		EXO_PROFILE_MALLOC(buffer.ptr, buffer.size);
+	}
 
 	ASSERT(buffer.size > 0);
 	ASSERT(buffer.ptr != nullptr);
@@ -22,8 +29,12 @@ void DynamicBuffer::init(DynamicBuffer &buffer, usize new_size)
 
 void DynamicBuffer::destroy()
 {
-	free(this->ptr);
-	EXO_PROFILE_MFREE(this->ptr);
+	if (this->allocator) {
+		this->allocator->free(this->ptr, this->size);
+	} else {
+		free(this->ptr);
+		EXO_PROFILE_MFREE(this->ptr);
+	}
 
 	this->ptr  = nullptr;
 	this->size = 0;
@@ -31,6 +42,12 @@ void DynamicBuffer::destroy()
 
 void DynamicBuffer::resize(usize new_size)
 {
+	if (this->allocator) {
+		this->ptr  = this->allocator->reallocate(this->ptr, this->size, new_size);
+		this->size = new_size;
+		return;
+	}
+
 	void *new_buffer = realloc(this->ptr, new_size);
 	ASSERT(new_buffer);
 
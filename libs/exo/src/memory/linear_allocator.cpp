@@ -2,6 +2,9 @@
 
 #include "exo/macros/assert.h"
 #include "exo/maths/pointer.h"
+#include "exo/memory/virtual_allocator.h"
+
+#include <algorithm>
 #include <utility>
 
 namespace exo
@@ -15,24 +18,73 @@ LinearAllocator LinearAllocator::with_external_memory(void *p, usize len)
 	return result;
 }
 
+LinearAllocator LinearAllocator::with_reserve(usize reserve_size)
+{
+	reserve_size = round_up_to_alignment(virtual_allocator::get_page_size(), reserve_size);
+
+	LinearAllocator result = {};
+	result.base_address    = reinterpret_cast<u8 *>(virtual_allocator::reserve(reserve_size));
+	result.ptr             = result.base_address;
+	result.end             = result.base_address;
+	result.reserved_end    = result.base_address + reserve_size;
+	return result;
+}
+
+LinearAllocator::~LinearAllocator()
+{
+	if (this->reserved_end) {
+		virtual_allocator::free(this->base_address);
+	}
+}
+
 LinearAllocator::LinearAllocator(LinearAllocator &&other) noexcept { *this = std::move(other); }
 
 LinearAllocator &LinearAllocator::operator=(LinearAllocator &&other) noexcept
 {
-	this->base_address = std::exchange(other.base_address, nullptr);
-	this->ptr          = std::exchange(other.ptr, nullptr);
-	this->end          = std::exchange(other.end, nullptr);
+	if (this->reserved_end) {
+		virtual_allocator::free(this->base_address);
+	}
+	this->base_address    = std::exchange(other.base_address, nullptr);
+	this->ptr             = std::exchange(other.ptr, nullptr);
+	this->end             = std::exchange(other.end, nullptr);
+	this->reserved_end    = std::exchange(other.reserved_end, nullptr);
+	this->high_water_mark = std::exchange(other.high_water_mark, 0);
 	return *this;
 }
 
+void LinearAllocator::grow(usize size)
+{
+	// External memory cannot grow
+	ASSERT(this->reserved_end != nullptr);
+
+	const usize used_size      = usize(this->ptr - this->base_address) + size;
+	const usize committed_size = usize(this->end - this->base_address);
+	const usize reserved_size  = usize(this->reserved_end - this->base_address);
+	ASSERT(used_size <= reserved_size);
+
+	const usize new_committed_size = std::min(round_up_to_alignment(COMMIT_GRANULARITY, used_size), reserved_size);
+	// Advancing `end` over pages that failed to commit would fault on their first access instead
+	void *committed = virtual_allocator::commit(this->end, new_committed_size - committed_size);
+	ASSERT(committed != nullptr);
+	this->end = this->base_address + new_committed_size;
+}
+
 void *LinearAllocator::allocate(usize size)
 {
-	size       = round_up_to_alignment(sizeof(u32), size);
-	u8 *result = this->ptr;
-	ASSERT(result + size < this->end);
-	this->ptr = this->ptr + size;
+	size = round_up_to_alignment(sizeof(u32), size);
+	if (usize(this->end - this->ptr) < size) [[unlikely]] {
+		this->grow(size);
+	}
+
+	u8 *result            = this->ptr;
+	this->ptr             = this->ptr + size;
+	this->high_water_mark = std::max(this->high_water_mark, this->get_used_size());
 	return result;
 }
 
-void LinearAllocator::rewind(void *p) { this->ptr = reinterpret_cast<u8 *>(p); }
+void LinearAllocator::rewind(void *p)
+{
+	ASSERT(this->base_address <= p && p <= this->ptr);
+	this->ptr = reinterpret_cast<u8 *>(p);
+}
 } // namespace exo
@@ -0,0 +1,107 @@
+#include "exo/memory/size_class_allocator.h"
+
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+
+#include <bit>
+#include <cstdlib>
+#include <utility>
+
+namespace exo
+{
+SizeClassAllocator::~SizeClassAllocator() { this->release(); }
+
+SizeClassAllocator::SizeClassAllocator(SizeClassAllocator &&other) noexcept { *this = std::move(other); }
+
+SizeClassAllocator &SizeClassAllocator::operator=(SizeClassAllocator &&other) noexcept
+{
+	this->release();
+	this->name  = other.name;
+	this->stats = std::exchange(other.stats, {});
+	for (u32 i_class = 0; i_class < SIZE_CLASS_COUNT; ++i_class) {
+		this->size_classes[i_class] = std::exchange(other.size_classes[i_class], {});
+	}
+	this->blocks = std::move(other.blocks);
+	return *this;
+}
+
+void SizeClassAllocator::release()
+{
+	for (void *block : this->blocks) {
+		EXO_PROFILE_MFREE(block);
+		std::free(block);
+	}
+	this->blocks.clear();
+	this->blocks.buffer.destroy();
+}
+
+u32 SizeClassAllocator::get_size_class(usize size)
+{
+	const usize class_size = std::bit_ceil(size < (usize(1) << MIN_SIZE_CLASS_SHIFT) ? 1 : size);
+	const u32   shift      = u32(std::countr_zero(class_size));
+	return shift < MIN_SIZE_CLASS_SHIFT ? 0 : shift - MIN_SIZE_CLASS_SHIFT;
+}
+
+void *SizeClassAllocator::allocate(usize size, usize alignment)
+{
+	// malloc and the size classes are aligned to 16 bytes
+	ASSERT(alignment <= DEFAULT_ALIGNMENT);
+
+	if (size > MAX_CLASS_SIZE) {
+		void *ptr = std::malloc(size);
+		EXO_PROFILE_MALLOC(ptr, size);
+		this->stats.system_bytes += size;
+		this->track_allocation(size);
+		return ptr;
+	}
+
+	const u32   i_class    = get_size_class(size);
+	const usize class_size = usize(1) << (i_class + MIN_SIZE_CLASS_SHIFT);
+	auto       &size_class = this->size_classes[i_class];
+
+	void *ptr = nullptr;
+	if (size_class.freelist_head != nullptr) {
+		ptr                      = size_class.freelist_head;
+		size_class.freelist_head = size_class.freelist_head->next;
+	} else {
+		if (size_class.block_cursor + class_size > size_class.block_end) {
+			auto *block = static_cast<u8 *>(std::malloc(BLOCK_SIZE));
+			EXO_PROFILE_MALLOC(block, BLOCK_SIZE);
+			this->blocks.push(block);
+			this->stats.system_bytes += BLOCK_SIZE;
+
+			size_class.block_cursor = block;
+			size_class.block_end    = block + BLOCK_SIZE;
+		}
+		ptr = size_class.block_cursor;
+		size_class.block_cursor += class_size;
+	}
+
+	this->track_allocation(class_size);
+	return ptr;
+}
+
+void SizeClassAllocator::free(void *ptr, usize size)
+{
+	if (ptr == nullptr) {
+		return;
+	}
+
+	if (size > MAX_CLASS_SIZE) {
+		EXO_PROFILE_MFREE(ptr);
+		std::free(ptr);
+		this->stats.system_bytes -= size;
+		this->track_free(size);
+		return;
+	}
+
+	const u32 i_class    = get_size_class(size);
+	auto     *element    = static_cast<FreeElement *>(ptr);
+	auto     &size_class = this->size_classes[i_class];
+
+	element->next            = size_class.freelist_head;
+	size_class.freelist_head = element;
+
+	this->track_free(usize(1) << (i_class + MIN_SIZE_CLASS_SHIFT));
+}
+} // namespace exo
@@ -43,14 +43,16 @@ const char *StringRepository::intern(exo::StringView s)
 	const usize page_size = virtual_allocator::get_page_size();
 	const usize old_size = this->buffer_size;
 	const usize new_size = this->buffer_size + s.len() + 1;
-	const usize page_count = round_up_to_alignment(page_size, old_size);
-	const usize new_page_count = round_up_to_alignment(page_size, new_size);
+	const usize page_count = round_up_to_alignment(page_size, old_size) / page_size;
+	const usize new_page_count = round_up_to_alignment(page_size, new_size) / page_size;
 	if (new_page_count != page_count) {
 		virtual_allocator::commit(this->string_buffer + page_count * page_size,
 			(new_page_count - page_count) * page_size);
 	}
 
-	std::memcpy(string_buffer + this->buffer_size, s.data(), s.len() + 1);
+	// `s` is not always null-terminated
+	std::memcpy(string_buffer + this->buffer_size, s.data(), s.len());
+	string_buffer[this->buffer_size + s.len()] = '\0';
 	offsets.insert(hash, this->buffer_size);
 	this->buffer_size = new_size;
 
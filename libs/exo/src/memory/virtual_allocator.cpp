@@ -5,6 +5,11 @@
 
 #if defined(_WIN32)
 #include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 namespace exo::virtual_allocator
@@ -16,7 +21,7 @@ u32 get_page_size()
 	GetSystemInfo(&system_info);
 	return system_info.dwPageSize;
 #else
-	return 4096;
+	return u32(sysconf(_SC_PAGESIZE));
 #endif
 }
 
@@ -25,12 +30,24 @@ void *reserve(usize size)
 #if defined(_WIN32)
 	void *region = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
 	if (region == nullptr) {
-		logger::error("win32 error: {}\n", GetLastError());
+		logger::error("win32 error: %lu\n", GetLastError());
 		ASSERT(false);
 	}
 	return region;
 #else
-	return nullptr;
+	// munmap needs the size of the mapping, it is stored in a page before the region
+	const usize page_size = get_page_size();
+	void       *mapping =
+		mmap(nullptr, page_size + size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mapping == MAP_FAILED) {
+		logger::error("mmap error: %s\n", strerror(errno));
+		ASSERT(false);
+		return nullptr;
+	}
+
+	mprotect(mapping, page_size, PROT_READ | PROT_WRITE);
+	*static_cast<usize *>(mapping) = page_size + size;
+	return static_cast<u8 *>(mapping) + page_size;
 #endif
 }
 
@@ -50,7 +67,20 @@ void *commit(void *page, usize size, MemoryAccess access)
 
 	return VirtualAlloc(page, size, MEM_COMMIT, protect);
 #else
-	return nullptr;
+	int protect = PROT_NONE;
+	if (access == ReadOnly) {
+		protect = PROT_READ;
+	} else if (access == ReadWrite) {
+		protect = PROT_READ | PROT_WRITE;
+	} else {
+		ASSERT(false);
+	}
+
+	if (mprotect(page, size, protect) != 0) {
+		logger::error("mprotect error: %s\n", strerror(errno));
+		return nullptr;
+	}
+	return page;
 #endif
 }
 
@@ -63,6 +93,10 @@ void free(void *region)
 #if defined(_WIN32)
 	auto res = VirtualFree(region, 0, MEM_RELEASE);
 	ASSERT(res != 0);
+#else
+	void *mapping = static_cast<u8 *>(region) - get_page_size();
+	auto  res     = munmap(mapping, *static_cast<usize *>(mapping));
+	ASSERT(res == 0);
 #endif
 }
 }; // namespace exo::virtual_allocator
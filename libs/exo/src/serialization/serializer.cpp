@@ -2,6 +2,7 @@
 
 #include "exo/maths/matrices.h"
 #include "exo/maths/vectors.h"
+#include "exo/memory/dynamic_buffer.h"
 #include "exo/memory/scope_stack.h"
 #include "exo/memory/string_repository.h"
 
@@ -19,23 +20,103 @@ Serializer Serializer::create(ScopeStack *s, StringRepository *r)
 	result.buffer = nullptr;
 	result.offset = 0;
 	result.buffer_size = 0;
+	result.flushed_size = 0;
+	result.sink = nullptr;
+	result.sink_userdata = nullptr;
 	return result;
 }
 
-void Serializer::read_bytes(void *dst, usize len)
+Serializer Serializer::create_reader(Span<const u8> data, ScopeStack *s, StringRepository *r)
 {
-	ASSERT(this->is_writing == false);
-	ASSERT(this->offset + len <= this->buffer_size);
-	std::memcpy(dst, ptr_offset(this->buffer, this->offset), len);
-	this->offset += len;
+	Serializer result = Serializer::create(s, r);
+	// const_cast, this pointer is only read when is_writing == false
+	result.buffer = const_cast<u8 *>(data.data());
+	result.buffer_size = data.size_bytes();
+	return result;
+}
+
+static void growable_sink(Serializer &serializer, usize len)
+{
+	auto &output = *static_cast<DynamicBuffer *>(serializer.sink_userdata);
+
+	usize new_size = output.size < 4_KiB ? 4_KiB : output.size;
+	while (new_size < serializer.offset + len) {
+		new_size *= 2;
+	}
+	if (new_size != output.size) {
+		output.resize(new_size);
+	}
+	serializer.buffer = output.ptr;
+	serializer.buffer_size = output.size;
+}
+
+Serializer Serializer::create_growable_writer(DynamicBuffer &output, ScopeStack *s, StringRepository *r)
+{
+	Serializer result = Serializer::create(s, r);
+	result.is_writing = true;
+	result.buffer = output.ptr;
+	result.buffer_size = output.size;
+	result.sink = growable_sink;
+	result.sink_userdata = &output;
+	return result;
+}
+
+static void file_sink(Serializer &serializer, usize /*len*/)
+{
+	auto *file = static_cast<FILE *>(serializer.sink_userdata);
+	if (serializer.offset == 0) {
+		return;
+	}
+
+	const usize bwritten = fwrite(serializer.buffer, 1, serializer.offset, file);
+	ASSERT(bwritten == serializer.offset);
+	serializer.flushed_size += serializer.offset;
+	serializer.offset = 0;
+}
+
+Serializer Serializer::create_file_writer(FILE *file, Span<u8> chunk, ScopeStack *s, StringRepository *r)
+{
+	ASSERT(file != nullptr);
+	ASSERT(!chunk.empty());
+
+	Serializer result = Serializer::create(s, r);
+	result.is_writing = true;
+	result.buffer = chunk.data();
+	result.buffer_size = chunk.size_bytes();
+	result.sink = file_sink;
+	result.sink_userdata = file;
+	return result;
 }
 
-void Serializer::write_bytes(const void *src, usize len)
+void Serializer::flush()
 {
 	ASSERT(this->is_writing == true);
-	ASSERT(this->offset + len <= this->buffer_size);
-	std::memcpy(ptr_offset(this->buffer, this->offset), src, len);
-	this->offset += len;
+	if (this->sink) {
+		this->sink(*this, 0);
+	}
+}
+
+void Serializer::write_bytes_to_sink(const void *src, usize len)
+{
+	// Fixed size buffers without a sink cannot overflow
+	ASSERT(this->sink != nullptr);
+
+	const auto *bytes = static_cast<const u8 *>(src);
+	while (this->offset + len > this->buffer_size) {
+		const usize available = this->buffer_size - this->offset;
+		if (available > 0) {
+			std::memcpy(ptr_offset(this->buffer, this->offset), bytes, available);
+			this->offset += available;
+			bytes += available;
+			len -= available;
+		}
+		this->sink(*this, len);
+	}
+
+	if (len > 0) {
+		std::memcpy(ptr_offset(this->buffer, this->offset), bytes, len);
+		this->offset += len;
+	}
 }
 
 static void serializer_read_or_write(Serializer &serializer, void *data, usize len)
@@ -74,15 +155,13 @@ void serialize(Serializer &serializer, const char *&data)
 		serialize(serializer, len);
 		serializer.write_bytes(data, len);
 	} else {
-		ASSERT(serializer.scope && serializer.str_repo);
+		ASSERT(serializer.str_repo);
 
 		len = 0;
 		serialize(serializer, len);
-		char *tmp = reinterpret_cast<char *>(serializer.scope->allocate(len + 1));
-		serializer.read_bytes(tmp, len);
-		tmp[len] = '\0';
-
-		data = serializer.str_repo->intern(tmp);
+		// The repository copies the string, it can be interned directly from the read buffer
+		const auto bytes = serializer.read_view(len);
+		data = serializer.str_repo->intern(exo::StringView(reinterpret_cast<const char *>(bytes.data()), len));
 	}
 }
 
@@ -5,6 +5,7 @@
 #include "exo/macros/assert.h"
 #include <cstdio>  // for snprintf
 #include <cstring> // for memset
+#include <random>  // for mt19937
 #if defined(PLATFORM_WINDOWS)
 #include <rpc.h>
 #include <windows.h>
@@ -30,6 +31,12 @@ UUID UUID::create()
 	auto res = ::UuidCreate(win32_uuid);
 	ASSERT(res == RPC_S_OK);
 	ASSERT(new_uuid.is_valid());
+#else
+	thread_local std::mt19937 generator{std::random_device{}()};
+	for (auto &word : new_uuid.data) {
+		word = static_cast<u32>(generator());
+	}
+	ASSERT(new_uuid.is_valid());
 #endif
 
 	write_uuid_string(new_uuid.data, new_uuid.str);
@@ -0,0 +1,95 @@
+#include "exo/collections/map.h"
+#include "exo/collections/pool.h"
+#include "exo/collections/vector.h"
+#include "exo/memory/arena_allocator.h"
+#include "exo/memory/size_class_allocator.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+
+TEST_CASE("exo::ArenaAllocator", "[allocator]")
+{
+	auto arena = exo::ArenaAllocator::with_reserve(1 << 20);
+
+	auto *a = static_cast<u8 *>(arena.allocate(100));
+	auto *b = static_cast<u8 *>(arena.allocate(100, 64));
+	REQUIRE(a != nullptr);
+	REQUIRE(reinterpret_cast<usize>(b) % 64 == 0);
+	REQUIRE(b >= a + 100);
+	std::memset(a, 1, 100);
+	std::memset(b, 2, 100);
+
+	// The last allocation grows in place
+	auto *grown = arena.reallocate(b, 100, 200 << 10);
+	REQUIRE(grown == b);
+	std::memset(grown, 3, 200 << 10);
+
+	const usize mark = arena.get_mark();
+	arena.allocate(1000);
+	arena.rewind(mark);
+	REQUIRE(arena.get_mark() == mark);
+	REQUIRE(arena.stats.used_bytes == mark);
+
+	arena.reset();
+	REQUIRE(arena.get_mark() == 0);
+	REQUIRE(arena.allocate(16) == a);
+	REQUIRE(arena.stats.peak_used_bytes >= (200 << 10));
+}
+
+TEST_CASE("exo::SizeClassAllocator", "[allocator]")
+{
+	exo::SizeClassAllocator allocator = {};
+
+	REQUIRE(exo::SizeClassAllocator::get_size_class(1) == 0);
+	REQUIRE(exo::SizeClassAllocator::get_size_class(16) == 0);
+	REQUIRE(exo::SizeClassAllocator::get_size_class(17) == 1);
+	REQUIRE(exo::SizeClassAllocator::get_size_class(2048) == 7);
+
+	void *a = allocator.allocate(24);
+	void *b = allocator.allocate(24);
+	REQUIRE(static_cast<u8 *>(b) == static_cast<u8 *>(a) + 32);
+	REQUIRE(allocator.stats.used_bytes == 64);
+
+	// Released elements are reused first
+	allocator.free(a, 24);
+	REQUIRE(allocator.allocate(30) == a);
+
+	void *big = allocator.allocate(1 << 20);
+	std::memset(big, 0, 1 << 20);
+	allocator.free(big, 1 << 20);
+
+	for (u32 i = 0; i < 10000; ++i) {
+		std::memset(allocator.allocate(100), 0, 100);
+	}
+	REQUIRE(allocator.stats.allocation_count == 10004);
+}
+
+TEST_CASE("exo containers with allocators", "[allocator]")
+{
+	auto arena = exo::ArenaAllocator::with_reserve(64 << 20);
+
+	auto vec = Vec<u32>::with_allocator(&arena);
+	for (u32 i = 0; i < 1000; ++i) {
+		vec.push(i);
+	}
+	REQUIRE(vec.buffer.allocator == &arena);
+	REQUIRE(vec.len() == 1000);
+	REQUIRE(vec[999] == 999);
+
+	auto map = exo::Map<u32, u32>::with_allocator(&arena);
+	for (u32 i = 0; i < 1000; ++i) {
+		map.insert(i, 2 * i);
+	}
+	REQUIRE(*map.at(500) == 1000);
+
+	exo::SizeClassAllocator size_classes = {};
+
+	auto pool = exo::Pool<u32>::with_allocator(&size_classes);
+	for (u32 i = 0; i < 100; ++i) {
+		pool.add(u32{i});
+	}
+	REQUIRE(pool.size == 100);
+	REQUIRE(size_classes.stats.used_bytes > 0);
+
+	vec.buffer.destroy();
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "exo/maths/numerics.h"
+#include "exo/maths/vectors.h"
+
+namespace exo::tests
+{
+// Deterministic linear congruential generator, the tests and benchmarks get the same values on every platform
+struct Random
+{
+	u32 state = 0x12345678;
+
+	u32 next_u32()
+	{
+		this->state = this->state * 1664525u + 1013904223u;
+		return this->state;
+	}
+
+	// In [0, 1)
+	float next() { return float(this->next_u32() >> 8) / float(1 << 24); }
+
+	float3 next3() { return float3(this->next(), this->next(), this->next()); }
+};
+} // namespace exo::tests
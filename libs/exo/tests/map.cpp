@@ -1,8 +1,20 @@
 #include "exo/collections/map.h"
+#include "exo/collections/pool.h"
+#include "exo/collections/set.h"
+#include "exo/collections/vector.h"
 #include "exo/hash.h"
+#include "exo/string.h"
+#include "exo/string_view.h"
+#include "exo/uuid.h"
+#include "exo/tests/random.h"
 #include "helpers.h"
+#include "legacy_map.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <string>
+#include <unordered_map>
+
 // Provide a hash function
 namespace exo
 {
@@ -14,6 +26,14 @@ namespace exo
 }
 } // namespace exo
 
+// All the keys have the same hash
+struct CollidingKey
+{
+	int i;
+	bool operator==(const CollidingKey &other) const = default;
+};
+[[nodiscard]] u64 hash_value(const CollidingKey &) { return 42; }
+
 TEST_CASE("exo::Map at", "[map]")
 {
 	exo::Map<int, int> map;
@@ -138,3 +158,328 @@ TEST_CASE("exo::Map move constructor", "[map]")
 	REQUIRE(new_map.keyvalues_buffer.ptr != nullptr);
 	REQUIRE(new_map.slots_buffer.ptr != nullptr);
 }
+
+TEST_CASE("exo::Map insert existing key", "[map]")
+{
+	exo::Map<int, int> map = {};
+	map.insert(1, 2);
+	map.insert(1, 3);
+
+	REQUIRE(map.size == 1);
+	REQUIRE(*map.at(1) == 3);
+	REQUIRE(map.contains(1));
+	REQUIRE(!map.contains(2));
+	REQUIRE(!map.is_empty());
+}
+
+TEST_CASE("exo::Map hash collisions", "[map]")
+{
+	exo::Map<CollidingKey, int> map = {};
+	for (int i = 0; i < 100; ++i) {
+		map.insert(CollidingKey{i}, i);
+	}
+	REQUIRE(map.size == 100);
+
+	for (int i = 0; i < 100; i += 2) {
+		map.remove(CollidingKey{i});
+	}
+	REQUIRE(map.size == 50);
+
+	for (int i = 0; i < 100; ++i) {
+		if (i % 2 == 0) {
+			REQUIRE(map.at(CollidingKey{i}) == nullptr);
+		} else {
+			REQUIRE(*map.at(CollidingKey{i}) == i);
+		}
+	}
+}
+
+TEST_CASE("exo::Map heterogeneous lookup", "[map]")
+{
+	exo::Map<exo::String, int> map = {};
+	map.insert(exo::String{"hello"}, 1);
+	map.insert(exo::String{"world"}, 2);
+
+	const exo::StringView hello = "hello";
+	REQUIRE(map.contains(hello));
+	REQUIRE(*map.at(hello) == 1);
+	REQUIRE(*map.at(exo::StringView{"world"}) == 2);
+	REQUIRE(map.at(exo::StringView{"other"}) == nullptr);
+
+	map.remove(hello);
+	REQUIRE(!map.contains(hello));
+	REQUIRE(map.size == 1);
+}
+
+TEST_CASE("exo::Map random operations", "[map]")
+{
+	exo::Map<int, int>          map       = {};
+	std::unordered_map<int, int> reference = {};
+
+	exo::tests::Random random = {.state = 1};
+	for (int i_op = 0; i_op < 20000; ++i_op) {
+		const u32 value = random.next_u32();
+		const int key   = int((value >> 8) % 1024);
+		if ((value >> 28) < 10) {
+			map.insert(key, i_op);
+			reference[key] = i_op;
+		} else if (reference.contains(key)) {
+			map.remove(key);
+			reference.erase(key);
+		}
+		REQUIRE(map.size == reference.size());
+	}
+
+	for (int key = 0; key < 1024; ++key) {
+		const auto it = reference.find(key);
+		if (it == reference.end()) {
+			REQUIRE(map.at(key) == nullptr);
+		} else {
+			REQUIRE(*map.at(key) == it->second);
+		}
+	}
+
+	u32 iter = 0;
+	for (const auto &[key, value] : map) {
+		REQUIRE(reference.at(key) == value);
+		iter += 1;
+	}
+	REQUIRE(iter == reference.size());
+}
+
+TEST_CASE("exo::Map destroys values", "[map]")
+{
+	int alive_count = 0;
+	{
+		exo::Map<int, Alive> map = {};
+		for (int i = 0; i < 100; ++i) {
+			map.insert(i, Alive{&alive_count});
+		}
+		for (int i = 0; i < 100; i += 3) {
+			map.remove(i);
+		}
+		REQUIRE(alive_count == 66);
+	}
+	REQUIRE(alive_count == 0);
+}
+
+TEST_CASE("exo::Set", "[map]")
+{
+	exo::Set<int> set = {};
+	for (int i = 0; i < 100; ++i) {
+		set.insert(i);
+	}
+	set.insert(5);
+	REQUIRE(set.size == 100);
+
+	for (int i = 0; i < 100; i += 2) {
+		set.remove(i);
+	}
+	for (int i = 0; i < 100; ++i) {
+		REQUIRE(set.contains(i) == (i % 2 == 1));
+	}
+
+	int sum = 0;
+	for (int value : set) {
+		sum += value;
+	}
+	REQUIRE(sum == 2500);
+}
+
+// std::unordered_map hasher for the exo keys
+struct ExoHash
+{
+	template <typename Key>
+	usize operator()(const Key &key) const
+	{
+		return usize(hash_value(key));
+	}
+};
+
+// Insert and lookup `keys` in exo::Map, the legacy map and std::unordered_map, `missing_keys` are not in the maps
+template <typename Key>
+static void benchmark_maps(const char *key_name, const Vec<Key> &keys, const Vec<Key> &missing_keys)
+{
+	const std::string prefix = std::string(key_name) + " ";
+
+	// The legacy map only compares 32-bit hashes, skip the keys that collide with a previous one.
+	// Its insert that copies the value grows the table when the map is empty, the values are moved instead.
+	Vec<Key>      legacy_keys   = {};
+	exo::Set<u32> legacy_hashes = {};
+	for (const auto &key : keys) {
+		const u32 hash = u32(hash_value(key));
+		if (!legacy_hashes.contains(hash)) {
+			legacy_hashes.insert(hash);
+			legacy_keys.push(key);
+		}
+	}
+
+	BENCHMARK(prefix + "insert")
+	{
+		exo::Map<Key, u32> map = {};
+		for (u32 i_key = 0; i_key < keys.len(); ++i_key) {
+			map.insert(keys[i_key], i_key);
+		}
+		return map.size;
+	};
+
+	BENCHMARK(prefix + "legacy insert")
+	{
+		exo::legacy::Map<Key, u32> legacy_map = {};
+		for (u32 i_key = 0; i_key < legacy_keys.len(); ++i_key) {
+			legacy_map.insert(legacy_keys[i_key], u32(i_key));
+		}
+		return legacy_map.size;
+	};
+
+	BENCHMARK(prefix + "std insert")
+	{
+		std::unordered_map<Key, u32, ExoHash> std_map = {};
+		for (u32 i_key = 0; i_key < keys.len(); ++i_key) {
+			std_map.emplace(keys[i_key], i_key);
+		}
+		return std_map.size();
+	};
+
+	exo::Map<Key, u32>                    map        = {};
+	exo::legacy::Map<Key, u32>            legacy_map = {};
+	std::unordered_map<Key, u32, ExoHash> std_map    = {};
+	for (u32 i_key = 0; i_key < keys.len(); ++i_key) {
+		map.insert(keys[i_key], i_key);
+		std_map.emplace(keys[i_key], i_key);
+	}
+	for (u32 i_key = 0; i_key < legacy_keys.len(); ++i_key) {
+		legacy_map.insert(legacy_keys[i_key], u32(i_key));
+	}
+
+	BENCHMARK(prefix + "lookup hit")
+	{
+		u32 sum = 0;
+		for (const auto &key : keys) {
+			sum += *map.at(key);
+		}
+		return sum;
+	};
+
+	BENCHMARK(prefix + "legacy lookup hit")
+	{
+		u32 sum = 0;
+		for (const auto &key : legacy_keys) {
+			sum += *legacy_map.at(key);
+		}
+		return sum;
+	};
+
+	BENCHMARK(prefix + "std lookup hit")
+	{
+		u32 sum = 0;
+		for (const auto &key : keys) {
+			sum += std_map.find(key)->second;
+		}
+		return sum;
+	};
+
+	BENCHMARK(prefix + "lookup miss")
+	{
+		u32 count = 0;
+		for (const auto &key : missing_keys) {
+			count += map.at(key) == nullptr ? 1 : 0;
+		}
+		return count;
+	};
+
+	BENCHMARK(prefix + "legacy lookup miss")
+	{
+		u32 count = 0;
+		for (const auto &key : missing_keys) {
+			count += legacy_map.at(key) == nullptr ? 1 : 0;
+		}
+		return count;
+	};
+
+	BENCHMARK(prefix + "std lookup miss")
+	{
+		u32 count = 0;
+		for (const auto &key : missing_keys) {
+			count += std_map.find(key) == std_map.end() ? 1 : 0;
+		}
+		return count;
+	};
+
+	BENCHMARK(prefix + "remove and insert")
+	{
+		for (const auto &key : keys) {
+			map.remove(key);
+		}
+		for (u32 i_key = 0; i_key < keys.len(); ++i_key) {
+			map.insert(keys[i_key], i_key);
+		}
+		return map.size;
+	};
+
+	BENCHMARK(prefix + "legacy remove and insert")
+	{
+		for (const auto &key : legacy_keys) {
+			legacy_map.remove(key);
+		}
+		for (u32 i_key = 0; i_key < legacy_keys.len(); ++i_key) {
+			legacy_map.insert(legacy_keys[i_key], u32(i_key));
+		}
+		return legacy_map.size;
+	};
+
+	BENCHMARK(prefix + "std remove and insert")
+	{
+		for (const auto &key : keys) {
+			std_map.erase(key);
+		}
+		for (u32 i_key = 0; i_key < keys.len(); ++i_key) {
+			std_map.emplace(keys[i_key], i_key);
+		}
+		return std_map.size();
+	};
+
+	legacy_keys.buffer.destroy();
+}
+
+// The maps of the engine have up to millions of entries
+inline constexpr u32 BENCHMARK_KEY_COUNT = 1u << 20;
+
+TEST_CASE("exo::Map benchmark UUID keys", "[.][map][benchmark]")
+{
+	exo::tests::Random random       = {.state = 1};
+	Vec<exo::UUID>     keys         = {};
+	Vec<exo::UUID>     missing_keys = {};
+	for (u32 i_key = 0; i_key < 2 * BENCHMARK_KEY_COUNT; ++i_key) {
+		const u32  values[4] = {random.next_u32(), random.next_u32(), random.next_u32(), random.next_u32()};
+		const auto uuid      = exo::UUID::from_values(values);
+		(i_key % 2 ? missing_keys : keys).push(uuid);
+	}
+
+	benchmark_maps("UUID", keys, missing_keys);
+
+	missing_keys.buffer.destroy();
+	keys.buffer.destroy();
+}
+
+TEST_CASE("exo::Map benchmark Handle keys", "[.][map][benchmark]")
+{
+	// Handles of a pool that reused its slots, the keys have different generations
+	exo::Pool<u32>   pool         = {};
+	Vec<Handle<u32>> keys         = {};
+	Vec<Handle<u32>> missing_keys = {};
+	for (u32 i_key = 0; i_key < BENCHMARK_KEY_COUNT; ++i_key) {
+		missing_keys.push(pool.add(u32(i_key)));
+	}
+	for (auto handle : missing_keys) {
+		pool.remove(handle);
+	}
+	for (u32 i_key = 0; i_key < BENCHMARK_KEY_COUNT; ++i_key) {
+		keys.push(pool.add(u32(i_key)));
+	}
+
+	benchmark_maps("Handle", keys, missing_keys);
+
+	missing_keys.buffer.destroy();
+	keys.buffer.destroy();
+}
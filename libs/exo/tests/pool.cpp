@@ -1,4 +1,6 @@
 #include "exo/collections/pool.h"
+#include "exo/memory/dynamic_buffer.h"
+#include "exo/serialization/pool_serializer.h"
 #include <catch2/catch_test_macros.hpp>
 
 TEST_CASE("exo::Pool insertion")
@@ -20,3 +22,117 @@ TEST_CASE("exo::Pool insertion")
 	REQUIRE(v1 == 42);
 	REQUIRE(v2 == 38);
 }
+
+TEST_CASE("exo::Pool iteration skips holes")
+{
+	exo::Pool<int> pool;
+
+	Vec<Handle<int>> handles;
+	for (int i = 0; i < 300; ++i) {
+		handles.push(pool.add(int{i}));
+	}
+	for (u32 i = 0; i < 300; ++i) {
+		if (i % 7 != 0 && (i < 64 || i > 200)) {
+			pool.remove(handles[i]);
+		}
+	}
+
+	int sum   = 0;
+	u32 count = 0;
+	for (auto [handle, value] : pool) {
+		REQUIRE(handle.get_index() == u32(*value));
+		REQUIRE((*value % 7 == 0 || (*value >= 64 && *value <= 200)));
+		sum += *value;
+		count += 1;
+	}
+	REQUIRE(count == pool.size);
+
+	int expected_sum = 0;
+	for (int i = 0; i < 300; ++i) {
+		if (i % 7 == 0 || (i >= 64 && i <= 200)) {
+			expected_sum += i;
+		}
+	}
+	REQUIRE(sum == expected_sum);
+
+	pool.clear();
+	REQUIRE(pool.begin() == pool.end());
+
+	handles.buffer.destroy();
+}
+
+TEST_CASE("exo::Pool compact")
+{
+	exo::Pool<int> pool;
+
+	Vec<Handle<int>> handles;
+	for (int i = 0; i < 100; ++i) {
+		handles.push(pool.add(int{i}));
+	}
+	for (u32 i = 0; i < 100; i += 3) {
+		pool.remove(handles[i]);
+	}
+	const u32 size = pool.size;
+
+	auto remap = pool.compact();
+	REQUIRE(remap.len() == pool.capacity);
+	REQUIRE(pool.size == size);
+
+	for (u32 i = 0; i < 100; ++i) {
+		if (i % 3 == 0) {
+			REQUIRE(!remap[i].is_valid());
+		} else {
+			REQUIRE(remap[i].get_index() < size);
+			REQUIRE(pool.get(remap[i]) == int(i));
+		}
+	}
+
+	u32 i_expected = 0;
+	for (auto [handle, value] : pool) {
+		REQUIRE(handle.get_index() == i_expected);
+		i_expected += 1;
+	}
+	REQUIRE(i_expected == size);
+
+	// New elements are added after the packed ones
+	auto new_handle = pool.add(1000);
+	REQUIRE(new_handle.get_index() == size);
+
+	remap.buffer.destroy();
+	handles.buffer.destroy();
+}
+
+TEST_CASE("exo::Pool loading replaces its content")
+{
+	exo::Pool<u32> saved_pool;
+	for (u32 i = 0; i < 3; ++i) {
+		saved_pool.add(u32(i));
+	}
+
+	exo::DynamicBuffer output = {};
+	auto               writer = exo::Serializer::create_growable_writer(output);
+	exo::serialize(writer, saved_pool);
+
+	// The loaded pool is smaller than the previous content, its elements were in the slots that are now free
+	exo::Pool<u32> pool;
+	for (u32 i = 0; i < 200; ++i) {
+		pool.add(u32(100 + i));
+	}
+	auto reader = exo::Serializer::create_reader(exo::Span<const u8>(output.content().data(), writer.offset));
+	exo::serialize(reader, pool);
+
+	REQUIRE(pool.size == 3);
+	u32 visited = 0;
+	for (auto [handle, value] : pool) {
+		REQUIRE(*value == handle.get_index());
+		visited += 1;
+	}
+	REQUIRE(visited == 3);
+
+	// The slots after the loaded elements are free
+	auto handle = pool.add(42u);
+	REQUIRE(pool.get(handle) == 42);
+	REQUIRE(pool.size == 4);
+
+	output.destroy();
+}
@@ -0,0 +1,140 @@
+#include "exo/memory/dynamic_buffer.h"
+#include "exo/memory/string_repository.h"
+#include "exo/serialization/path_serializer.h"
+#include "exo/serialization/serializer.h"
+#include "exo/serialization/string_serializer.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+struct SerializedObject
+{
+	u32         id   = 0;
+	const char *name = nullptr;
+	exo::String description;
+	exo::Path   path;
+	Vec<u32>    values;
+
+	void serialize(exo::Serializer &serializer)
+	{
+		exo::serialize(serializer, this->id);
+		exo::serialize(serializer, this->name);
+		exo::serialize(serializer, this->description);
+		exo::serialize(serializer, this->path);
+		exo::serialize(serializer, this->values);
+	}
+};
+
+static SerializedObject make_object(exo::StringRepository &str_repo, u32 value_count)
+{
+	SerializedObject object = {};
+	object.id               = 42;
+	object.name             = str_repo.intern("object");
+	object.description      = "a serialized object";
+	object.path             = exo::Path::from_string("assets/object.bin");
+	for (u32 i = 0; i < value_count; ++i) {
+		object.values.push(i * 7);
+	}
+	return object;
+}
+
+static void check_object(const SerializedObject &object, const SerializedObject &expected)
+{
+	REQUIRE(object.id == expected.id);
+	REQUIRE(std::strcmp(object.name, expected.name) == 0);
+	REQUIRE(object.description == expected.description);
+	REQUIRE(object.path == expected.path);
+	REQUIRE(object.values.len() == expected.values.len());
+	for (u32 i = 0; i < object.values.len(); ++i) {
+		REQUIRE(object.values[i] == expected.values[i]);
+	}
+}
+
+TEST_CASE("exo::Serializer growable writer", "[serializer]")
+{
+	auto str_repo = exo::StringRepository::create();
+	auto object   = make_object(str_repo, 10'000);
+
+	exo::DynamicBuffer output = {};
+	auto writer               = exo::Serializer::create_growable_writer(output, nullptr, &str_repo);
+	exo::serialize(writer, object);
+	REQUIRE(writer.written_size() == writer.offset);
+	REQUIRE(output.size >= writer.offset);
+
+	// The interned strings are read in place
+	SerializedObject read_object = {};
+	auto reader = exo::Serializer::create_reader(exo::Span<const u8>(output.content().data(), writer.offset),
+		nullptr,
+		&str_repo);
+	exo::serialize(reader, read_object);
+	REQUIRE(reader.offset == writer.offset);
+	check_object(read_object, object);
+	REQUIRE(read_object.name == object.name);
+
+	read_object.values.buffer.destroy();
+	object.values.buffer.destroy();
+	output.destroy();
+}
+
+TEST_CASE("exo::Serializer file writer", "[serializer]")
+{
+	auto str_repo = exo::StringRepository::create();
+	auto object   = make_object(str_repo, 1000);
+
+	FILE *file = std::tmpfile();
+	REQUIRE(file != nullptr);
+
+	// Smaller than most of the writes
+	u8   chunk[7] = {};
+	auto writer   = exo::Serializer::create_file_writer(file, exo::Span<u8>(chunk, 7), nullptr, &str_repo);
+	exo::serialize(writer, object);
+	writer.flush();
+	REQUIRE(writer.offset == 0);
+
+	const usize file_size = usize(std::ftell(file));
+	REQUIRE(file_size == writer.written_size());
+
+	exo::DynamicBuffer content = {};
+	exo::DynamicBuffer::init(content, file_size);
+	std::rewind(file);
+	REQUIRE(std::fread(content.ptr, 1, file_size, file) == file_size);
+	std::fclose(file);
+
+	SerializedObject read_object = {};
+	auto             reader      = exo::Serializer::create_reader(content.content(), nullptr, &str_repo);
+	exo::serialize(reader, read_object);
+	check_object(read_object, object);
+
+	read_object.values.buffer.destroy();
+	object.values.buffer.destroy();
+	content.destroy();
+}
+
+TEST_CASE("exo::Serializer bulk vectors", "[serializer]")
+{
+	Vec<u16> values;
+	for (u16 i = 0; i < 100; ++i) {
+		values.push(u16(i * 3));
+	}
+
+	exo::DynamicBuffer bulk_output = {};
+	auto bulk_writer               = exo::Serializer::create_growable_writer(bulk_output);
+	exo::serialize(bulk_writer, values);
+
+	// Same layout as serializing the length then every element
+	exo::DynamicBuffer loop_output = {};
+	auto loop_writer               = exo::Serializer::create_growable_writer(loop_output);
+	usize len                      = values.len();
+	exo::serialize(loop_writer, len);
+	for (u16 &value : values) {
+		exo::serialize(loop_writer, value);
+	}
+
+	REQUIRE(bulk_writer.offset == loop_writer.offset);
+	REQUIRE(std::memcmp(bulk_output.ptr, loop_output.ptr, bulk_writer.offset) == 0);
+
+	values.buffer.destroy();
+	bulk_output.destroy();
+	loop_output.destroy();
+}
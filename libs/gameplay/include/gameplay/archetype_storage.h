@@ -0,0 +1,166 @@
+#pragma once
+#include "exo/collections/handle.h"
+#include "exo/collections/pool.h"
+#include "exo/collections/span.h"
+#include "exo/collections/vector.h"
+#include "exo/maths/numerics.h"
+#include "exo/memory/dynamic_buffer.h"
+#include "reflection/reflection.h"
+
+#include <bit>
+#include <new>
+#include <utility>
+
+/**
+   Opt-in storage grouping the components of entities by signature, the set of their component types.
+   Each signature has an archetype made of fixed-size chunks, a chunk stores one array per component type so queries
+   stream through the contiguous components of the matching chunks.
+   Rows never move: removing an entity leaves a hole that the next entity of the same archetype reuses, so pointers to
+   stored components stay valid (Entity::components references them). Chunks track their rows with an occupancy mask,
+   queries use it to skip the holes.
+   Only the entities created with their components are stored here, the components of the other entities are
+   allocated individually and the queries don't see them.
+ **/
+
+struct ArchetypeRow
+{
+	u32 i_archetype = u32_invalid;
+	u32 i_chunk     = u32_invalid;
+	u32 i_row       = u32_invalid;
+};
+
+struct ArchetypeColumn
+{
+	const refl::TypeInfo *type      = nullptr;
+	u32                   offset    = 0; // byte offset of the component array in a chunk
+	u32                   stride    = 0;
+	u32                   alignment = 0;
+	void (*destroy)(void *component) = nullptr;
+};
+
+struct ArchetypeChunk
+{
+	exo::DynamicBuffer memory    = {};
+	u64                occupancy = 0; // one bit per row
+};
+
+struct Archetype
+{
+	Vec<ArchetypeColumn> columns          = {}; // sorted by type
+	Vec<ArchetypeChunk>  chunks           = {};
+	u32                  rows_per_chunk   = 0;
+	u32                  chunk_size       = 0;
+	u32                  first_free_chunk = 0; // chunks before it are full
+	u32                  len              = 0;
+};
+
+struct ArchetypeStorage
+{
+	static constexpr u32 CHUNK_SIZE         = 16 << 10;
+	static constexpr u32 MAX_ROWS_PER_CHUNK = 64;
+
+	Vec<Archetype>          archetypes = {};
+	exo::Pool<ArchetypeRow> rows       = {};
+
+	// --
+	void destroy();
+
+	// Default constructs the components of a new entity in the archetype of their signature
+	template <typename... Components>
+	Handle<ArchetypeRow> create();
+	// Destroys the components of an entity, its row will be reused
+	void remove(Handle<ArchetypeRow> handle);
+
+	template <typename Component>
+	Component *get(Handle<ArchetypeRow> handle)
+	{
+		return static_cast<Component *>(this->get_component(handle, Component::TYPE_INFO));
+	}
+
+	// Calls fn(u64 occupancy, Components *...columns) for each chunk whose archetype contains all the components, the
+	// columns are arrays of rows_per_chunk components and only the rows whose bit is set in occupancy are alive. The
+	// types are matched exactly (a query on a base component doesn't match its derived components).
+	template <typename... Components, typename Fn>
+	void for_each_chunk(Fn &&fn);
+
+	// Calls fn(Components &...) for each entity whose archetype contains all the components
+	template <typename... Components, typename Fn>
+	void for_each(Fn &&fn);
+
+	// --
+	u32                  find_or_create_archetype(exo::Span<ArchetypeColumn> columns);
+	Handle<ArchetypeRow> allocate_row(u32 i_archetype);
+	void                *get_component(Handle<ArchetypeRow> handle, const refl::TypeInfo *type);
+	bool                 find_columns(const Archetype              &archetype,
+						 exo::Span<const refl::TypeInfo *const> types,
+						 exo::Span<u32>                         out_offsets) const;
+};
+
+namespace details::archetype
+{
+template <typename Component>
+ArchetypeColumn column()
+{
+	return ArchetypeColumn{
+		.type      = Component::TYPE_INFO,
+		.stride    = sizeof(Component),
+		.alignment = alignof(Component),
+		.destroy   = [](void *component) { static_cast<Component *>(component)->~Component(); },
+	};
+}
+
+template <typename... Components, typename Fn, usize... I>
+void call_with_chunk(Fn &fn, u64 occupancy, u8 *chunk_memory, const u32 *offsets, std::index_sequence<I...>)
+{
+	fn(occupancy, std::launder(reinterpret_cast<Components *>(chunk_memory + offsets[I]))...);
+}
+} // namespace details::archetype
+
+template <typename... Components>
+Handle<ArchetypeRow> ArchetypeStorage::create()
+{
+	static_assert(sizeof...(Components) > 0);
+
+	ArchetypeColumn columns[]   = {details::archetype::column<Components>()...};
+	const u32       i_archetype = this->find_or_create_archetype(exo::Span(columns, sizeof...(Components)));
+
+	const auto handle = this->allocate_row(i_archetype);
+	(new (this->get_component(handle, Components::TYPE_INFO)) Components(), ...);
+	return handle;
+}
+
+template <typename... Components, typename Fn>
+void ArchetypeStorage::for_each_chunk(Fn &&fn)
+{
+	const refl::TypeInfo *const types[] = {Components::TYPE_INFO...};
+	u32                         offsets[sizeof...(Components)];
+
+	for (auto &archetype : this->archetypes) {
+		if (archetype.len == 0 || !this->find_columns(archetype,
+									  exo::Span<const refl::TypeInfo *const>(types, sizeof...(Components)),
+									  exo::Span<u32>(offsets, sizeof...(Components)))) {
+			continue;
+		}
+
+		for (auto &chunk : archetype.chunks) {
+			if (chunk.occupancy != 0) {
+				details::archetype::call_with_chunk<Components...>(fn,
+					chunk.occupancy,
+					static_cast<u8 *>(chunk.memory.ptr),
+					offsets,
+					std::index_sequence_for<Components...>{});
+			}
+		}
+	}
+}
+
+template <typename... Components, typename Fn>
+void ArchetypeStorage::for_each(Fn &&fn)
+{
+	this->for_each_chunk<Components...>([&](u64 occupancy, Components *...columns) {
+		for (; occupancy != 0; occupancy &= occupancy - 1) {
+			const u32 i_row = u32(std::countr_zero(occupancy));
+			fn(columns[i_row]...);
+		}
+	});
+}
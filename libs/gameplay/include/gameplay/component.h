@@ -13,6 +13,7 @@ struct Serializer;
 };
 struct LoadingContext;
 struct Entity;
+struct TransformHierarchy;
 
 enum struct ComponentState
 {
@@ -78,9 +79,12 @@ struct SpatialComponent : BaseComponent
 
 private:
 	float4x4  local_transform = {};
-	float4x4  world_transform = {};
 	exo::AABB local_bounds    = {};
-	exo::AABB world_bounds    = {};
+
+	// The world transform and bounds live in the hierarchy of the world once the entity is initialized, local space is
+	// world space until then
+	TransformHierarchy *transform_hierarchy = nullptr;
+	u32                 transform_node      = u32_invalid;
 
 	refl::BasePtr<SpatialComponent>      parent   = {};
 	Vec<refl::BasePtr<SpatialComponent>> children = {};
@@ -91,14 +95,17 @@ public:
 
 	inline const float4x4  &get_local_transform() const { return local_transform; }
 	inline const exo::AABB &get_local_bounds() const { return local_bounds; }
-	inline const float4x4  &get_world_transform() const { return world_transform; }
-	inline const exo::AABB &get_world_bounds() const { return world_bounds; }
+	const float4x4         &get_world_transform() const;
+	const exo::AABB        &get_world_bounds() const;
+	// Node tracking the world transform in the hierarchy, changes of the node are listed in changed_handles
+	inline TransformHierarchy *get_transform_hierarchy() const { return transform_hierarchy; }
+	inline u32                 get_transform_node() const { return transform_node; }
 
 	void serialize(exo::Serializer &serializer) override;
 
 private:
-	void update_world_transform();
 	friend struct EntityWorld;
+	friend struct TransformHierarchy;
 };
 
 /**
@@ -4,6 +4,7 @@
 struct Entity;
 struct BaseComponent;
 struct SystemRegistry;
+struct TransformHierarchy;
 struct AssetManager;
 
 struct InitializationContext
@@ -22,7 +23,8 @@ struct InitializationContext
 	     system.register_component(entity, component);
 	 **/
 
-	SystemRegistry *system_registry;
+	SystemRegistry     *system_registry;
+	TransformHierarchy *transform_hierarchy;
 };
 
 struct LoadingContext
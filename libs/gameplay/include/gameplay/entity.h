@@ -1,5 +1,6 @@
 #pragma once
 #include "exo/collections/enum_array.h"
+#include "exo/collections/handle.h"
 #include "exo/collections/vector.h"
 
 #include "exo/uuid.h"
@@ -20,6 +21,7 @@ struct UpdateContext;
 struct LocalSystem;
 struct LoadingContext;
 struct InitializationContext;
+struct ArchetypeRow;
 
 enum struct EntityState
 {
@@ -60,6 +62,9 @@ struct Entity
 	exo::UUID                       parent                = {};
 	bool                            is_attached_to_parent = false;
 
+	// Row of the components in the archetype storage of the world, invalid when they are allocated individually
+	Handle<ArchetypeRow> archetype_row = {};
+
 	// --
 	void load(LoadingContext &ctx);
 	void unload(LoadingContext &ctx);
@@ -84,8 +89,14 @@ struct Entity
 	template <std::derived_from<BaseComponent> Component, typename... Args>
 	refl::BasePtr<BaseComponent> create_component(Args &&...args)
 	{
-		Component *new_component     = new Component(std::forward<Args>(args)...);
-		auto       new_component_ptr = refl::BasePtr<BaseComponent>(new_component);
+		return add_component(new Component(std::forward<Args>(args)...));
+	}
+
+	// Add a component constructed by the caller, e.g. in the archetype storage of the world
+	template <std::derived_from<BaseComponent> Component>
+	refl::BasePtr<BaseComponent> add_component(Component *new_component)
+	{
+		auto new_component_ptr = refl::BasePtr<BaseComponent>(new_component);
 		create_component_internal(new_component_ptr);
 
 		// If the component is the first spatial component, it's the entity's root
@@ -1,17 +1,35 @@
 #pragma once
 #include "exo/collections/set.h"
+#include "exo/memory/arena_allocator.h"
+#include "exo/memory/size_class_allocator.h"
 #include "exo/memory/string_repository.h"
 #include "exo/string_view.h"
 #include "exo/uuid.h"
+#include "gameplay/archetype_storage.h"
+#include "gameplay/component.h"
+#include "gameplay/entity.h"
 #include "gameplay/system.h"
 #include "gameplay/system_registry.h"
+#include "gameplay/transform_hierarchy.h"
 
 namespace exo
 {
 struct Serializer;
 }
+namespace cross
+{
+struct JobManager;
+}
 struct AssetManager;
-struct Entity;
+
+// Cost of an update stage during the last update
+struct UpdateStageStats
+{
+	double entities_ms      = 0.0;
+	double global_ms        = 0.0;
+	u32    updated_entities = 0;
+	u32    global_batches   = 0; // groups of global systems updated concurrently
+};
 
 struct EntityWorld
 {
@@ -19,15 +37,39 @@ struct EntityWorld
 	exo::Map<exo::UUID, Entity *> entities = {};
 	exo::Set<Entity *> root_entities = {};
 	SystemRegistry system_registry = {};
+	TransformHierarchy transform_hierarchy = {};
+	ArchetypeStorage component_storage = {};
+	// Stages and transforms are updated on the calling thread when null
+	const cross::JobManager *jobmanager = nullptr;
+
+	exo::SizeClassAllocator entity_allocator = exo::SizeClassAllocator{"Entities"};
+	// Containers rebuilt every update
+	exo::ArenaAllocator frame_arena = {};
 
 	exo::EnumArray<Vec<refl::BasePtr<GlobalSystem>>, UpdateStage> global_per_stage_update_list = {};
+	// The global systems of the batch i are [offsets[i], offsets[i + 1]) in the update list of their stage
+	exo::EnumArray<Vec<u32>, UpdateStage> global_per_stage_batch_offsets = {};
+	exo::EnumArray<Vec<Entity *>, UpdateStage> entities_per_stage = {};
+
+	exo::EnumArray<UpdateStageStats, UpdateStage> stage_stats = {};
 
 	// --
 	EntityWorld();
+	// Destroys the entities and the components stored in the archetypes
+	void destroy();
 	void update(double delta_t, AssetManager *asset_manager);
 
 	// Entities
 	Entity *create_entity(exo::StringView name = "Unnamed");
+	// Creates an entity whose components are stored next to the components of the entities with the same signature
+	template <std::derived_from<BaseComponent>... Components>
+	Entity *create_entity_with_components(exo::StringView name = "Unnamed")
+	{
+		auto *new_entity          = this->create_entity(name);
+		new_entity->archetype_row = this->component_storage.create<Components...>();
+		(new_entity->add_component(this->component_storage.get<Components>(new_entity->archetype_row)), ...);
+		return new_entity;
+	}
 	void destroy_entity(Entity *entity);
 	void set_parent_entity(Entity *entity, Entity *parent);
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "exo/collections/enum_array.h"
+#include "exo/collections/vector.h"
 #include "reflection/reflection.h"
 
 #include "gameplay/update_stages.h"
@@ -25,13 +26,41 @@ struct LocalSystem
 	virtual void unregister_component(refl::BasePtr<BaseComponent> component) = 0;
 };
 
+// Components read and written by a global system during its update.
+// The global systems of a stage are updated concurrently when their accesses don't conflict, a system that doesn't
+// declare its accesses is updated alone. The transform hierarchy of the world is accessed as SpatialComponent.
+struct SystemAccess
+{
+	Vec<const refl::TypeInfo *> reads    = {};
+	Vec<const refl::TypeInfo *> writes   = {};
+	bool                        declared = false;
+
+	// --
+	template <typename Component>
+	void read()
+	{
+		reads.push(Component::TYPE_INFO);
+		declared = true;
+	}
+
+	template <typename Component>
+	void write()
+	{
+		writes.push(Component::TYPE_INFO);
+		declared = true;
+	}
+
+	bool conflicts_with(const SystemAccess &other) const;
+};
+
 struct GlobalSystem
 {
 	using Self = GlobalSystem;
 	REFL_REGISTER_TYPE("GlobalSystem")
 
-	UpdateStage update_stage = UpdateStage::FrameStart;
-	float       priority     = -1.0f;
+	UpdateStage  update_stage = UpdateStage::FrameStart;
+	float        priority     = -1.0f;
+	SystemAccess access       = {};
 
 	// --
 	friend struct EntityWorld;
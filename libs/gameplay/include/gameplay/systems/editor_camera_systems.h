@@ -5,40 +5,36 @@
 
 class Inputs;
 
-struct CameraComponent;
-struct EditorCameraComponent;
-struct CameraInputComponent;
-
-struct EditorCameraInputSystem : LocalSystem
+// The editor cameras are the entities created with a CameraComponent, an EditorCameraComponent and a
+// CameraInputComponent, the systems query them in the component storage of the world
+struct EditorCameraInputSystem : GlobalSystem
 {
 	using Self  = EditorCameraInputSystem;
-	using Super = LocalSystem;
+	using Super = GlobalSystem;
 	REFL_REGISTER_TYPE_WITH_SUPER("EditorCameraInputSystem")
 
-	CameraInputComponent  *camera_input_component  = {};
-	EditorCameraComponent *editor_camera_component = {};
-	const Inputs          *inputs                  = {};
+	const Inputs *inputs = {};
 
 	// --
 	EditorCameraInputSystem(const Inputs *_inputs);
+	void initialize(const SystemRegistry &) final {}
+	void shutdown() final {}
 	void update(const UpdateContext &ctx) final;
-	void register_component(refl::BasePtr<BaseComponent> component) final;
-	void unregister_component(refl::BasePtr<BaseComponent> component) final;
+	void register_component(const Entity *, refl::BasePtr<BaseComponent>) final {}
+	void unregister_component(const Entity *, refl::BasePtr<BaseComponent>) final {}
 };
 
-struct EditorCameraTransformSystem : LocalSystem
+struct EditorCameraTransformSystem : GlobalSystem
 {
 	using Self  = EditorCameraTransformSystem;
-	using Super = LocalSystem;
+	using Super = GlobalSystem;
 	REFL_REGISTER_TYPE_WITH_SUPER("EditorCameraTransformSystem")
 
-	CameraInputComponent  *camera_input_component  = {};
-	EditorCameraComponent *editor_camera_component = {};
-	CameraComponent       *camera_component        = {};
-
 	// --
 	EditorCameraTransformSystem();
+	void initialize(const SystemRegistry &) final {}
+	void shutdown() final {}
 	void update(const UpdateContext &ctx) final;
-	void register_component(refl::BasePtr<BaseComponent> component) final;
-	void unregister_component(refl::BasePtr<BaseComponent> component) final;
+	void register_component(const Entity *, refl::BasePtr<BaseComponent>) final {}
+	void unregister_component(const Entity *, refl::BasePtr<BaseComponent>) final {}
 };
@@ -0,0 +1,70 @@
+#pragma once
+#include "exo/collections/vector.h"
+#include "exo/maths/aabb.h"
+#include "exo/maths/matrices.h"
+#include "exo/maths/numerics.h"
+
+#include <atomic>
+
+namespace cross
+{
+struct JobManager;
+}
+struct SpatialComponent;
+
+/**
+   Transforms of the spatial components of a world, stored as arrays sorted by depth.
+   The nodes of a level are contiguous and their parents are in the previous levels, so the world transforms are
+   propagated level by level and the nodes of a level can be computed in parallel.
+   Components reference their node with a stable handle, the index of a node changes every time the hierarchy is sorted.
+ **/
+struct TransformHierarchy
+{
+	Vec<float4x4>  local_transforms = {};
+	Vec<float4x4>  world_transforms = {};
+	Vec<exo::AABB> local_bounds     = {};
+	Vec<exo::AABB> world_bounds     = {};
+	Vec<u32>       parents          = {}; // handle of the parent, u32_invalid for roots
+	Vec<u32>       parent_indices   = {}; // index of the parent, only valid when the hierarchy is sorted
+	Vec<u8>        dirty            = {}; // the node or one of its ancestors changed since the last update
+	Vec<u32>       handles          = {};
+
+	// The nodes of the level i are [level_offsets[i], level_offsets[i + 1])
+	Vec<u32> level_offsets   = {};
+	Vec<u32> handle_to_index = {}; // u32_invalid for free handles
+	Vec<u32> free_handles    = {};
+
+	// Handles of the nodes whose world transform or bounds changed since the last call to clear_changes(), a node
+	// appears once. The handle of a removed node can be in the list, and even be reused by a new node.
+	Vec<u32> changed_handles = {};
+	Vec<u8>  is_changed      = {}; // indexed by handle
+
+	bool              needs_sort      = false;
+	std::atomic<bool> has_dirty_nodes = false;
+
+	// --
+	void destroy();
+
+	// Adds a component and its ancestors that are not in the hierarchy yet
+	void add(SpatialComponent &component);
+	// The children of the component become roots until they are attached again
+	void remove(SpatialComponent &component);
+	// Follows the parent of a component after it changed
+	void set_parent(SpatialComponent &component);
+
+	// The local transform and bounds of different nodes can be set concurrently, the other modifiers are not thread-safe
+	void set_local_transform(u32 handle, const float4x4 &transform);
+	void set_local_bounds(u32 handle, const exo::AABB &bounds);
+
+	const float4x4  &get_world_transform(u32 handle) const { return world_transforms[handle_to_index[handle]]; }
+	const exo::AABB &get_world_bounds(u32 handle) const { return world_bounds[handle_to_index[handle]]; }
+
+	// Recomputes the world transforms and bounds of the dirty subtrees, levels are split in jobs when `jobmanager` is
+	// not null
+	void update(const cross::JobManager *jobmanager);
+	// Called by the consumer of changed_handles once it has processed them
+	void clear_changes();
+
+private:
+	void sort();
+};
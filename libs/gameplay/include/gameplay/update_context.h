@@ -1,8 +1,16 @@
 #pragma once
 #include "gameplay/update_stages.h"
 
+namespace cross
+{
+struct JobManager;
+}
+struct ArchetypeStorage;
+
 struct UpdateContext
 {
-	double      delta_t;
-	UpdateStage stage;
+	double                   delta_t;
+	UpdateStage              stage;
+	const cross::JobManager *jobmanager        = nullptr; // null when the world is updated on one thread
+	ArchetypeStorage        *component_storage = nullptr; // queried by the global systems
 };
@@ -0,0 +1,172 @@
+#include "gameplay/archetype_storage.h"
+
+#include "exo/macros/assert.h"
+#include "exo/maths/pointer.h"
+#include "exo/memory/allocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+
+static u64 full_occupancy(u32 rows_per_chunk)
+{
+	return rows_per_chunk == 64 ? ~u64(0) : (u64(1) << rows_per_chunk) - 1;
+}
+
+// Column arrays are laid out one after the other, returns the size of a chunk with `rows_per_chunk` rows
+static u32 layout_columns(exo::Span<ArchetypeColumn> columns, u32 rows_per_chunk)
+{
+	usize offset = 0;
+	for (auto &column : columns) {
+		offset        = exo::round_up_to_alignment(column.alignment, offset);
+		column.offset = u32(offset);
+		offset += usize(column.stride) * rows_per_chunk;
+	}
+	return u32(offset);
+}
+
+void ArchetypeStorage::destroy()
+{
+	for (auto &archetype : this->archetypes) {
+		for (auto &chunk : archetype.chunks) {
+			auto *chunk_memory = static_cast<u8 *>(chunk.memory.ptr);
+			for (u64 occupancy = chunk.occupancy; occupancy != 0; occupancy &= occupancy - 1) {
+				const u32 i_row = u32(std::countr_zero(occupancy));
+				for (const auto &column : archetype.columns) {
+					column.destroy(chunk_memory + column.offset + i_row * column.stride);
+				}
+			}
+			chunk.memory.destroy();
+		}
+		archetype.chunks.buffer.destroy();
+		archetype.columns.buffer.destroy();
+	}
+	// The storage can be used again after being destroyed
+	this->archetypes.clear();
+	this->archetypes.buffer.destroy();
+	this->rows.clear();
+}
+
+u32 ArchetypeStorage::find_or_create_archetype(exo::Span<ArchetypeColumn> columns)
+{
+	// Any total order works, a signature only has to be sorted the same way every time
+	std::sort(columns.begin(), columns.end(), [](const ArchetypeColumn &lhs, const ArchetypeColumn &rhs) {
+		return std::less<>{}(lhs.type, rhs.type);
+	});
+	for (usize i_column = 1; i_column < columns.len(); ++i_column) {
+		// A component type appears twice in the signature
+		ASSERT(columns[i_column - 1].type != columns[i_column].type);
+	}
+
+	for (u32 i_archetype = 0; i_archetype < this->archetypes.len(); ++i_archetype) {
+		const auto &archetype_columns = this->archetypes[i_archetype].columns;
+		if (archetype_columns.len() != columns.len()) {
+			continue;
+		}
+
+		bool same_signature = true;
+		for (u32 i_column = 0; i_column < archetype_columns.len(); ++i_column) {
+			same_signature = same_signature && archetype_columns[i_column].type == columns[i_column].type;
+		}
+		if (same_signature) {
+			return i_archetype;
+		}
+	}
+
+	Archetype new_archetype = {};
+	usize     row_size      = 0;
+	for (const auto &column : columns) {
+		// Chunks are allocated with the default alignment
+		ASSERT(column.alignment <= exo::Allocator::DEFAULT_ALIGNMENT);
+		row_size += column.stride;
+		new_archetype.columns.push(column);
+	}
+
+	// Fit as many rows as possible in a chunk, big components get a single row and a bigger chunk
+	new_archetype.rows_per_chunk = u32(std::clamp(usize(CHUNK_SIZE) / std::max(row_size, usize(1)),
+		usize(1),
+		usize(MAX_ROWS_PER_CHUNK)));
+	new_archetype.chunk_size     = layout_columns(new_archetype.columns, new_archetype.rows_per_chunk);
+	while (new_archetype.rows_per_chunk > 1 && new_archetype.chunk_size > CHUNK_SIZE) {
+		new_archetype.rows_per_chunk -= 1;
+		new_archetype.chunk_size = layout_columns(new_archetype.columns, new_archetype.rows_per_chunk);
+	}
+
+	this->archetypes.push(std::move(new_archetype));
+	return this->archetypes.len() - 1;
+}
+
+bool ArchetypeStorage::find_columns(const Archetype &archetype,
+	exo::Span<const refl::TypeInfo *const>             types,
+	exo::Span<u32>                                     out_offsets) const
+{
+	ASSERT(types.len() == out_offsets.len());
+	for (usize i_type = 0; i_type < types.len(); ++i_type) {
+		bool found = false;
+		for (const auto &column : archetype.columns) {
+			if (column.type == types[i_type]) {
+				out_offsets[i_type] = column.offset;
+				found               = true;
+				break;
+			}
+		}
+		if (!found) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void *ArchetypeStorage::get_component(Handle<ArchetypeRow> handle, const refl::TypeInfo *type)
+{
+	const auto &row       = this->rows.get(handle);
+	auto       &archetype = this->archetypes[row.i_archetype];
+	auto       &chunk     = archetype.chunks[row.i_chunk];
+
+	for (const auto &column : archetype.columns) {
+		if (column.type == type) {
+			return static_cast<u8 *>(chunk.memory.ptr) + column.offset + row.i_row * column.stride;
+		}
+	}
+	return nullptr;
+}
+
+Handle<ArchetypeRow> ArchetypeStorage::allocate_row(u32 i_archetype)
+{
+	auto     &archetype = this->archetypes[i_archetype];
+	const u64 full      = full_occupancy(archetype.rows_per_chunk);
+
+	while (archetype.first_free_chunk < archetype.chunks.len() &&
+		   archetype.chunks[archetype.first_free_chunk].occupancy == full) {
+		archetype.first_free_chunk += 1;
+	}
+	if (archetype.first_free_chunk == archetype.chunks.len()) {
+		auto &new_chunk = archetype.chunks.push();
+		exo::DynamicBuffer::init(new_chunk.memory, archetype.chunk_size);
+	}
+
+	const u32 i_chunk = archetype.first_free_chunk;
+	auto     &chunk   = archetype.chunks[i_chunk];
+	const u32 i_row   = u32(std::countr_one(chunk.occupancy));
+	chunk.occupancy |= u64(1) << i_row;
+	archetype.len += 1;
+
+	return this->rows.add(ArchetypeRow{.i_archetype = i_archetype, .i_chunk = i_chunk, .i_row = i_row});
+}
+
+void ArchetypeStorage::remove(Handle<ArchetypeRow> handle)
+{
+	const auto row       = this->rows.get(handle);
+	auto      &archetype = this->archetypes[row.i_archetype];
+	auto      &chunk     = archetype.chunks[row.i_chunk];
+
+	auto *chunk_memory = static_cast<u8 *>(chunk.memory.ptr);
+	for (const auto &column : archetype.columns) {
+		column.destroy(chunk_memory + column.offset + row.i_row * column.stride);
+	}
+	chunk.occupancy &= ~(u64(1) << row.i_row);
+	archetype.len -= 1;
+	archetype.first_free_chunk = std::min(archetype.first_free_chunk, row.i_chunk);
+
+	this->rows.remove(handle);
+}
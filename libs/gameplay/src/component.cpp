@@ -1,5 +1,7 @@
 #include "gameplay/component.h"
 
+#include "gameplay/transform_hierarchy.h"
+
 #include "exo/serialization/serializer.h"
 #include "exo/serialization/string_serializer.h"
 #include "exo/serialization/uuid_serializer.h"
@@ -8,27 +10,27 @@
 void SpatialComponent::set_local_transform(const float4x4 &new_transform)
 {
 	local_transform = new_transform;
-	this->update_world_transform();
+	if (transform_hierarchy) {
+		transform_hierarchy->set_local_transform(transform_node, new_transform);
+	}
 }
 
 void SpatialComponent::set_local_bounds(const exo::AABB &new_bounds)
 {
 	local_bounds = new_bounds;
-	// TODO: compute world_bounds
+	if (transform_hierarchy) {
+		transform_hierarchy->set_local_bounds(transform_node, new_bounds);
+	}
 }
 
-void SpatialComponent::update_world_transform()
+const float4x4 &SpatialComponent::get_world_transform() const
 {
-	world_transform = local_transform;
-	auto p          = parent;
-	while (p.get() != nullptr) {
-		world_transform = p->local_transform * world_transform;
-		p               = p->parent;
-	}
+	return transform_hierarchy ? transform_hierarchy->get_world_transform(transform_node) : local_transform;
+}
 
-	for (auto child : children) {
-		child->update_world_transform();
-	}
+const exo::AABB &SpatialComponent::get_world_bounds() const
+{
+	return transform_hierarchy ? transform_hierarchy->get_world_bounds(transform_node) : local_bounds;
 }
 
 void BaseComponent::serialize(exo::Serializer &serializer)
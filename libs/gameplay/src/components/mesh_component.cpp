@@ -4,6 +4,7 @@
 
 #include "assets/asset_id.h"
 #include "assets/asset_manager.h"
+#include "assets/mesh.h"
 
 void MeshComponent::load(LoadingContext &ctx)
 {
@@ -20,6 +21,13 @@ void MeshComponent::unload(LoadingContext &ctx)
 void MeshComponent::update_loading(LoadingContext &ctx)
 {
 	if (ctx.asset_manager->is_fully_loaded(this->mesh_asset)) {
+		// The world bounds are computed from the bounds of the submeshes
+		exo::AABB mesh_bounds = {};
+		for (const auto &submesh : ctx.asset_manager->get_asset_t<Mesh>(this->mesh_asset)->submeshes) {
+			exo::extend(mesh_bounds, exo::AABB{.min = submesh.bounds_min, .max = submesh.bounds_max});
+		}
+		this->set_local_bounds(mesh_bounds);
+
 		this->state = ComponentState::Loaded;
 	}
 }
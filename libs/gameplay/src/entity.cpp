@@ -3,6 +3,7 @@
 #include "gameplay/component.h"
 #include "gameplay/contexts.h"
 #include "gameplay/system.h"
+#include "gameplay/transform_hierarchy.h"
 #include "gameplay/update_context.h"
 
 #include "exo/serialization/serializer.h"
@@ -60,10 +61,11 @@ void Entity::initialize(InitializationContext &ctx)
 {
 	ASSERT(state == EntityState::Loaded);
 
-	// if is spatial entity, update root
-
 	for (auto component : components) {
 		if (component->is_initialized()) {
+			if (auto *spatial_component = refl::upcast<SpatialComponent>(component.get(), &component.typeinfo())) {
+				ctx.transform_hierarchy->add(*spatial_component);
+			}
 			for (auto system : local_systems) {
 				system->register_component(component);
 			}
@@ -77,7 +79,7 @@ void Entity::initialize(InitializationContext &ctx)
 		per_stage_update_list[stage].clear();
 
 		for (auto system : local_systems) {
-			if (system->priority > 0.0) {
+			if (system->update_stage == stage && system->priority > 0.0) {
 				per_stage_update_list[stage].push(system.get());
 			}
 		}
@@ -105,6 +107,9 @@ void Entity::shutdown(InitializationContext &ctx)
 				system->unregister_component(component);
 			}
 			ctx.unregister_global_system(this, component);
+			if (auto *spatial_component = refl::upcast<SpatialComponent>(component.get(), &component.typeinfo())) {
+				ctx.transform_hierarchy->remove(*spatial_component);
+			}
 		}
 	}
 
@@ -180,6 +185,7 @@ void serialize(exo::Serializer &serializer, Entity &entity)
 			}
 		}
 
-		entity.state = static_cast<EntityState>(state);
+		// The components are read unloaded, the entity is loaded and registered to the systems again
+		entity.state = EntityState::Unloaded;
 	}
 }
@@ -8,21 +8,113 @@
 #include "gameplay/update_stages.h"
 
 #include "assets/asset_manager.h"
+#include "cross/jobmanager.h"
+#include "cross/jobs/foreach.h"
+#include "cross/jobs/waitable.h"
 #include "exo/collections/vector.h"
 #include "exo/profile.h"
+#include "exo/timer.h"
 #include "exo/serialization/serializer.h"
 #include "exo/uuid.h"
 
 #include <algorithm> // for std::sort
+#include <chrono>
 
-EntityWorld::EntityWorld() { this->str_repo = exo::StringRepository::create(); }
+// Local systems are cheap, a job updates this many entities
+static constexpr int ENTITY_GRAIN_SIZE = 64;
+
+EntityWorld::EntityWorld()
+{
+	this->str_repo    = exo::StringRepository::create();
+	this->frame_arena = exo::ArenaAllocator::with_reserve(16_MiB, "EntityWorld frame");
+}
+
+void EntityWorld::destroy()
+{
+	Vec<Entity *> to_destroy = {};
+	for (auto &[uuid, entity] : this->entities) {
+		to_destroy.push(entity);
+	}
+	for (auto *entity : to_destroy) {
+		this->destroy_entity(entity);
+	}
+	to_destroy.buffer.destroy();
+
+	this->component_storage.destroy();
+	this->transform_hierarchy.destroy();
+}
+
+static Entity *allocate_entity(EntityWorld &world)
+{
+	return new (world.entity_allocator.allocate(sizeof(Entity), alignof(Entity))) Entity();
+}
+
+// A system starts a new batch when it conflicts with a system of the current batch, so conflicting systems are still
+// updated in priority order
+static void split_global_systems_in_batches(Vec<refl::BasePtr<GlobalSystem>> &systems, Vec<u32> &out_batch_offsets)
+{
+	out_batch_offsets.push(0u);
+	u32 batch_begin = 0;
+	for (u32 i_system = 0; i_system < systems.len(); ++i_system) {
+		for (u32 i_batch_system = batch_begin; i_batch_system < i_system; ++i_batch_system) {
+			if (systems[i_system]->access.conflicts_with(systems[i_batch_system]->access)) {
+				out_batch_offsets.push(i_system);
+				batch_begin = i_system;
+				break;
+			}
+		}
+	}
+	out_batch_offsets.push(systems.len());
+}
+
+static void update_entities(
+	const cross::JobManager *jobmanager, exo::Span<Entity *> entities, const UpdateContext &update_context)
+{
+	if (jobmanager == nullptr || entities.len() <= usize(ENTITY_GRAIN_SIZE)) {
+		for (auto *entity : entities) {
+			entity->update_systems(update_context);
+		}
+		return;
+	}
+
+	auto waitable = cross::parallel_foreach_userdata<Entity *, const UpdateContext, true>(
+		*jobmanager,
+		entities,
+		&update_context,
+		[](Entity *&entity, const UpdateContext *ctx) { entity->update_systems(*ctx); },
+		ENTITY_GRAIN_SIZE);
+	waitable->wait();
+}
+
+static void update_global_systems(const cross::JobManager *jobmanager,
+	exo::Span<refl::BasePtr<GlobalSystem>>                   systems,
+	const UpdateContext                                     &update_context)
+{
+	if (jobmanager == nullptr || systems.len() == 1) {
+		for (auto system : systems) {
+			system->update(update_context);
+		}
+		return;
+	}
+
+	auto waitable = cross::parallel_foreach_userdata<refl::BasePtr<GlobalSystem>, const UpdateContext, true>(
+		*jobmanager,
+		systems,
+		&update_context,
+		[](refl::BasePtr<GlobalSystem> &system, const UpdateContext *ctx) { system->update(*ctx); },
+		1);
+	waitable->wait();
+}
 
 void EntityWorld::update(double delta_t, AssetManager *asset_manager)
 {
 	EXO_PROFILE_SCOPE;
 
 	LoadingContext        loading_context        = {asset_manager};
-	InitializationContext initialization_context = {.system_registry = &this->system_registry};
+	InitializationContext initialization_context = {
+		.system_registry     = &this->system_registry,
+		.transform_hierarchy = &this->transform_hierarchy,
+	};
 
 	// -- Prepare entities
 	{
@@ -43,43 +135,92 @@ void EntityWorld::update(double delta_t, AssetManager *asset_manager)
 	// -- Prepare global systems
 	{
 		EXO_PROFILE_SCOPE_NAMED("Prepare global systems");
+		this->frame_arena.reset();
 		for (auto &update_list : global_per_stage_update_list) {
-			update_list.clear();
+			update_list = Vec<refl::BasePtr<GlobalSystem>>::with_allocator(&this->frame_arena);
 		}
 
 		for (auto global_system : system_registry.global_systems) {
 			global_per_stage_update_list[global_system->update_stage].push(global_system);
 		}
 
-		for (auto &update_list : global_per_stage_update_list) {
+		for (usize i_stage = 0; i_stage < static_cast<usize>(UpdateStage::Count); i_stage += 1) {
+			auto  stage       = static_cast<UpdateStage>(i_stage);
+			auto &update_list = global_per_stage_update_list[stage];
 			std::sort(update_list.begin(), update_list.end(), [](auto a, auto b) { return a->priority > b->priority; });
+
+			global_per_stage_batch_offsets[stage] = Vec<u32>::with_allocator(&this->frame_arena);
+			split_global_systems_in_batches(update_list, global_per_stage_batch_offsets[stage]);
 		}
 	}
 
-	// --
+	// -- Prepare the entities to update in each stage
+	{
+		EXO_PROFILE_SCOPE_NAMED("Prepare entity updates");
+		for (auto &update_list : entities_per_stage) {
+			update_list = Vec<Entity *>::with_allocator(&this->frame_arena);
+		}
+
+		for (auto &[uuid, entity] : entities) {
+			if (!entity->is_active()) {
+				continue;
+			}
+			for (usize i_stage = 0; i_stage < static_cast<usize>(UpdateStage::Count); i_stage += 1) {
+				auto stage = static_cast<UpdateStage>(i_stage);
+				if (!entity->per_stage_update_list[stage].is_empty()) {
+					entities_per_stage[stage].push(entity);
+				}
+			}
+		}
+	}
+
+	// -- Update stages, the systems of a stage see the changes of all the previous stages
 
-	UpdateContext update_context = {};
-	update_context.delta_t       = delta_t;
+	UpdateContext update_context     = {};
+	update_context.delta_t           = delta_t;
+	update_context.jobmanager        = this->jobmanager;
+	update_context.component_storage = &this->component_storage;
 	for (usize i_stage = 0; i_stage < static_cast<usize>(UpdateStage::Count); i_stage += 1) {
 		update_context.stage = static_cast<UpdateStage>(i_stage);
 		EXO_PROFILE_SCOPE_NAMED("Update stage");
 
+		auto &stats = this->stage_stats[update_context.stage];
+		stats       = {};
+
 		{
 			EXO_PROFILE_SCOPE_NAMED("Entities");
-			// TODO: parallel for
-			for (auto &[uuid, entity] : entities) {
-				if (entity->is_active()) {
-					entity->update_systems(update_context);
-				}
-			}
+			const auto start = std::chrono::steady_clock::now();
+
+			auto &update_list = entities_per_stage[update_context.stage];
+			update_entities(this->jobmanager, update_list, update_context);
+
+			stats.updated_entities = update_list.len();
+			stats.entities_ms      = exo::elapsed_ms(start);
 		}
 
 		{
 			EXO_PROFILE_SCOPE_NAMED("Global");
-			for (auto system : global_per_stage_update_list[update_context.stage]) {
-				system->update(update_context);
+			const auto start = std::chrono::steady_clock::now();
+
+			auto       &update_list   = global_per_stage_update_list[update_context.stage];
+			const auto &batch_offsets = global_per_stage_batch_offsets[update_context.stage];
+			for (u32 i_batch = 0; i_batch + 1 < batch_offsets.len(); ++i_batch) {
+				const u32 batch_begin = batch_offsets[i_batch];
+				const u32 batch_end   = batch_offsets[i_batch + 1];
+				if (batch_begin == batch_end) {
+					continue;
+				}
+				update_global_systems(this->jobmanager,
+					exo::Span(update_list.data() + batch_begin, batch_end - batch_begin),
+					update_context);
+				stats.global_batches += 1;
 			}
+
+			stats.global_ms = exo::elapsed_ms(start);
 		}
+
+		// Systems of the next stages see the world transforms of this stage
+		this->transform_hierarchy.update(this->jobmanager);
 	}
 }
 
@@ -87,7 +228,7 @@ void EntityWorld::update(double delta_t, AssetManager *asset_manager)
 
 Entity *EntityWorld::create_entity(exo::StringView name)
 {
-	auto *new_entity = new Entity();
+	auto *new_entity = allocate_entity(*this);
 	new_entity->name = this->str_repo.intern(name);
 	new_entity->uuid = exo::UUID::create();
 
@@ -111,11 +252,46 @@ void EntityWorld::set_parent_entity(Entity *entity, Entity *parent)
 
 void EntityWorld::destroy_entity(Entity *entity)
 {
+	// The attached entities become roots
+	for (auto attached_entity_id : entity->attached_entities) {
+		Entity *attached_entity = *this->entities.at(attached_entity_id);
+		if (attached_entity->is_attached_to_parent) {
+			this->_dettach_to_parent(attached_entity);
+		}
+		attached_entity->parent = {};
+		this->root_entities.insert(attached_entity);
+	}
+	if (entity->parent.is_valid()) {
+		if (entity->is_attached_to_parent) {
+			this->_dettach_to_parent(entity);
+		}
+		auto &siblings = (*this->entities.at(entity->parent))->attached_entities;
+		for (u32 i_sibling = 0; i_sibling < siblings.len(); ++i_sibling) {
+			if (siblings[i_sibling] == entity->uuid) {
+				siblings.swap_remove(i_sibling);
+				break;
+			}
+		}
+	}
+
+	// Unregisters the entity from the systems and removes its spatial components from the transform hierarchy
+	if (entity->is_active()) {
+		InitializationContext initialization_context = {
+			.system_registry     = &this->system_registry,
+			.transform_hierarchy = &this->transform_hierarchy,
+		};
+		entity->shutdown(initialization_context);
+	}
+
 	entities.remove(entity->uuid);
 	if (this->root_entities.contains(entity)) {
 		this->root_entities.remove(entity);
 	}
-	delete entity;
+	if (entity->archetype_row.is_valid()) {
+		this->component_storage.remove(entity->archetype_row);
+	}
+	entity->~Entity();
+	this->entity_allocator.free(entity, sizeof(Entity));
 }
 
 void EntityWorld::_attach_to_parent(Entity *entity)
@@ -127,7 +303,7 @@ void EntityWorld::_attach_to_parent(Entity *entity)
 	auto    parent_root = parent->root_component;
 
 	entity->root_component->parent = parent_root;
-	entity->root_component->update_world_transform();
+	this->transform_hierarchy.set_parent(*entity->root_component.get());
 	parent_root->children.push(entity->root_component);
 
 	entity->is_attached_to_parent = true;
@@ -142,7 +318,7 @@ void EntityWorld::_dettach_to_parent(Entity *entity)
 	auto    parent_root = parent->root_component;
 
 	entity->root_component->parent = {};
-	entity->root_component->update_world_transform();
+	this->transform_hierarchy.set_parent(*entity->root_component.get());
 
 	u32 i_parent_child = 0;
 	for (; i_parent_child < parent_root->children.len(); i_parent_child += 1) {
@@ -207,7 +383,7 @@ void serialize(exo::Serializer &serializer, EntityWorld &world)
 		exo::serialize(serializer, entities_length);
 
 		for (usize i = 0; i < entities_length; ++i) {
-			auto *new_entity = new Entity;
+			auto *new_entity = allocate_entity(world);
 			serialize(serializer, *new_entity);
 			world.entities.insert(new_entity->uuid, new_entity);
 
@@ -0,0 +1,39 @@
+#include "gameplay/system.h"
+
+// Accessing a component type also accesses the components deriving from it
+static bool types_overlap(const refl::TypeInfo *a, const refl::TypeInfo *b)
+{
+	for (const refl::TypeInfo *type = a; type != nullptr; type = type->base) {
+		if (type == b) {
+			return true;
+		}
+	}
+	for (const refl::TypeInfo *type = b; type != nullptr; type = type->base) {
+		if (type == a) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool accesses_overlap(const Vec<const refl::TypeInfo *> &a, const Vec<const refl::TypeInfo *> &b)
+{
+	for (const auto *type_a : a) {
+		for (const auto *type_b : b) {
+			if (types_overlap(type_a, type_b)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool SystemAccess::conflicts_with(const SystemAccess &other) const
+{
+	if (!this->declared || !other.declared) {
+		return true;
+	}
+
+	return accesses_overlap(this->writes, other.writes) || accesses_overlap(this->writes, other.reads) ||
+	       accesses_overlap(this->reads, other.writes);
+}
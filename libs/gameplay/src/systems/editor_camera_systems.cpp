@@ -1,5 +1,6 @@
 #include "gameplay/systems/editor_camera_systems.h"
 
+#include "gameplay/archetype_storage.h"
 #include "gameplay/component.h"
 #include "gameplay/components/camera_component.h"
 #include "gameplay/inputs.h"
@@ -15,74 +16,40 @@ EditorCameraInputSystem::EditorCameraInputSystem(const Inputs *_inputs) : inputs
 	ASSERT(inputs != nullptr);
 	this->update_stage = UpdateStage::Input;
 	this->priority     = 1.0f;
-}
-
-void EditorCameraInputSystem::register_component(refl::BasePtr<BaseComponent> component)
-{
-	if (auto *ci = component.as<CameraInputComponent>()) {
-		camera_input_component = ci;
-	} else if (auto *ec = component.as<EditorCameraComponent>()) {
-		editor_camera_component = ec;
-	}
-}
-
-void EditorCameraInputSystem::unregister_component(refl::BasePtr<BaseComponent> component)
-{
-	if (component.as<CameraInputComponent>() == camera_input_component) {
-		camera_input_component = nullptr;
-	} else if (component.as<EditorCameraComponent>() == editor_camera_component) {
-		editor_camera_component = nullptr;
-	}
+	this->access.write<CameraInputComponent>();
 }
 
 EditorCameraTransformSystem::EditorCameraTransformSystem()
 {
 	this->update_stage = UpdateStage::PrePhysics;
 	this->priority     = 1.0f;
+	this->access.read<CameraInputComponent>();
+	this->access.write<EditorCameraComponent>();
+	// The camera component and its node in the transform hierarchy
+	this->access.write<SpatialComponent>();
 }
 
-void EditorCameraTransformSystem::register_component(refl::BasePtr<BaseComponent> component)
-{
-	if (auto *ci = component.as<CameraInputComponent>()) {
-		camera_input_component = ci;
-	} else if (auto *ec = component.as<EditorCameraComponent>()) {
-		editor_camera_component = ec;
-	} else if (auto *c = component.as<CameraComponent>()) {
-		camera_component = c;
-	}
-}
-
-void EditorCameraTransformSystem::unregister_component(refl::BasePtr<BaseComponent> component)
-{
-	if (component.as<CameraInputComponent>() == camera_input_component) {
-		camera_input_component = nullptr;
-	} else if (component.as<EditorCameraComponent>() == editor_camera_component) {
-		editor_camera_component = nullptr;
-	} else if (component.as<CameraComponent>() == camera_component) {
-		camera_component = nullptr;
-	}
-}
-
-void EditorCameraInputSystem::update(const UpdateContext &)
+void EditorCameraInputSystem::update(const UpdateContext &ctx)
 {
-	ASSERT(camera_input_component && editor_camera_component);
-
-	camera_input_component->camera_active = inputs->is_pressed(Action::CameraModifier);
-	camera_input_component->camera_move   = inputs->is_pressed(Action::CameraMove);
-	camera_input_component->camera_orbit  = inputs->is_pressed(Action::CameraOrbit);
+	ctx.component_storage->for_each<CameraInputComponent>([&](CameraInputComponent &camera_input_component) {
+		camera_input_component.camera_active = inputs->is_pressed(Action::CameraModifier);
+		camera_input_component.camera_move   = inputs->is_pressed(Action::CameraMove);
+		camera_input_component.camera_orbit  = inputs->is_pressed(Action::CameraOrbit);
 
-	if (auto scroll = inputs->get_scroll_this_frame()) {
-		camera_input_component->scroll = scroll.value();
-	} else {
-		camera_input_component->scroll = {};
-	}
-	camera_input_component->mouse_delta = inputs->get_mouse_delta();
+		if (auto scroll = inputs->get_scroll_this_frame()) {
+			camera_input_component.scroll = scroll.value();
+		} else {
+			camera_input_component.scroll = {};
+		}
+		camera_input_component.mouse_delta = inputs->get_mouse_delta();
+	});
 }
 
-void EditorCameraTransformSystem::update(const UpdateContext &ctx)
+static void update_editor_camera(const UpdateContext &ctx,
+	const CameraInputComponent                        *camera_input_component,
+	EditorCameraComponent                             *editor_camera_component,
+	CameraComponent                                   *camera_component)
 {
-	ASSERT(editor_camera_component && camera_component);
-
 	constexpr float CAMERA_MOVE_SPEED   = 5.0f;
 	constexpr float CAMERA_ROTATE_SPEED = 80.0f;
 	constexpr float CAMERA_SCROLL_SPEED = 80.0f;
@@ -202,3 +169,11 @@ void EditorCameraTransformSystem::update(const UpdateContext &ctx)
 
 	camera_component->look_at(position, editor_camera_component->target, up);
 }
+
+void EditorCameraTransformSystem::update(const UpdateContext &ctx)
+{
+	ctx.component_storage->for_each<CameraInputComponent, EditorCameraComponent, CameraComponent>(
+		[&](CameraInputComponent &camera_input, EditorCameraComponent &editor_camera, CameraComponent &camera) {
+			update_editor_camera(ctx, &camera_input, &editor_camera, &camera);
+		});
+}
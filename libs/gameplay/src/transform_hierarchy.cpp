@@ -0,0 +1,346 @@
+#include "gameplay/transform_hierarchy.h"
+
+#include "gameplay/component.h"
+
+#include "cross/jobmanager.h"
+#include "cross/jobs/foreach.h"
+#include "cross/jobs/waitable.h"
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+
+#include <algorithm>
+
+// Levels with less nodes are propagated on the calling thread
+static constexpr u32 PARALLEL_GRAIN_SIZE = 512;
+
+struct PropagationContext
+{
+	const float4x4  *local_transforms;
+	float4x4        *world_transforms;
+	const exo::AABB *local_bounds;
+	exo::AABB       *world_bounds;
+	const u32       *parent_indices;
+	u8              *dirty;
+};
+
+static exo::AABB transform_bounds(const exo::AABB &bounds, const float4x4 &transform)
+{
+	// Empty bounds stay empty
+	if (bounds.min.x > bounds.max.x) {
+		return {};
+	}
+
+	const float3 translation = transform.col(3).xyz();
+	exo::AABB    result      = {.min = translation, .max = translation};
+	for (u32 i_col = 0; i_col < 3; ++i_col) {
+		for (u32 i_row = 0; i_row < 3; ++i_row) {
+			const float a = transform.at(i_row, i_col) * bounds.min[i_col];
+			const float b = transform.at(i_row, i_col) * bounds.max[i_col];
+			result.min[i_row] += std::min(a, b);
+			result.max[i_row] += std::max(a, b);
+		}
+	}
+	return result;
+}
+
+static void propagate_node(const PropagationContext &ctx, u32 i_node)
+{
+	const u32  i_parent     = ctx.parent_indices[i_node];
+	const bool parent_dirty = i_parent != u32_invalid && ctx.dirty[i_parent];
+	if (!ctx.dirty[i_node] && !parent_dirty) {
+		return;
+	}
+
+	// Parents are in the previous levels, the children of this node will see it dirty
+	ctx.dirty[i_node] = 1;
+	if (i_parent != u32_invalid) {
+		ctx.world_transforms[i_node] = ctx.world_transforms[i_parent] * ctx.local_transforms[i_node];
+	} else {
+		ctx.world_transforms[i_node] = ctx.local_transforms[i_node];
+	}
+	ctx.world_bounds[i_node] = transform_bounds(ctx.local_bounds[i_node], ctx.world_transforms[i_node]);
+}
+
+template <typename T>
+static void permute(Vec<T> &values, const Vec<u32> &new_indices)
+{
+	auto sorted = Vec<T>::with_length(values.len());
+	for (u32 i = 0; i < values.len(); ++i) {
+		sorted[new_indices[i]] = values[i];
+	}
+	values.buffer.destroy();
+	values = std::move(sorted);
+}
+
+template <typename T>
+static void destroy_values(Vec<T> &values)
+{
+	values.clear();
+	values.buffer.destroy();
+}
+
+void TransformHierarchy::destroy()
+{
+	destroy_values(local_transforms);
+	destroy_values(world_transforms);
+	destroy_values(local_bounds);
+	destroy_values(world_bounds);
+	destroy_values(parents);
+	destroy_values(parent_indices);
+	destroy_values(dirty);
+	destroy_values(handles);
+	destroy_values(level_offsets);
+	destroy_values(handle_to_index);
+	destroy_values(free_handles);
+	destroy_values(changed_handles);
+	destroy_values(is_changed);
+	needs_sort      = false;
+	has_dirty_nodes = false;
+}
+
+void TransformHierarchy::add(SpatialComponent &component)
+{
+	if (component.transform_hierarchy == this) {
+		return;
+	}
+	ASSERT(component.transform_hierarchy == nullptr);
+
+	u32 parent_handle = u32_invalid;
+	if (component.parent.get() != nullptr) {
+		this->add(*component.parent.get());
+		parent_handle = component.parent->transform_node;
+	}
+
+	u32 handle = u32_invalid;
+	if (!this->free_handles.is_empty()) {
+		handle = this->free_handles.pop();
+	} else {
+		handle = this->handle_to_index.len();
+		this->handle_to_index.push(u32_invalid);
+		this->is_changed.push(u8(0));
+	}
+
+	// New nodes are appended, the next update sorts them in their level
+	const u32 i_node = this->handles.len();
+	this->local_transforms.push(component.local_transform);
+	this->world_transforms.push(component.local_transform);
+	this->local_bounds.push(component.local_bounds);
+	this->world_bounds.push(component.local_bounds);
+	this->parents.push(parent_handle);
+	this->parent_indices.push(u32_invalid);
+	this->dirty.push(u8(1));
+	this->handles.push(handle);
+	this->handle_to_index[handle] = i_node;
+
+	component.transform_hierarchy = this;
+	component.transform_node      = handle;
+
+	this->needs_sort      = true;
+	this->has_dirty_nodes = true;
+}
+
+void TransformHierarchy::remove(SpatialComponent &component)
+{
+	ASSERT(component.transform_hierarchy == this);
+	const u32 handle = component.transform_node;
+
+	for (u32 i_node = 0; i_node < this->parents.len(); ++i_node) {
+		if (this->parents[i_node] == handle) {
+			this->parents[i_node] = u32_invalid;
+			this->dirty[i_node]   = 1;
+		}
+	}
+
+	const u32 i_node = this->handle_to_index[handle];
+	this->local_transforms.swap_remove(i_node);
+	this->world_transforms.swap_remove(i_node);
+	this->local_bounds.swap_remove(i_node);
+	this->world_bounds.swap_remove(i_node);
+	this->parents.swap_remove(i_node);
+	this->parent_indices.swap_remove(i_node);
+	this->dirty.swap_remove(i_node);
+	this->handles.swap_remove(i_node);
+	if (i_node < this->handles.len()) {
+		this->handle_to_index[this->handles[i_node]] = i_node;
+	}
+
+	this->handle_to_index[handle] = u32_invalid;
+	this->free_handles.push(handle);
+
+	component.transform_hierarchy = nullptr;
+	component.transform_node      = u32_invalid;
+
+	this->needs_sort      = true;
+	this->has_dirty_nodes = true;
+}
+
+void TransformHierarchy::set_parent(SpatialComponent &component)
+{
+	if (component.transform_hierarchy != this) {
+		return;
+	}
+
+	u32 parent_handle = u32_invalid;
+	if (component.parent.get() != nullptr) {
+		this->add(*component.parent.get());
+		parent_handle = component.parent->transform_node;
+	}
+
+	const u32 i_node      = this->handle_to_index[component.transform_node];
+	this->parents[i_node] = parent_handle;
+	this->dirty[i_node]   = 1;
+	this->needs_sort      = true;
+	this->has_dirty_nodes = true;
+}
+
+void TransformHierarchy::set_local_transform(u32 handle, const float4x4 &transform)
+{
+	const u32 i_node               = this->handle_to_index[handle];
+	this->local_transforms[i_node] = transform;
+	this->dirty[i_node]            = 1;
+	this->has_dirty_nodes.store(true, std::memory_order_relaxed);
+}
+
+void TransformHierarchy::set_local_bounds(u32 handle, const exo::AABB &bounds)
+{
+	const u32 i_node           = this->handle_to_index[handle];
+	this->local_bounds[i_node] = bounds;
+	this->dirty[i_node]        = 1;
+	this->has_dirty_nodes.store(true, std::memory_order_relaxed);
+}
+
+void TransformHierarchy::sort()
+{
+	EXO_PROFILE_SCOPE
+
+	const u32 nodes_len = this->handles.len();
+
+	// Compute the depth of every node, parents can be stored after their children until the hierarchy is sorted
+	auto     depths    = Vec<u32>::with_values(nodes_len, u32_invalid);
+	Vec<u32> ancestors = {};
+	u32      max_depth = 0;
+	for (u32 i_node = 0; i_node < nodes_len; ++i_node) {
+		u32 i_ancestor = i_node;
+		while (depths[i_ancestor] == u32_invalid && this->parents[i_ancestor] != u32_invalid) {
+			ancestors.push(i_ancestor);
+			i_ancestor = this->handle_to_index[this->parents[i_ancestor]];
+		}
+		if (depths[i_ancestor] == u32_invalid) {
+			depths[i_ancestor] = 0;
+		}
+
+		u32 depth = depths[i_ancestor];
+		while (!ancestors.is_empty()) {
+			depth += 1;
+			depths[ancestors.pop()] = depth;
+		}
+		max_depth = std::max(max_depth, depth);
+	}
+
+	// Counting sort by depth, the order of the nodes inside a level is kept
+	this->level_offsets.clear();
+	this->level_offsets.resize(nodes_len > 0 ? max_depth + 2 : 1, 0);
+	for (u32 i_node = 0; i_node < nodes_len; ++i_node) {
+		this->level_offsets[depths[i_node] + 1] += 1;
+	}
+	for (u32 i_level = 1; i_level < this->level_offsets.len(); ++i_level) {
+		this->level_offsets[i_level] += this->level_offsets[i_level - 1];
+	}
+
+	auto level_cursors = Vec<u32>::with_length(this->level_offsets.len());
+	for (u32 i_level = 0; i_level < this->level_offsets.len(); ++i_level) {
+		level_cursors[i_level] = this->level_offsets[i_level];
+	}
+	auto new_indices = Vec<u32>::with_length(nodes_len);
+	for (u32 i_node = 0; i_node < nodes_len; ++i_node) {
+		new_indices[i_node] = level_cursors[depths[i_node]];
+		level_cursors[depths[i_node]] += 1;
+	}
+
+	permute(this->local_transforms, new_indices);
+	permute(this->world_transforms, new_indices);
+	permute(this->local_bounds, new_indices);
+	permute(this->world_bounds, new_indices);
+	permute(this->parents, new_indices);
+	permute(this->dirty, new_indices);
+	permute(this->handles, new_indices);
+
+	for (u32 i_node = 0; i_node < nodes_len; ++i_node) {
+		this->handle_to_index[this->handles[i_node]] = i_node;
+	}
+	for (u32 i_node = 0; i_node < nodes_len; ++i_node) {
+		const u32 parent_handle      = this->parents[i_node];
+		this->parent_indices[i_node] = parent_handle != u32_invalid ? this->handle_to_index[parent_handle] : u32_invalid;
+	}
+
+	depths.buffer.destroy();
+	ancestors.buffer.destroy();
+	level_cursors.buffer.destroy();
+	new_indices.buffer.destroy();
+}
+
+void TransformHierarchy::update(const cross::JobManager *jobmanager)
+{
+	EXO_PROFILE_SCOPE
+
+	if (this->needs_sort) {
+		this->sort();
+		this->needs_sort = false;
+	}
+
+	if (!this->has_dirty_nodes) {
+		return;
+	}
+
+	const PropagationContext ctx = {
+		.local_transforms = this->local_transforms.data(),
+		.world_transforms = this->world_transforms.data(),
+		.local_bounds     = this->local_bounds.data(),
+		.world_bounds     = this->world_bounds.data(),
+		.parent_indices   = this->parent_indices.data(),
+		.dirty            = this->dirty.data(),
+	};
+
+	for (u32 i_level = 0; i_level + 1 < this->level_offsets.len(); ++i_level) {
+		const u32 level_begin = this->level_offsets[i_level];
+		const u32 level_end   = this->level_offsets[i_level + 1];
+
+		if (jobmanager == nullptr || level_end - level_begin <= PARALLEL_GRAIN_SIZE) {
+			for (u32 i_node = level_begin; i_node < level_end; ++i_node) {
+				propagate_node(ctx, i_node);
+			}
+			continue;
+		}
+
+		// The nodes of a level only write to themselves and read their parents from the previous levels
+		auto level_world_transforms =
+			exo::Span<float4x4>(this->world_transforms.data() + level_begin, level_end - level_begin);
+		auto waitable = cross::parallel_foreach_userdata<float4x4, const PropagationContext, true>(
+			*jobmanager,
+			level_world_transforms,
+			&ctx,
+			[](float4x4 &world_transform, const PropagationContext *propagation_ctx) {
+				propagate_node(*propagation_ctx, u32(&world_transform - propagation_ctx->world_transforms));
+			},
+			int(PARALLEL_GRAIN_SIZE));
+		waitable->wait();
+	}
+
+	for (u32 i_node = 0; i_node < this->dirty.len(); ++i_node) {
+		const u32 handle = this->handles[i_node];
+		if (this->dirty[i_node] && !this->is_changed[handle]) {
+			this->is_changed[handle] = 1;
+			this->changed_handles.push(handle);
+		}
+		this->dirty[i_node] = 0;
+	}
+	this->has_dirty_nodes = false;
+}
+
+void TransformHierarchy::clear_changes()
+{
+	for (const u32 handle : this->changed_handles) {
+		this->is_changed[handle] = 0;
+	}
+	this->changed_handles.clear();
+}
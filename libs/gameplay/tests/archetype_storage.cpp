@@ -0,0 +1,133 @@
+#include "gameplay/archetype_storage.h"
+#include <catch2/catch_test_macros.hpp>
+
+static u32 destroyed_healths = 0;
+
+struct Position
+{
+	using Self = Position;
+	REFL_REGISTER_TYPE("Position")
+
+	float x = 1.0f;
+	float y = 2.0f;
+};
+
+struct Health
+{
+	using Self = Health;
+	REFL_REGISTER_TYPE("Health")
+
+	u32 value = 100;
+	~Health() { destroyed_healths += 1; }
+};
+
+struct BigComponent
+{
+	using Self = BigComponent;
+	REFL_REGISTER_TYPE("BigComponent")
+
+	u8 data[20 << 10] = {};
+};
+
+TEST_CASE("ArchetypeStorage groups entities by signature", "[archetype_storage]")
+{
+	ArchetypeStorage storage = {};
+
+	auto a = storage.create<Position, Health>();
+	auto b = storage.create<Health, Position>();
+	auto c = storage.create<Position>();
+	REQUIRE(storage.archetypes.len() == 2);
+
+	REQUIRE(storage.get<Position>(a)->x == 1.0f);
+	REQUIRE(storage.get<Health>(b)->value == 100);
+	REQUIRE(storage.get<Health>(c) == nullptr);
+
+	// The components of a and b are in the same chunk
+	REQUIRE(storage.archetypes[0].len == 2);
+	REQUIRE(storage.archetypes[0].chunks.len() == 1);
+	REQUIRE(storage.get<Health>(b) - storage.get<Health>(a) == 1);
+	REQUIRE(storage.archetypes[1].len == 1);
+
+	storage.get<Health>(a)->value = 10;
+	u32 positions  = 0;
+	u32 health_sum = 0;
+	storage.for_each<Position>([&](Position &) { positions += 1; });
+	storage.for_each<Health, Position>([&](Health &health, Position &) { health_sum += health.value; });
+	REQUIRE(positions == 3);
+	REQUIRE(health_sum == 110);
+
+	storage.destroy();
+}
+
+TEST_CASE("ArchetypeStorage reuses holes and keeps components in place", "[archetype_storage]")
+{
+	ArchetypeStorage storage = {};
+	destroyed_healths = 0;
+
+	Vec<Handle<ArchetypeRow>> handles = {};
+	for (u32 i = 0; i < 200; ++i) {
+		auto handle = storage.create<Position, Health>();
+		storage.get<Health>(handle)->value = i;
+		handles.push(handle);
+	}
+	const auto &archetype = storage.archetypes[0];
+	REQUIRE(archetype.chunk_size <= ArchetypeStorage::CHUNK_SIZE);
+	const u32 chunks_len = archetype.chunks.len();
+
+	Health *last = storage.get<Health>(handles[199]);
+	storage.remove(handles[3]);
+	storage.remove(handles[100]);
+	REQUIRE(destroyed_healths == 2);
+	REQUIRE(storage.get<Health>(handles[199]) == last);
+	REQUIRE(last->value == 199);
+
+	REQUIRE(storage.archetypes[0].len == 198);
+	REQUIRE(storage.get<Health>(handles[4])->value == 4);
+	REQUIRE(storage.get<Health>(handles[101])->value == 101);
+
+	// Queries skip the holes
+	u32 visited = 0;
+	storage.for_each<Health>([&](Health &health) {
+		REQUIRE(health.value != 3);
+		REQUIRE(health.value != 100);
+		visited += 1;
+	});
+	REQUIRE(visited == 198);
+
+	// A chunk query sees the columns of every chunk
+	u32 chunks = 0;
+	u32 rows   = 0;
+	storage.for_each_chunk<Position, Health>([&](u64 occupancy, Position *positions, Health *healths) {
+		REQUIRE(positions != nullptr);
+		const u32 i_row = u32(std::countr_zero(occupancy));
+		REQUIRE(storage.get<Health>(handles[chunks * archetype.rows_per_chunk + i_row]) == &healths[i_row]);
+		chunks += 1;
+		rows += u32(std::popcount(occupancy));
+	});
+	REQUIRE(chunks == chunks_len);
+	REQUIRE(rows == 198);
+
+	// New rows fill the holes before allocating a chunk
+	storage.create<Position, Health>();
+	storage.create<Position, Health>();
+	REQUIRE(storage.archetypes[0].chunks.len() == chunks_len);
+	REQUIRE(storage.archetypes[0].len == 200);
+
+	storage.destroy();
+	REQUIRE(destroyed_healths == 202);
+	handles.buffer.destroy();
+}
+
+TEST_CASE("ArchetypeStorage stores components bigger than a chunk", "[archetype_storage]")
+{
+	ArchetypeStorage storage = {};
+
+	auto a = storage.create<BigComponent, Position>();
+	auto b = storage.create<BigComponent, Position>();
+	REQUIRE(storage.archetypes[0].rows_per_chunk == 1);
+	REQUIRE(storage.archetypes[0].chunks.len() == 2);
+	REQUIRE(storage.get<Position>(a)->y == 2.0f);
+	REQUIRE(storage.get<Position>(b)->y == 2.0f);
+
+	storage.destroy();
+}
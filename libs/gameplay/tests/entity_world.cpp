@@ -0,0 +1,284 @@
+#include "cross/jobmanager.h"
+#include "gameplay/component.h"
+#include "gameplay/entity_world.h"
+#include "gameplay/system.h"
+#include "gameplay/update_context.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+
+struct ParentComponent : BaseComponent
+{
+	using Self  = ParentComponent;
+	using Super = BaseComponent;
+	REFL_REGISTER_TYPE_WITH_SUPER("ParentComponent")
+};
+
+struct ChildComponent : ParentComponent
+{
+	using Self  = ChildComponent;
+	using Super = ParentComponent;
+	REFL_REGISTER_TYPE_WITH_SUPER("ChildComponent")
+};
+
+struct OtherComponent : BaseComponent
+{
+	using Self  = OtherComponent;
+	using Super = BaseComponent;
+	REFL_REGISTER_TYPE_WITH_SUPER("OtherComponent")
+};
+
+static u32 destroyed_components = 0;
+
+struct TrackedComponent : BaseComponent
+{
+	using Self  = TrackedComponent;
+	using Super = BaseComponent;
+	REFL_REGISTER_TYPE_WITH_SUPER("TrackedComponent")
+
+	~TrackedComponent() override { destroyed_components += 1; }
+};
+
+// Takes a ticket when it is updated to check the order of the batches
+struct TicketSystem : GlobalSystem
+{
+	using Self  = TicketSystem;
+	using Super = GlobalSystem;
+	REFL_REGISTER_TYPE_WITH_SUPER("TicketSystem")
+
+	std::atomic<u32> *next_ticket = nullptr;
+	u32               ticket      = u32_invalid;
+
+	// --
+	TicketSystem(std::atomic<u32> *_next_ticket, float _priority, SystemAccess &&_access)
+		: next_ticket{_next_ticket}
+	{
+		this->update_stage = UpdateStage::PrePhysics;
+		this->priority     = _priority;
+		this->access       = std::move(_access);
+	}
+
+	void initialize(const SystemRegistry &) final {}
+	void shutdown() final {}
+	void update(const UpdateContext &) final { this->ticket = this->next_ticket->fetch_add(1); }
+	void register_component(const Entity *, refl::BasePtr<BaseComponent>) final {}
+	void unregister_component(const Entity *, refl::BasePtr<BaseComponent>) final {}
+};
+
+struct CountingSystem : LocalSystem
+{
+	using Self  = CountingSystem;
+	using Super = LocalSystem;
+	REFL_REGISTER_TYPE_WITH_SUPER("CountingSystem")
+
+	std::atomic<u32> *total   = nullptr;
+	u32               updates = 0;
+
+	// --
+	CountingSystem(std::atomic<u32> *_total) : total{_total}
+	{
+		this->update_stage = UpdateStage::Physics;
+		this->priority     = 1.0f;
+	}
+
+	void update(const UpdateContext &) final
+	{
+		this->updates += 1;
+		this->total->fetch_add(1);
+	}
+	void register_component(refl::BasePtr<BaseComponent>) final {}
+	void unregister_component(refl::BasePtr<BaseComponent>) final {}
+};
+
+template <typename... Components>
+static SystemAccess reading()
+{
+	SystemAccess access = {};
+	(access.read<Components>(), ...);
+	return access;
+}
+
+template <typename... Components>
+static SystemAccess writing()
+{
+	SystemAccess access = {};
+	(access.write<Components>(), ...);
+	return access;
+}
+
+TEST_CASE("SystemAccess conflicts", "[scheduler]")
+{
+	// Done by main in the apps
+	refl::details::call_all_registers();
+
+	// A system that doesn't declare its accesses conflicts with every system
+	const SystemAccess undeclared = {};
+	REQUIRE(undeclared.conflicts_with(undeclared));
+	REQUIRE(undeclared.conflicts_with(reading<OtherComponent>()));
+	REQUIRE(reading<OtherComponent>().conflicts_with(undeclared));
+
+	REQUIRE(!reading<ParentComponent>().conflicts_with(reading<ParentComponent>()));
+	REQUIRE(reading<ParentComponent>().conflicts_with(writing<ParentComponent>()));
+	REQUIRE(writing<ParentComponent>().conflicts_with(reading<ParentComponent>()));
+	REQUIRE(writing<ParentComponent>().conflicts_with(writing<ParentComponent>()));
+	REQUIRE(!writing<ParentComponent>().conflicts_with(writing<OtherComponent>()));
+
+	// Accessing a type accesses the types deriving from it
+	REQUIRE(writing<ParentComponent>().conflicts_with(reading<ChildComponent>()));
+	REQUIRE(reading<ChildComponent>().conflicts_with(writing<ParentComponent>()));
+	REQUIRE(writing<BaseComponent>().conflicts_with(reading<OtherComponent>()));
+	REQUIRE(!reading<ChildComponent>().conflicts_with(writing<OtherComponent>()));
+	REQUIRE(!reading<BaseComponent>().conflicts_with(reading<ChildComponent>()));
+}
+
+TEST_CASE("Global systems are updated in batches in priority order", "[scheduler]")
+{
+	refl::details::call_all_registers();
+	auto        jobmanager = cross::JobManager::create();
+	EntityWorld world      = {};
+	world.jobmanager       = &jobmanager;
+
+	std::atomic<u32> next_ticket = 0;
+	// Created out of order, the stage is sorted by decreasing priority
+	world.create_system<TicketSystem>(&next_ticket, 2.0f, reading<OtherComponent>());
+	world.create_system<TicketSystem>(&next_ticket, 4.0f, reading<ParentComponent>());
+	world.create_system<TicketSystem>(&next_ticket, 3.0f, reading<ParentComponent, OtherComponent>());
+	world.create_system<TicketSystem>(&next_ticket, 1.0f, writing<ChildComponent>());
+	world.create_system<TicketSystem>(&next_ticket, 0.5f, SystemAccess{});
+	world.create_system<TicketSystem>(&next_ticket, 0.0f, reading<OtherComponent>());
+
+	world.update(0.016, nullptr);
+
+	auto &update_list = world.global_per_stage_update_list[UpdateStage::PrePhysics];
+	REQUIRE(update_list.len() == 6);
+	for (u32 i_system = 1; i_system < update_list.len(); ++i_system) {
+		REQUIRE(update_list[i_system - 1]->priority > update_list[i_system]->priority);
+	}
+
+	// The readers share a batch, the writer of a derived type and the undeclared system start new ones
+	const auto &batch_offsets      = world.global_per_stage_batch_offsets[UpdateStage::PrePhysics];
+	const u32   expected_offsets[] = {0, 3, 4, 5, 6};
+	REQUIRE(batch_offsets.len() == 5);
+	for (u32 i_offset = 0; i_offset < batch_offsets.len(); ++i_offset) {
+		REQUIRE(batch_offsets[i_offset] == expected_offsets[i_offset]);
+	}
+	REQUIRE(world.stage_stats[UpdateStage::PrePhysics].global_batches == 4);
+
+	// A batch is updated after all the systems of the previous batch
+	for (u32 i_batch = 0; i_batch + 2 < batch_offsets.len(); ++i_batch) {
+		for (u32 i_system = batch_offsets[i_batch]; i_system < batch_offsets[i_batch + 1]; ++i_system) {
+			for (u32 i_next = batch_offsets[i_batch + 1]; i_next < update_list.len(); ++i_next) {
+				const u32 ticket       = update_list[i_system].as<TicketSystem>()->ticket;
+				const u32 later_ticket = update_list[i_next].as<TicketSystem>()->ticket;
+				REQUIRE(ticket < later_ticket);
+			}
+		}
+	}
+	REQUIRE(next_ticket == 6);
+
+	// The other stages have no global system
+	REQUIRE(world.global_per_stage_batch_offsets[UpdateStage::FrameStart].len() == 2);
+	REQUIRE(world.stage_stats[UpdateStage::FrameStart].global_batches == 0);
+
+	for (auto system : world.system_registry.global_systems) {
+		delete system.get();
+	}
+	jobmanager.destroy();
+}
+
+TEST_CASE("Entities are updated in parallel", "[scheduler]")
+{
+	refl::details::call_all_registers();
+	auto        jobmanager = cross::JobManager::create();
+	EntityWorld world      = {};
+	world.jobmanager       = &jobmanager;
+
+	// More entities than a job updates
+	constexpr u32         ENTITY_COUNT = 1000;
+	std::atomic<u32>      total        = 0;
+	Vec<Entity *>         entities     = {};
+	Vec<CountingSystem *> systems      = {};
+	for (u32 i_entity = 0; i_entity < ENTITY_COUNT; ++i_entity) {
+		auto *entity = world.create_entity();
+		entity->create_system<CountingSystem>(&total);
+		entities.push(entity);
+		systems.push(entity->local_systems.last().as<CountingSystem>());
+	}
+
+	world.update(0.016, nullptr);
+	world.update(0.016, nullptr);
+
+	REQUIRE(total == 2 * ENTITY_COUNT);
+	for (auto *system : systems) {
+		REQUIRE(system->updates == 2);
+	}
+	REQUIRE(world.stage_stats[UpdateStage::Physics].updated_entities == ENTITY_COUNT);
+	REQUIRE(world.stage_stats[UpdateStage::FrameStart].updated_entities == 0);
+
+	for (auto *entity : entities) {
+		delete entity->local_systems[0].get();
+	}
+	world.destroy();
+	systems.buffer.destroy();
+	entities.buffer.destroy();
+	jobmanager.destroy();
+}
+
+TEST_CASE("EntityWorld destroys the components of its archetypes", "[entity_world]")
+{
+	refl::details::call_all_registers();
+	EntityWorld world    = {};
+	destroyed_components = 0;
+
+	for (u32 i_entity = 0; i_entity < 3; ++i_entity) {
+		world.create_entity_with_components<TrackedComponent, OtherComponent>();
+	}
+	world.destroy_entity(world.create_entity_with_components<TrackedComponent>());
+	REQUIRE(destroyed_components == 1);
+
+	world.destroy();
+	REQUIRE(destroyed_components == 4);
+	REQUIRE(world.entities.size == 0);
+	REQUIRE(world.component_storage.archetypes.len() == 0);
+}
+
+// Counts the components registered by the entities
+struct RegistrySystem : GlobalSystem
+{
+	using Self  = RegistrySystem;
+	using Super = GlobalSystem;
+	REFL_REGISTER_TYPE_WITH_SUPER("RegistrySystem")
+
+	u32 registered_components = 0;
+
+	// --
+	void initialize(const SystemRegistry &) final {}
+	void shutdown() final {}
+	void update(const UpdateContext &) final {}
+	void register_component(const Entity *, refl::BasePtr<BaseComponent>) final { this->registered_components += 1; }
+	void unregister_component(const Entity *, refl::BasePtr<BaseComponent>) final { this->registered_components -= 1; }
+};
+
+TEST_CASE("EntityWorld shuts down the entities it destroys", "[entity_world]")
+{
+	refl::details::call_all_registers();
+	EntityWorld world = {};
+	world.create_system<RegistrySystem>();
+	auto *system = world.system_registry.get_system<RegistrySystem>();
+
+	auto *entity = world.create_entity_with_components<SpatialComponent, TrackedComponent>();
+	world.create_entity_with_components<SpatialComponent>();
+	world.update(0.016, nullptr);
+	REQUIRE(entity->is_active());
+	REQUIRE(system->registered_components == 3);
+	REQUIRE(world.transform_hierarchy.handles.len() == 2);
+
+	world.destroy_entity(entity);
+	REQUIRE(system->registered_components == 1);
+	REQUIRE(world.transform_hierarchy.handles.len() == 1);
+	REQUIRE(world.system_registry.entities_to_update.size == 1);
+
+	world.destroy();
+	REQUIRE(system->registered_components == 0);
+	delete system;
+}
@@ -0,0 +1,157 @@
+#include "cross/jobmanager.h"
+#include "exo/tests/random.h"
+#include "gameplay/component.h"
+#include "gameplay/entity_world.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+
+static float4x4 random_transform(exo::tests::Random &random)
+{
+	// Scales around 1 keep the products of deep chains in range
+	const float  scale       = 0.8f + 0.4f * random.next();
+	const float3 translation = random.next3() * 10.0f - float3(5.0f);
+	const float  angle       = random.next() * 6.28f;
+	const float  c           = std::cos(angle) * scale;
+	const float  s           = std::sin(angle) * scale;
+	// Rotation around the Y axis, in row-major order
+	return float4x4({
+		c,    0.0f,  s,    translation.x,
+		0.0f, scale, 0.0f, translation.y,
+		-s,   0.0f,  c,    translation.z,
+		0.0f, 0.0f,  0.0f, 1.0f,
+	});
+}
+
+// Reference implementation: the product of the local transforms along the chain of parents
+static float4x4 naive_world_transform(EntityWorld &world, Entity *entity)
+{
+	float4x4 transform = entity->root_component->get_local_transform();
+	while (entity->is_attached_to_parent) {
+		entity    = *world.entities.at(entity->parent);
+		transform = entity->root_component->get_local_transform() * transform;
+	}
+	return transform;
+}
+
+static bool approx_equal(const float4x4 &a, const float4x4 &b)
+{
+	for (u32 i = 0; i < 16; ++i) {
+		if (std::abs(a.values[i] - b.values[i]) > 1e-3f * (1.0f + std::abs(b.values[i]))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void reparent(EntityWorld &world, Entity *entity, Entity *new_parent)
+{
+	if (entity->parent.is_valid()) {
+		Entity *parent = *world.entities.at(entity->parent);
+		world._dettach_to_parent(entity);
+		for (u32 i_sibling = 0; i_sibling < parent->attached_entities.len(); ++i_sibling) {
+			if (parent->attached_entities[i_sibling] == entity->uuid) {
+				parent->attached_entities.swap_remove(i_sibling);
+				break;
+			}
+		}
+		entity->parent = {};
+		world.root_entities.insert(entity);
+	}
+	if (new_parent != nullptr) {
+		world.set_parent_entity(entity, new_parent);
+	}
+}
+
+static void check_world_transforms(EntityWorld &world, const Vec<Entity *> &entities)
+{
+	for (auto *entity : entities) {
+		if (entity == nullptr) {
+			continue;
+		}
+		REQUIRE(entity->root_component->get_transform_hierarchy() == &world.transform_hierarchy);
+		REQUIRE(approx_equal(entity->root_component->get_world_transform(), naive_world_transform(world, entity)));
+	}
+}
+
+static void test_random_hierarchy(const cross::JobManager *jobmanager)
+{
+	refl::details::call_all_registers();
+	EntityWorld world = {};
+	world.jobmanager  = jobmanager;
+
+	// Enough entities to split the biggest levels in jobs
+	constexpr u32      ENTITY_COUNT = 4096;
+	exo::tests::Random random       = {};
+	Vec<Entity *>      entities     = {};
+	for (u32 i_entity = 0; i_entity < ENTITY_COUNT; ++i_entity) {
+		auto *entity = world.create_entity();
+		entity->create_component<SpatialComponent>();
+		entity->root_component->set_local_transform(random_transform(random));
+		entities.push(entity);
+	}
+
+	// Parents are created before their children, the hierarchy can't have cycles
+	for (u32 i_entity = 1; i_entity < ENTITY_COUNT; ++i_entity) {
+		reparent(world, entities[i_entity], entities[random.next_u32() % i_entity]);
+	}
+	world.update(0.016, nullptr);
+	check_world_transforms(world, entities);
+
+	for (u32 i_round = 0; i_round < 4; ++i_round) {
+		for (u32 i_change = 0; i_change < ENTITY_COUNT / 8; ++i_change) {
+			const u32 i_entity = 1 + random.next_u32() % (ENTITY_COUNT - 1);
+			const u32 i_parent = random.next_u32() % i_entity;
+			auto     *entity   = entities[i_entity];
+			if (entity == nullptr) {
+				continue;
+			}
+
+			switch (random.next_u32() % 4) {
+			case 0:
+				reparent(world, entity, entities[i_parent]);
+				break;
+			case 1:
+				reparent(world, entity, nullptr);
+				break;
+			case 2:
+				entity->root_component->set_local_transform(random_transform(random));
+				break;
+			case 3: {
+				auto *component = entity->root_component.get();
+				world.destroy_entity(entity);
+				delete component;
+				entities[i_entity] = nullptr;
+				break;
+			}
+			}
+		}
+
+		world.update(0.016, nullptr);
+		check_world_transforms(world, entities);
+	}
+
+	for (auto *entity : entities) {
+		if (entity != nullptr) {
+			auto *component = entity->root_component.get();
+			world.destroy_entity(entity);
+			delete component;
+		}
+	}
+	REQUIRE(world.transform_hierarchy.handles.is_empty());
+	world.destroy();
+	REQUIRE(world.transform_hierarchy.handle_to_index.is_empty());
+	entities.buffer.destroy();
+}
+
+TEST_CASE("TransformHierarchy matches the products of the parent chains", "[transform_hierarchy]")
+{
+	test_random_hierarchy(nullptr);
+}
+
+TEST_CASE("TransformHierarchy matches the products of the parent chains with jobs", "[transform_hierarchy]")
+{
+	auto jobmanager = cross::JobManager::create();
+	test_random_hierarchy(&jobmanager);
+	jobmanager.destroy();
+}
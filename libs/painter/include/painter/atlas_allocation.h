@@ -0,0 +1,19 @@
+#pragma once
+#include "exo/collections/handle.h"
+#include "exo/maths/vectors.h"
+
+// A rect allocated in an atlas, shared by the atlas allocators
+using AllocationId = Handle<struct Allocation>;
+struct Allocation
+{
+	int2 pos      = int2(0);
+	int2 size     = int2(0);
+	i32  refcount = 0;
+};
+
+// An allocation that has been moved by a defragmentation, its content has to be copied from `old_pos` to its new pos
+struct AllocationMove
+{
+	AllocationId id      = {};
+	int2         old_pos = int2(0);
+};
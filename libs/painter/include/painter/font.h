@@ -13,10 +13,11 @@ struct FontMetrics
 
 struct Font
 {
-	hb_font_t  *hb_font = nullptr;
-	FontMetrics metrics = {};
+	hb_font_t  *hb_font    = nullptr;
+	i32         size_in_pt = 0;
+	FontMetrics metrics    = {};
 
 	static Font from_file(const char *path, i32 size_in_pt, i32 face_index = 0);
 };
 
-void freetype_rasterizer(Font &font, u32 glyph_id, GlyphImage &out_image, GlyphMetrics &out_metrics);
+void freetype_rasterizer(Font &font, u32 glyph_id, u32 subpixel_x, GlyphImage &out_image, GlyphMetrics &out_metrics);
@@ -1,16 +1,27 @@
 #pragma once
+#include "exo/collections/map.h"
 #include "exo/collections/pool.h"
+#include "exo/collections/span.h"
 #include "exo/collections/vector.h"
 #include "exo/maths/numerics.h"
 #include "exo/maths/vectors.h"
 #include "exo/option.h"
 
-#include "shelf_allocator.h"
+#include "painter/lru.h"
+#include "painter/guillotine_allocator.h"
 
+namespace cross
+{
+struct JobManager;
+}
 struct Font;
+struct hb_font_t;
 using GlyphId = u32;
 struct GlyphEntry;
 
+// Glyphs can be rasterized at fractions of a pixel horizontally
+inline constexpr u32 GLYPH_SUBPIXEL_STEPS = 4;
+
 // A rasterized glyph
 struct GlyphImage
 {
@@ -32,17 +43,31 @@ struct GlyphEvent
 		Invalid,
 		New,
 		Evicted,
+		Moved, // the glyph has been moved by a defragmentation, it has to be uploaded again or copied from old_pos
 	};
 
 	Type               type         = Type::Invalid;
 	Handle<GlyphEntry> glyph_handle = {};
+	int2               old_pos      = int2(0);
+};
+
+// Identifies a rasterized glyph, every face and size has its own glyphs in the shared atlas
+struct GlyphKey
+{
+	const hb_font_t *face       = nullptr;
+	i32              size       = 0; // in points
+	GlyphId          glyph_id   = 0;
+	u32              subpixel_x = 0; // in 1 / GLYPH_SUBPIXEL_STEPS of pixel
+
+	bool operator==(const GlyphKey &other) const = default;
 };
+u64 hash_value(const GlyphKey &key);
 
 // A glyph that is in the cache
 struct GlyphEntry
 {
 	AllocationId allocator_id;
-	GlyphId      glyph_id;
+	GlyphKey     key;
 	GlyphImage   image;
 	GlyphMetrics metrics;
 
@@ -50,29 +75,43 @@ struct GlyphEntry
 	Handle<GlyphEntry> lru_next;
 };
 
-// This struct is used instead of Handle<GlyphEntry> to make it easier to find a given glyph_id
-struct GlyphKey
+struct GlyphRequest
 {
-	Handle<GlyphEntry> handle;
-	GlyphId            glyph_id;
+	Font   *font       = nullptr;
+	GlyphId glyph_id   = 0;
+	u32     subpixel_x = 0;
 };
 
-// The rasterizer can be changed anytime
-using RasterizerFn = void (*)(Font &font, u32 glyph_id, GlyphImage &out_image, GlyphMetrics &out_metrics);
+// The rasterizer can be changed anytime, it is called from several threads but never on the same font at once
+using RasterizerFn =
+	void (*)(Font &font, u32 glyph_id, u32 subpixel_x, GlyphImage &out_image, GlyphMetrics &out_metrics);
 
 struct GlyphCache
 {
-	ShelfAllocator        allocator  = {};
+	GuillotineAllocator   allocator  = {};
 	Vec<GlyphEvent>       events     = {};
 	exo::Pool<GlyphEntry> lru_cache  = {};
-	Handle<GlyphEntry>    lru_head   = {};
+	LruList<GlyphEntry>   lru        = {};
 	RasterizerFn          rasterizer = nullptr;
+	// Optional, rasterize the glyphs of different faces in parallel
+	const cross::JobManager *jobmanager = nullptr;
+
+	exo::Map<GlyphKey, Handle<GlyphEntry>> glyph_indices = {};
 
-	// TODO: Per-face
-	Vec<GlyphKey> face_caches[1] = {};
+	// Free the images of all the glyphs
+	void destroy();
 
 	// Returns the pixel offset from the top left corner and atlas coords for a specified face and glyph
-	Option<int2> queue_glyph(Font &font, GlyphId glyph_id, GlyphImage *image);
+	Option<int2> queue_glyph(Font &font, GlyphId glyph_id, GlyphImage *image, u32 subpixel_x = 0);
+
+	// Rasterize the requested glyphs that are not in the cache yet, in one batch
+	void rasterize_glyphs(exo::Span<const GlyphRequest> requests);
+
+	// Remove all the glyphs of a font, before destroying it
+	void evict_font(const Font &font);
+
+	// Move at most `max_moves` glyphs to merge the free space of the atlas, before the glyphs are queued for the frame
+	void defragment(u32 max_moves);
 
 	template <typename Lambda> void process_events(Lambda fn)
 	{
@@ -82,7 +121,7 @@ struct GlyphCache
 		for (const auto &event : this->events) {
 			const GlyphImage *image    = nullptr;
 			int2              position = int2(0);
-			if (event.type == GlyphEvent::Type::New) {
+			if (event.type == GlyphEvent::Type::New || event.type == GlyphEvent::Type::Moved) {
 				const auto &entry = this->lru_cache.get(event.glyph_handle);
 				if (entry.allocator_id.is_valid()) {
 					image    = &entry.image;
@@ -100,4 +139,6 @@ struct GlyphCache
 
 private:
 	AllocationId alloc_glyph(int2 alloc_size);
+	// Returns true if its space in the atlas has been freed
+	bool evict_glyph(Handle<GlyphEntry> glyph_handle);
 };
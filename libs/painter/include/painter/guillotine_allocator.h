@@ -0,0 +1,61 @@
+#pragma once
+#include "exo/collections/map.h"
+#include "exo/collections/pool.h"
+#include "exo/collections/vector.h"
+#include "exo/maths/vectors.h"
+
+#include "painter/atlas_allocation.h"
+
+/**
+   Guillotine packer: an allocation takes the free rect that fits it with the least waste, the remaining space is cut
+   in two along the shorter leftover axis.
+   The cuts are kept in a tree, when both children of a cut are free they are merged back into their parent. The free
+   space never fragments more than the live allocations require, and an empty atlas is a single free rect.
+   `defragment` incrementally moves the lowest allocations toward the top-left so that the free space merges at the
+   bottom.
+ **/
+struct GuillotineNode
+{
+	enum struct State : u8
+	{
+		Free,
+		Used,
+		Split,
+	};
+
+	int2                   pos          = int2(0);
+	int2                   size         = int2(0);
+	Handle<GuillotineNode> parent       = {};
+	Handle<GuillotineNode> first_child  = {};
+	Handle<GuillotineNode> second_child = {};
+	State                  state        = State::Free;
+	u32                    i_free_node  = u32_invalid; // index in free_nodes
+};
+
+struct GuillotineAllocator
+{
+	int2 size = int2(0, 0);
+
+	exo::Pool<Allocation>                          allocations;
+	exo::Pool<GuillotineNode>                      nodes;
+	Vec<Handle<GuillotineNode>>                    free_nodes;
+	exo::Map<AllocationId, Handle<GuillotineNode>> allocation_nodes;
+	Handle<GuillotineNode>                         root = {};
+
+	AllocationId      alloc(int2 alloc_size);
+	const Allocation &get(AllocationId id) const;
+
+	void ref(AllocationId id);
+	// Returns true if the alloc has been freed
+	bool unref(AllocationId id);
+
+	// Moves at most `max_moves` allocations, their ids stay valid, returns the number of moves pushed in `out_moves`
+	u32 defragment(u32 max_moves, Vec<AllocationMove> &out_moves);
+
+	i32 free_area() const;
+	i32 largest_free_area() const;
+
+private:
+	Handle<GuillotineNode> place(u32 i_free_node, int2 alloc_size);
+	void                   free_node(Handle<GuillotineNode> node_handle);
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include "exo/collections/pool.h"
+#include "exo/macros/assert.h"
+
+// Intrusive LRU list over the elements of a pool, from the most recently used (head) to the least recently used (tail)
+// T needs `Handle<T> lru_prev` and `Handle<T> lru_next` members
+template <typename T>
+struct LruList
+{
+	Handle<T> head = {}; // most recently used
+	Handle<T> tail = {}; // least recently used
+
+	void unlink(exo::Pool<T> &pool, Handle<T> handle)
+	{
+		auto &element = pool.get(handle);
+
+		if (element.lru_prev.is_valid()) {
+			pool.get(element.lru_prev).lru_next = element.lru_next;
+		} else {
+			this->head = element.lru_next;
+		}
+
+		if (element.lru_next.is_valid()) {
+			pool.get(element.lru_next).lru_prev = element.lru_prev;
+		} else {
+			this->tail = element.lru_prev;
+		}
+
+		element.lru_prev = Handle<T>::invalid();
+		element.lru_next = Handle<T>::invalid();
+	}
+
+	// Makes an unlinked element the head of the list
+	void push(exo::Pool<T> &pool, Handle<T> handle)
+	{
+		auto &element = pool.get(handle);
+		ASSERT(!element.lru_prev.is_valid() && !element.lru_next.is_valid());
+
+		element.lru_next = this->head;
+		if (this->head.is_valid()) {
+			pool.get(this->head).lru_prev = handle;
+		} else {
+			this->tail = handle;
+		}
+		this->head = handle;
+	}
+
+	void use(exo::Pool<T> &pool, Handle<T> handle)
+	{
+		if (this->head == handle) {
+			return;
+		}
+		this->unlink(pool, handle);
+		this->push(pool, handle);
+	}
+};
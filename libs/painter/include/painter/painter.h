@@ -1,11 +1,14 @@
 #pragma once
 #include "exo/collections/map.h"
+#include "exo/collections/pool.h"
 #include "exo/collections/span.h"
+#include "exo/collections/vector.h"
 #include "exo/macros/packed.h"
 #include "exo/maths/vectors.h"
 #include "exo/string_view.h"
 #include "painter/color.h"
 #include "painter/glyph_cache.h"
+#include "painter/lru.h"
 #include "painter/rect.h"
 
 namespace exo
@@ -63,21 +66,78 @@ union PrimitiveIndex
 };
 static_assert(sizeof(PrimitiveIndex) == sizeof(u32));
 
+// Identifies a shaped run by its content instead of the address of the text
+struct ShapeKey
+{
+	const hb_font_t *face = nullptr;
+	i32 size = 0; // in points
+	u64 text_hash = 0;
+
+	bool operator==(const ShapeKey &other) const = default;
+};
+u64 hash_value(const ShapeKey &key);
+
 struct CachedRun
 {
 	hb_buffer_t *hb_buf = nullptr;
 	hb_glyph_info_t *glyph_infos = nullptr;
 	hb_glyph_position_t *glyph_positions = nullptr;
 	u32 glyph_count = 0;
+
+	// Copy of the shaped text, to detect hash collisions
+	char *text = nullptr;
+	u32 text_len = 0;
+
+	ShapeKey key = {};
+	Handle<CachedRun> lru_prev = {};
+	Handle<CachedRun> lru_next = {};
+};
+
+struct ShapeCacheStats
+{
+	u64 hits = 0;
+	u64 misses = 0;
+	u64 evictions = 0;
 };
 
 struct ShapeContext
 {
-	exo::Map<exo::StringView, CachedRun> cached_runs;
+	exo::Pool<CachedRun> runs = {};
+	exo::Map<ShapeKey, Handle<CachedRun>> run_indices = {};
+	LruList<CachedRun> lru = {};
+	// Buffers of evicted runs, reused by the next runs
+	Vec<hb_buffer_t *> free_buffers = {};
+	u32 max_runs = 1024;
+	ShapeCacheStats stats = {};
 
 	// --
-	static ShapeContext create();
+	static ShapeContext create(u32 max_runs = 1024);
+	void destroy();
+
+	// The returned run is valid until the next call
 	const CachedRun &get_run(Font &font, exo::StringView text_run);
+
+private:
+	void evict_run(Handle<CachedRun> run_handle);
+};
+
+enum struct PainterMode : u8
+{
+	// Primitives are written to the vertex buffer when they are drawn, with 6 indices per rect
+	Immediate,
+	// Primitives are recorded per type and written by end_frame, with 1 index per rect drawn as an instanced quad
+	Batched,
+};
+
+// A primitive recorded in batched mode, `index` is the index in the stream of its type
+struct PainterCommand
+{
+	u32 layer = 0;
+	u32 texture = 0;
+	u32 i_clip_rect = 0;
+	u32 sequence = 0;
+	u32 index = 0;
+	RectType type = RectType_Color;
 };
 
 struct Painter
@@ -90,9 +150,30 @@ struct Painter
 	u32 index_offset = 0;
 	u32 glyph_atlas_gpu_idx = u32_invalid;
 
+	PainterMode mode = PainterMode::Immediate;
+	// Batched mode: the textured rects of a layer are drawn after its shapes, use another layer to draw on top of them
+	u32 layer = 0;
+	Vec<Rect> clip_rects = {};
+	Vec<ColorRect> color_rects = {};
+	Vec<SdfRect> sdf_rects = {};
+	Vec<TexturedRect> textured_rects = {};
+	Vec<PainterCommand> commands = {};
+	u32 clipped_primitives = 0;
+
 	// --
 
 	static Painter create(exo::Span<u8> vbuffer, exo::Span<PrimitiveIndex> ibuffer, int2 glyph_cache_size);
+	// The vertex and index buffers are owned by the caller
+	void destroy();
+
+	void begin_frame();
+	// Writes the recorded primitives to the vertex and index buffers in batched mode
+	void end_frame();
+
+	// Clip rects are referenced by the primitives drawn inside of them
+	u32 register_clip_rect(const Rect &clip_rect);
+	const Rect &get_clip_rect(u32 i_clip_rect) const;
+	bool is_clipped(const Rect &rect, u32 i_clip_rect) const;
 
 	void draw_textured_rect(const Rect &r, u32 i_clip_rect, const Rect &uv, u32 texture_id);
 	void draw_color_rect(const Rect &r, u32 i_clip_rect, ColorU32 c);
@@ -3,15 +3,9 @@
 #include "exo/collections/vector.h"
 #include "exo/maths/vectors.h"
 
-// Simple implementation in JS: https://github.com/mapbox/shelf-pack
+#include "painter/atlas_allocation.h"
 
-using AllocationId = Handle<struct Allocation>;
-struct Allocation
-{
-	int2 pos      = int2(0);
-	int2 size     = int2(0);
-	i32  refcount = 0;
-};
+// Simple implementation in JS: https://github.com/mapbox/shelf-pack
 
 struct FreeAllocation
 {
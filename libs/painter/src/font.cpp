@@ -24,7 +24,8 @@ Font Font::from_file(const char *path, i32 size_in_pt, i32 face_index)
 		EXO_PROFILE_MALLOC(global_library, sizeof(FT_Library));
 	}
 
-	Font res = {};
+	Font res       = {};
+	res.size_in_pt = size_in_pt;
 
 	FT_Face new_face = nullptr;
 	auto    error    = FT_New_Face(*global_library, path, face_index, &new_face);
@@ -44,16 +45,23 @@ Font Font::from_file(const char *path, i32 size_in_pt, i32 face_index)
 	return res;
 }
 
-void freetype_rasterizer(Font &font, u32 glyph_id, GlyphImage &out_image, GlyphMetrics & /*out_metrics*/)
+void freetype_rasterizer(
+	Font &font, u32 glyph_id, u32 subpixel_x, GlyphImage &out_image, GlyphMetrics & /*out_metrics*/)
 {
 	FT_Face face = hb_ft_font_get_face(font.hb_font);
 
 	FT_GlyphSlot slot = face->glyph;
 
+	// The outline is translated in 26.6 fixed point before being rendered
+	FT_Vector subpixel_offset = {.x = FT_Pos(subpixel_x * 64 / GLYPH_SUBPIXEL_STEPS), .y = 0};
+	FT_Set_Transform(face, nullptr, &subpixel_offset);
+
 	int error = 0;
 	error     = FT_Load_Glyph(face, glyph_id, 0);
 	ASSERT(!error);
 
+	FT_Set_Transform(face, nullptr, nullptr);
+
 	error = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL);
 	ASSERT(!error);
 
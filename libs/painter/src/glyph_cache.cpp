@@ -1,121 +1,230 @@
 #include "painter/glyph_cache.h"
 
+#include "cross/jobmanager.h"
+#include "cross/jobs/foreach.h"
+#include "cross/jobs/waitable.h"
+#include "exo/hash.h"
+#include "exo/profile.h"
 #include "painter/font.h"
 
-static void lru_cache_use(exo::Pool<GlyphEntry> &cache, Handle<GlyphEntry> &head, Handle<GlyphEntry> handle)
+#include <algorithm>
+#include <cstdlib>
+
+u64 hash_value(const GlyphKey &key)
 {
-	if (head == handle) {
-		return;
-	}
+	u64 hash = exo::hash_value(static_cast<const void *>(key.face));
+	hash     = exo::hash_combine(hash, u64(key.size));
+	hash     = exo::hash_combine(hash, u64(key.glyph_id) | (u64(key.subpixel_x) << 32));
+	return hash;
+}
 
-	// Remove the element from the list
-	auto &element_prev = cache.get(handle).lru_prev;
-	auto &element_next = cache.get(handle).lru_next;
+static GlyphKey glyph_key(const Font &font, GlyphId glyph_id, u32 subpixel_x)
+{
+	ASSERT(subpixel_x < GLYPH_SUBPIXEL_STEPS);
+	return GlyphKey{.face = font.hb_font, .size = font.size_in_pt, .glyph_id = glyph_id, .subpixel_x = subpixel_x};
+}
 
-	if (element_next.is_valid()) {
-		cache.get(element_next).lru_prev = element_prev;
-	}
-	if (element_prev.is_valid()) {
-		cache.get(element_prev).lru_next = element_next;
-	}
-	element_prev = Handle<GlyphEntry>::invalid();
+// A glyph that is not in the cache yet
+struct PendingGlyph
+{
+	GlyphKey     key     = {};
+	Font        *font    = nullptr;
+	GlyphImage   image   = {};
+	GlyphMetrics metrics = {};
+};
 
-	// Connect the head to the element
-	if (head.is_valid()) {
-		auto &head_prev = cache.get(head).lru_prev;
-		ASSERT(head_prev.is_valid() == false);
-		head_prev = handle;
-	}
+// The glyphs of a face, a FreeType face can only be used by one thread at a time
+struct FaceBatch
+{
+	exo::Span<PendingGlyph> glyphs     = {};
+	RasterizerFn            rasterizer = nullptr;
+};
 
-	// Connect the element to the head
-	element_next = head;
+static void rasterize_face_batch(FaceBatch &batch, void * /*user_data*/)
+{
+	EXO_PROFILE_SCOPE
+	for (auto &glyph : batch.glyphs) {
+		batch.rasterizer(*glyph.font, glyph.key.glyph_id, glyph.key.subpixel_x, glyph.image, glyph.metrics);
+	}
+}
 
-	// The new head is the element
-	head = handle;
+void GlyphCache::destroy()
+{
+	for (auto [glyph_handle, glyph_entry] : this->lru_cache) {
+		EXO_PROFILE_MFREE(glyph_entry->image.data);
+		std::free(glyph_entry->image.data);
+	}
+	this->lru_cache     = {};
+	this->lru           = {};
+	this->glyph_indices = {};
+	this->events.clear();
+	this->events.buffer.destroy();
+	this->allocator.free_nodes.clear();
+	this->allocator.free_nodes.buffer.destroy();
+	this->allocator.allocations = {};
+	this->allocator.nodes       = {};
 }
 
-static Handle<GlyphEntry> lru_cache_pop(exo::Pool<GlyphEntry> &cache, Handle<GlyphEntry> &head)
+// Returns the pixel offset from the top left corner and atlas coords for a specified face and glyph
+Option<int2> GlyphCache::queue_glyph(Font &font, GlyphId glyph_id, GlyphImage *image, u32 subpixel_x)
 {
-	if (head.is_valid() == false) {
-		return {};
+	const auto key = glyph_key(font, glyph_id, subpixel_x);
+
+	const Handle<GlyphEntry> *glyph_handle = this->glyph_indices.at(key);
+	if (!glyph_handle) {
+		// Not found, we need to rasterize it
+		const GlyphRequest request = {.font = &font, .glyph_id = glyph_id, .subpixel_x = subpixel_x};
+		this->rasterize_glyphs(exo::Span<const GlyphRequest>(&request, 1));
+		glyph_handle = this->glyph_indices.at(key);
+		ASSERT(glyph_handle);
 	}
 
-	const Handle<GlyphEntry> popped = head;
+	const auto &glyph_entry = this->lru_cache.get(*glyph_handle);
+	this->lru.use(this->lru_cache, *glyph_handle);
 
-	auto head_next = cache.get(head).lru_next;
+	if (!glyph_entry.allocator_id.is_valid()) {
+		return None;
+	}
 
-	// The new head is head_next
-	if (head_next.is_valid()) {
-		cache.get(head_next).lru_prev = Handle<GlyphEntry>::invalid();
+	if (image) {
+		*image = glyph_entry.image;
 	}
-	head = head_next;
 
-	return popped;
+	const auto &atlas_alloc = this->allocator.get(glyph_entry.allocator_id);
+	return Some(atlas_alloc.pos);
 }
 
-// Returns the pixel offset from the top left corner and atlas coords for a specified face and glyph
-Option<int2> GlyphCache::queue_glyph(Font &font, GlyphId glyph_id, GlyphImage *image)
+void GlyphCache::rasterize_glyphs(exo::Span<const GlyphRequest> requests)
 {
-	auto &face_cache = this->face_caches[0];
+	EXO_PROFILE_SCOPE
 
-	// Find an already allocated glyph
-	for (const auto &glyph_key : face_cache) {
-		if (glyph_key.glyph_id == glyph_id) {
-			const auto &glyph_entry = this->lru_cache.get(glyph_key.handle);
-			lru_cache_use(this->lru_cache, this->lru_head, glyph_key.handle);
-
-			if (!glyph_entry.allocator_id.is_valid()) {
-				return None;
-			}
+	// Gather the unique glyphs that are not in the cache
+	Vec<PendingGlyph> pending_glyphs;
+	for (const auto &request : requests) {
+		const auto key = glyph_key(*request.font, request.glyph_id, request.subpixel_x);
+		if (this->glyph_indices.contains(key)) {
+			continue;
+		}
+		const bool is_pending = std::any_of(pending_glyphs.begin(),
+			pending_glyphs.end(),
+			[&](const PendingGlyph &pending) { return pending.key == key; });
+		if (!is_pending) {
+			pending_glyphs.push(PendingGlyph{.key = key, .font = request.font});
+		}
+	}
+	if (pending_glyphs.is_empty()) {
+		pending_glyphs.buffer.destroy();
+		return;
+	}
 
-			if (image) {
-				*image = glyph_entry.image;
-			}
+	// Split them by face
+	std::sort(pending_glyphs.begin(), pending_glyphs.end(), [](const PendingGlyph &lhs, const PendingGlyph &rhs) {
+		return lhs.key.face < rhs.key.face;
+	});
+	Vec<FaceBatch> batches;
+	for (u32 i_glyph = 0; i_glyph < pending_glyphs.len();) {
+		u32 i_end = i_glyph + 1;
+		while (i_end < pending_glyphs.len() && pending_glyphs[i_end].key.face == pending_glyphs[i_glyph].key.face) {
+			i_end += 1;
+		}
+		batches.push(FaceBatch{
+			.glyphs     = exo::Span<PendingGlyph>(pending_glyphs.data() + i_glyph, i_end - i_glyph),
+			.rasterizer = this->rasterizer,
+		});
+		i_glyph = i_end;
+	}
 
-			const auto &atlas_alloc = this->allocator.get(glyph_entry.allocator_id);
-			return Some(atlas_alloc.pos);
+	if (this->jobmanager && batches.len() > 1) {
+		auto waitable = cross::parallel_foreach_userdata<FaceBatch, void>(*this->jobmanager,
+			batches,
+			nullptr,
+			rasterize_face_batch,
+			1);
+		waitable->wait();
+	} else {
+		for (auto &batch : batches) {
+			rasterize_face_batch(batch, nullptr);
 		}
 	}
 
-	// Not found, we need to rasterize it
-	GlyphImage   glyph_image   = {};
-	GlyphMetrics glyph_metrics = {};
-	this->rasterizer(font, glyph_id, glyph_image, glyph_metrics);
+	// The atlas and the LRU are only modified from the calling thread
+	for (auto &pending : pending_glyphs) {
+		AllocationId alloc_id;
+		if (pending.image.image_size.x == 0 || pending.image.image_size.y == 0) {
+			alloc_id = AllocationId::invalid();
+		} else {
+			alloc_id = this->alloc_glyph(int2(pending.image.image_size) + int2(2));
+		}
+
+		auto new_glyph_handle = this->lru_cache.add(GlyphEntry{
+			.allocator_id = alloc_id,
+			.key          = pending.key,
+			.image        = pending.image,
+			.metrics      = pending.metrics,
+		});
+		this->lru.push(this->lru_cache, new_glyph_handle);
+		this->glyph_indices.insert(pending.key, new_glyph_handle);
 
-	AllocationId alloc_id;
-	if (glyph_image.image_size.x == 0 || glyph_image.image_size.y == 0) {
-		alloc_id = AllocationId::invalid();
-	} else {
-		alloc_id = this->alloc_glyph(int2(glyph_image.image_size) + int2(2));
+		this->events.push(GlyphEvent{
+			.type         = GlyphEvent::Type::New,
+			.glyph_handle = new_glyph_handle,
+		});
 	}
 
-	auto new_glyph_handle = this->lru_cache.add(GlyphEntry{
-		.allocator_id = alloc_id,
-		.glyph_id     = glyph_id,
-		.image        = glyph_image,
-		.metrics      = glyph_metrics,
-	});
-	lru_cache_use(this->lru_cache, this->lru_head, new_glyph_handle);
-	face_cache.push(GlyphKey{
-		.handle   = new_glyph_handle,
-		.glyph_id = glyph_id,
-	});
+	batches.buffer.destroy();
+	pending_glyphs.buffer.destroy();
+}
 
-	this->events.push(GlyphEvent{
-		.type         = GlyphEvent::Type::New,
-		.glyph_handle = new_glyph_handle,
-	});
+void GlyphCache::evict_font(const Font &font)
+{
+	Vec<Handle<GlyphEntry>> to_evict;
+	for (const auto &[glyph_key, glyph_handle] : this->glyph_indices) {
+		if (glyph_key.face == font.hb_font) {
+			to_evict.push(glyph_handle);
+		}
+	}
+	for (auto glyph_handle : to_evict) {
+		this->evict_glyph(glyph_handle);
+	}
+	to_evict.buffer.destroy();
+}
 
-	if (!alloc_id.is_valid()) {
-		return None;
+void GlyphCache::defragment(u32 max_moves)
+{
+	EXO_PROFILE_SCOPE
+
+	Vec<AllocationMove> moves;
+	if (this->allocator.defragment(max_moves, moves) == 0) {
+		moves.buffer.destroy();
+		return;
 	}
 
-	if (image) {
-		*image = glyph_image;
+	for (auto [glyph_handle, glyph_entry] : this->lru_cache) {
+		if (!glyph_entry->allocator_id.is_valid()) {
+			continue;
+		}
+
+		for (const auto &move : moves) {
+			if (move.id != glyph_entry->allocator_id) {
+				continue;
+			}
+
+			// A glyph that has not been uploaded yet will be uploaded at its new position
+			const bool is_new = std::any_of(this->events.begin(), this->events.end(), [&](const GlyphEvent &event) {
+				return event.type == GlyphEvent::Type::New && event.glyph_handle == glyph_handle;
+			});
+			if (!is_new) {
+				this->events.push(GlyphEvent{
+					.type         = GlyphEvent::Type::Moved,
+					.glyph_handle = glyph_handle,
+					.old_pos      = move.old_pos,
+				});
+			}
+			break;
+		}
 	}
 
-	const auto &atlas_alloc = this->allocator.get(alloc_id);
-	return Some(atlas_alloc.pos);
+	moves.buffer.destroy();
 }
 
 AllocationId GlyphCache::alloc_glyph(int2 alloc_size)
@@ -124,22 +233,8 @@ AllocationId GlyphCache::alloc_glyph(int2 alloc_size)
 	auto alloc_id = this->allocator.alloc(alloc_size);
 	while (!alloc_id.is_valid()) {
 		// Evict the least recently used glyph
-		auto evicted_glyph_handle   = lru_cache_pop(this->lru_cache, this->lru_head);
-		auto evicted_glyph_alloc_id = this->lru_cache.get(evicted_glyph_handle).allocator_id;
-		this->lru_cache.remove(evicted_glyph_handle);
-
-		// Remove it from the face cache
-		auto &face_cache  = this->face_caches[0];
-		usize i_glyph_key = 0;
-		for (; i_glyph_key < face_cache.len(); ++i_glyph_key) {
-			if (face_cache[i_glyph_key].handle == evicted_glyph_handle) {
-				break;
-			}
-		}
-		face_cache.swap_remove(i_glyph_key);
-
-		// Deallocate it in the atlas
-		auto glyph_removed = this->allocator.unref(evicted_glyph_alloc_id);
+		ASSERT(this->lru.tail.is_valid());
+		const bool glyph_removed = this->evict_glyph(this->lru.tail);
 
 		if (glyph_removed) {
 			// Try to allocate it again
@@ -148,3 +243,39 @@ AllocationId GlyphCache::alloc_glyph(int2 alloc_size)
 	}
 	return alloc_id;
 }
+
+bool GlyphCache::evict_glyph(Handle<GlyphEntry> glyph_handle)
+{
+	auto &glyph_entry = this->lru_cache.get(glyph_handle);
+	this->lru.unlink(this->lru_cache, glyph_handle);
+	this->glyph_indices.remove(glyph_entry.key);
+
+	// The glyph may not have been uploaded yet, and its pending moves would refer to a removed entry
+	bool was_uploaded = true;
+	for (u32 i_event = 0; i_event < this->events.len();) {
+		const auto &event = this->events[i_event];
+		if (event.glyph_handle != glyph_handle ||
+			(event.type != GlyphEvent::Type::New && event.type != GlyphEvent::Type::Moved)) {
+			i_event += 1;
+			continue;
+		}
+		was_uploaded = was_uploaded && event.type != GlyphEvent::Type::New;
+		this->events.swap_remove(i_event);
+	}
+	if (was_uploaded) {
+		this->events.push(GlyphEvent{
+			.type         = GlyphEvent::Type::Evicted,
+			.glyph_handle = glyph_handle,
+		});
+	}
+
+	EXO_PROFILE_MFREE(glyph_entry.image.data);
+	std::free(glyph_entry.image.data);
+
+	bool glyph_removed = false;
+	if (glyph_entry.allocator_id.is_valid()) {
+		glyph_removed = this->allocator.unref(glyph_entry.allocator_id);
+	}
+	this->lru_cache.remove(glyph_handle);
+	return glyph_removed;
+}
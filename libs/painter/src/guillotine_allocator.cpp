@@ -0,0 +1,284 @@
+#include "painter/guillotine_allocator.h"
+
+#include "exo/macros/assert.h"
+#include "exo/profile.h"
+
+#include <algorithm>
+#include <limits>
+
+static bool fits(const GuillotineNode &node, int2 alloc_size)
+{
+	return alloc_size.x <= node.size.x && alloc_size.y <= node.size.y;
+}
+
+static void add_free_node(GuillotineAllocator &allocator, Handle<GuillotineNode> node_handle)
+{
+	auto &node       = allocator.nodes.get(node_handle);
+	node.state       = GuillotineNode::State::Free;
+	node.i_free_node = allocator.free_nodes.len();
+	allocator.free_nodes.push(node_handle);
+}
+
+static void remove_free_node(GuillotineAllocator &allocator, Handle<GuillotineNode> node_handle)
+{
+	auto &node = allocator.nodes.get(node_handle);
+	ASSERT(node.state == GuillotineNode::State::Free);
+	ASSERT(allocator.free_nodes[node.i_free_node] == node_handle);
+
+	const u32 i_free_node = node.i_free_node;
+	allocator.free_nodes.swap_remove(i_free_node);
+	if (i_free_node < allocator.free_nodes.len()) {
+		allocator.nodes.get(allocator.free_nodes[i_free_node]).i_free_node = i_free_node;
+	}
+	node.i_free_node = u32_invalid;
+}
+
+// Cut a node in two, returns the first child that starts at the node position
+static Handle<GuillotineNode> split_node(
+	GuillotineAllocator &allocator, Handle<GuillotineNode> node_handle, bool horizontal_cut, i32 first_extent)
+{
+	const auto node = allocator.nodes.get(node_handle);
+
+	GuillotineNode first  = {.pos = node.pos, .size = node.size, .parent = node_handle};
+	GuillotineNode second = {.pos = node.pos, .size = node.size, .parent = node_handle};
+	if (horizontal_cut) {
+		first.size.y = first_extent;
+		second.pos.y += first_extent;
+		second.size.y -= first_extent;
+	} else {
+		first.size.x = first_extent;
+		second.pos.x += first_extent;
+		second.size.x -= first_extent;
+	}
+
+	const auto first_handle  = allocator.nodes.add(std::move(first));
+	const auto second_handle = allocator.nodes.add(std::move(second));
+	add_free_node(allocator, second_handle);
+
+	// The pool may have grown, get the node again
+	auto &cut_node        = allocator.nodes.get(node_handle);
+	cut_node.state        = GuillotineNode::State::Split;
+	cut_node.first_child  = first_handle;
+	cut_node.second_child = second_handle;
+	return first_handle;
+}
+
+// Returns the index of the free node that fits `alloc_size` with the least waste
+static u32 find_best_node(const GuillotineAllocator &allocator, int2 alloc_size)
+{
+	u32 i_best_node   = u32_invalid;
+	i32 best_waste    = std::numeric_limits<i32>::max();
+	i32 best_leftover = std::numeric_limits<i32>::max();
+
+	for (u32 i_free_node = 0; i_free_node < allocator.free_nodes.len(); ++i_free_node) {
+		const auto &node = allocator.nodes.get(allocator.free_nodes[i_free_node]);
+		if (!fits(node, alloc_size)) {
+			continue;
+		}
+
+		if (node.size == alloc_size) {
+			return i_free_node;
+		}
+
+		const i32 waste    = node.size.x * node.size.y - alloc_size.x * alloc_size.y;
+		const i32 leftover = std::min(node.size.x - alloc_size.x, node.size.y - alloc_size.y);
+		if (waste < best_waste || (waste == best_waste && leftover < best_leftover)) {
+			i_best_node   = i_free_node;
+			best_waste    = waste;
+			best_leftover = leftover;
+		}
+	}
+
+	return i_best_node;
+}
+
+// Place the allocation at the top-left of a free node, and cut the remaining space along the shorter leftover axis
+Handle<GuillotineNode> GuillotineAllocator::place(u32 i_free_node, int2 alloc_size)
+{
+	auto node_handle = this->free_nodes[i_free_node];
+	remove_free_node(*this, node_handle);
+
+	const auto &node       = this->nodes.get(node_handle);
+	const i32   leftover_x = node.size.x - alloc_size.x;
+	const i32   leftover_y = node.size.y - alloc_size.y;
+	ASSERT(leftover_x >= 0 && leftover_y >= 0);
+
+	// The first cut separates the biggest leftover from the row (or column) of the allocation
+	if (leftover_x < leftover_y) {
+		if (leftover_y > 0) {
+			node_handle = split_node(*this, node_handle, true, alloc_size.y);
+		}
+		if (leftover_x > 0) {
+			node_handle = split_node(*this, node_handle, false, alloc_size.x);
+		}
+	} else {
+		if (leftover_x > 0) {
+			node_handle = split_node(*this, node_handle, false, alloc_size.x);
+		}
+		if (leftover_y > 0) {
+			node_handle = split_node(*this, node_handle, true, alloc_size.y);
+		}
+	}
+
+	this->nodes.get(node_handle).state = GuillotineNode::State::Used;
+	return node_handle;
+}
+
+void GuillotineAllocator::free_node(Handle<GuillotineNode> node_handle)
+{
+	// Merge the cuts whose children are both free
+	while (true) {
+		const auto parent_handle = this->nodes.get(node_handle).parent;
+		if (!parent_handle.is_valid()) {
+			break;
+		}
+
+		const auto &parent         = this->nodes.get(parent_handle);
+		const auto  sibling_handle = parent.first_child == node_handle ? parent.second_child : parent.first_child;
+		if (this->nodes.get(sibling_handle).state != GuillotineNode::State::Free) {
+			break;
+		}
+
+		remove_free_node(*this, sibling_handle);
+		this->nodes.remove(sibling_handle);
+		this->nodes.remove(node_handle);
+
+		auto &merged_node        = this->nodes.get(parent_handle);
+		merged_node.first_child  = {};
+		merged_node.second_child = {};
+		node_handle              = parent_handle;
+	}
+
+	add_free_node(*this, node_handle);
+}
+
+AllocationId GuillotineAllocator::alloc(int2 alloc_size)
+{
+	ASSERT(alloc_size.x > 0 && alloc_size.y > 0);
+
+	// The whole atlas is free
+	if (!this->root.is_valid()) {
+		this->root = this->nodes.add(GuillotineNode{.pos = int2(0), .size = this->size});
+		add_free_node(*this, this->root);
+	}
+
+	const u32 i_free_node = find_best_node(*this, alloc_size);
+	if (i_free_node == u32_invalid) {
+		return {};
+	}
+
+	const auto node_handle = this->place(i_free_node, alloc_size);
+	const auto alloc_id    = this->allocations.add({
+		.pos      = this->nodes.get(node_handle).pos,
+		.size     = alloc_size,
+		.refcount = 1,
+	});
+	this->allocation_nodes.insert(alloc_id, node_handle);
+	return alloc_id;
+}
+
+const Allocation &GuillotineAllocator::get(AllocationId id) const { return this->allocations.get(id); }
+
+void GuillotineAllocator::ref(AllocationId id)
+{
+	auto &alloc = this->allocations.get(id);
+	alloc.refcount += 1;
+}
+
+bool GuillotineAllocator::unref(AllocationId id)
+{
+	auto &alloc = this->allocations.get(id);
+	alloc.refcount -= 1;
+	if (alloc.refcount <= 0) {
+		this->free_node(*this->allocation_nodes.at(id));
+		this->allocation_nodes.remove(id);
+		this->allocations.remove(id);
+		return true;
+	}
+	return false;
+}
+
+u32 GuillotineAllocator::defragment(u32 max_moves, Vec<AllocationMove> &out_moves)
+{
+	EXO_PROFILE_SCOPE
+
+	// Start with the allocations that are the farthest from the top
+	Vec<AllocationId> candidates;
+	candidates.reserve(this->allocations.size);
+	for (auto [id, p_alloc] : this->allocations) {
+		candidates.push(id);
+	}
+	std::sort(candidates.begin(), candidates.end(), [&](AllocationId lhs, AllocationId rhs) {
+		const auto &lhs_alloc = this->allocations.get(lhs);
+		const auto &rhs_alloc = this->allocations.get(rhs);
+		return lhs_alloc.pos.y + lhs_alloc.size.y > rhs_alloc.pos.y + rhs_alloc.size.y;
+	});
+
+	u32 move_count = 0;
+	for (auto id : candidates) {
+		if (move_count >= max_moves) {
+			break;
+		}
+
+		const Allocation alloc = this->allocations.get(id);
+
+		// Find the free node closest to the top that is before the current position
+		u32  i_best_node = u32_invalid;
+		int2 best_pos    = alloc.pos;
+		for (u32 i_free_node = 0; i_free_node < this->free_nodes.len(); ++i_free_node) {
+			const auto &node = this->nodes.get(this->free_nodes[i_free_node]);
+			if (!fits(node, alloc.size)) {
+				continue;
+			}
+			const bool is_before = node.pos.y < best_pos.y || (node.pos.y == best_pos.y && node.pos.x < best_pos.x);
+			if (is_before) {
+				i_best_node = i_free_node;
+				best_pos    = node.pos;
+			}
+		}
+
+		if (i_best_node == u32_invalid) {
+			continue;
+		}
+
+		const auto new_node_handle = this->place(i_best_node, alloc.size);
+		auto      *node_handle     = this->allocation_nodes.at(id);
+		this->free_node(*node_handle);
+		*node_handle = new_node_handle;
+
+		this->allocations.get(id).pos = this->nodes.get(new_node_handle).pos;
+		out_moves.push(AllocationMove{.id = id, .old_pos = alloc.pos});
+		move_count += 1;
+	}
+
+	candidates.buffer.destroy();
+	return move_count;
+}
+
+i32 GuillotineAllocator::free_area() const
+{
+	if (!this->root.is_valid()) {
+		return this->size.x * this->size.y;
+	}
+
+	i32 area = 0;
+	for (auto node_handle : this->free_nodes) {
+		const auto &node = this->nodes.get(node_handle);
+		area += node.size.x * node.size.y;
+	}
+	return area;
+}
+
+i32 GuillotineAllocator::largest_free_area() const
+{
+	if (!this->root.is_valid()) {
+		return this->size.x * this->size.y;
+	}
+
+	i32 area = 0;
+	for (auto node_handle : this->free_nodes) {
+		const auto &node = this->nodes.get(node_handle);
+		area             = std::max(area, node.size.x * node.size.y);
+	}
+	return area;
+}
@@ -1,5 +1,6 @@
 #include "painter/painter.h"
 #include "exo/collections/span.h"
+#include "exo/hash.h"
 #include "exo/macros/assert.h"
 #include "exo/memory/scope_stack.h"
 #include "exo/profile.h"
@@ -8,37 +9,109 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include <algorithm>
+#include <cstdlib>
 #include <cstring> // for std::memset
 #include <hb.h>
 
-ShapeContext ShapeContext::create()
+u64 hash_value(const ShapeKey &key)
 {
+	u64 hash = exo::hash_value(static_cast<const void *>(key.face));
+	hash = exo::hash_combine(hash, u64(key.size));
+	hash = exo::hash_combine(hash, key.text_hash);
+	return hash;
+}
+
+ShapeContext ShapeContext::create(u32 max_runs)
+{
+	ASSERT(max_runs > 0);
 	ShapeContext context = {};
+	context.max_runs = max_runs;
 	return context;
 }
 
+void ShapeContext::destroy()
+{
+	while (this->lru.tail.is_valid()) {
+		this->evict_run(this->lru.tail);
+	}
+	for (auto *hb_buf : this->free_buffers) {
+		hb_buffer_destroy(hb_buf);
+	}
+	this->free_buffers.clear();
+	this->free_buffers.buffer.destroy();
+	this->stats = {};
+}
+
 const CachedRun &ShapeContext::get_run(Font &font, exo::StringView text_run)
 {
-	auto cache_key = text_run;
-	CachedRun *run = this->cached_runs.at(cache_key);
-	if (!run) {
-		run = this->cached_runs.insert(cache_key, {.hb_buf = hb_buffer_create()});
+	const ShapeKey key = {
+		.face = font.hb_font,
+		.size = font.size_in_pt,
+		.text_hash = exo::hash_value(text_run),
+	};
+
+	const Handle<CachedRun> *cached_handle = this->run_indices.at(key);
+	if (cached_handle) {
+		auto &cached_run = this->runs.get(*cached_handle);
+		const bool same_text =
+			cached_run.text_len == text_run.len() && std::memcmp(cached_run.text, text_run.data(), text_run.len()) == 0;
+		if (same_text) {
+			this->stats.hits += 1;
+			this->lru.use(this->runs, *cached_handle);
+			return cached_run;
+		}
+		// Hash collision, replace the old run
+		this->evict_run(*cached_handle);
+	}
+	this->stats.misses += 1;
+
+	while (this->runs.size >= this->max_runs) {
+		this->evict_run(this->lru.tail);
+		this->stats.evictions += 1;
+	}
+
+	hb_buffer_t *hb_buf = nullptr;
+	if (this->free_buffers.is_empty()) {
+		hb_buf = hb_buffer_create();
+	} else {
+		hb_buf = this->free_buffers.pop();
+	}
 
-		hb_buffer_clear_contents(run->hb_buf);
+	// clear_contents clear buffer props
+	hb_buffer_set_direction(hb_buf, HB_DIRECTION_LTR);
+	hb_buffer_set_script(hb_buf, HB_SCRIPT_LATIN);
+	hb_buffer_set_language(hb_buf, hb_language_from_string("en", -1));
 
-		// clear_contents clear buffer props
-		hb_buffer_set_direction(run->hb_buf, HB_DIRECTION_LTR);
-		hb_buffer_set_script(run->hb_buf, HB_SCRIPT_LATIN);
-		hb_buffer_set_language(run->hb_buf, hb_language_from_string("en", -1));
+	hb_buffer_add_utf8(hb_buf, text_run.data(), int(text_run.len()), 0, -1);
 
-		hb_buffer_add_utf8(run->hb_buf, text_run.data(), int(text_run.len()), 0, -1);
+	hb_shape(font.hb_font, hb_buf, nullptr, 0);
 
-		hb_shape(font.hb_font, run->hb_buf, nullptr, 0);
+	CachedRun run = {.hb_buf = hb_buf, .key = key};
+	run.glyph_infos = hb_buffer_get_glyph_infos(hb_buf, &run.glyph_count);
+	run.glyph_positions = hb_buffer_get_glyph_positions(hb_buf, nullptr);
+	run.text_len = u32(text_run.len());
+	run.text = static_cast<char *>(std::malloc(text_run.len() + 1));
+	std::memcpy(run.text, text_run.data(), text_run.len());
+	run.text[text_run.len()] = '\0';
 
-		run->glyph_infos = hb_buffer_get_glyph_infos(run->hb_buf, &run->glyph_count);
-		run->glyph_positions = hb_buffer_get_glyph_positions(run->hb_buf, nullptr);
-	}
-	return *run;
+	auto run_handle = this->runs.add(std::move(run));
+	this->lru.push(this->runs, run_handle);
+	this->run_indices.insert(key, run_handle);
+	return this->runs.get(run_handle);
+}
+
+void ShapeContext::evict_run(Handle<CachedRun> run_handle)
+{
+	auto &run = this->runs.get(run_handle);
+	this->lru.unlink(this->runs, run_handle);
+	this->run_indices.remove(run.key);
+
+	hb_buffer_clear_contents(run.hb_buf);
+	this->free_buffers.push(run.hb_buf);
+	std::free(run.text);
+
+	this->runs.remove(run_handle);
 }
 
 Painter Painter::create(exo::Span<u8> vbuffer, exo::Span<PrimitiveIndex> ibuffer, int2 glyph_cache_size)
@@ -56,33 +129,214 @@ Painter Painter::create(exo::Span<u8> vbuffer, exo::Span<PrimitiveIndex> ibuffer
 	return painter;
 }
 
-void Painter::draw_textured_rect(const Rect &r, u32 i_clip_rect, const Rect &uv, u32 texture_id)
+void Painter::destroy()
+{
+	this->shaper.destroy();
+	this->glyph_cache.destroy();
+	this->begin_frame();
+	this->clip_rects.buffer.destroy();
+	this->color_rects.buffer.destroy();
+	this->sdf_rects.buffer.destroy();
+	this->textured_rects.buffer.destroy();
+	this->commands.buffer.destroy();
+}
+
+void Painter::begin_frame()
+{
+	this->index_offset = 0;
+	this->vertex_bytes_offset = 0;
+	this->layer = 0;
+	this->clipped_primitives = 0;
+
+	this->clip_rects.clear();
+	this->color_rects.clear();
+	this->sdf_rects.clear();
+	this->textured_rects.clear();
+	this->commands.clear();
+}
+
+static PrimitiveIndex primitive_index(u32 i_rect, u32 corner, RectType type)
+{
+	ASSERT(i_rect < (1u << 24));
+	return {{.index = i_rect & 0xFF'FFFFu, .corner = corner & 0b11u, .type = type & 0b11'1111u}};
+}
+
+// Copy a stream after the previous ones, returns the index of its first element in the vertex buffer
+template <typename T>
+static u32 write_stream(Painter &painter, const Vec<T> &stream)
+{
+	auto misalignment = painter.vertex_bytes_offset % sizeof(T);
+	if (misalignment != 0) {
+		painter.vertex_bytes_offset += sizeof(T) - misalignment;
+	}
+
+	const usize stream_size = stream.len() * sizeof(T);
+	ASSERT(painter.vertex_bytes_offset + stream_size <= painter.vertex_buffer.len());
+	if (stream_size != 0) {
+		std::memcpy(painter.vertex_buffer.data() + painter.vertex_bytes_offset, stream.data(), stream_size);
+	}
+
+	const u32 i_first = u32(painter.vertex_bytes_offset / sizeof(T));
+	painter.vertex_bytes_offset += stream_size;
+	return i_first;
+}
+
+void Painter::end_frame()
 {
 	EXO_PROFILE_SCOPE;
-	ASSERT(texture_id != u32_invalid);
 
-	auto misalignment = this->vertex_bytes_offset % sizeof(TexturedRect);
+	if (this->mode != PainterMode::Batched) {
+		return;
+	}
+
+	// Each type is contiguous, there is at most one padding per type instead of one per primitive
+	ASSERT(this->vertex_bytes_offset == 0);
+	const u32 i_first_clip_rect = write_stream(*this, this->clip_rects);
+	const u32 i_first_color_rect = write_stream(*this, this->color_rects);
+	const u32 i_first_sdf_rect = write_stream(*this, this->sdf_rects);
+	const u32 i_first_textured_rect = write_stream(*this, this->textured_rects);
+	// The clip rects are referenced by their index in the vertex buffer
+	ASSERT(i_first_clip_rect == 0);
+
+	// Shapes keep their order inside a layer, they are drawn before the textured rects that are sorted by texture and
+	// clip rect.
+	std::sort(this->commands.begin(),
+		this->commands.end(),
+		[](const PainterCommand &lhs, const PainterCommand &rhs) {
+			if (lhs.layer != rhs.layer) {
+				return lhs.layer < rhs.layer;
+			}
+			const bool lhs_textured = lhs.type == RectType_Textured;
+			const bool rhs_textured = rhs.type == RectType_Textured;
+			if (lhs_textured != rhs_textured) {
+				return rhs_textured;
+			}
+			if (lhs_textured) {
+				if (lhs.texture != rhs.texture) {
+					return lhs.texture < rhs.texture;
+				}
+				if (lhs.i_clip_rect != rhs.i_clip_rect) {
+					return lhs.i_clip_rect < rhs.i_clip_rect;
+				}
+			}
+			return lhs.sequence < rhs.sequence;
+		});
+
+	// One index per rect, the quad is made by the vertex shader
+	ASSERT(this->commands.len() <= this->index_buffer.len());
+	for (const auto &command : this->commands) {
+		u32 i_first = i_first_color_rect;
+		if (command.type == RectType_Textured) {
+			i_first = i_first_textured_rect;
+		} else if (command.type != RectType_Color) {
+			i_first = i_first_sdf_rect;
+		}
+		this->index_buffer[this->index_offset++] = primitive_index(i_first + command.index, 0, command.type);
+	}
+}
+
+u32 Painter::register_clip_rect(const Rect &clip_rect)
+{
+	if (this->mode == PainterMode::Batched) {
+		this->clip_rects.push(clip_rect);
+		return this->clip_rects.len() - 1;
+	}
+
+	// The clip rect is stored like a color rect that is not drawn
+	this->draw_color_rect(clip_rect, u32_invalid, ColorU32::from_uints(0, 0, 0xFF, 0x88));
+
+	auto i_first_rect_index = this->index_offset - 6;
+	for (u32 i_corner = 0; i_corner < 6; ++i_corner) {
+		this->index_buffer[i_first_rect_index + i_corner].bits.type = RectType_Clip;
+	}
+
+	const usize last_color_rect_offset = this->vertex_bytes_offset - sizeof(ColorRect);
+	ASSERT(last_color_rect_offset % sizeof(Rect) == 0);
+	return static_cast<u32>(last_color_rect_offset / sizeof(Rect));
+}
+
+const Rect &Painter::get_clip_rect(u32 i_clip_rect) const
+{
+	if (this->mode == PainterMode::Batched) {
+		return this->clip_rects[i_clip_rect];
+	}
+	return exo::reinterpret_span<const Rect>(exo::Span<const u8>(this->vertex_buffer))[i_clip_rect];
+}
+
+bool Painter::is_clipped(const Rect &rect, u32 i_clip_rect) const
+{
+	return i_clip_rect != u32_invalid && !rect.intersects(this->get_clip_rect(i_clip_rect));
+}
+
+// Writes a primitive in the vertex buffer after the previous one, returns its index
+template <typename T>
+static u32 push_primitive(Painter &painter, const T &primitive)
+{
+	auto misalignment = painter.vertex_bytes_offset % sizeof(T);
 	if (misalignment != 0) {
-		this->vertex_bytes_offset += sizeof(TexturedRect) - misalignment;
+		painter.vertex_bytes_offset += sizeof(T) - misalignment;
 	}
 
-	ASSERT(this->vertex_bytes_offset % sizeof(TexturedRect) == 0);
-	const u32 i_rect = static_cast<u32>(this->vertex_bytes_offset / sizeof(TexturedRect));
+	ASSERT(painter.vertex_bytes_offset % sizeof(T) == 0);
+	const u32 i_rect = static_cast<u32>(painter.vertex_bytes_offset / sizeof(T));
 
-	auto vertices = exo::reinterpret_span<TexturedRect>(this->vertex_buffer);
-	vertices[i_rect] = {.rect = r, .uv = uv, .texture_descriptor = texture_id, .i_clip_rect = i_clip_rect};
+	auto vertices = exo::reinterpret_span<T>(painter.vertex_buffer);
+	vertices[i_rect] = primitive;
 
-	this->vertex_bytes_offset += sizeof(TexturedRect);
+	painter.vertex_bytes_offset += sizeof(T);
+	return i_rect;
+}
 
+static void push_quad_indices(Painter &painter, u32 i_rect, RectType type)
+{
 	// 0 - 3
 	// |   |
 	// 1 - 2
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 0, .type = RectType_Textured}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 1, .type = RectType_Textured}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 2, .type = RectType_Textured}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 2, .type = RectType_Textured}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 3, .type = RectType_Textured}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 0, .type = RectType_Textured}};
+	painter.index_buffer[painter.index_offset++] = primitive_index(i_rect, 0, type);
+	painter.index_buffer[painter.index_offset++] = primitive_index(i_rect, 1, type);
+	painter.index_buffer[painter.index_offset++] = primitive_index(i_rect, 2, type);
+	painter.index_buffer[painter.index_offset++] = primitive_index(i_rect, 2, type);
+	painter.index_buffer[painter.index_offset++] = primitive_index(i_rect, 3, type);
+	painter.index_buffer[painter.index_offset++] = primitive_index(i_rect, 0, type);
+}
+
+// Draws the primitive now in immediate mode, or records it in the stream of its type in batched mode
+template <typename T>
+static void submit_primitive(
+	Painter &painter, Vec<T> &stream, const T &primitive, RectType type, u32 i_clip_rect, u32 texture = 0)
+{
+	if (painter.mode == PainterMode::Batched) {
+		painter.commands.push(PainterCommand{
+			.layer = painter.layer,
+			.texture = texture,
+			.i_clip_rect = i_clip_rect,
+			.sequence = painter.commands.len(),
+			.index = stream.len(),
+			.type = type,
+		});
+		stream.push(primitive);
+	} else {
+		const u32 i_rect = push_primitive(painter, primitive);
+		push_quad_indices(painter, i_rect, type);
+	}
+}
+
+void Painter::draw_textured_rect(const Rect &r, u32 i_clip_rect, const Rect &uv, u32 texture_id)
+{
+	EXO_PROFILE_SCOPE;
+	ASSERT(texture_id != u32_invalid);
+
+	if (this->is_clipped(r, i_clip_rect)) {
+		this->clipped_primitives += 1;
+		return;
+	}
+
+	submit_primitive(*this,
+		this->textured_rects,
+		TexturedRect{.rect = r, .uv = uv, .texture_descriptor = texture_id, .i_clip_rect = i_clip_rect},
+		RectType_Textured,
+		i_clip_rect,
+		texture_id);
 }
 
 void Painter::draw_color_rect(const Rect &r, u32 i_clip_rect, ColorU32 color)
@@ -94,25 +348,16 @@ void Painter::draw_color_rect(const Rect &r, u32 i_clip_rect, ColorU32 color)
 		return;
 	}
 
-	auto misalignment = this->vertex_bytes_offset % sizeof(ColorRect);
-	if (misalignment != 0) {
-		this->vertex_bytes_offset += sizeof(ColorRect) - misalignment;
+	if (this->is_clipped(r, i_clip_rect)) {
+		this->clipped_primitives += 1;
+		return;
 	}
 
-	const u32 i_rect = u32(this->vertex_bytes_offset / sizeof(ColorRect));
-	auto vertices = exo::reinterpret_span<ColorRect>(this->vertex_buffer);
-	vertices[i_rect] = {.rect = r, .color = color.raw, .i_clip_rect = i_clip_rect};
-	this->vertex_bytes_offset += sizeof(ColorRect);
-
-	// 0 - 3
-	// |   |
-	// 1 - 2
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 0, .type = RectType_Color}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 1, .type = RectType_Color}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 2, .type = RectType_Color}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 2, .type = RectType_Color}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 3, .type = RectType_Color}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 0, .type = RectType_Color}};
+	submit_primitive(*this,
+		this->color_rects,
+		ColorRect{.rect = r, .color = color.raw, .i_clip_rect = i_clip_rect},
+		RectType_Color,
+		i_clip_rect);
 }
 
 int2 Painter::measure_label(Font &font, exo::StringView label)
@@ -138,6 +383,15 @@ void Painter::draw_label(const Rect &view_rect, u32 i_clip_rect, Font &font, exo
 	const auto &shaped_run = this->shaper.get_run(font, label);
 	const i32 line_height = font.metrics.height;
 
+	// Rasterize the missing glyphs of the label at once
+	Vec<GlyphRequest> glyph_requests;
+	glyph_requests.reserve(shaped_run.glyph_count);
+	for (u32 i = 0; i < shaped_run.glyph_count; i++) {
+		glyph_requests.push(GlyphRequest{.font = &font, .glyph_id = shaped_run.glyph_infos[i].codepoint});
+	}
+	this->glyph_cache.rasterize_glyphs(glyph_requests);
+	glyph_requests.buffer.destroy();
+
 	i32 cursor_x = i32(view_rect.pos.x);
 	i32 cursor_y = i32(view_rect.pos.y) + font.metrics.ascender;
 	for (u32 i = 0; i < shaped_run.glyph_count; i++) {
@@ -183,31 +437,22 @@ void Painter::draw_color_round_rect(
 		return;
 	}
 
-	auto misalignment = this->vertex_bytes_offset % sizeof(SdfRect);
-	if (misalignment != 0) {
-		this->vertex_bytes_offset += sizeof(SdfRect) - misalignment;
+	if (this->is_clipped(r, i_clip_rect)) {
+		this->clipped_primitives += 1;
+		return;
 	}
 
-	const u32 i_rect = u32(this->vertex_bytes_offset / sizeof(SdfRect));
-	auto vertices = exo::reinterpret_span<SdfRect>(this->vertex_buffer);
-	vertices[i_rect] = {
-		.rect = r,
-		.color = color.raw,
-		.i_clip_rect = i_clip_rect,
-		.border_color = border_color.raw,
-		.border_thickness = border_thickness,
-	};
-	this->vertex_bytes_offset += sizeof(SdfRect);
-
-	// 0 - 3
-	// |   |
-	// 1 - 2
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 0, .type = RectType_Sdf_RoundRectangle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 1, .type = RectType_Sdf_RoundRectangle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 2, .type = RectType_Sdf_RoundRectangle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 2, .type = RectType_Sdf_RoundRectangle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 3, .type = RectType_Sdf_RoundRectangle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 0, .type = RectType_Sdf_RoundRectangle}};
+	submit_primitive(*this,
+		this->sdf_rects,
+		SdfRect{
+			.rect = r,
+			.color = color.raw,
+			.i_clip_rect = i_clip_rect,
+			.border_color = border_color.raw,
+			.border_thickness = border_thickness,
+		},
+		RectType_Sdf_RoundRectangle,
+		i_clip_rect);
 }
 
 void Painter::draw_color_circle(
@@ -220,29 +465,20 @@ void Painter::draw_color_circle(
 		return;
 	}
 
-	auto misalignment = this->vertex_bytes_offset % sizeof(SdfRect);
-	if (misalignment != 0) {
-		this->vertex_bytes_offset += sizeof(SdfRect) - misalignment;
+	if (this->is_clipped(r, i_clip_rect)) {
+		this->clipped_primitives += 1;
+		return;
 	}
 
-	const u32 i_rect = u32(this->vertex_bytes_offset / sizeof(SdfRect));
-	auto vertices = exo::reinterpret_span<SdfRect>(this->vertex_buffer.subspan(this->vertex_bytes_offset));
-	vertices[i_rect] = {
-		.rect = r,
-		.color = color.raw,
-		.i_clip_rect = i_clip_rect,
-		.border_color = border_color.raw,
-		.border_thickness = border_thickness,
-	};
-	this->vertex_bytes_offset += sizeof(SdfRect);
-
-	// 0 - 3
-	// |   |
-	// 1 - 2
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 0, .type = RectType_Sdf_Circle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 1, .type = RectType_Sdf_Circle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 2, .type = RectType_Sdf_Circle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 2, .type = RectType_Sdf_Circle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 3, .type = RectType_Sdf_Circle}};
-	this->index_buffer[this->index_offset++] = {{.index = i_rect, .corner = 0, .type = RectType_Sdf_Circle}};
+	submit_primitive(*this,
+		this->sdf_rects,
+		SdfRect{
+			.rect = r,
+			.color = color.raw,
+			.i_clip_rect = i_clip_rect,
+			.border_color = border_color.raw,
+			.border_thickness = border_thickness,
+		},
+		RectType_Sdf_Circle,
+		i_clip_rect);
 }
@@ -50,8 +50,8 @@ AllocationId ShelfAllocator::alloc(int2 alloc_size)
 			continue;
 		}
 
-		ASSERT(alloc_size.y < freealloc.capacity.y);
-		ASSERT(alloc_size.x < freealloc.capacity.x);
+		ASSERT(alloc_size.y <= freealloc.capacity.y);
+		ASSERT(alloc_size.x <= freealloc.capacity.x);
 		const i32 waste = (freealloc.capacity.x * freealloc.capacity.y) - (alloc_size.x * alloc_size.y);
 		if (waste < area_waste) {
 			area_waste      = waste;
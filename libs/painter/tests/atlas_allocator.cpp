@@ -0,0 +1,207 @@
+#include "exo/tests/random.h"
+#include "painter/guillotine_allocator.h"
+#include "painter/shelf_allocator.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <utility>
+
+static bool overlaps(const Allocation &lhs, const Allocation &rhs)
+{
+	return lhs.pos.x < rhs.pos.x + rhs.size.x && rhs.pos.x < lhs.pos.x + lhs.size.x &&
+	       lhs.pos.y < rhs.pos.y + rhs.size.y && rhs.pos.y < lhs.pos.y + lhs.size.y;
+}
+
+static void check_allocations(const GuillotineAllocator &allocator)
+{
+	i32 used_area = 0;
+	for (auto [id, p_alloc] : allocator.allocations) {
+		const auto &alloc = *p_alloc;
+		REQUIRE(alloc.pos.x >= 0);
+		REQUIRE(alloc.pos.y >= 0);
+		REQUIRE(alloc.pos.x + alloc.size.x <= allocator.size.x);
+		REQUIRE(alloc.pos.y + alloc.size.y <= allocator.size.y);
+		used_area += alloc.size.x * alloc.size.y;
+
+		for (auto node_handle : allocator.free_nodes) {
+			const auto &node = allocator.nodes.get(node_handle);
+			REQUIRE(!overlaps(alloc, Allocation{.pos = node.pos, .size = node.size}));
+		}
+		for (auto [other_id, other] : allocator.allocations) {
+			REQUIRE((other_id == id || !overlaps(alloc, *other)));
+		}
+	}
+	REQUIRE(used_area + allocator.free_area() == allocator.size.x * allocator.size.y);
+}
+
+// Glyph-like sizes
+struct GlyphSizes
+{
+	exo::tests::Random random = {.state = 1};
+
+	int2 next()
+	{
+		const u32 value  = random.next_u32();
+		const i32 width  = 4 + i32((value >> 8) % 20);
+		const i32 height = 8 + i32((value >> 16) % 16);
+		return int2(width, height);
+	}
+};
+
+TEST_CASE("GuillotineAllocator alloc and free", "[atlas_allocator]")
+{
+	GuillotineAllocator allocator = {};
+	allocator.size                = int2(256, 256);
+
+	Vec<AllocationId> ids;
+	GlyphSizes        sizes = {};
+	for (u32 i = 0; i < 200; ++i) {
+		auto id = allocator.alloc(sizes.next());
+		REQUIRE(id.is_valid());
+		ids.push(id);
+	}
+	check_allocations(allocator);
+
+	// Does not fit
+	REQUIRE(!allocator.alloc(int2(257, 1)).is_valid());
+
+	// The free nodes are merged back into the whole atlas
+	for (u32 i = 0; i < ids.len(); i += 2) {
+		REQUIRE(allocator.unref(ids[i]));
+	}
+	check_allocations(allocator);
+	for (u32 i = 1; i < ids.len(); i += 2) {
+		REQUIRE(allocator.unref(ids[i]));
+	}
+	REQUIRE(allocator.free_nodes.len() == 1);
+	REQUIRE(allocator.largest_free_area() == 256 * 256);
+
+	auto full = allocator.alloc(int2(256, 256));
+	REQUIRE(full.is_valid());
+	REQUIRE(allocator.get(full).pos == int2(0, 0));
+
+	ids.buffer.destroy();
+}
+
+TEST_CASE("GuillotineAllocator defragment", "[atlas_allocator]")
+{
+	GuillotineAllocator allocator = {};
+	allocator.size                = int2(128, 128);
+
+	Vec<AllocationId> ids;
+	for (u32 i = 0; i < 64; ++i) {
+		ids.push(allocator.alloc(int2(16, 16)));
+		REQUIRE(ids.last().is_valid());
+	}
+	REQUIRE(!allocator.alloc(int2(16, 16)).is_valid());
+
+	// Free one slot out of two, no 32x32 rect is free
+	for (u32 i = 0; i < ids.len(); i += 2) {
+		allocator.unref(ids[i]);
+	}
+	REQUIRE(!allocator.alloc(int2(32, 32)).is_valid());
+
+	Vec<AllocationMove> moves;
+	u32                 total_moves = 0;
+	while (u32 move_count = allocator.defragment(4, moves)) {
+		REQUIRE(move_count <= 4);
+		total_moves += move_count;
+		check_allocations(allocator);
+	}
+	REQUIRE(total_moves == moves.len());
+	REQUIRE(total_moves > 0);
+
+	// The moved allocations keep their id and went toward the top
+	for (const auto &move : moves) {
+		const auto &alloc = allocator.get(move.id);
+		REQUIRE((alloc.pos.y < move.old_pos.y || (alloc.pos.y == move.old_pos.y && alloc.pos.x < move.old_pos.x)));
+	}
+
+	REQUIRE(allocator.largest_free_area() >= 64 * 64);
+	REQUIRE(allocator.alloc(int2(32, 32)).is_valid());
+
+	moves.buffer.destroy();
+	ids.buffer.destroy();
+}
+
+struct ChurnResult
+{
+	float occupancy = 0.0f; // average occupancy of the atlas when an allocation fails, higher is better
+	u32   failures  = 0;    // glyphs that did not fit in an empty atlas
+	u32   moves     = 0;
+};
+
+// Replace random glyphs forever like the glyph cache does, and measure how full the atlas is when an allocation fails
+template <typename Allocator>
+static ChurnResult churn(Allocator &allocator, u32 defragment_moves)
+{
+	GlyphSizes         sizes     = {};
+	Vec<AllocationId>  live      = {};
+	exo::tests::Random random    = {.state = 7};
+	i32                live_area = 0;
+	u32                samples   = 0;
+	ChurnResult        result    = {};
+
+	for (u32 i_alloc = 0; i_alloc < 100'000; ++i_alloc) {
+		const int2 size = sizes.next();
+		auto       id   = allocator.alloc(size);
+
+		// Evict until it fits
+		while (!id.is_valid() && !live.is_empty()) {
+			result.occupancy += float(live_area) / float(allocator.size.x * allocator.size.y);
+			samples += 1;
+
+			const u32   i_evict = (random.next_u32() >> 8) % live.len();
+			const auto &alloc   = allocator.get(live[i_evict]);
+			live_area -= alloc.size.x * alloc.size.y;
+			allocator.unref(live[i_evict]);
+			live.swap_remove(i_evict);
+
+			id = allocator.alloc(size);
+		}
+
+		if (!id.is_valid()) {
+			result.failures += 1;
+			continue;
+		}
+
+		live.push(id);
+		live_area += size.x * size.y;
+
+		if constexpr (requires { allocator.defragment(0u, std::declval<Vec<AllocationMove> &>()); }) {
+			if (defragment_moves > 0 && i_alloc % 64 == 0) {
+				Vec<AllocationMove> moves;
+				result.moves += allocator.defragment(defragment_moves, moves);
+				moves.buffer.destroy();
+			}
+		}
+	}
+
+	live.buffer.destroy();
+	result.occupancy = samples ? result.occupancy / float(samples) : 1.0f;
+	return result;
+}
+
+TEST_CASE("Atlas allocators packing benchmark", "[.][atlas_allocator][benchmark]")
+{
+	ShelfAllocator shelf    = {};
+	shelf.size              = int2(512, 512);
+	const auto shelf_result = churn(shelf, 0);
+
+	GuillotineAllocator guillotine = {};
+	guillotine.size                = int2(512, 512);
+	const auto guillotine_result   = churn(guillotine, 0);
+
+	GuillotineAllocator defragmented = {};
+	defragmented.size                = int2(512, 512);
+	const auto defragmented_result   = churn(defragmented, 16);
+
+	// Shown when the packing regresses
+	INFO("shelf occupancy " << shelf_result.occupancy);
+	INFO("guillotine occupancy " << guillotine_result.occupancy);
+	INFO("guillotine + defragment occupancy " << defragmented_result.occupancy << ", " << defragmented_result.moves
+											  << " moves");
+
+	REQUIRE(guillotine_result.failures == 0);
+	REQUIRE(defragmented_result.failures == 0);
+	REQUIRE(guillotine_result.occupancy > shelf_result.occupancy);
+}
@@ -0,0 +1,69 @@
+#include "painter/font.h"
+#include "painter/glyph_cache.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+
+// Every glyph takes a 16x16 rect in the atlas with its padding
+static void square_rasterizer(Font &, u32, u32, GlyphImage &out_image, GlyphMetrics &)
+{
+	out_image.image_size = uint2(14, 14);
+	out_image.data_size  = 14 * 14;
+	out_image.data       = std::malloc(out_image.data_size);
+}
+
+TEST_CASE("GlyphCache drops the moves of evicted glyphs", "[glyph_cache]")
+{
+	// The faces are only used as keys
+	int  faces[2] = {};
+	Font font_a   = {.hb_font = reinterpret_cast<hb_font_t *>(&faces[0]), .size_in_pt = 12};
+	Font font_b   = {.hb_font = reinterpret_cast<hb_font_t *>(&faces[1]), .size_in_pt = 12};
+
+	GlyphCache cache     = {};
+	cache.allocator.size = int2(64, 64);
+	cache.rasterizer     = square_rasterizer;
+
+	const auto upload_all = [](const GlyphEvent &, const GlyphImage *, int2) { return true; };
+
+	// Fill the atlas with both fonts, then free one glyph out of two
+	for (u32 i_glyph = 0; i_glyph < 16; ++i_glyph) {
+		REQUIRE(cache.queue_glyph(i_glyph % 2 ? font_b : font_a, i_glyph, nullptr).has_value());
+	}
+	cache.evict_font(font_b);
+	cache.process_events(upload_all);
+	REQUIRE(cache.events.is_empty());
+
+	cache.defragment(16);
+	Vec<Handle<GlyphEntry>> moved_glyphs = {};
+	for (const auto &event : cache.events) {
+		REQUIRE(event.type == GlyphEvent::Type::Moved);
+		moved_glyphs.push(event.glyph_handle);
+	}
+	REQUIRE(!moved_glyphs.is_empty());
+
+	// The glyphs of font_a are the least recently used, filling the atlas evicts them after their move
+	for (u32 i_glyph = 0; i_glyph < 16; ++i_glyph) {
+		REQUIRE(cache.queue_glyph(font_b, 100 + i_glyph, nullptr).has_value());
+	}
+	REQUIRE(cache.lru_cache.size == 16);
+
+	u32 evicted = 0;
+	cache.process_events([&](const GlyphEvent &event, const GlyphImage *image, int2) {
+		for (auto moved_glyph : moved_glyphs) {
+			if (event.glyph_handle == moved_glyph) {
+				REQUIRE(event.type == GlyphEvent::Type::Evicted);
+				evicted += 1;
+			}
+		}
+		if (event.type == GlyphEvent::Type::New) {
+			REQUIRE(image != nullptr);
+		}
+		return true;
+	});
+	REQUIRE(evicted == moved_glyphs.len());
+
+	cache.evict_font(font_b);
+	REQUIRE(cache.lru_cache.size == 0);
+	moved_glyphs.buffer.destroy();
+	cache.destroy();
+}
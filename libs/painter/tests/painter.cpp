@@ -0,0 +1,193 @@
+#include "painter/painter.h"
+#include <catch2/catch_test_macros.hpp>
+
+// The primitives are identified by the x position of their rect
+static Rect rect_at(float id) { return Rect{.pos = float2(id, 0.0f), .size = float2(10.0f, 10.0f)}; }
+
+struct TestPainter
+{
+	alignas(16) u8 vertex_data[16 * 1024] = {};
+	PrimitiveIndex index_data[1024]       = {};
+	Painter        painter                = {};
+
+	TestPainter()
+	{
+		this->painter = Painter::create({this->vertex_data, sizeof(this->vertex_data)}, {this->index_data, 1024}, int2(64, 64));
+		this->painter.mode = PainterMode::Batched;
+		this->painter.begin_frame();
+	}
+
+	~TestPainter() { this->painter.destroy(); }
+
+	// Returns the rect drawn by the i-th index
+	const Rect &drawn_rect(u32 i_index) const
+	{
+		const auto index    = this->painter.index_buffer[i_index];
+		const auto vertices = exo::Span<const u8>(this->painter.vertex_buffer);
+		if (index.bits.type == RectType_Color) {
+			return exo::reinterpret_span<const ColorRect>(vertices)[index.bits.index].rect;
+		} else if (index.bits.type == RectType_Textured) {
+			return exo::reinterpret_span<const TexturedRect>(vertices)[index.bits.index].rect;
+		}
+		return exo::reinterpret_span<const SdfRect>(vertices)[index.bits.index].rect;
+	}
+
+	u32 drawn_type(u32 i_index) const { return this->painter.index_buffer[i_index].bits.type; }
+};
+
+TEST_CASE("Painter batched mode sorts the primitives", "[painter]")
+{
+	TestPainter test;
+	auto       &painter = test.painter;
+
+	const auto color = ColorU32::from_uints(255, 255, 255);
+	const auto uv    = Rect{.pos = float2(0.0f), .size = float2(1.0f)};
+	const u32  clip0 = painter.register_clip_rect(Rect{.pos = float2(0.0f), .size = float2(1000.0f)});
+	const u32  clip1 = painter.register_clip_rect(Rect{.pos = float2(0.0f), .size = float2(500.0f)});
+
+	painter.draw_textured_rect(rect_at(1.0f), clip1, uv, 2);
+	painter.draw_color_rect(rect_at(2.0f), clip0, color);
+	painter.draw_textured_rect(rect_at(3.0f), clip1, uv, 1);
+	painter.draw_color_round_rect(rect_at(4.0f), clip1, color, color, 1);
+	painter.draw_textured_rect(rect_at(5.0f), clip0, uv, 1);
+	painter.draw_color_rect(rect_at(6.0f), clip1, color);
+	painter.draw_color_circle(rect_at(7.0f), clip0, color, color, 1);
+
+	painter.layer += 1;
+	painter.draw_textured_rect(rect_at(8.0f), clip0, uv, 0);
+	painter.draw_color_rect(rect_at(9.0f), clip0, color);
+
+	painter.end_frame();
+
+	// One index per rect
+	REQUIRE(painter.index_offset == 9);
+
+	// The shapes of a layer keep their order, the textured rects come after them sorted by texture then clip rect.
+	const float expected_ids[]   = {2.0f, 4.0f, 6.0f, 7.0f, 5.0f, 3.0f, 1.0f, 9.0f, 8.0f};
+	const u32   expected_types[] = {
+		RectType_Color,
+		RectType_Sdf_RoundRectangle,
+		RectType_Color,
+		RectType_Sdf_Circle,
+		RectType_Textured,
+		RectType_Textured,
+		RectType_Textured,
+		RectType_Color,
+		RectType_Textured,
+	};
+	for (u32 i_index = 0; i_index < painter.index_offset; ++i_index) {
+		REQUIRE(test.drawn_type(i_index) == expected_types[i_index]);
+		REQUIRE(test.drawn_rect(i_index).pos.x == expected_ids[i_index]);
+		REQUIRE(painter.index_buffer[i_index].bits.corner == 0);
+	}
+
+	// The clip rects are at the start of the vertex buffer, the primitives reference them by index
+	REQUIRE(painter.get_clip_rect(clip1).size.x == 500.0f);
+	const auto vertices = exo::Span<const u8>(painter.vertex_buffer);
+	REQUIRE(exo::reinterpret_span<const Rect>(vertices)[clip1].size.x == 500.0f);
+}
+
+TEST_CASE("Painter batched mode writes each stream after the previous one", "[painter]")
+{
+	TestPainter test;
+	auto       &painter = test.painter;
+
+	const auto color = ColorU32::from_uints(255, 0, 0);
+	const auto uv    = Rect{.pos = float2(0.0f), .size = float2(1.0f)};
+	// An odd number of clip rects misaligns the next stream
+	for (u32 i_clip = 0; i_clip < 3; ++i_clip) {
+		painter.register_clip_rect(Rect{.pos = float2(0.0f), .size = float2(100.0f)});
+	}
+	for (u32 i_rect = 0; i_rect < 4; ++i_rect) {
+		painter.draw_textured_rect(rect_at(float(10 + i_rect)), u32_invalid, uv, 0);
+		painter.draw_color_rect(rect_at(float(20 + i_rect)), u32_invalid, color);
+		painter.draw_color_round_rect(rect_at(float(30 + i_rect)), u32_invalid, color, color, 0);
+	}
+	painter.end_frame();
+
+	REQUIRE(painter.index_offset == 12);
+	REQUIRE(painter.vertex_bytes_offset % sizeof(TexturedRect) == 0);
+
+	// Each primitive index points after the clip rects and the streams written before its type
+	u32 i_color = 0;
+	u32 i_sdf   = 0;
+	u32 i_tex   = 0;
+	for (u32 i_index = 0; i_index < painter.index_offset; ++i_index) {
+		const auto  index = painter.index_buffer[i_index];
+		const float id    = test.drawn_rect(i_index).pos.x;
+		if (index.bits.type == RectType_Color) {
+			REQUIRE(index.bits.index * sizeof(ColorRect) >= 3 * sizeof(Rect));
+			REQUIRE(id == float(20 + i_color++));
+		} else if (index.bits.type == RectType_Sdf_RoundRectangle) {
+			REQUIRE(index.bits.index * sizeof(SdfRect) >= 3 * sizeof(Rect) + 4 * sizeof(ColorRect));
+			REQUIRE(id == float(30 + i_sdf++));
+		} else {
+			REQUIRE(index.bits.type == RectType_Textured);
+			REQUIRE(index.bits.index * sizeof(TexturedRect) >=
+					3 * sizeof(Rect) + 4 * sizeof(ColorRect) + 4 * sizeof(SdfRect));
+			REQUIRE(id == float(10 + i_tex++));
+		}
+	}
+	REQUIRE(i_color == 4);
+	REQUIRE(i_sdf == 4);
+	REQUIRE(i_tex == 4);
+
+	// The next frame starts from empty streams
+	painter.begin_frame();
+	painter.draw_color_rect(rect_at(1.0f), u32_invalid, color);
+	painter.end_frame();
+	REQUIRE(painter.index_offset == 1);
+	REQUIRE(test.drawn_rect(0).pos.x == 1.0f);
+}
+
+TEST_CASE("Painter batched mode draws the text of a layer under the shapes of the next one", "[painter]")
+{
+	TestPainter test;
+	auto       &painter = test.painter;
+
+	// Two floating areas: a background and its text each
+	const auto uv = Rect{.pos = float2(0.0f), .size = float2(1.0f)};
+	painter.draw_color_rect(rect_at(1.0f), u32_invalid, ColorU32::from_uints(0, 0, 0));
+	painter.draw_textured_rect(rect_at(2.0f), u32_invalid, uv, 0);
+	painter.layer += 1;
+	painter.draw_color_rect(rect_at(3.0f), u32_invalid, ColorU32::from_uints(0, 0, 0));
+	painter.draw_textured_rect(rect_at(4.0f), u32_invalid, uv, 0);
+	painter.end_frame();
+
+	REQUIRE(painter.index_offset == 4);
+	for (u32 i_index = 0; i_index < 4; ++i_index) {
+		REQUIRE(test.drawn_rect(i_index).pos.x == float(1 + i_index));
+	}
+}
+
+TEST_CASE("Painter culls the primitives outside of their clip rect", "[painter]")
+{
+	TestPainter test;
+	auto       &painter = test.painter;
+
+	const auto color = ColorU32::from_uints(0, 255, 0);
+	const auto uv    = Rect{.pos = float2(0.0f), .size = float2(1.0f)};
+	const u32  clip  = painter.register_clip_rect(Rect{.pos = float2(0.0f), .size = float2(50.0f)});
+
+	const auto outside = Rect{.pos = float2(100.0f), .size = float2(10.0f)};
+	painter.draw_color_rect(outside, clip, color);
+	painter.draw_textured_rect(outside, clip, uv, 0);
+	painter.draw_color_round_rect(outside, clip, color, color, 1);
+	painter.draw_color_circle(outside, clip, color, color, 1);
+	REQUIRE(painter.clipped_primitives == 4);
+
+	// Partially visible, or without clip rect
+	painter.draw_color_rect(Rect{.pos = float2(45.0f), .size = float2(10.0f)}, clip, color);
+	painter.draw_color_rect(outside, u32_invalid, color);
+	// Invisible rects are not drawn and not counted
+	painter.draw_color_rect(outside, clip, ColorU32::from_uints(0, 0, 0, 0));
+
+	REQUIRE(painter.clipped_primitives == 4);
+	REQUIRE(painter.commands.len() == 2);
+
+	painter.end_frame();
+	REQUIRE(painter.index_offset == 2);
+
+	painter.begin_frame();
+	REQUIRE(painter.clipped_primitives == 0);
+}
@@ -0,0 +1,94 @@
+#include "painter/font.h"
+#include "painter/painter.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <hb.h>
+
+// The empty face shapes every character to the notdef glyph, it is enough to test the cache
+static Font create_test_font(i32 size_in_pt)
+{
+	return Font{.hb_font = hb_font_create(hb_face_get_empty()), .size_in_pt = size_in_pt};
+}
+
+TEST_CASE("ShapeContext hits runs with the same content", "[shape_context]")
+{
+	Font font       = create_test_font(12);
+	Font other_font = create_test_font(12);
+	auto context    = ShapeContext::create();
+
+	const auto &run = context.get_run(font, "hello");
+	REQUIRE(run.glyph_count == 5);
+	REQUIRE(context.stats.misses == 1);
+
+	// Same text at another address
+	const char  text[] = "say hello";
+	const auto &hit    = context.get_run(font, exo::StringView{text + 4, 5});
+	REQUIRE(&hit == &run);
+	REQUIRE(context.stats.hits == 1);
+
+	// The face and the size are part of the key
+	context.get_run(other_font, "hello");
+	font.size_in_pt = 13;
+	context.get_run(font, "hello");
+	REQUIRE(context.stats.misses == 3);
+	REQUIRE(context.runs.size == 3);
+
+	context.destroy();
+	REQUIRE(context.runs.size == 0);
+	REQUIRE(context.run_indices.size == 0);
+	REQUIRE(context.free_buffers.is_empty());
+	hb_font_destroy(other_font.hb_font);
+	hb_font_destroy(font.hb_font);
+}
+
+TEST_CASE("ShapeContext evicts the least recently used run", "[shape_context]")
+{
+	Font font    = create_test_font(12);
+	auto context = ShapeContext::create(2);
+
+	context.get_run(font, "a");
+	context.get_run(font, "bb");
+	context.get_run(font, "a");
+	REQUIRE(context.stats.hits == 1);
+
+	// "bb" is the least recently used
+	const auto &run = context.get_run(font, "ccc");
+	REQUIRE(run.glyph_count == 3);
+	REQUIRE(context.stats.evictions == 1);
+	REQUIRE(context.runs.size == 2);
+	// The buffer of the evicted run was reused
+	REQUIRE(context.free_buffers.is_empty());
+
+	context.get_run(font, "a");
+	REQUIRE(context.stats.hits == 2);
+	context.get_run(font, "bb");
+	REQUIRE(context.stats.misses == 4);
+	REQUIRE(context.stats.evictions == 2);
+	REQUIRE(context.runs.size == 2);
+
+	context.destroy();
+	hb_font_destroy(font.hb_font);
+}
+
+TEST_CASE("ShapeContext replaces a run when the hashes collide", "[shape_context]")
+{
+	Font font    = create_test_font(12);
+	auto context = ShapeContext::create();
+
+	auto &run = const_cast<CachedRun &>(context.get_run(font, "abc"));
+	// The cached run looks like another text with the same hash
+	run.text[0] = 'x';
+
+	const auto &replaced = context.get_run(font, "abc");
+	REQUIRE(context.stats.hits == 0);
+	REQUIRE(context.stats.misses == 2);
+	REQUIRE(context.stats.evictions == 0);
+	REQUIRE(context.runs.size == 1);
+	REQUIRE(exo::StringView{replaced.text, replaced.text_len} == exo::StringView{"abc"});
+
+	REQUIRE(&context.get_run(font, "abc") == &replaced);
+	REQUIRE(context.stats.hits == 1);
+
+	context.destroy();
+	hb_font_destroy(font.hb_font);
+}
@@ -44,4 +44,7 @@ struct RingBuffer
 	// uniform buffer
 	std::pair<exo::Span<u8>, usize> allocate(usize len, usize subalignment = 256);
 	void                            start_frame();
+	// Keep the allocations of the previous frames alive as long as the allocations of the current frame, used when
+	// the content of an older allocation is still written or consumed by a later frame
+	void retain_previous_frames();
 };
@@ -102,3 +102,16 @@ void RingBuffer::start_frame()
 	}
 	this->frame_size_allocated[this->i_frame % frame_count] = 0;
 }
+
+void RingBuffer::retain_previous_frames()
+{
+	// The tail moves in allocation order, older allocations can only be kept by releasing them with the current frame
+	const usize frame_count   = this->frame_size_allocated.len();
+	const usize current_frame = this->i_frame % frame_count;
+	for (usize i_frame_slot = 0; i_frame_slot < frame_count; ++i_frame_slot) {
+		if (i_frame_slot != current_frame) {
+			this->frame_size_allocated[current_frame] += this->frame_size_allocated[i_frame_slot];
+			this->frame_size_allocated[i_frame_slot] = 0;
+		}
+	}
+}
@@ -66,12 +66,13 @@ SimpleRenderer SimpleRenderer::create(u64 display_handle, u64 window_handle)
 			.frame_queue_length = FRAME_QUEUE_LENGTH,
 		});
 
+	// Uploads can be filled asynchronously and copied during the next frame, keep them one more frame
 	renderer.upload_buffer = RingBuffer::create(device,
 		{
 			.name = "Upload buffer",
 			.size = 128_MiB,
 			.gpu_usage = vulkan::source_buffer_usage,
-			.frame_queue_length = FRAME_QUEUE_LENGTH,
+			.frame_queue_length = FRAME_QUEUE_LENGTH + 1,
 		});
 
 	// Create the drawing surface
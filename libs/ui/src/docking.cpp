@@ -93,12 +93,17 @@ void begin_docking(Docking &self, ui::Ui &ui, Rect rect)
 void end_docking(Docking &self, ui::Ui &ui)
 {
 	draw_area_rec(self, ui, self.root);
+
+	// Floating areas and overlays are drawn on top of the docked areas, each floating area has its own layer so that
+	// its background covers the text of the ones below
 	for (usize i = 0; i < self.floating_containers.len(); ++i) {
+		ui.painter->layer += 1;
 		draw_floating_area(self, ui, i);
 	}
 
 	draw_docking(self, ui);
 
+	ui.painter->layer += 1;
 	for (auto [area_handle, area] : self.area_pool) {
 		draw_area_overlay(self, ui, area_handle);
 	}
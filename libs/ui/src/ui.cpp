@@ -51,30 +51,14 @@ bool Ui::has_clicked(u64 id, cross::MouseButton button) const
 	return this->has_pressed_and_released(button) && this->activation.focused == id && this->activation.active == id;
 }
 
-const Rect &Ui::current_clip_rect() const
-{
-	return exo::reinterpret_span<Rect>(this->painter->vertex_buffer)[this->state.current_clip_rect];
-}
+const Rect &Ui::current_clip_rect() const { return this->painter->get_clip_rect(this->state.current_clip_rect); }
 
 bool Ui::is_clipped(const Rect &rect) const { return !rect.intersects(this->current_clip_rect()); }
 
 u32 Ui::register_clip_rect(const Rect &clip_rect)
 {
 	EXO_PROFILE_SCOPE;
-
-	this->painter->draw_color_rect(clip_rect, u32_invalid, ColorU32::from_uints(0, 0, 0xFF, 0x88));
-
-	auto i_first_rect_index = this->painter->index_offset - 6;
-	this->painter->index_buffer[i_first_rect_index++].bits.type = RectType_Clip;
-	this->painter->index_buffer[i_first_rect_index++].bits.type = RectType_Clip;
-	this->painter->index_buffer[i_first_rect_index++].bits.type = RectType_Clip;
-	this->painter->index_buffer[i_first_rect_index++].bits.type = RectType_Clip;
-	this->painter->index_buffer[i_first_rect_index++].bits.type = RectType_Clip;
-	this->painter->index_buffer[i_first_rect_index++].bits.type = RectType_Clip;
-
-	const usize last_color_rect_offset = this->painter->vertex_bytes_offset - sizeof(ColorRect);
-	ASSERT(last_color_rect_offset % sizeof(Rect) == 0);
-	return static_cast<u32>(last_color_rect_offset / sizeof(Rect));
+	return this->painter->register_clip_rect(clip_rect);
 }
 
 void Ui::push_clip_rect(u32 i_clip_rect)
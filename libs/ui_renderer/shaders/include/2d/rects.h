@@ -60,5 +60,6 @@ BINDLESS_BUFFER ColorRectBuffer    { ColorRect rects[];  } global_buffers_color_
 BINDLESS_BUFFER TexturedRectBuffer { TexturedRect rects[];  } global_buffers_textured_rects[];
 BINDLESS_BUFFER RectBuffer         { Rect rects[];  } global_buffers_rects[];
 BINDLESS_BUFFER SdfBuffer          { SdfRect rects[];  } global_buffers_sdf_rects[];
+BINDLESS_BUFFER PrimitiveIndexBuffer { u32 indices[]; } global_buffers_primitive_indices[];
 
 #endif
@@ -9,6 +9,7 @@ layout(set = SHADER_UNIFORM_SET, binding = 0) uniform Options {
     float2 translation;
     u32 vertices_descriptor_index;
     u32 primitive_bytes_offset;
+    u32 instance_indices_offset;
 };
 
 bool is_in_rect(float2 pos, Rect rect)
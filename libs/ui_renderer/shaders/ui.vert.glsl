@@ -9,6 +9,7 @@ layout(set = SHADER_UNIFORM_SET, binding = 0) uniform Options {
     float2 translation;
     u32 vertices_descriptor_index;
     u32 primitive_bytes_offset;
+    u32 instance_indices_offset;
 };
 
 void textured_rect(out float2 o_position, out float2 o_uv, u32 i_primitive, u32 corner)
@@ -71,9 +72,18 @@ layout(location = 0) out float2 o_uv;
 layout(location = 1) out flat u32 o_primitive_index;
 void main()
 {
-    u32 i_primitive    = gl_VertexIndex & 0x00ffffff;
-    u32 corner         = (gl_VertexIndex & 0x03000000) >> 24;
-    u32 primitive_type = (gl_VertexIndex & 0xfc000000) >> 26;
+    u32 primitive_index = gl_VertexIndex;
+    // Batched painter: one index per rect, the quad corners come from the vertex index
+    if (instance_indices_offset != u32_invalid)
+    {
+        const u32 corners[6] = u32[](0, 1, 2, 2, 3, 0);
+        primitive_index = global_buffers_primitive_indices[vertices_descriptor_index].indices[instance_indices_offset + gl_InstanceIndex];
+        primitive_index |= corners[gl_VertexIndex] << 24;
+    }
+
+    u32 i_primitive    = primitive_index & 0x00ffffff;
+    u32 corner         = (primitive_index & 0x03000000) >> 24;
+    u32 primitive_type = (primitive_index & 0xfc000000) >> 26;
 
     float2 position = float2(0.0);
     float2 uv = float2(0.0);
@@ -98,5 +108,5 @@ void main()
 
     gl_Position = float4(position * scale + translation, 0.0, 1.0);
     o_uv = uv;
-    o_primitive_index = gl_VertexIndex;
+    o_primitive_index = primitive_index;
 }
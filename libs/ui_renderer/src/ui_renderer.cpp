@@ -36,7 +36,9 @@ GraphicPass &register_graph(RenderGraph &graph, UiRenderer &renderer, Painter *p
 	graph.raw_pass([painter, glyph_atlas](RenderGraph & /*graph*/, PassApi &api, vulkan::ComputeWork &cmd) {
 		Vec<VkBufferImageCopy> glyphs_to_upload;
 		painter->glyph_cache.process_events([&](const GlyphEvent &event, const GlyphImage *image, int2 pos) {
-			if (event.type == GlyphEvent::Type::New && image) {
+			// Moved glyphs are uploaded again from their image instead of being copied inside of the atlas
+			const bool needs_upload = event.type == GlyphEvent::Type::New || event.type == GlyphEvent::Type::Moved;
+			if (needs_upload && image) {
 				auto [p_image, image_offset] = api.upload_buffer.allocate(image->data_size);
 				if (p_image.empty()) {
 					return false;
@@ -88,16 +90,21 @@ GraphicPass &register_graph(RenderGraph &graph, UiRenderer &renderer, Painter *p
 			ASSERT(vert_offset % sizeof(ColorRect) == 0);
 			ASSERT(vert_offset % sizeof(Rect) == 0);
 
-			auto [p_indices, ind_offset] =
-				api.dynamic_index_buffer.allocate(painter->index_offset * sizeof(PrimitiveIndex),
-					sizeof(PrimitiveIndex));
-			std::memcpy(p_indices.data(), painter->index_buffer.data(), painter->index_offset * sizeof(PrimitiveIndex));
+			// The batched painter has one index per rect, they are read by the vertex shader from the storage buffer
+			const bool is_batched = painter->mode == PainterMode::Batched;
+			const usize indices_size = painter->index_offset * sizeof(PrimitiveIndex);
+			auto [p_indices, ind_offset] = is_batched
+				? api.dynamic_vertex_buffer.allocate(indices_size, sizeof(PrimitiveIndex))
+				: api.dynamic_index_buffer.allocate(indices_size, sizeof(PrimitiveIndex));
+			ASSERT(!p_indices.empty());
+			std::memcpy(p_indices.data(), painter->index_buffer.data(), indices_size);
 
 			PACKED(struct PainterOptions {
 				float2 scale;
 				float2 translation;
 				u32 vertices_descriptor_index;
 				u32 primitive_byte_offset;
+				u32 instance_indices_offset;
 			})
 
 			auto output_size = graph.image_size(output);
@@ -107,9 +114,15 @@ GraphicPass &register_graph(RenderGraph &graph, UiRenderer &renderer, Painter *p
 			options[0].vertices_descriptor_index =
 				api.device.get_buffer_storage_index(api.dynamic_vertex_buffer.buffer);
 			options[0].primitive_byte_offset = static_cast<u32>(vert_offset);
+			options[0].instance_indices_offset =
+				is_batched ? static_cast<u32>(ind_offset / sizeof(PrimitiveIndex)) : u32_invalid;
 
 			cmd.bind_pipeline(ui_program, 0);
-			cmd.bind_index_buffer(api.dynamic_index_buffer.buffer, VK_INDEX_TYPE_UINT32, ind_offset);
-			cmd.draw_indexed({.vertex_count = painter->index_offset});
+			if (is_batched) {
+				cmd.draw({.vertex_count = 6, .instance_count = painter->index_offset});
+			} else {
+				cmd.bind_index_buffer(api.dynamic_index_buffer.buffer, VK_INDEX_TYPE_UINT32, ind_offset);
+				cmd.draw_indexed({.vertex_count = painter->index_offset});
+			}
 		});
 }